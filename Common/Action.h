@@ -2,6 +2,8 @@
 
 #include <vector>
 
+class PointerWrap;
+
 // Sometimes you want to set something to happen later, without that later place really needing
 // to know about all the things that might happen. That's when you use an Action, and add it
 // to the appropriate ActionSet.
@@ -17,4 +19,9 @@ class Action
 public:
   virtual ~Action() {}
   virtual void run() = 0;
+
+  // For save states. Actions that can be saved return a nonzero type, which their
+  // owner uses to make an empty one again when loading.
+  virtual int GetType() const { return 0; }
+  virtual void DoState(PointerWrap &p) {}
 };
@@ -59,9 +59,13 @@ inline u32 AtomicLoad(volatile u32& src) {
 inline u32 AtomicLoadAcquire(volatile u32& src) {
 	//keep the compiler from caching any memory references
 	u32 result = src; // 32-bit reads are always atomic.
-	//__sync_synchronize(); // TODO: May not be necessary.
+#if defined(_M_IX86) || defined(_M_X64)
 	// Compiler instruction only. x86 loads always have acquire semantics.
 	__asm__ __volatile__ ( "":::"memory" );
+#else
+	// ARM may do later loads before this one, they'd see data older than result.
+	__sync_synchronize();
+#endif
 	return result;
 }
 
@@ -73,7 +77,24 @@ inline void AtomicStore(volatile u32& dest, u32 value) {
 	dest = value; // 32-bit writes are always atomic.
 }
 inline void AtomicStoreRelease(volatile u32& dest, u32 value) {
-	__sync_lock_test_and_set(&dest, value); // TODO: Wrong! This function is has acquire semantics.
+#if defined(_M_IX86) || defined(_M_X64)
+	// Compiler instruction only. x86 stores are never reordered with earlier stores.
+	__asm__ __volatile__ ( "":::"memory" );
+#else
+	// Earlier stores have to be visible before this one is.
+	__sync_synchronize();
+#endif
+	dest = value; // 32-bit writes are always atomic.
+}
+
+// Returns true if dest was comparand and got replaced. Full barrier.
+inline bool AtomicCompareAndSwap(volatile u32& dest, u32 comparand, u32 value) {
+	return __sync_bool_compare_and_swap(&dest, comparand, value);
+}
+
+// Returns the old value. Acquire semantics.
+inline u32 AtomicExchange(volatile u32& dest, u32 value) {
+	return __sync_lock_test_and_set(&dest, value);
 }
 
 }
@@ -80,6 +80,16 @@ inline void AtomicStoreRelease(volatile u32& dest, u32 value) {
 	dest = value; // 32-bit writes are always atomic.
 }
 
+// Returns true if dest was comparand and got replaced. Full barrier.
+inline bool AtomicCompareAndSwap(volatile u32& dest, u32 comparand, u32 value) {
+	return (u32)InterlockedCompareExchange((volatile LONG*)&dest, (LONG)value, (LONG)comparand) == comparand;
+}
+
+// Returns the old value. Full barrier.
+inline u32 AtomicExchange(volatile u32& dest, u32 value) {
+	return (u32)InterlockedExchange((volatile LONG*)&dest, (LONG)value);
+}
+
 }
 
 #endif
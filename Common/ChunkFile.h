@@ -28,6 +28,8 @@
 // - Serialization code for anything complex has to be manually written.
 
 #include <map>
+#include <list>
+#include <set>
 #include <vector>
 #include <deque>
 #include <string>
@@ -52,12 +54,18 @@ public:
 		MODE_VERIFY, // compare
 	};
 
+	enum Error {
+		ERROR_NONE = 0,
+		ERROR_FAILURE, // the data can't be used, whatever was loaded so far is inconsistent
+	};
+
 	u8 **ptr;
 	Mode mode;
+	Error error;
 
 public:
-	PointerWrap(u8 **ptr_, Mode mode_) : ptr(ptr_), mode(mode_) {}
-	PointerWrap(unsigned char **ptr_, int mode_) : ptr((u8**)ptr_), mode((Mode)mode_) {}
+	PointerWrap(u8 **ptr_, Mode mode_) : ptr(ptr_), mode(mode_), error(ERROR_NONE) {}
+	PointerWrap(unsigned char **ptr_, int mode_) : ptr((u8**)ptr_), mode((Mode)mode_), error(ERROR_NONE) {}
 
 	void SetMode(Mode mode_) {mode = mode_;}
 	Mode GetMode() const {return mode;}
@@ -119,7 +127,8 @@ public:
 		u32 vec_size = (u32)x.size();
 		Do(vec_size);
 		x.resize(vec_size);
-		DoArray(&x[0], vec_size);
+		if (vec_size > 0)
+			DoArray(&x[0], vec_size);
 	}
 	
 	// Store deques.
@@ -134,6 +143,45 @@ public:
 			DoVoid(&x[i],sizeof(T));
 	}
 	
+	// Store lists.
+	template<class T>
+	void Do(std::list<T> &x)
+	{
+		u32 list_size = (u32)x.size();
+		Do(list_size);
+		x.resize(list_size);
+		typename std::list<T>::iterator itr, end;
+		for (itr = x.begin(), end = x.end(); itr != end; ++itr)
+			Do(*itr);
+	}
+
+	// Store sets.
+	template<class T>
+	void Do(std::set<T> &x)
+	{
+		u32 number = (u32)x.size();
+		Do(number);
+		if (mode == MODE_READ)
+		{
+			x.clear();
+			for (u32 i = 0; i < number; ++i)
+			{
+				T item = T();
+				Do(item);
+				x.insert(item);
+			}
+		}
+		else
+		{
+			typename std::set<T>::iterator itr, end;
+			for (itr = x.begin(), end = x.end(); itr != end; ++itr)
+			{
+				T item = *itr;
+				Do(item);
+			}
+		}
+	}
+
 	// Store strings.
 	void Do(std::string &x) 
 	{
@@ -242,6 +290,37 @@ public:
 		}
 	}
 
+	// Starts a versioned section. Returns the version the data was saved with, or 0 (and
+	// stops reading, like DoMarker) if the title doesn't match or the version is outside
+	// [minVer, ver]. Bump ver when a section's layout changes, minVer when old data can't
+	// be read anymore.
+	int Section(const char *title, int minVer, int ver)
+	{
+		char marker[16] = {0};
+		strncpy(marker, title, sizeof(marker) - 1);
+		int foundVersion = ver;
+		DoArray(marker, sizeof(marker));
+		Do(foundVersion);
+		if (mode != PointerWrap::MODE_READ)
+			return ver;
+
+		if (strncmp(marker, title, sizeof(marker) - 1) != 0)
+		{
+			ERROR_LOG(COMMON, "Savestate failure: expected section \"%s\", found \"%.16s\"", title, marker);
+			mode = PointerWrap::MODE_MEASURE;
+			error = ERROR_FAILURE;
+			return 0;
+		}
+		if (foundVersion < minVer || foundVersion > ver)
+		{
+			ERROR_LOG(COMMON, "Savestate failure: section \"%s\" has version %d, can only read %d to %d", title, foundVersion, minVer, ver);
+			mode = PointerWrap::MODE_MEASURE;
+			error = ERROR_FAILURE;
+			return 0;
+		}
+		return foundVersion;
+	}
+
 	void DoMarker(const char* prevName, u32 arbitraryNumber=0x42)
 	{
 		u32 cookie = arbitraryNumber;
@@ -250,6 +329,7 @@ public:
 		{
 			PanicAlertT("Error: After \"%s\", found %d (0x%X) instead of save marker %d (0x%X). Aborting savestate load...", prevName, cookie, cookie, arbitraryNumber, arbitraryNumber);
 			mode = PointerWrap::MODE_MEASURE;
+			error = ERROR_FAILURE;
 		}
 	}
 };
@@ -313,6 +393,7 @@ public:
 		if (!pFile.ReadBytes(buffer, sz))
 		{
 			ERROR_LOG(COMMON,"ChunkReader: Error reading file");
+			delete[] buffer;
 			return false;
 		}
 
@@ -320,6 +401,13 @@ public:
 		PointerWrap p(&ptr, PointerWrap::MODE_READ);
 		_class.DoState(p);
 		delete[] buffer;
+
+		// A failed marker or section switches the wrapper out of read mode.
+		if (p.GetMode() != PointerWrap::MODE_READ || p.error == PointerWrap::ERROR_FAILURE)
+		{
+			ERROR_LOG(COMMON, "ChunkReader: Failed loading %s", _rFilename.c_str());
+			return false;
+		}
 		
 		INFO_LOG(COMMON, "ChunkReader: Done loading %s" , _rFilename.c_str());
 		return true;
@@ -19,6 +19,7 @@
 #define _FIXED_SIZE_QUEUE_H_
 
 #include <cstring>
+#include "ChunkFile.h"
 
 // STL-look-a-like interface, but name is mixed case to distinguish it clearly from the
 // real STL classes.
@@ -95,6 +96,14 @@ public:
     return count_;
   }
 
+	void DoState(PointerWrap &p) {
+		p.DoArray(storage_, N);
+		p.Do(head_);
+		p.Do(tail_);
+		p.Do(count_);
+		p.DoMarker("FixedSizeQueue");
+	}
+
 private:
 	T *storage_;
 	int head_;
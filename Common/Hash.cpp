@@ -20,6 +20,9 @@
 #include "CPUDetect.h"
 #include <nmmintrin.h>
 #endif
+#if defined(_M_SSE) || defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 static u64 (*ptrHashFunction)(const u8 *src, int len, u32 samples) = &GetMurmurHash3;
 
@@ -505,6 +508,53 @@ u64 GetHash64(const u8 *src, int len, u32 samples)
     return ptrHashFunction(src, len, samples);
 }
 
+// Hashes all of the data, or with samples != 0 that many 16-byte blocks spread evenly over it.
+// Only for comparing against hashes from the same build, like the texture cache does.
+u64 GetTextureHash(const u8 *src, int len, u32 samples)
+{
+#if defined(_M_SSE) || defined(__SSE2__)
+	const int nblocks = len / 16;
+	int step = 1;
+	if (samples != 0 && (u32)nblocks > samples)
+		step = nblocks / samples;
+
+	// The madd lanes weight each 16-bit word by its position, so moved data hashes differently.
+	// The rotate and xor lanes catch changes that happen to cancel out in the sums.
+	const __m128i *blocks = (const __m128i *)src;
+	__m128i mult = _mm_set_epi16(15, 13, 11, 9, 7, 5, 3, 1);
+	const __m128i multStep = _mm_set1_epi16(16);
+	__m128i sum = _mm_set1_epi32(len);
+	__m128i mix = _mm_setzero_si128();
+	for (int i = 0; i < nblocks; i += step)
+	{
+		__m128i data = _mm_loadu_si128(blocks + i);
+		sum = _mm_add_epi32(sum, _mm_madd_epi16(data, mult));
+		mix = _mm_xor_si128(_mm_or_si128(_mm_slli_epi32(mix, 5), _mm_srli_epi32(mix, 27)), data);
+		mult = _mm_add_epi16(mult, multStep);
+	}
+
+	u32 lanes[8];
+	_mm_storeu_si128((__m128i *)lanes, sum);
+	_mm_storeu_si128((__m128i *)(lanes + 4), mix);
+
+	u64 h = 0xcbf29ce484222325ULL ^ (u64)len;
+	for (int i = 0; i < 8; i++)
+		h = (h ^ lanes[i]) * 0x100000001b3ULL;
+	for (int i = nblocks * 16; i < len; i++)
+		h = (h ^ src[i]) * 0x100000001b3ULL;
+
+	// Same finalizer as MurmurHash3, spreads the bits over the whole key.
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ULL;
+	h ^= h >> 33;
+	return h;
+#else
+	return GetMurmurHash3(src, len, samples);
+#endif
+}
+
 // sets the hash function used for the texture cache
 void SetHash64Function(bool useHiresTextures)
 {
@@ -28,5 +28,6 @@ u64 GetCRC32(const u8 *src, int len, u32 samples); // SSE4.2 version of CRC32
 u64 GetHashHiresTexture(const u8 *src, int len, u32 samples);
 u64 GetMurmurHash3(const u8 *src, int len, u32 samples);
 u64 GetHash64(const u8 *src, int len, u32 samples);
+u64 GetTextureHash(const u8 *src, int len, u32 samples); // SSE2 where available, not stable between versions
 void SetHash64Function(bool useHiresTextures);
 #endif // _HASH_H_
@@ -176,6 +176,10 @@ bool DisassembleMov(const unsigned char *codePtr, InstructionInfo &info, int acc
 		case MOVE_REG_TO_MEM: //move reg to memory
 			break;
 
+		case MOVE_8BIT_REG_TO_MEM: //move 8-bit reg to memory
+			info.operandSize = 1;
+			break;
+
 		default:
 			PanicAlert("Unhandled disasm case in write handler!\n\nPlease implement or avoid.");
 			return false;
@@ -54,6 +54,7 @@ enum{
 	MOVE_8BIT	    = 0xC6, //move 8-bit immediate
 	MOVE_16_32BIT   = 0xC7, //move 16 or 32-bit immediate
 	MOVE_REG_TO_MEM = 0x89, //move reg to memory
+	MOVE_8BIT_REG_TO_MEM = 0x88, //move 8-bit reg to memory
 };
 
 enum AccessType{
@@ -614,6 +614,8 @@ public:
 	void PINSRW(X64Reg dest, OpArg arg, u8 subreg);
 
 	void PMADDWD(X64Reg dest, OpArg arg); 
+	void PMULLW(X64Reg dest, OpArg arg);
+	void PMULHUW(X64Reg dest, OpArg arg);
 	void PSADBW(X64Reg dest, OpArg arg);  
 
 	void PMAXSW(X64Reg dest, OpArg arg);  
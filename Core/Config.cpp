@@ -42,6 +42,7 @@ void CConfig::Load(const char *iniFileName)
 	IniFile::Section *general = iniFile.GetOrCreateSection("General");
 
 	bSpeedLimit = false;
+	bFastForward = false;
 	general->Get("FirstRun", &bFirstRun, true);
 	general->Get("AutoLoadLast", &bAutoLoadLast, false);
 	general->Get("AutoRun", &bAutoRun, false);
@@ -51,12 +52,21 @@ void CConfig::Load(const char *iniFileName)
 	general->Get("ShowDebuggerOnLoad", &bShowDebuggerOnLoad, false);
 	IniFile::Section *cpu = iniFile.GetOrCreateSection("CPU");
 	cpu->Get("Core", &iCpuCore, 0);
+	cpu->Get("FastMemory", &bFastMemory, true);
+	cpu->Get("JitDiskCache", &bJitDiskCache, false);
+	cpu->Get("TieredJitThreshold", &iTieredJitThreshold, 0);
 
 	IniFile::Section *graphics = iniFile.GetOrCreateSection("Graphics");
 	graphics->Get("ShowFPSCounter", &bShowFPSCounter, false);
 	graphics->Get("DisplayFramebuffer", &bDisplayFramebuffer, false);
 	graphics->Get("WindowZoom", &iWindowZoom, 1);
 	graphics->Get("BufferedRendering", &bBufferedRendering, true);
+	graphics->Get("TextureFullHash", &bTextureFullHash, false);
+	graphics->Get("TextureDecodeThreads", &iTextureDecodeThreads, 0);
+	graphics->Get("TextureMipmaps", &bTextureMipmaps, false);
+	graphics->Get("VertexDecoderJit", &bVertexDecoderJit, true);
+	graphics->Get("VertexCache", &bVertexCache, true);
+	graphics->Get("FrameSkip", &iFrameSkip, 0);
 
 	IniFile::Section *sound = iniFile.GetOrCreateSection("Sound");
 	sound->Get("Enable", &bEnableSound, true);
@@ -83,12 +93,21 @@ void CConfig::Save()
 		general->Set("ShowDebuggerOnLoad", bShowDebuggerOnLoad);
 		IniFile::Section *cpu = iniFile.GetOrCreateSection("CPU");
 		cpu->Set("Core", iCpuCore);
+		cpu->Set("FastMemory", bFastMemory);
+		cpu->Set("JitDiskCache", bJitDiskCache);
+		cpu->Set("TieredJitThreshold", iTieredJitThreshold);
 
 		IniFile::Section *graphics = iniFile.GetOrCreateSection("Graphics");
 		graphics->Set("ShowFPSCounter", bShowFPSCounter);
 		graphics->Set("DisplayFramebuffer", bDisplayFramebuffer);
 		graphics->Set("WindowZoom", iWindowZoom);
 		graphics->Set("BufferedRendering", bBufferedRendering);
+		graphics->Set("TextureFullHash", bTextureFullHash);
+		graphics->Set("TextureDecodeThreads", iTextureDecodeThreads);
+		graphics->Set("TextureMipmaps", bTextureMipmaps);
+		graphics->Set("VertexDecoderJit", bVertexDecoderJit);
+		graphics->Set("VertexCache", bVertexCache);
+		graphics->Set("FrameSkip", iFrameSkip);
 
 		IniFile::Section *sound = iniFile.GetOrCreateSection("Sound");
 		sound->Set("Enable", bEnableSound);
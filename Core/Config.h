@@ -43,6 +43,11 @@ public:
 	bool bIgnoreBadMemAccess;
 	bool bDisplayFramebuffer;
 	bool bBufferedRendering;
+	bool bTextureFullHash;  // Hash whole textures and cluts instead of trusting the first word.
+	int iTextureDecodeThreads;  // 0 decodes textures on the GPU thread when they're drawn.
+	bool bTextureMipmaps;  // Decode and use all the mip levels, not just the first.
+	bool bVertexDecoderJit;  // Decode vertices with generated code where the host supports it.
+	bool bVertexCache;  // Keep decoded vertices of unchanged geometry between draws.
 
 	bool bShowTouchControls;
 	bool bShowDebuggerOnLoad;
@@ -51,6 +56,11 @@ public:
 	bool bShowDebugStats;
 	int iWindowZoom;  // for Windows
 	int iCpuCore;
+	bool bFastMemory;
+	bool bJitDiskCache;
+	int iTieredJitThreshold;
+	bool bFastForward;  // No frame pacing and no host frame work, for batch runs.
+	int iFrameSkip;  // Only draw every Nth frame, 0 or 1 draws them all.
 
 	std::string currentDirectory;
 
@@ -24,6 +24,7 @@ enum CPUCore {
 	CPU_INTERPRETER,
 	CPU_FASTINTERPRETER,  // unsafe, a bit faster than INTERPRETER
 	CPU_JIT,
+	CPU_BLOCKINTERPRETER,  // pre-decoded basic blocks, same memory shortcuts as FASTINTERPRETER
 };
 
 enum GPUCore {
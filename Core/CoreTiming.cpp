@@ -16,11 +16,15 @@
 // https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
 
 
+#include <algorithm>
+#include <map>
 #include <vector>
 #include <cstdio>
 
+#include "Atomic.h"
 #include "MsgHandler.h"
 #include "StdMutex.h"
+#include "ChunkFile.h"
 #include "CoreTiming.h"
 #include "Core.h"
 #include "HLE/sceKernelThread.h"
@@ -47,31 +51,61 @@ struct BaseEvent
 	s64 time;
 	u64 userdata;
 	int type;
-//	Event *next;
 };
 
-template <class T>
-struct LinkedListItem : public T
+// Events scheduled from other threads wait in a bounded ring until MoveEvents queues them.
+// Any number of threads may post, only the CPU thread takes them out. Posting claims a
+// cell with a compare and swap, so nobody ever blocks. Each cell's sequence number tells
+// whose turn it is: the start of the lap when free for a post in that lap, one more once
+// that post is written. Zeroed memory is an empty ring. If it fills up, posts go to a
+// locked overflow list instead.
+struct TsEventCell
 {
-	LinkedListItem<T> *next;
+	volatile u32 sequence;
+	BaseEvent ev;
 };
 
-typedef LinkedListItem<BaseEvent> Event;
+enum
+{
+	TS_RING_SIZE = 1024,
+	TS_RING_MASK = TS_RING_SIZE - 1,
+};
+
+static TsEventCell tsRing[TS_RING_SIZE];
+static volatile u32 tsEnqueuePos;
+static u32 tsDequeuePos;
+// Set after every post, so Advance can skip MoveEvents with a single load.
+static volatile u32 tsHasEvents;
+static volatile u32 tsOverflowCount;
+static std::vector<BaseEvent> tsOverflow;
+static ThreadsafeEventStats tsStats;
+
+// The queue itself is a binary min-heap of slots, ordered by time and then by when they
+// were scheduled, so events due at the same time still run first come first served.
+// Slots with the same type and userdata are chained off eventsByKey, which makes
+// UnscheduleEvent O(log n).
+struct QueuedEvent : public BaseEvent
+{
+	u64 order;
+	int heapIndex;
+	int nextSameKey;
+};
 
-Event *first;
-Event *tsFirst;
-Event *tsLast;
+typedef std::pair<int, u64> EventKey;
 
-// event pools
-Event *eventPool = 0;
-Event *eventTsPool = 0;
-int allocatedTsEvents = 0;
+static std::vector<QueuedEvent> eventSlots;
+static std::vector<int> freeSlots;
+static std::vector<int> eventHeap;
+static std::map<EventKey, int> eventsByKey;
+static std::vector<int> eventsPerType;
+static u64 nextEventOrder;
 
 int downcount, slicelength;
 
 s64 globalTimer;
 s64 idledCycles;
 
+// Only protects the overflow list now.
 static std::recursive_mutex externalEventSection;
 
 void (*advanceCallback)(int cyclesExecuted) = NULL;
@@ -87,39 +121,148 @@ int GetClockFrequencyMHz()
 }
 
 
-Event* GetNewEvent()
+static void ResetThreadsafeEvents()
+{
+	for (u32 i = 0; i < TS_RING_SIZE; i++)
+		tsRing[i].sequence = 0;
+	tsEnqueuePos = 0;
+	tsDequeuePos = 0;
+	tsHasEvents = 0;
+	tsOverflowCount = 0;
+	tsOverflow.clear();
+}
+
+static void PostThreadsafeEvent(const BaseEvent &ev)
 {
-	if(!eventPool)
-		return new Event;
+	Common::AtomicIncrement(tsStats.posted);
 
-	Event* ev = eventPool;
-	eventPool = ev->next;
-	return ev;
+	u32 pos = Common::AtomicLoad(tsEnqueuePos);
+	TsEventCell *cell;
+	while (true)
+	{
+		cell = &tsRing[pos & TS_RING_MASK];
+		s32 diff = (s32)(Common::AtomicLoadAcquire(cell->sequence) - (pos & ~TS_RING_MASK));
+		if (diff == 0)
+		{
+			if (Common::AtomicCompareAndSwap(tsEnqueuePos, pos, pos + 1))
+				break;
+			Common::AtomicIncrement(tsStats.casRetries);
+		}
+		else if (diff < 0)
+		{
+			// Still holds an event from a full lap ago, the CPU thread is behind.
+			Common::AtomicIncrement(tsStats.overflowed);
+			std::lock_guard<std::recursive_mutex> lk(externalEventSection);
+			tsOverflow.push_back(ev);
+			Common::AtomicIncrement(tsOverflowCount);
+			Common::AtomicStoreRelease(tsHasEvents, 1);
+			return;
+		}
+		pos = Common::AtomicLoad(tsEnqueuePos);
+	}
+
+	cell->ev = ev;
+	Common::AtomicStoreRelease(cell->sequence, (pos & ~TS_RING_MASK) + 1);
+	Common::AtomicStoreRelease(tsHasEvents, 1);
 }
 
-Event* GetNewTsEvent()
+static bool EventBefore(int a, int b)
 {
-	allocatedTsEvents++;
+	const QueuedEvent &ea = eventSlots[a];
+	const QueuedEvent &eb = eventSlots[b];
+	return ea.time < eb.time || (ea.time == eb.time && ea.order < eb.order);
+}
 
-	if(!eventTsPool)
-		return new Event;
+static void HeapSiftUp(int pos)
+{
+	int id = eventHeap[pos];
+	while (pos > 0)
+	{
+		int parent = (pos - 1) / 2;
+		if (!EventBefore(id, eventHeap[parent]))
+			break;
+		eventHeap[pos] = eventHeap[parent];
+		eventSlots[eventHeap[pos]].heapIndex = pos;
+		pos = parent;
+	}
+	eventHeap[pos] = id;
+	eventSlots[id].heapIndex = pos;
+}
 
-	Event* ev = eventTsPool;
-	eventTsPool = ev->next;
-	return ev;
+static void HeapSiftDown(int pos)
+{
+	int id = eventHeap[pos];
+	int size = (int)eventHeap.size();
+	while (true)
+	{
+		int child = pos * 2 + 1;
+		if (child >= size)
+			break;
+		if (child + 1 < size && EventBefore(eventHeap[child + 1], eventHeap[child]))
+			child++;
+		if (!EventBefore(eventHeap[child], id))
+			break;
+		eventHeap[pos] = eventHeap[child];
+		eventSlots[eventHeap[pos]].heapIndex = pos;
+		pos = child;
+	}
+	eventHeap[pos] = id;
+	eventSlots[id].heapIndex = pos;
+}
+
+static void HeapRemoveAt(int pos)
+{
+	int last = eventHeap.back();
+	eventHeap.pop_back();
+	if (pos < (int)eventHeap.size())
+	{
+		eventHeap[pos] = last;
+		eventSlots[last].heapIndex = pos;
+		HeapSiftDown(pos);
+		HeapSiftUp(eventSlots[last].heapIndex);
+	}
+}
+
+static void UnlinkFromKey(int id)
+{
+	const QueuedEvent &ev = eventSlots[id];
+	std::map<EventKey, int>::iterator iter = eventsByKey.find(EventKey(ev.type, ev.userdata));
+	if (iter == eventsByKey.end())
+		return;
+
+	if (iter->second == id)
+	{
+		if (ev.nextSameKey >= 0)
+			iter->second = ev.nextSameKey;
+		else
+			eventsByKey.erase(iter);
+		return;
+	}
+	int prev = iter->second;
+	while (eventSlots[prev].nextSameKey >= 0 && eventSlots[prev].nextSameKey != id)
+		prev = eventSlots[prev].nextSameKey;
+	if (eventSlots[prev].nextSameKey == id)
+		eventSlots[prev].nextSameKey = ev.nextSameKey;
 }
 
-void FreeEvent(Event* ev)
+static void FreeSlot(int id)
 {
-	ev->next = eventPool;
-	eventPool = ev;
+	eventsPerType[eventSlots[id].type]--;
+	eventSlots[id].heapIndex = -1;
+	freeSlots.push_back(id);
 }
 
-void FreeTsEvent(Event* ev)
+// Takes the event out of the heap and the key chains, and frees its slot.
+static void RemoveQueuedEvent(int id)
 {
-	ev->next = eventTsPool;
-	eventTsPool = ev;
-	allocatedTsEvents--;
+	UnlinkFromKey(id);
+	HeapRemoveAt(eventSlots[id].heapIndex);
+	FreeSlot(id);
+}
+
+static const QueuedEvent *GetFirstEvent()
+{
+	return eventHeap.empty() ? 0 : &eventSlots[eventHeap[0]];
 }
 
 int RegisterEvent(const char *name, TimedCallback callback)
@@ -128,18 +271,21 @@ int RegisterEvent(const char *name, TimedCallback callback)
 	type.name = name;
 	type.callback = callback;
 	event_types.push_back(type);
+	eventsPerType.push_back(0);
 	return (int)event_types.size() - 1;
 }
 
 void UnregisterAllEvents()
 {
-	if (first)
+	if (!eventHeap.empty())
 		PanicAlert("Cannot unregister events with events pending");
 	event_types.clear();
+	eventsPerType.clear();
 }
 
 void Init()
 {
+	ResetThreadsafeEvents();
 	downcount = INITIAL_SLICE_LENGTH;
 	slicelength = INITIAL_SLICE_LENGTH;
 	globalTimer = 0;
@@ -152,20 +298,7 @@ void Shutdown()
 	ClearPendingEvents();
 	UnregisterAllEvents();
 
-	while(eventPool)
-	{
-		Event *ev = eventPool;
-		eventPool = ev->next;
-		delete ev;
-	}
-
-	std::lock_guard<std::recursive_mutex> lk(externalEventSection);
-	while(eventTsPool)
-	{
-		Event *ev = eventTsPool;
-		eventTsPool = ev->next;
-		delete ev;
-	}
+	ResetThreadsafeEvents();
 }
 
 u64 GetTicks()
@@ -183,17 +316,11 @@ u64 GetIdleTicks()
 // schedule things to be executed on the main thread.
 void ScheduleEvent_Threadsafe(int cyclesIntoFuture, int event_type, u64 userdata)
 {
-	std::lock_guard<std::recursive_mutex> lk(externalEventSection);
-	Event *ne = GetNewTsEvent();
-	ne->time = globalTimer + cyclesIntoFuture;
-	ne->type = event_type;
-	ne->next = 0;
-	ne->userdata = userdata;
-	if(!tsFirst)
-		tsFirst = ne;
-	if(tsLast)
-		tsLast->next = ne;
-	tsLast = ne;
+	BaseEvent ev;
+	ev.time = globalTimer + cyclesIntoFuture;
+	ev.type = event_type;
+	ev.userdata = userdata;
+	PostThreadsafeEvent(ev);
 }
 
 // Same as ScheduleEvent_Threadsafe(0, ...) EXCEPT if we are already on the CPU thread
@@ -211,30 +338,46 @@ void ScheduleEvent_Threadsafe_Immediate(int event_type, u64 userdata)
 
 void ClearPendingEvents()
 {
-	while (first)
-	{
-		Event *e = first->next;
-		FreeEvent(first);
-		first = e;
-	}
+	// clear() keeps the capacity around for the next game.
+	eventSlots.clear();
+	freeSlots.clear();
+	eventHeap.clear();
+	eventsByKey.clear();
+	std::fill(eventsPerType.begin(), eventsPerType.end(), 0);
 }
 
-void AddEventToQueue(Event* ne)
+void AddEventToQueue(s64 time, int event_type, u64 userdata)
 {
-	Event* prev = NULL;
-	Event** pNext = &first;
-	for(;;)
+	int id;
+	if (freeSlots.empty())
 	{
-		Event*& next = *pNext;
-		if(!next || ne->time < next->time)
-		{
-			ne->next = next;
-			next = ne;
-			break;
-		}
-		prev = next;
-		pNext = &prev->next;
+		id = (int)eventSlots.size();
+		eventSlots.push_back(QueuedEvent());
+	}
+	else
+	{
+		id = freeSlots.back();
+		freeSlots.pop_back();
+	}
+
+	QueuedEvent &ne = eventSlots[id];
+	ne.time = time;
+	ne.type = event_type;
+	ne.userdata = userdata;
+	ne.order = nextEventOrder++;
+
+	std::pair<std::map<EventKey, int>::iterator, bool> inserted = eventsByKey.insert(std::make_pair(EventKey(event_type, userdata), id));
+	if (inserted.second)
+		ne.nextSameKey = -1;
+	else
+	{
+		ne.nextSameKey = inserted.first->second;
+		inserted.first->second = id;
 	}
+	eventsPerType[event_type]++;
+
+	eventHeap.push_back(id);
+	HeapSiftUp((int)eventHeap.size() - 1);
 }
 
 // This must be run ONLY from within the cpu thread
@@ -242,56 +385,35 @@ void AddEventToQueue(Event* ne)
 // than Advance 
 void ScheduleEvent(int cyclesIntoFuture, int event_type, u64 userdata)
 {
-	Event *ne = GetNewEvent();
-	ne->userdata = userdata;
-	ne->type = event_type;
-	ne->time = globalTimer + cyclesIntoFuture;
-	AddEventToQueue(ne);
+	AddEventToQueue(globalTimer + cyclesIntoFuture, event_type, userdata);
 }
 
 // Returns cycles left in timer.
 u64 UnscheduleEvent(int event_type, u64 userdata)
 {
-	u64 result = 0;
-	if (!first)
-		return result;
-	while(first)
-	{
-		if (first->type == event_type && first->userdata == userdata)
-		{
-			result = first->time - globalTimer;
+	std::map<EventKey, int>::iterator iter = eventsByKey.find(EventKey(event_type, userdata));
+	if (iter == eventsByKey.end())
+		return 0;
 
-			Event *next = first->next;
-			FreeEvent(first);
-			first = next;
-		}
-		else
-		{
-			break;
-		}
-	}
-	if (!first)
-		return result;
-	Event *prev = first;
-	Event *ptr = prev->next;
-	while (ptr)
+	// If there are several, report the one that would have run last.
+	s64 latest = 0;
+	bool found = false;
+	int id = iter->second;
+	eventsByKey.erase(iter);
+	while (id >= 0)
 	{
-		if (ptr->type == event_type && ptr->userdata == userdata)
-		{
-			result = ptr->time - globalTimer;
-
-			prev->next = ptr->next;
-			FreeEvent(ptr);
-			ptr = prev->next;
-		}
-		else
-		{
-			prev = ptr;
-			ptr = ptr->next;
-		}
+		const QueuedEvent &ev = eventSlots[id];
+		if (!found || ev.time >= latest)
+			latest = ev.time;
+		found = true;
+
+		int next = ev.nextSameKey;
+		HeapRemoveAt(ev.heapIndex);
+		FreeSlot(id);
+		id = next;
 	}
 
-	return result;
+	return latest - globalTimer;
 }
 
 void RegisterAdvanceCallback(void (*callback)(int cyclesExecuted))
@@ -301,94 +423,31 @@ void RegisterAdvanceCallback(void (*callback)(int cyclesExecuted))
 
 bool IsScheduled(int event_type) 
 {
-	if (!first)
-		return false;
-	Event *e = first;
-	while (e) {
-		if (e->type == event_type)
-			return true;
-		e = e->next;
-	}
-	return false;
+	return event_type >= 0 && event_type < (int)eventsPerType.size() && eventsPerType[event_type] > 0;
 }
 
 void RemoveEvent(int event_type)
 {
-	if (!first)
+	if (!IsScheduled(event_type))
 		return;
-	while(first)
+
+	// Not indexed by type alone, but this is rare (shutting down a subsystem.)
+	std::vector<int> matches;
+	for (size_t i = 0; i < eventHeap.size(); i++)
 	{
-		if (first->type == event_type)
-		{
-			Event *next = first->next;
-			FreeEvent(first);
-			first = next;
-		}
-		else
-		{
-			break;
-		}
-	}
-	if (!first)
-		return;
-	Event *prev = first;
-	Event *ptr = prev->next;
-	while (ptr)
-	{
-		if (ptr->type == event_type)
-		{
-			prev->next = ptr->next;
-			FreeEvent(ptr);
-			ptr = prev->next;
-		}
-		else
-		{
-			prev = ptr;
-			ptr = ptr->next;
-		}
+		if (eventSlots[eventHeap[i]].type == event_type)
+			matches.push_back(eventHeap[i]);
 	}
+	for (size_t i = 0; i < matches.size(); i++)
+		RemoveQueuedEvent(matches[i]);
 }
 
+// Must be called from the CPU thread, like RemoveEvent.
 void RemoveThreadsafeEvent(int event_type)
 {
-	std::lock_guard<std::recursive_mutex> lk(externalEventSection);
-	if (!tsFirst)
-	{
-		return;
-	}
-	while(tsFirst)
-	{
-		if (tsFirst->type == event_type)
-		{
-			Event *next = tsFirst->next;
-			FreeTsEvent(tsFirst);
-			tsFirst = next;
-		}
-		else
-		{
-			break;
-		}
-	}
-	if (!tsFirst)
-	{
-		return;
-	}
-	Event *prev = tsFirst;
-	Event *ptr = prev->next;
-	while (ptr)
-	{
-		if (ptr->type == event_type)
-		{	
-			prev->next = ptr->next;
-			FreeTsEvent(ptr);
-			ptr = prev->next;
-		}
-		else
-		{
-			prev = ptr;
-			ptr = ptr->next;
-		}
-	}
+	// Posted events are only reachable once they're queued.
+	MoveEvents();
+	RemoveEvent(event_type);
 }
 
 void RemoveAllEvents(int event_type)
@@ -397,53 +456,64 @@ void RemoveAllEvents(int event_type)
 	RemoveEvent(event_type);
 }
 
+// Runs everything due by globalTimer. Callbacks may schedule and unschedule freely.
+static void RunDueEvents()
+{
+	while (!eventHeap.empty())
+	{
+		int id = eventHeap[0];
+		if (eventSlots[id].time > globalTimer)
+			break;
+		BaseEvent evt = eventSlots[id];
+		RemoveQueuedEvent(id);
+		event_types[evt.type].callback(evt.userdata, (int)(globalTimer - evt.time));
+	}
+}
+
 //This raise only the events required while the fifo is processing data
 void ProcessFifoWaitEvents()
 {
 	MoveEvents();
+	RunDueEvents();
+}
 
-	if (!first)
+void MoveEvents()
+{
+	// Nothing posted since the last time, which is almost always.
+	if (Common::AtomicLoadAcquire(tsHasEvents) == 0)
 		return;
+	// Clear first, anything posted while draining will set it again.
+	Common::AtomicExchange(tsHasEvents, 0);
+	Common::AtomicIncrement(tsStats.drains);
 
-	while (first)
+	while (true)
 	{
-		if (first->time <= globalTimer)
-		{
-			Event* evt = first;
-			first = first->next;
-			event_types[evt->type].callback(evt->userdata, (int)(globalTimer - evt->time));
-			FreeEvent(evt);
-		}
-		else
-		{
+		TsEventCell &cell = tsRing[tsDequeuePos & TS_RING_MASK];
+		u32 lap = tsDequeuePos & ~TS_RING_MASK;
+		if (Common::AtomicLoadAcquire(cell.sequence) != lap + 1)
 			break;
-		}
-	}	
-}
+		BaseEvent ev = cell.ev;
+		Common::AtomicStoreRelease(cell.sequence, lap + TS_RING_SIZE);
+		tsDequeuePos++;
+		AddEventToQueue(ev.time, ev.type, ev.userdata);
+	}
 
-void MoveEvents()
-{
-	std::lock_guard<std::recursive_mutex> lk(externalEventSection);
-		// Move events from async queue into main queue
-	while (tsFirst)
+	if (Common::AtomicLoad(tsOverflowCount) != 0)
 	{
-		Event *next = tsFirst->next;
-		AddEventToQueue(tsFirst);
-		tsFirst = next;
-	}
-	tsLast = NULL;
-
-	// Move free events to threadsafe pool
-	while(allocatedTsEvents > 0 && eventPool)
-	{		    
-		Event *ev = eventPool;
-		eventPool = ev->next;
-		ev->next = eventTsPool;
-		eventTsPool = ev;
-		allocatedTsEvents--;
+		std::lock_guard<std::recursive_mutex> lk(externalEventSection);
+		Common::AtomicIncrement(tsStats.lockedDrains);
+		for (size_t i = 0; i < tsOverflow.size(); i++)
+			AddEventToQueue(tsOverflow[i].time, tsOverflow[i].type, tsOverflow[i].userdata);
+		tsOverflow.clear();
+		Common::AtomicStore(tsOverflowCount, 0);
 	}
 }
 
+const ThreadsafeEventStats &GetThreadsafeEventStats()
+{
+	return tsStats;
+}
+
 void Advance()
 {
 	MoveEvents();		
@@ -452,22 +522,9 @@ void Advance()
 	globalTimer += cyclesExecuted;
 	downcount = slicelength;
 
-	while (first)
-	{
-		if (first->time <= globalTimer)
-		{
-//			LOG(CPU, "[Scheduler] %s		 (%lld, %lld) ", 
-//				first->name ? first->name : "?", (u64)globalTimer, (u64)first->time);
-			Event* evt = first;
-			first = first->next;
-			event_types[evt->type].callback(evt->userdata, (int)(globalTimer - evt->time));
-			FreeEvent(evt);
-		}
-		else
-		{
-			break;
-		}
-	}
+	RunDueEvents();
+
+	const QueuedEvent *first = GetFirstEvent();
 	if (!first) 
 	{
 		// WARN_LOG(CPU, "WARNING - no events in queue. Setting downcount to 10000");
@@ -484,13 +541,20 @@ void Advance()
 		advanceCallback(cyclesExecuted);
 }
 
+// The queued events in the order they'll run.
+static void GetSortedEvents(std::vector<int> &sorted)
+{
+	sorted = eventHeap;
+	std::sort(sorted.begin(), sorted.end(), EventBefore);
+}
+
 void LogPendingEvents()
 {
-	Event *ptr = first;
-	while (ptr)
+	std::vector<int> sorted;
+	GetSortedEvents(sorted);
+	for (size_t i = 0; i < sorted.size(); i++)
 	{
-		//INFO_LOG(CPU, "PENDING: Now: %lld Pending: %lld Type: %d", globalTimer, ptr->time, ptr->type);
-		ptr = ptr->next;
+		//INFO_LOG(CPU, "PENDING: Now: %lld Pending: %lld Type: %d", globalTimer, eventSlots[sorted[i]].time, eventSlots[sorted[i]].type);
 	}
 }
 
@@ -500,6 +564,7 @@ void Idle(int maxIdle)
 	if (maxIdle != 0 && cyclesDown > maxIdle)
 		cyclesDown = maxIdle;
 
+	const QueuedEvent *first = GetFirstEvent();
     if (first && cyclesDown > 0)
     {
         int cyclesExecuted = slicelength - downcount;
@@ -522,11 +587,13 @@ void Idle(int maxIdle)
 
 std::string GetScheduledEventsSummary()
 {
-	Event *ptr = first;
+	std::vector<int> sorted;
+	GetSortedEvents(sorted);
 	std::string text = "Scheduled events\n";
 	text.reserve(1000);
-	while (ptr)
+	for (size_t i = 0; i < sorted.size(); i++)
 	{
+		const QueuedEvent *ptr = &eventSlots[sorted[i]];
 		unsigned int t = ptr->type;
 		if (t >= event_types.size())
 			PanicAlert("Invalid event type"); // %i", t);
@@ -536,9 +603,80 @@ std::string GetScheduledEventsSummary()
 		char temp[512];
 		sprintf(temp, "%s : %i %08x%08x\n", name, (int)ptr->time, (u32)(ptr->userdata >> 32), (u32)(ptr->userdata));
 		text += temp;
-		ptr = ptr->next;
 	}
 	return text;
 }
 
+void Event_DoState(PointerWrap &p, BaseEvent *ev)
+{
+	p.Do(ev->time);
+	p.Do(ev->userdata);
+	p.Do(ev->type);
+}
+
+// Lists are written exactly like PointerWrap::DoLinkedList would write the old sorted
+// lists, so states keep loading either way.
+static void ReadEventList(PointerWrap &p)
+{
+	while (true)
+	{
+		u8 shouldExist = 0;
+		p.Do(shouldExist);
+		if (shouldExist != 1)
+			break;
+		BaseEvent ev;
+		Event_DoState(p, &ev);
+		if (ev.type < 0 || ev.type >= (int)event_types.size())
+		{
+			PanicAlert("Invalid event type %d in savestate", ev.type);
+			continue;
+		}
+		AddEventToQueue(ev.time, ev.type, ev.userdata);
+	}
+}
+
+static void WriteEventList(PointerWrap &p, const std::vector<int> &ids)
+{
+	for (size_t i = 0; i < ids.size(); i++)
+	{
+		u8 shouldExist = 1;
+		p.Do(shouldExist);
+		BaseEvent ev = eventSlots[ids[i]];
+		Event_DoState(p, &ev);
+	}
+	u8 shouldExist = 0;
+	p.Do(shouldExist);
+}
+
+// Must be called from the CPU thread.
+void DoState(PointerWrap &p)
+{
+	// Anything posted from other threads goes in the main queue first, or is dropped on load.
+	MoveEvents();
+
+	if (!p.Section("CoreTiming", 1, 1))
+		return;
+
+	p.Do(downcount);
+	p.Do(slicelength);
+	p.Do(globalTimer);
+	p.Do(idledCycles);
+
+	if (p.GetMode() == PointerWrap::MODE_READ)
+	{
+		ClearPendingEvents();
+		ReadEventList(p);
+		// Old states may still have threadsafe events, they're due just the same.
+		ReadEventList(p);
+	}
+	else
+	{
+		std::vector<int> sorted;
+		GetSortedEvents(sorted);
+		WriteEventList(p, sorted);
+		WriteEventList(p, std::vector<int>());
+	}
+	p.DoMarker("CoreTiming");
+}
+
 }	// namespace
@@ -35,6 +35,8 @@
 
 #include <string>
 
+class PointerWrap;
+
 //const int CPU_HZ = 222000000;
 extern int CPU_HZ;
 
@@ -103,6 +105,19 @@ namespace CoreTiming
 
 	std::string GetScheduledEventsSummary();
 
+	// Counters for ScheduleEvent_Threadsafe, which never takes a lock unless the ring is full.
+	struct ThreadsafeEventStats
+	{
+		volatile u32 posted;
+		volatile u32 casRetries;  // lost a race with another posting thread
+		volatile u32 overflowed;  // ring was full, went through the locked list
+		volatile u32 drains;      // MoveEvents calls that found something
+		volatile u32 lockedDrains;
+	};
+	const ThreadsafeEventStats &GetThreadsafeEventStats();
+
+	void DoState(PointerWrap &p);
+
 	void SetClockFrequencyMHz(int cpuMhz);
 	int GetClockFrequencyMHz();
 	extern int downcount;
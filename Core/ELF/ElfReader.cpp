@@ -16,6 +16,7 @@
 // https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
 
 #include "../MemMap.h"
+#include "../MIPS/MIPS.h"
 #include "../MIPS/MIPSTables.h"
 #include "ElfReader.h"
 #include "../Debugger/SymbolMap.h"
@@ -317,6 +318,9 @@ bool ElfReader::LoadInto(u32 loadAddress)
 		}
 	}
 
+	// Whatever code used to live here is gone now.
+	currentMIPS->InvalidateICache(vaddr, totalSize);
+
 	NOTICE_LOG(LOADER,"ELF loading completed successfully.");
 	return true;
 }
@@ -23,6 +23,7 @@
 #endif
 
 #include "FileUtil.h"
+#include "ChunkFile.h"
 #include "DirectoryFileSystem.h"
 
 DirectoryFileSystem::DirectoryFileSystem(IHandleAllocator *_hAlloc, std::string _basePath) : basePath(_basePath)
@@ -99,13 +100,9 @@ bool DirectoryFileSystem::DeleteFile(const std::string &filename)
 #endif
 }
 
-u32 DirectoryFileSystem::OpenFile(std::string filename, FileAccess access)
+// When reopening (loading a state) the file must already exist, and is never truncated.
+bool DirectoryFileSystem::OpenFileEntry::Open(std::string fullName, FileAccess access, bool reopening)
 {
-	std::string fullName = GetLocalPath(filename);
-	INFO_LOG(HLE,"Actually opening %s (%s)", fullName.c_str(), filename.c_str());
-
-	OpenFileEntry entry;
-
 #ifdef _WIN32
 	// Convert parameters to Windows permissions and access
 	DWORD desired = 0;
@@ -121,7 +118,7 @@ u32 DirectoryFileSystem::OpenFile(std::string filename, FileAccess access)
 		desired   |= GENERIC_WRITE;
 		sharemode |= FILE_SHARE_WRITE;
 	}
-	if (access & FILEACCESS_CREATE)
+	if ((access & FILEACCESS_CREATE) && !reopening)
 	{
 		openmode = OPEN_ALWAYS;
 	}
@@ -129,12 +126,35 @@ u32 DirectoryFileSystem::OpenFile(std::string filename, FileAccess access)
 		openmode = OPEN_EXISTING;
 
 	//Let's do it!
-	entry.hFile = CreateFile(fullName.c_str(), desired, sharemode, 0, openmode, 0, 0);
-	bool success = entry.hFile != INVALID_HANDLE_VALUE;
+	hFile = CreateFile(fullName.c_str(), desired, sharemode, 0, openmode, 0, 0);
+	return hFile != INVALID_HANDLE_VALUE;
 #else
-  entry.hFile = fopen(fullName.c_str(), access & FILEACCESS_WRITE ? "wb" : "rb");
-  bool success = entry.hFile != 0;
+	const char *mode = "rb";
+	if (access & FILEACCESS_WRITE)
+		mode = reopening ? "r+b" : "wb";
+	hFile = fopen(fullName.c_str(), mode);
+	return hFile != 0;
 #endif
+}
+
+void DirectoryFileSystem::OpenFileEntry::Close()
+{
+#ifdef _WIN32
+	CloseHandle(hFile);
+#else
+	fclose(hFile);
+#endif
+}
+
+u32 DirectoryFileSystem::OpenFile(std::string filename, FileAccess access)
+{
+	std::string fullName = GetLocalPath(filename);
+	INFO_LOG(HLE,"Actually opening %s (%s)", fullName.c_str(), filename.c_str());
+
+	OpenFileEntry entry;
+	entry.guestFilename = filename;
+	entry.access = access;
+	bool success = entry.Open(fullName, access, false);
 
 	if (!success)
 	{
@@ -159,11 +179,7 @@ void DirectoryFileSystem::CloseFile(u32 handle)
 	if (iter != entries.end())
 	{
 		hAlloc->FreeHandle(handle);
-#ifdef _WIN32
-		CloseHandle((*iter).second.hFile);
-#else
-    fclose((*iter).second.hFile);
-#endif
+		iter->second.Close();
 		entries.erase(iter);
 	}
 	else
@@ -323,3 +339,52 @@ std::vector<PSPFileInfo> DirectoryFileSystem::GetDirListing(std::string path)
 	return myVector;
 }
 
+void DirectoryFileSystem::DoState(PointerWrap &p)
+{
+	if (!p.Section("DirectoryFS", 1, 1))
+		return;
+
+	// Handles keep their numbers, the files are reopened and seeked back to where they were.
+	u32 num = (u32)entries.size();
+	p.Do(num);
+
+	if (p.mode == p.MODE_READ)
+	{
+		for (EntryMap::iterator iter = entries.begin(); iter != entries.end(); ++iter)
+			iter->second.Close();
+		entries.clear();
+
+		for (u32 i = 0; i < num; i++)
+		{
+			u32 key = 0;
+			u32 seekPos = 0;
+			OpenFileEntry entry;
+			p.Do(key);
+			p.Do(entry.guestFilename);
+			p.Do(entry.access);
+			p.Do(seekPos);
+			if (p.mode != p.MODE_READ)
+				break;
+
+			if (!entry.Open(GetLocalPath(entry.guestFilename), entry.access, true))
+			{
+				ERROR_LOG(HLE, "Failed to reopen file %s while loading state", entry.guestFilename.c_str());
+				continue;
+			}
+			entries[key] = entry;
+			SeekFile(key, seekPos, FILEMOVE_BEGIN);
+		}
+	}
+	else
+	{
+		for (EntryMap::iterator iter = entries.begin(); iter != entries.end(); ++iter)
+		{
+			u32 key = iter->first;
+			u32 seekPos = (u32)SeekFile(key, 0, FILEMOVE_CURRENT);
+			p.Do(key);
+			p.Do(iter->second.guestFilename);
+			p.Do(iter->second.access);
+			p.Do(seekPos);
+		}
+	}
+}
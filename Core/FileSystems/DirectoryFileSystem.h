@@ -38,6 +38,12 @@ class DirectoryFileSystem : public IFileSystem
 #else
 		FILE *hFile;
 #endif
+		// Kept to reopen the file when loading a state.
+		std::string guestFilename;
+		FileAccess access;
+
+		bool Open(std::string fullName, FileAccess access, bool reopening);
+		void Close();
 	};
 
 	typedef std::map<u32,OpenFileEntry> EntryMap;
@@ -63,5 +69,7 @@ public:
 	bool RmDir(const std::string &dirname);
 	bool RenameFile(const std::string &from, const std::string &to);
 	bool DeleteFile(const std::string &filename);
+
+	void DoState(PointerWrap &p);
 };
  
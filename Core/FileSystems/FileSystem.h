@@ -19,6 +19,9 @@
 
 #include "../../Globals.h"
 #include <string>
+#include <vector>
+
+class PointerWrap;
 
 enum FileAccess
 {
@@ -85,6 +88,8 @@ public:
 	virtual bool     RmDir(const std::string &dirname) = 0;
 	virtual bool     RenameFile(const std::string &from, const std::string &to) = 0;
 	virtual bool     DeleteFile(const std::string &filename) = 0;
+	// Open handles only, mounts are redone by booting the same game.
+	virtual void     DoState(PointerWrap &p) = 0;
 };
 
 
@@ -103,6 +108,7 @@ public:
 	virtual bool RmDir(const std::string &dirname) {return false;}
 	virtual bool RenameFile(const std::string &from, const std::string &to) {return false;}
 	virtual bool DeleteFile(const std::string &filename) {return false;}
+	virtual void DoState(PointerWrap &p) {}
 };
 
 
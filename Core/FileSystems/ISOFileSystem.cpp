@@ -17,6 +17,7 @@
 
 #include "Globals.h"
 #include "Log.h"
+#include "ChunkFile.h"
 #include "ISOFileSystem.h"
 #include <cstring>
 #include <cstdio>
@@ -323,6 +324,7 @@ u32 ISOFileSystem::OpenFile(std::string filename, FileAccess access)
 	entry.file = GetFromPath(filename);
 	if (!entry.file)
 		return 0;
+	entry.path = filename;
 
 	entry.seekPos = 0;
 
@@ -527,3 +529,52 @@ std::vector<PSPFileInfo> ISOFileSystem::GetDirListing(std::string path)
 	}
 	return myVector;
 }
+
+void ISOFileSystem::DoState(PointerWrap &p)
+{
+	if (!p.Section("ISOFileSystem", 1, 1))
+		return;
+
+	// Tree entries are pointers into this instance's tree, so save the path and look it up again.
+	u32 num = (u32)entries.size();
+	p.Do(num);
+
+	if (p.mode == p.MODE_READ)
+	{
+		entries.clear();
+		for (u32 i = 0; i < num; i++)
+		{
+			u32 key = 0;
+			OpenFileEntry of;
+			p.Do(key);
+			p.Do(of.seekPos);
+			p.Do(of.isRawSector);
+			p.Do(of.sectorStart);
+			p.Do(of.openSize);
+			p.Do(of.path);
+			if (p.mode != p.MODE_READ)
+				break;
+
+			of.file = of.isRawSector ? 0 : GetFromPath(of.path);
+			if (!of.isRawSector && !of.file)
+			{
+				ERROR_LOG(FILESYS, "Failed to find %s in the ISO while loading state", of.path.c_str());
+				continue;
+			}
+			entries[key] = of;
+		}
+	}
+	else
+	{
+		for (EntryMap::iterator iter = entries.begin(); iter != entries.end(); ++iter)
+		{
+			u32 key = iter->first;
+			p.Do(key);
+			p.Do(iter->second.seekPos);
+			p.Do(iter->second.isRawSector);
+			p.Do(iter->second.sectorStart);
+			p.Do(iter->second.openSize);
+			p.Do(iter->second.path);
+		}
+	}
+}
@@ -54,6 +54,8 @@ class ISOFileSystem : public IFileSystem
 		bool isRawSector;   // "/sce_lbn" mode
 		u32 sectorStart;
 		u32 openSize;
+		// What file was looked up, to find it again when loading a state.
+		std::string path;
 	};
 	
 
@@ -84,4 +86,6 @@ public:
 	virtual bool RmDir(const std::string &dirname) {return false;}
 	virtual bool RenameFile(const std::string &from, const std::string &to) {return false;}
 	virtual bool DeleteFile(const std::string &filename) {return false;}
+
+	void DoState(PointerWrap &p);
 };
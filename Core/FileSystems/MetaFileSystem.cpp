@@ -16,6 +16,7 @@
 // https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
 
 #include <set>
+#include "ChunkFile.h"
 #include "MetaFileSystem.h"
 
 IFileSystem *MetaFileSystem::GetHandleOwner(u32 handle)
@@ -240,3 +241,28 @@ size_t MetaFileSystem::SeekFile(u32 handle, s32 position, FileMove type)
 		return 0;
 }
 
+void MetaFileSystem::DoState(PointerWrap &p)
+{
+	if (!p.Section("MetaFileSystem", 1, 1))
+		return;
+
+	p.Do(current);
+	p.Do(currentDirectory);
+
+	u32 n = (u32)fileSystems.size();
+	p.Do(n);
+	if (n != (u32)fileSystems.size())
+	{
+		ERROR_LOG(FILESYS, "Savestate failure: number of filesystems doesn't match.");
+		p.SetMode(PointerWrap::MODE_MEASURE);
+		return;
+	}
+
+	// The same system is often mounted under several prefixes (umd0:, disc0:...)
+	std::set<IFileSystem *> done;
+	for (u32 i = 0; i < n; ++i)
+	{
+		if (done.insert(fileSystems[i].system).second)
+			fileSystems[i].system->DoState(p);
+	}
+}
@@ -64,6 +64,9 @@ public:
 	void SetCurrentDirectory(const std::string &dir) {
 		currentDirectory = dir;
 	}
+
+	// Expects the same file systems to be mounted, in the same order, as when saved.
+	void DoState(PointerWrap &p);
 private:
 	u32 current;
 	struct System
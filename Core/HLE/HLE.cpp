@@ -16,7 +16,9 @@
 // https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
 
 #include "HLE.h"
+#include <algorithm>
 #include <map>
+#include "base/timeutil.h"
 #include "../MemMap.h"
 
 #include "HLETables.h"
@@ -30,6 +32,23 @@
 static std::vector<HLEModule> moduleDB;
 static std::vector<Syscall> unresolvedSyscalls;
 
+enum
+{
+	// Power of two buckets, from under 1 microsecond up.
+	SYSCALL_TIME_BUCKETS = 12,
+};
+
+struct SyscallStats
+{
+	u32 calls;
+	double time;
+	u32 histogram[SYSCALL_TIME_BUCKETS];
+};
+
+static bool syscallStatsEnabled = false;
+// By callno, the module and function index from the syscall op.
+static std::map<u32, SyscallStats> syscallStats;
+
 void HLEInit()
 {
 	RegisterAllModules();
@@ -38,6 +57,7 @@ void HLEInit()
 void HLEShutdown()
 {
 	moduleDB.clear();
+	syscallStats.clear();
 }
 
 void RegisterModule(const char *name, int numFunctions, const HLEFunction *funcTable)
@@ -177,6 +197,18 @@ const char *GetFuncName(int moduleIndex, int func)
 	return "[unknown]";
 }
 
+static void UpdateSyscallStats(u32 callno, double elapsed)
+{
+	SyscallStats &stats = syscallStats[callno];
+	stats.calls++;
+	stats.time += elapsed;
+
+	int bucket = 0;
+	for (double us = elapsed * 1000000.0; us >= 1.0 && bucket < SYSCALL_TIME_BUCKETS - 1; us *= 0.5)
+		bucket++;
+	stats.histogram[bucket]++;
+}
+
 void CallSyscall(u32 op)
 {
 	u32 callno = (op >> 6) & 0xFFFFF; //20 bits
@@ -191,10 +223,66 @@ void CallSyscall(u32 op)
 	HLEFunc func = moduleDB[modulenum].funcTable[funcnum].func;
 	if (func)
 	{
-		func();
+		if (syscallStatsEnabled)
+		{
+			double start = time_now_d();
+			func();
+			UpdateSyscallStats(callno, time_now_d() - start);
+		}
+		else
+			func();
 	}
 	else
 	{
 		ERROR_LOG(HLE,"Unimplemented HLE function %s", moduleDB[modulenum].funcTable[funcnum].name);
 	}
 }
+
+const HLEFunction *GetSyscallInfo(u32 op)
+{
+	u32 callno = (op >> 6) & 0xFFFFF;
+	int funcnum = callno & 0xFFF;
+	int modulenum = (callno & 0xFF000) >> 12;
+	if (funcnum == 0xfff || modulenum >= (int)moduleDB.size() || funcnum >= moduleDB[modulenum].numFunctions)
+		return 0;
+	return &moduleDB[modulenum].funcTable[funcnum];
+}
+
+void EnableSyscallStats(bool enable)
+{
+	syscallStatsEnabled = enable;
+}
+
+bool SyscallStatsEnabled()
+{
+	return syscallStatsEnabled;
+}
+
+static bool CompareSyscallTime(const std::pair<u32, SyscallStats> &a, const std::pair<u32, SyscallStats> &b)
+{
+	return a.second.time > b.second.time;
+}
+
+std::string GetSyscallStatsSummary()
+{
+	std::vector<std::pair<u32, SyscallStats> > sorted(syscallStats.begin(), syscallStats.end());
+	std::sort(sorted.begin(), sorted.end(), CompareSyscallTime);
+
+	std::string text = "Syscalls by host time (histogram buckets: <1us, <2us, <4us, ...)\n";
+	char temp[256];
+	for (size_t i = 0; i < sorted.size(); i++)
+	{
+		u32 callno = sorted[i].first;
+		const SyscallStats &stats = sorted[i].second;
+		const char *name = GetFuncName((callno & 0xFF000) >> 12, callno & 0xFFF);
+		sprintf(temp, "%-40s %9u calls %10.3f ms %8.3f us/call  ", name, stats.calls, stats.time * 1000.0, stats.time * 1000000.0 / stats.calls);
+		text += temp;
+		for (int j = 0; j < SYSCALL_TIME_BUCKETS; j++)
+		{
+			sprintf(temp, " %u", stats.histogram[j]);
+			text += temp;
+		}
+		text += "\n";
+	}
+	return text;
+}
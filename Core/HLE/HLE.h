@@ -17,6 +17,8 @@
 
 #pragma once
 
+#include <string>
+
 #include "../Globals.h"
 #include "../MIPS/MIPS.h"
 
@@ -30,6 +32,13 @@ enum {
 	NOT_DISPATCH_SUSPENDED,
 };
 
+// HLEFunction::flags
+enum {
+	// Never reschedules, waits or changes the PC, so the jit can call it
+	// directly and keep running the block after it.
+	HLE_NOT_RESCHEDULE = 0x100,
+};
+
 struct HLEFunction
 {
 	u32 ID;
@@ -80,9 +89,12 @@ u32 GetNibByName(const char *module, const char *function);
 u32 GetSyscallOp(const char *module, u32 nib);
 void WriteSyscall(const char *module, u32 nib, u32 address);
 void CallSyscall(u32 op);
+// The function a syscall op calls, 0 if it's unknown.
+const HLEFunction *GetSyscallInfo(u32 op);
+
+// Per syscall call counts and host time histograms, off by default.
+void EnableSyscallStats(bool enable);
+bool SyscallStatsEnabled();
+std::string GetSyscallStatsSummary();
 void ResolveSyscall(const char *moduleName, u32 nib, u32 address);
 
-// Need to be able to save entire kernel state
-int GetStateSize();
-void SaveState(u8 *ptr);
-void LoadState(const u8 *ptr);
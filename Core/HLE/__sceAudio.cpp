@@ -27,6 +27,7 @@
 #include "../Config.h"
 #include "FixedSizeQueue.h"
 #include "Common/Thread.h"
+#include "ChunkFile.h"
 
 // While buffers == MAX_BUFFERS, block on blocking write
 // non-blocking writes will return busy, I guess
@@ -78,6 +79,23 @@ void __AudioInit()
 		chans[i].clear();
 }
 
+void __AudioDoState(PointerWrap &p)
+{
+	std::lock_guard<std::recursive_mutex> guard(section);
+
+	if (!p.Section("sceAudio", 1, 1))
+		return;
+
+	p.Do(mixFrequency);
+	for (int i = 0; i < MAX_CHANNEL; i++)
+		chans[i].DoState(p);
+	p.DoMarker("sceAudio");
+
+	// Already mixed output belongs to the host, just drop it.
+	if (p.mode == p.MODE_READ)
+		outAudioQueue.clear();
+}
+
 void __AudioShutdown()
 {
 	for (int i = 0; i < 8; i++)
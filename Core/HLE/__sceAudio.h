@@ -23,6 +23,7 @@
 
 void __AudioInit();
 void __AudioUpdate();
+void __AudioDoState(PointerWrap &p);
 void __AudioShutdown();
 void __AudioSetOutputFrequency(int freq);
 
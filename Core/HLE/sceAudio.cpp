@@ -22,6 +22,7 @@
 #include "sceAudio.h"
 #include "__sceAudio.h"
 #include "HLE.h"
+#include "ChunkFile.h"
 
 
 // There's a second Audio api called Audio2 that only has one channel, I guess the 8 channel api was overkill.
@@ -30,6 +31,20 @@
 
 AudioChannel chans[8];
 
+void AudioChannel::DoState(PointerWrap &p)
+{
+	p.Do(reserved);
+	p.Do(sampleAddress);
+	p.Do(sampleCount);
+	p.Do(dataLen);
+	p.Do(leftVolume);
+	p.Do(rightVolume);
+	p.Do(format);
+	p.Do(waitingThread);
+	sampleQueue.DoState(p);
+	p.DoMarker("AudioChannel");
+}
+
 // Enqueues the buffer pointer on the channel. If channel buffer queue is full (2 items?) will block until it isn't.
 // For solid audio output we'll need a queue length of 2 buffers at least, we'll try that first.
 
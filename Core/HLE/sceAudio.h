@@ -76,6 +76,8 @@ struct AudioChannel
 		sampleCount = 0;
     sampleQueue.clear();
   }
+
+	void DoState(PointerWrap &p);
 };
 
 extern AudioChannel chans[8];
@@ -18,11 +18,13 @@
 #include "HLE.h"
 #include "../MIPS/MIPS.h"
 #include "../CoreTiming.h"
+#include "../Replay.h"
 #include "StdMutex.h"
 #include "sceCtrl.h"
 #include "sceDisplay.h"
 #include "sceKernel.h"
 #include "sceKernelThread.h"
+#include "ChunkFile.h"
 
 /* Index for the two analog directions */
 #define CTRL_ANALOG_X   0
@@ -83,6 +85,9 @@ void __CtrlUpdateLatch()
 {
 	std::lock_guard<std::recursive_mutex> guard(ctrlMutex);
 
+	// Host input can arrive at any time, so this is where it's recorded or replayed.
+	Replay_Ctrl(ctrlCurrent.buttons, ctrlCurrent.analog);
+
 	u32 changed = ctrlCurrent.buttons ^ ctrlOldButtons;
 	latch.btnMake |= ctrlCurrent.buttons & changed;
 	latch.btnBreak |= ctrlOldButtons & changed;
@@ -122,7 +127,7 @@ u32 __CtrlPeekButtons()
 {
 	std::lock_guard<std::recursive_mutex> guard(ctrlMutex);
 
-	return ctrlCurrent.buttons;
+	return (u32)Replay_Value(REPLAY_CTRL_PEEK, ctrlCurrent.buttons);
 }
 
 // Functions so that the rest of the emulator can control what the sceCtrl interface should return
@@ -226,6 +231,25 @@ retry:
 	}
 }
 
+void __CtrlDoState(PointerWrap &p)
+{
+	std::lock_guard<std::recursive_mutex> guard(ctrlMutex);
+
+	if (!p.Section("sceCtrl", 1, 1))
+		return;
+
+	p.Do(analogEnabled);
+	p.Do(ctrlLatchBufs);
+	p.Do(ctrlOldButtons);
+	p.DoArray(ctrlBufs, NUM_CTRL_BUFFERS);
+	p.Do(ctrlCurrent);
+	p.Do(ctrlBuf);
+	p.Do(ctrlBufRead);
+	p.Do(latch);
+	p.Do(waitingThreads);
+	p.DoMarker("sceCtrl");
+}
+
 void __CtrlInit()
 {
 	std::lock_guard<std::recursive_mutex> guard(ctrlMutex);
@@ -384,8 +408,8 @@ static const HLEFunction sceCtrl[] =
 	{0x02BAAD91, WrapI_U<sceCtrlGetSamplingCycle>,"sceCtrlGetSamplingCycle"},
 	{0xDA6B76A1, WrapI_U<sceCtrlGetSamplingMode>, "sceCtrlGetSamplingMode"},
 	{0x1f803938, WrapV_UU<sceCtrlReadBufferPositive>, "sceCtrlReadBufferPositive"}, //(ctrl_data_t* paddata, int unknown) // unknown should be 1
-	{0x3A622550, WrapI_UU<sceCtrlPeekBufferPositive>, "sceCtrlPeekBufferPositive"},
-	{0xC152080A, WrapI_UU<sceCtrlPeekBufferNegative>, "sceCtrlPeekBufferNegative"},
+	{0x3A622550, WrapI_UU<sceCtrlPeekBufferPositive>, "sceCtrlPeekBufferPositive", HLE_NOT_RESCHEDULE},
+	{0xC152080A, WrapI_UU<sceCtrlPeekBufferNegative>, "sceCtrlPeekBufferNegative", HLE_NOT_RESCHEDULE},
 	{0x60B81F86, WrapV_UU<sceCtrlReadBufferNegative>, "sceCtrlReadBufferNegative"},
 	{0xB1D0E5CD, WrapU_U<sceCtrlPeekLatch>, "sceCtrlPeekLatch"},
 	{0x0B588501, WrapU_U<sceCtrlReadLatch>, "sceCtrlReadLatch"},
@@ -17,6 +17,8 @@
 
 #pragma once
 
+class PointerWrap;
+
 void Register_sceCtrl();
 
 #define CTRL_SQUARE     0x8000
@@ -33,6 +35,7 @@ void Register_sceCtrl();
 #define CTRL_RTRIGGER   0x0200
 
 void __CtrlInit();
+void __CtrlDoState(PointerWrap &p);
 
 void __CtrlButtonDown(u32 buttonBit);
 void __CtrlButtonUp(u32 buttonBit);
@@ -22,6 +22,7 @@
 // to be dependent on "native", I think. Or maybe should get rid of common
 // and move everything into native...
 #include "base/timeutil.h"
+#include "zlib.h"
 
 #include "Thread.h"
 #include "../Core/CoreTiming.h"
@@ -36,6 +37,7 @@
 #include "sceKernel.h"
 #include "sceKernelThread.h"
 #include "sceKernelInterrupt.h"
+#include "ChunkFile.h"
 
 // TODO: This file should not depend directly on GLES code.
 #include "../../GPU/GLES/Framebuffer.h"
@@ -72,6 +74,9 @@ double lastFrameTime = 0;
 
 // STATE END
 
+// Host side only, frameskip just restarts after loading a state.
+static bool frameSkipped = false;
+
 std::vector<VblankCallback> vblankListeners;
 
 // The vblank period is 731.5 us (0.7315 ms)
@@ -109,10 +114,44 @@ void __DisplayInit()
 	CoreTiming::ScheduleEvent(msToCycles(frameMs - vblankMs), enterVblankEvent, 0);
 	isVblank = 0;
 	vCount = 0;
+	frameSkipped = false;
 
 	InitGfxState();
 }
 
+void __DisplayDoState(PointerWrap &p)
+{
+	if (!p.Section("sceDisplay", 1, 1))
+		return;
+
+	// lastFrameTime is host time, it just restarts.
+	p.Do(framebuf);
+	p.Do(latchedFramebuf);
+	p.Do(framebufIsLatched);
+	p.Do(hCount);
+	p.Do(hCountTotal);
+	p.Do(vCount);
+	p.Do(isVblank);
+	p.Do(hasSetMode);
+	p.Do(vblankWaitingThreads);
+	p.DoMarker("sceDisplay");
+}
+
+u32 __DisplayGetFrameHash()
+{
+	int bytesPerPixel = framebuf.pspFramebufFormat == PSP_DISPLAY_PIXEL_FORMAT_8888 ? 4 : 2;
+	u32 stride = framebuf.pspFramebufLinesize * bytesPerPixel;
+	uLong crc = crc32(0L, Z_NULL, 0);
+	for (int y = 0; y < 272; y++)
+	{
+		u32 addr = framebuf.topaddr + y * stride;
+		if (!Memory::IsValidAddress(addr) || !Memory::IsValidAddress(addr + 480 * bytesPerPixel - 1))
+			break;
+		crc = crc32(crc, Memory::GetPointer(addr), 480 * bytesPerPixel);
+	}
+	return (u32)crc;
+}
+
 void __DisplayShutdown()
 {
 	ShutdownGfxState();
@@ -164,14 +203,19 @@ void hleEnterVblank(u64 userdata, int cyclesLate)
 
 	gpuStats.numFrames++;
 
+	// A frame that frameskip didn't draw isn't presented either, the host keeps showing the last one.
+	// Fast-forward skips the host frame work altogether.
+	bool presentFrame = !frameSkipped && !g_Config.bFastForward;
+
 	// Yeah, this has to be the right moment to end the frame. Give the graphics backend opportunity
 	// to blit the framebuffer, in order to support half-framerate games that otherwise wouldn't have
 	// anything to draw here.
-	gpu->CopyDisplayToOutput();
+	if (!frameSkipped)
+		gpu->CopyDisplayToOutput();
 
 	// Now we can subvert the Ge engine in order to draw custom overlays like stat counters etc.
 	// Here we will be drawing to the non buffered front surface.
-	if (g_Config.bShowDebugStats)
+	if (g_Config.bShowDebugStats && presentFrame)
 	{
 		gpu->UpdateStats();
 		char stats[512];
@@ -179,6 +223,7 @@ void hleEnterVblank(u64 userdata, int cyclesLate)
 			"Frames: %i\n"
 			"Draw calls: %i\n"
 			"Vertices Transformed: %i\n"
+			"Vertex cache hits: %i, misses: %i, entries: %i\n"
 			"Textures active: %i\n"
 			"Vertex shaders loaded: %i\n"
 			"Fragment shaders loaded: %i\n"
@@ -186,6 +231,9 @@ void hleEnterVblank(u64 userdata, int cyclesLate)
 			gpuStats.numFrames,
 			gpuStats.numDrawCalls,
 			gpuStats.numVertsTransformed,
+			gpuStats.numVertexCacheHits,
+			gpuStats.numVertexCacheMisses,
+			gpuStats.numVertexCacheEntries,
 			gpuStats.numTextures,
 			gpuStats.numVertexShaders,
 			gpuStats.numFragmentShaders,
@@ -202,7 +250,8 @@ void hleEnterVblank(u64 userdata, int cyclesLate)
 	}
 
 
-	host->EndFrame();
+	if (presentFrame)
+		host->EndFrame();
 
 #ifdef _WIN32
 	static double lastFrameTime = 0.0;
@@ -210,7 +259,7 @@ void hleEnterVblank(u64 userdata, int cyclesLate)
 	time_update();
 	if (lastFrameTime == 0.0)
 		lastFrameTime = time_now_d();
-	if (!GetAsyncKeyState(VK_TAB)) {
+	if (!GetAsyncKeyState(VK_TAB) && !g_Config.bFastForward) {
 		while (time_now_d() < lastFrameTime + 1.0 / 60.0f) {
 			Common::SleepCurrentThread(1);
 			time_update();
@@ -219,7 +268,12 @@ void hleEnterVblank(u64 userdata, int cyclesLate)
 	}
 #endif
 
-	host->BeginFrame();
+	// Decide whether the coming frame gets drawn.
+	frameSkipped = g_Config.iFrameSkip > 1 && (gpuStats.numFrames % g_Config.iFrameSkip) != 0;
+	gpu->SetSkipDrawing(frameSkipped);
+
+	if (!frameSkipped && !g_Config.bFastForward)
+		host->BeginFrame();
 	gpu->BeginFrame();
 
 	shaderManager.DirtyShader();
@@ -17,7 +17,13 @@
 
 #pragma once
 
+class PointerWrap;
+
 void __DisplayInit();
+void __DisplayDoState(PointerWrap &p);
+
+// CRC of the visible part of the displayed framebuffer, for checking replays.
+u32 __DisplayGetFrameHash();
 
 void Register_sceDisplay();
 
@@ -17,12 +17,15 @@
 
 #include "Globals.h"
 #include "HLE.h"
+#include "../../GPU/GPUState.h"
+#include "../../GPU/GPUInterface.h"
 
 u32 sceDmacMemcpy(u32 dst, u32 src, u32 size)
 {
 	DEBUG_LOG(HLE, "sceDmacMemcpy(dest=%08x, src=%08x, size=%i)", dst, src, size);
 	// TODO: check the addresses.
 	Memory::Memcpy(dst, Memory::GetPointer(src), size);
+	gpu->InvalidateCache(dst, size);
 	return 0;
 }
 
@@ -24,6 +24,7 @@
 #include "sceKernelInterrupt.h"
 #include "../GPU/GPUState.h"
 #include "../GPU/GPUInterface.h"
+#include "ChunkFile.h"
 
 // TODO: This doesn't really belong here
 static int state;
@@ -34,6 +35,15 @@ void __GeInit()
 	state = 0;
 }
 
+void __GeDoState(PointerWrap &p)
+{
+	if (!p.Section("sceGe", 1, 1))
+		return;
+
+	p.Do(state);
+	p.DoMarker("sceGe");
+}
+
 void __GeShutdown()
 {
 
@@ -36,7 +36,10 @@ typedef struct PspGeCallbackData
 
 void Register_sceGe_user();
 
+class PointerWrap;
+
 void __GeInit();
+void __GeDoState(PointerWrap &p);
 void __GeShutdown();
 
 
@@ -21,6 +21,7 @@
 #endif
 
 #include "../System.h"
+#include "../Replay.h"
 #include "HLE.h"
 #include "../MIPS/MIPS.h"
 #include "../HW/MemoryStick.h"
@@ -29,6 +30,7 @@
 #include "../FileSystems/MetaFileSystem.h"
 #include "../FileSystems/ISOFileSystem.h"
 #include "../FileSystems/DirectoryFileSystem.h"
+#include "ChunkFile.h"
 
 #include "sceIo.h"
 #include "sceRtc.h"
@@ -134,6 +136,20 @@ public:
 	}
 	static u32 GetMissingErrorCode() { return SCE_KERNEL_ERROR_BADF; }
 	int GetIDType() const { return 0; }
+	static int GetStaticIDType() { return PPSSPP_KERNEL_TMID_File; }
+
+	// The handle itself is restored by pspFileSystem's DoState.
+	virtual void DoState(PointerWrap &p)
+	{
+		p.Do(fullpath);
+		p.Do(handle);
+		p.Do(callbackID);
+		p.Do(callbackArg);
+		p.Do(asyncResult);
+		p.Do(pendingAsyncResult);
+		p.Do(sectorBlockMode);
+		p.DoMarker("FileNode");
+	}
 
 	std::string fullpath;
 	u32 handle;
@@ -147,6 +163,11 @@ public:
 	bool sectorBlockMode;
 };
 
+KernelObject *__KernelFileNodeObject()
+{
+	return new FileNode;
+}
+
 void __IoInit()
 {
 	INFO_LOG(HLE, "Starting up I/O...");
@@ -242,6 +263,9 @@ void __IoGetStat(SceIoStat *stat, PSPFileInfo &info)
 	stat->st_attr = attr;
 	stat->st_size = info.size;
 	stat->st_private[0] = info.startSector;
+
+	// Host files come and go between runs, and the times will come from them too.
+	Replay_Data(REPLAY_IO_STAT, stat, sizeof(SceIoStat));
 }
 
 
@@ -732,6 +756,20 @@ u32 __IoClose(SceUID id, int param)
 	return kernelObjects.Destroy<FileNode>(id);
 }
 
+void __IoDoState(PointerWrap &p)
+{
+	if (!p.Section("sceIo", 1, 1))
+		return;
+
+	// __IoClose is the only deferred action there is.
+	bool hasDefAction = defAction != 0;
+	p.Do(hasDefAction);
+	p.Do(defParam);
+	if (p.mode == p.MODE_READ)
+		defAction = hasDefAction ? &__IoClose : 0;
+	p.DoMarker("sceIo");
+}
+
 void sceIoCloseAsync()
 {
 	DEBUG_LOG(HLE,"sceIoCloseAsync(%d)",PARAM(0));
@@ -889,12 +927,42 @@ public:
 	const char *GetTypeName() {return "DirListing";}
 	static u32 GetMissingErrorCode() { return SCE_KERNEL_ERROR_BADF; }
 	int GetIDType() const { return 0; }
+	static int GetStaticIDType() { return PPSSPP_KERNEL_TMID_DirList; }
+
+	virtual void DoState(PointerWrap &p)
+	{
+		p.Do(name);
+		p.Do(index);
+
+		// PSPFileInfo has a string, so no raw copy.
+		u32 count = (u32)listing.size();
+		p.Do(count);
+		listing.resize(count);
+		for (u32 i = 0; i < count; ++i)
+		{
+			PSPFileInfo &info = listing[i];
+			p.Do(info.name);
+			p.Do(info.size);
+			p.Do(info.access);
+			p.Do(info.exists);
+			p.Do(info.type);
+			p.Do(info.isOnSectorSystem);
+			p.Do(info.startSector);
+			p.Do(info.numSectors);
+		}
+		p.DoMarker("DirListing");
+	}
 
 	std::string name;
 	std::vector<PSPFileInfo> listing;
 	int index;
 };
 
+KernelObject *__KernelDirListingObject()
+{
+	return new DirListing;
+}
+
 void sceIoDopen() //(const char *path); 
 {
 	const char *path = Memory::GetCharPointer(PARAM(0));
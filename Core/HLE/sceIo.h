@@ -19,11 +19,16 @@
 
 #include <string>
 #include "HLE.h"
+#include "sceKernel.h"
 
 void __IoInit();
+void __IoDoState(PointerWrap &p);
 void __IoShutdown();
 
 void Register_IoFileMgrForUser();
 void Register_StdioForUser();
 
 const std::string &EmuDebugOutput();
+
+KernelObject *__KernelFileNodeObject();
+KernelObject *__KernelDirListingObject();
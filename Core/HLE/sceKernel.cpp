@@ -25,6 +25,7 @@
 #include "../PSPLoaders.h"
 #include "../../Core/CoreTiming.h"
 #include "../../Core/System.h"
+#include "ChunkFile.h"
 
 
 #include "__sceAudio.h"
@@ -38,6 +39,7 @@
 #include "sceKernelInterrupt.h"
 #include "sceKernelThread.h"
 #include "sceKernelMemory.h"
+#include "sceKernelModule.h"
 #include "sceKernelMutex.h"
 #include "sceKernelMbx.h"
 #include "sceKernelMsgPipe.h"
@@ -73,6 +75,8 @@ void __KernelInit()
 
 	__KernelMemoryInit();
 	__KernelThreadingInit();
+	__KernelSemaInit();
+	__KernelMutexInit();
 	__IoInit();
 	__AudioInit();
 	__DisplayInit();
@@ -116,6 +120,31 @@ void __KernelShutdown()
 	kernelRunning = false;
 }
 
+// Objects first: clearing the pool closes files and frees memory of the old objects,
+// and everything after refers to the new ones by UID.
+void __KernelDoState(PointerWrap &p)
+{
+	if (!p.Section("Kernel", 1, 1))
+		return;
+
+	kernelObjects.DoState(p);
+	p.DoMarker("KernelObjects");
+
+	__KernelMemoryDoState(p);
+	__KernelThreadingDoState(p);
+	__KernelMutexDoState(p);
+	__IoDoState(p);
+	__InterruptsDoState(p);
+	__AudioDoState(p);
+	__DisplayDoState(p);
+	__GeDoState(p);
+	__PowerDoState(p);
+	__UtilityDoState(p);
+	__UmdDoState(p);
+	__CtrlDoState(p);
+	p.DoMarker("Kernel");
+}
+
 bool __KernelIsRunning() {
 	return kernelRunning;
 }
@@ -196,36 +225,45 @@ KernelObjectPool kernelObjects;
 
 KernelObjectPool::KernelObjectPool()
 {
-	memset(occupied, 0, sizeof(bool)*maxCount);
+	memset(slots, 0, sizeof(slots));
+	ResetFreeList();
 }
 
-SceUID KernelObjectPool::Create(KernelObject *obj, int rangeBottom, int rangeTop)
+void KernelObjectPool::ResetFreeList()
 {
-	if (rangeTop > maxCount)
-		rangeTop = maxCount;
-	for (int i = rangeBottom; i < rangeTop; i++)
+	freeCount = 0;
+	for (int i = maxCount - 1; i >= firstIndex; i--)
 	{
-		if (!occupied[i])
-		{
-			occupied[i] = true;
-			pool[i] = obj;
-			pool[i]->uid = i + handleOffset;
-			return i + handleOffset;
-		}
+		if (!slots[i].occupied)
+			freeList[freeCount++] = i;
 	}
-	_dbg_assert_(HLE, 0);
-	return 0;
 }
 
-bool KernelObjectPool::IsValid(SceUID handle)
+SceUID KernelObjectPool::CreateSlot(KernelObject *obj, int type)
 {
-	int index = handle - handleOffset;
-	if (index < 0)
-		return false;
-	if (index >= maxCount)
-		return false;
+	if (freeCount == 0)
+	{
+		_dbg_assert_(HLE, 0);
+		return 0;
+	}
 
-	return occupied[index];
+	int index = freeList[--freeCount];
+	Slot &slot = slots[index];
+	slot.occupied = true;
+	slot.obj = obj;
+	slot.type = type;
+	obj->uid = (slot.generation << generationShift) | (index + handleOffset);
+	return obj->uid;
+}
+
+void KernelObjectPool::FreeSlot(int index)
+{
+	Slot &slot = slots[index];
+	delete slot.obj;
+	slot.obj = 0;
+	slot.occupied = false;
+	slot.generation = (slot.generation + 1) & generationMask;
+	freeList[freeCount++] = index;
 }
 
 void KernelObjectPool::Clear()
@@ -233,60 +271,169 @@ void KernelObjectPool::Clear()
 	for (int i=0; i<maxCount; i++)
 	{
 		//brutally clear everything, no validation
-		if (occupied[i])
-			delete pool[i];
-		occupied[i]=false;
+		if (slots[i].occupied)
+			delete slots[i].obj;
 	}
-	memset(pool, 0, sizeof(KernelObject*)*maxCount);
+	memset(slots, 0, sizeof(slots));
+	ResetFreeList();
 }
 
 KernelObject *&KernelObjectPool::operator [](SceUID handle)
 {
 	_dbg_assert_msg_(HLE, IsValid(handle), "GRABBING UNALLOCED KERNEL OBJ");
-	return pool[handle - handleOffset];
+	return slots[SlotIndex(handle)].obj;
 }
 
 void KernelObjectPool::List()
 {
 	for (int i = 0; i < maxCount; i++)
 	{
-		if (occupied[i])
+		if (slots[i].occupied)
 		{
 			char buffer[256];
-			if (pool[i])
+			if (slots[i].obj)
 			{
-				pool[i]->GetQuickInfo(buffer,256);
+				slots[i].obj->GetQuickInfo(buffer,256);
+				INFO_LOG(HLE, "KO %i: %s \"%s\": %s", slots[i].obj->GetUID(), slots[i].obj->GetTypeName(), slots[i].obj->GetName(), buffer);
 			}
 			else
 			{
-				strcpy(buffer,"WTF? Zero Pointer");
+				INFO_LOG(HLE, "KO %i: WTF? Zero Pointer", i + handleOffset);
 			}
-			INFO_LOG(HLE, "KO %i: %s \"%s\": %s", i + handleOffset, pool[i]->GetTypeName(), pool[i]->GetName(), buffer);
 		}
 	}
 }
 
 int KernelObjectPool::GetCount()
 {
-	int count = 0;
-	for (int i=0; i<maxCount; i++)
+	return maxCount - firstIndex - freeCount;
+}
+
+void KernelObject::DoState(PointerWrap &p)
+{
+	ERROR_LOG(HLE, "Unable to do state for %s", GetTypeName());
+	// Nothing after this would line up.
+	p.SetMode(PointerWrap::MODE_MEASURE);
+	p.error = p.ERROR_FAILURE;
+}
+
+void KernelObjectPool::DoState(PointerWrap &p)
+{
+	if (!p.Section("KernelObjectPool", 1, 1))
+		return;
+
+	int count = maxCount;
+	p.Do(count);
+	if (count != maxCount)
 	{
-		if (occupied[i])
-			count++;
+		ERROR_LOG(HLE, "Unable to load state: different kernel object pool size.");
+		p.SetMode(PointerWrap::MODE_MEASURE);
+		p.error = p.ERROR_FAILURE;
+		return;
+	}
+
+	bool reading = p.mode == p.MODE_READ;
+	if (reading)
+		Clear();
+
+	for (int i = 0; i < maxCount; i++)
+	{
+		Slot &slot = slots[i];
+		p.Do(slot.occupied);
+		p.Do(slot.generation);
+		if (!slot.occupied)
+			continue;
+
+		p.Do(slot.type);
+		if (reading)
+		{
+			slot.obj = CreateByIDType(slot.type);
+			if (!slot.obj)
+			{
+				// Can't know how big it was, nothing after this would load right.
+				// Frees the objects loaded so far too.
+				ERROR_LOG(HLE, "Unable to load state: unknown kernel object type %d.", slot.type);
+				Clear();
+				p.SetMode(PointerWrap::MODE_MEASURE);
+				p.error = p.ERROR_FAILURE;
+				return;
+			}
+			slot.obj->uid = (slot.generation << generationShift) | (i + handleOffset);
+		}
+		slot.obj->DoState(p);
+		if (reading && p.mode != p.MODE_READ)
+		{
+			// The object failed, don't leave the ones before it around half loaded.
+			Clear();
+			p.error = p.ERROR_FAILURE;
+			return;
+		}
+	}
+	p.Do(freeCount);
+	p.DoArray(freeList, freeCount);
+	p.DoMarker("KernelObjectPool");
+}
+
+KernelObject *KernelObjectPool::CreateByIDType(int type)
+{
+	switch (type)
+	{
+	case SCE_KERNEL_TMID_Thread:
+		return __KernelThreadObject();
+	case SCE_KERNEL_TMID_Callback:
+		return __KernelCallbackObject();
+	case SCE_KERNEL_TMID_Semaphore:
+		return __KernelSemaphoreObject();
+	case SCE_KERNEL_TMID_EventFlag:
+		return __KernelEventFlagObject();
+	case SCE_KERNEL_TMID_Mbox:
+		return __KernelMbxObject();
+	case SCE_KERNEL_TMID_Fpl:
+		return __KernelMemoryFPLObject();
+	case SCE_KERNEL_TMID_Vpl:
+		return __KernelMemoryVPLObject();
+	case PPSSPP_KERNEL_TMID_PMB:
+		return __KernelMemoryPMBObject();
+	case SCE_KERNEL_TMID_Mpipe:
+		return __KernelMsgPipeObject();
+	case SCE_KERNEL_TMID_VTimer:
+		return __KernelVTimerObject();
+	case SCE_KERNEL_TMID_Mutex:
+		return __KernelMutexObject();
+	case SCE_KERNEL_TMID_LwMutex:
+		return __KernelLwMutexObject();
+	case PPSSPP_KERNEL_TMID_Module:
+		return __KernelModuleObject();
+	case PPSSPP_KERNEL_TMID_File:
+		return __KernelFileNodeObject();
+	case PPSSPP_KERNEL_TMID_DirList:
+		return __KernelDirListingObject();
+
+	default:
+		ERROR_LOG(COMMON, "Unable to load state: could not find object type %d.", type);
+		return NULL;
 	}
-	return count;
 }
 
 void sceKernelIcacheInvalidateAll()
 {
-	DEBUG_LOG(CPU, "Icache invalidated - should clear JIT someday");
+	DEBUG_LOG(CPU, "Icache invalidated");
+	currentMIPS->InvalidateICache(0, 0x20000000);
 	RETURN(0);
 }
 
+void sceKernelIcacheInvalidateRange(u32 addr, int size)
+{
+	DEBUG_LOG(CPU, "sceKernelIcacheInvalidateRange(%08x, %i)", addr, size);
+	if (size > 0)
+		currentMIPS->InvalidateICache(addr, size);
+	RETURN(0);
+}
 
 void sceKernelIcacheClearAll()
 {
-	DEBUG_LOG(CPU, "Icache cleared - should clear JIT someday");
+	DEBUG_LOG(CPU, "Icache cleared");
+	currentMIPS->InvalidateICache(0, 0x20000000);
 	RETURN(0);
 }
 
@@ -398,9 +545,9 @@ const HLEFunction ThreadManForUser[] =
 	{0xd8b299ae,sceKernelSetVTimerHandler,"sceKernelSetVTimerHandler"},
 	{0x53B00E9A,0,"sceKernelSetVTimerHandlerWide"},
 
-	{0x82BC5777,sceKernelGetSystemTimeWide,"sceKernelGetSystemTimeWide"},
+	{0x82BC5777,sceKernelGetSystemTimeWide,"sceKernelGetSystemTimeWide", HLE_NOT_RESCHEDULE},
 	{0xdb738f35,sceKernelGetSystemTime,"sceKernelGetSystemTime"},
-	{0x369ed59d,sceKernelGetSystemTimeLow,"sceKernelGetSystemTimeLow"},
+	{0x369ed59d,sceKernelGetSystemTimeLow,"sceKernelGetSystemTimeLow", HLE_NOT_RESCHEDULE},
 
 	{0x8218B4DD,&WrapU_U<sceKernelReferGlobalProfiler>,"sceKernelReferGlobalProfiler"},
 	{0x627E6F3A,&WrapU_U<sceKernelReferSystemStatus>,"sceKernelReferSystemStatus"},
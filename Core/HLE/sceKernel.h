@@ -20,6 +20,8 @@
 #include "../../Globals.h"
 #include <cstring>
 
+class PointerWrap;
+
 enum
 {
 	SCE_KERNEL_ERROR_OK      = 0,
@@ -263,6 +265,7 @@ struct SceKernelLoadExecParam
 
 void __KernelInit();
 void __KernelShutdown();
+void __KernelDoState(PointerWrap &p);
 bool __KernelIsRunning();
 bool __KernelLoadExec(const char *filename, SceKernelLoadExecParam *param);
 
@@ -289,12 +292,22 @@ void sceKernelDcacheWritebackInvalidateRange();
 void sceKernelDcacheWritebackInvalidateAll();
 void sceKernelGetThreadStackFreeSize();
 void sceKernelIcacheInvalidateAll();
+void sceKernelIcacheInvalidateRange(u32 addr, int size);
 void sceKernelIcacheClearAll();
 
 #define KERNELOBJECT_MAX_NAME_LENGTH 31
 
 class KernelObjectPool;
 
+// Our own ids for the objects the PSP doesn't give a TMID, so every class has a unique one.
+enum
+{
+	PPSSPP_KERNEL_TMID_File = 0x100001,
+	PPSSPP_KERNEL_TMID_DirList = 0x100002,
+	PPSSPP_KERNEL_TMID_Module = 0x100003,
+	PPSSPP_KERNEL_TMID_PMB = 0x100004,
+};
+
 class KernelObject
 {
 	friend class KernelObjectPool;
@@ -307,67 +320,67 @@ public:
 	virtual int GetIDType() const = 0;
 	virtual void GetQuickInfo(char *ptr, int size) {strcpy(ptr,"-");}
 
-	// Implement this in all subclasses:
+	// Implement these in all subclasses:
 	// static u32 GetMissingErrorCode()
+	// static int GetStaticIDType()  - unique per class, the TMID if there is one.
 
-	// Future
-	// void Serialize(ChunkFile)
-	// void DeSerialize(ChunkFile)
+	// Types without state support abort the load.
+	virtual void DoState(PointerWrap &p);
 };
 
-
+// Handles are the slot index plus handleOffset, with a generation count above that
+// which changes every time the slot is freed, so stale handles don't find the next
+// object in the slot. Each slot keeps its class id, which makes Get<T> a compare.
 class KernelObjectPool {
 public:
 	KernelObjectPool();
 	~KernelObjectPool() {}
 
-	// Allocates a UID within the range and inserts the object into the map.
-	SceUID Create(KernelObject *obj, int rangeBottom = 16, int rangeTop = 0x7fffffff);
-
-	// TODO: How will we ever save/restore this pool?
+	// Allocates a UID and inserts the object into the pool.
+	template <class T>
+	SceUID Create(T *obj)
+	{
+		return CreateSlot(obj, T::GetStaticIDType());
+	}
 
 	template <class T>
 	u32 Destroy(SceUID handle)
 	{
 		u32 error;
 		if (Get<T>(handle, error))
-		{
-			occupied[handle-handleOffset] = false;
-			delete pool[handle-handleOffset];
-		}
+			FreeSlot(SlotIndex(handle));
 		return error;
 	};
 
-	bool IsValid(SceUID handle);
+	bool IsValid(SceUID handle) const { return SlotIndex(handle) >= 0; }
 
 	template <class T>
 	T* Get(SceUID handle, u32 &outError)
 	{
-		if (handle < handleOffset || handle >= handleOffset+maxCount || !occupied[handle-handleOffset])
+		int index = SlotIndex(handle);
+		if (index < 0)
 		{
 			ERROR_LOG(HLE, "Kernel: Bad object handle %i (%08x)", handle, handle);
 			outError = T::GetMissingErrorCode(); // ?
 			return 0;
 		}
-		else
+		else if (slots[index].type != T::GetStaticIDType())
 		{
-			T* t = dynamic_cast<T*>(pool[handle - handleOffset]);
-			if (t == 0)
-			{
-				ERROR_LOG(HLE, "Kernel: Wrong type object %i (%08x)", handle, handle);
-				outError = T::GetMissingErrorCode(); //FIX
-				return 0;
-			}
-			outError = SCE_KERNEL_ERROR_OK;
-			return t;
+			ERROR_LOG(HLE, "Kernel: Wrong type object %i (%08x)", handle, handle);
+			outError = T::GetMissingErrorCode(); //FIX
+			return 0;
 		}
+		outError = SCE_KERNEL_ERROR_OK;
+		return static_cast<T*>(slots[index].obj);
 	}
 	static u32 GetMissingErrorCode() { return -1; }	// TODO
 
 	bool GetIDType(SceUID handle, int *type) const
 	{
-		KernelObject *t = pool[handle - handleOffset];
-		*type = t->GetIDType();
+		int index = SlotIndex(handle);
+		if (index < 0)
+			return false;
+		*type = slots[index].obj->GetIDType();
 		return true;
 	}
 
@@ -376,10 +389,48 @@ public:
 	void Clear();
 	int GetCount();
 
+	void DoState(PointerWrap &p);
+	// Makes an empty object of a class, by its GetStaticIDType, for loading states.
+	static KernelObject *CreateByIDType(int type);
+
 private:
-	enum {maxCount=4096, handleOffset=0x100};
-	KernelObject *pool[maxCount];
-	bool occupied[maxCount];
+	enum
+	{
+		maxCount = 4096,
+		handleOffset = 0x100,
+		firstIndex = 16,
+		generationShift = 16,
+		generationMask = 0x7fff,
+	};
+
+	struct Slot
+	{
+		KernelObject *obj;
+		int type;
+		u16 generation;
+		bool occupied;
+	};
+
+	SceUID CreateSlot(KernelObject *obj, int type);
+	void FreeSlot(int index);
+	void ResetFreeList();
+
+	// Returns -1 unless the handle is for a live object.
+	int SlotIndex(SceUID handle) const
+	{
+		int index = (handle & ((1 << generationShift) - 1)) - handleOffset;
+		if (handle < 0 || index < 0 || index >= maxCount)
+			return -1;
+		const Slot &slot = slots[index];
+		if (!slot.occupied || slot.generation != ((handle >> generationShift) & generationMask))
+			return -1;
+		return index;
+	}
+
+	Slot slots[maxCount];
+	// Stack of free slots, lowest index on top to begin with.
+	int freeList[maxCount];
+	int freeCount;
 };
 
 extern KernelObjectPool kernelObjects;
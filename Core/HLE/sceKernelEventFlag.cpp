@@ -19,6 +19,7 @@
 
 #include "HLE.h"
 #include "../MIPS/MIPS.h"
+#include "ChunkFile.h"
 
 #include "sceKernel.h"
 #include "sceKernelThread.h"
@@ -62,11 +63,24 @@ public:
 		return SCE_KERNEL_ERROR_UNKNOWN_EVFID;
 	}
 	int GetIDType() const { return SCE_KERNEL_TMID_EventFlag; }
+	static int GetStaticIDType() { return SCE_KERNEL_TMID_EventFlag; }
+
+	virtual void DoState(PointerWrap &p)
+	{
+		p.Do(nef);
+		p.Do(waitingThreads);
+		p.DoMarker("EventFlag");
+	}
 
 	NativeEventFlag nef;
 	std::vector<EventFlagTh> waitingThreads;
 };
 
+KernelObject *__KernelEventFlagObject()
+{
+	return new EventFlag;
+}
+
 
 /** Event flag creation attributes */
 enum PspEventFlagAttributes
@@ -25,4 +25,6 @@ void sceKernelWaitEventFlag(SceUID id, u32 bits, u32 wait, u32 outBitsPtr, u32 t
 void sceKernelWaitEventFlagCB(SceUID id, u32 bits, u32 wait, u32 outBitsPtr, u32 timeoutPtr);
 int sceKernelPollEventFlag(SceUID id, u32 bits, u32 wait, u32 outBitsPtr, u32 timeoutPtr);
 u32 sceKernelReferEventFlagStatus(SceUID id, u32 statusPtr);
-u32 sceKernelCancelEventFlag();
\ No newline at end of file
+u32 sceKernelCancelEventFlag();
+
+KernelObject *__KernelEventFlagObject();
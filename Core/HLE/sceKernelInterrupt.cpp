@@ -23,10 +23,13 @@
 #include "../MIPS/MIPS.h"
 
 #include "Action.h"
+#include "ChunkFile.h"
 #include "sceKernel.h"
 #include "sceKernelThread.h"
 #include "sceKernelInterrupt.h"
 #include "sceKernelMutex.h"
+#include "../../GPU/GPUState.h"
+#include "../../GPU/GPUInterface.h"
 
 struct Interrupt
 {
@@ -180,8 +183,18 @@ public:
 		// RA is already taken care of
 	}
 
+	void DoState(PointerWrap &p)
+	{
+		p.Do(enabled);
+		p.Do(number);
+		p.Do(intrNumber);
+		p.Do(handlerAddress);
+		p.Do(handlerArg);
+	}
+
 	bool enabled;
 	int number;
+	int intrNumber;
 	u32 handlerAddress;
 	u32 handlerArg;
 };
@@ -231,6 +244,25 @@ public:
 		}
 	}
 
+	void DoState(PointerWrap &p)
+	{
+		u32 count = (u32)subIntrHandlers.size();
+		p.Do(count);
+		if (p.mode == p.MODE_READ)
+			subIntrHandlers.clear();
+
+		std::map<int, SubIntrHandler>::iterator iter = subIntrHandlers.begin();
+		for (u32 i = 0; i < count; ++i)
+		{
+			int subIntrNum = p.mode == p.MODE_READ ? 0 : iter->first;
+			p.Do(subIntrNum);
+			if (p.mode == p.MODE_READ)
+				subIntrHandlers[subIntrNum].DoState(p);
+			else
+				(iter++)->second.DoState(p);
+		}
+	}
+
 private:
 	std::map<int, SubIntrHandler> subIntrHandlers;
 };
@@ -262,6 +294,53 @@ public:
 InterruptState intState;
 IntrHandler intrHandlers[PSP_NUMBER_INTERRUPTS];
 
+void __InterruptsDoState(PointerWrap &p)
+{
+	if (!p.Section("sceKernelInterrupt", 1, 1))
+		return;
+
+	p.Do(interruptsEnabled);
+	p.Do(inInterrupt);
+	p.Do(intState.insideInterrupt);
+	p.Do(intState.savedCpu);
+	for (int i = 0; i < PSP_NUMBER_INTERRUPTS; ++i)
+		intrHandlers[i].DoState(p);
+
+	// Pending interrupts point at their handler, which is found again by number.
+	u32 count = (u32)pendingInterrupts.size();
+	p.Do(count);
+	if (p.mode == p.MODE_READ)
+	{
+		pendingInterrupts.clear();
+		for (u32 i = 0; i < count; ++i)
+		{
+			int intrNumber = 0, subIntrNumber = 0;
+			PendingInterrupt pend;
+			p.Do(intrNumber);
+			p.Do(subIntrNumber);
+			p.Do(pend.arg);
+			p.Do(pend.hasArg);
+			if (intrNumber < 0 || intrNumber >= PSP_NUMBER_INTERRUPTS)
+				continue;
+			pend.handler = intrHandlers[intrNumber].get(subIntrNumber);
+			if (pend.handler)
+				pendingInterrupts.push_back(pend);
+		}
+	}
+	else
+	{
+		for (std::list<PendingInterrupt>::iterator iter = pendingInterrupts.begin(); iter != pendingInterrupts.end(); ++iter)
+		{
+			SubIntrHandler *handler = static_cast<SubIntrHandler *>(iter->handler);
+			p.Do(handler->intrNumber);
+			p.Do(handler->number);
+			p.Do(iter->arg);
+			p.Do(iter->hasArg);
+		}
+	}
+	p.DoMarker("sceKernelInterrupt");
+}
+
 // http://forums.ps2dev.org/viewtopic.php?t=5687
 
 // http://www.google.se/url?sa=t&rct=j&q=&esrc=s&source=web&cd=7&ved=0CFYQFjAG&url=http%3A%2F%2Fdev.psnpt.com%2Fredmine%2Fprojects%2Fuofw%2Frepository%2Frevisions%2F65%2Fraw%2Ftrunk%2Finclude%2Finterruptman.h&ei=J4pCUKvyK4nl4QSu-YC4Cg&usg=AFQjCNFxJcgzQnv6dK7aiQlht_BM9grfQQ&sig2=GGk5QUEWI6qouYDoyE07YQ
@@ -336,6 +415,7 @@ u32 sceKernelRegisterSubIntrHandler(u32 intrNumber, u32 subIntrNumber, u32 handl
 
 	SubIntrHandler subIntrHandler;
 	subIntrHandler.number = subIntrNumber;
+	subIntrHandler.intrNumber = intrNumber;
 	subIntrHandler.enabled = false;
 	subIntrHandler.handlerAddress = handler;
 	subIntrHandler.handlerArg = handlerArg;
@@ -418,6 +498,7 @@ void sceKernelMemset()
 	DEBUG_LOG(HLE, "sceKernelMemset(ptr = %08x, c = %02x, n = %08x)", addr, c, n);
 	for (size_t i = 0; i < n; i++)
 		Memory::Write_U8((u8)c, addr + i);
+	gpu->InvalidateCache(addr, n);
 	RETURN(0); /* TODO: verify it should return this */
 }
 
@@ -427,6 +508,7 @@ u32 sceKernelMemcpy(u32 dst, u32 src, u32 size)
 	if (Memory::IsValidAddress(dst) && Memory::IsValidAddress(src+size)) // a bit of bound checking. Wrong??
 	{
 		Memory::Memcpy(dst, Memory::GetPointer(src), size);
+		gpu->InvalidateCache(dst, size);
 	}
 	return 0;
 }
@@ -439,8 +521,8 @@ const HLEFunction Kernel_Library[] =
 	{0x47a0b729,sceKernelIsCpuIntrSuspended, "sceKernelIsCpuIntrSuspended"}, //flags
 	{0xb55249d2,sceKernelIsCpuIntrEnable, "sceKernelIsCpuIntrEnable"}, 
 	{0xa089eca4,sceKernelMemset, "sceKernelMemset"}, 
-	{0xDC692EE3,&WrapV_UI<sceKernelTryLockLwMutex>, "sceKernelTryLockLwMutex"},
-	{0x37431849,&WrapV_UI<sceKernelTryLockLwMutex_600>, "sceKernelTryLockLwMutex_600"},
+	{0xDC692EE3,&WrapV_UI<sceKernelTryLockLwMutex>, "sceKernelTryLockLwMutex", HLE_NOT_RESCHEDULE},
+	{0x37431849,&WrapV_UI<sceKernelTryLockLwMutex_600>, "sceKernelTryLockLwMutex_600", HLE_NOT_RESCHEDULE},
 	{0xbea46419,&WrapV_UIU<sceKernelLockLwMutex>, "sceKernelLockLwMutex"}, 
 	{0x1FC64E09,&WrapV_UIU<sceKernelLockLwMutexCB>, "sceKernelLockLwMutexCB"},
 	{0x15b6446b,&WrapV_UI<sceKernelUnlockLwMutex>, "sceKernelUnlockLwMutex"}, 
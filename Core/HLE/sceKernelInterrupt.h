@@ -56,6 +56,7 @@ enum PSPGeSubInterrupts {
 
 bool __IsInInterrupt();
 void __InterruptsInit();
+void __InterruptsDoState(PointerWrap &p);
 void __InterruptsShutdown();
 void __TriggerInterrupt(PSPInterrupt intno, int subInterrupts = -1);
 void __TriggerInterruptWithArg(PSPInterrupt intno, int subintr, int arg);  // For GE "callbacks"
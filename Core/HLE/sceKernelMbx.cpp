@@ -19,6 +19,7 @@
 #include "sceKernelThread.h"
 #include "sceKernelMbx.h"
 #include "HLE.h"
+#include "ChunkFile.h"
 
 #define SCE_KERNEL_MBA_THPRI 0x100
 #define SCE_KERNEL_MBA_MSPRI 0x400
@@ -41,6 +42,7 @@ struct Mbx : public KernelObject
 	const char *GetTypeName() {return "Mbx";}
 	static u32 GetMissingErrorCode() { return SCE_KERNEL_ERROR_UNKNOWN_MBXID; }
 	int GetIDType() const { return SCE_KERNEL_TMID_Mbox; }
+	static int GetStaticIDType() { return SCE_KERNEL_TMID_Mbox; }
 
 	void AddWaitingThread(SceUID id, u32 addr)
 	{
@@ -61,12 +63,25 @@ struct Mbx : public KernelObject
 		}
 	}
 
+	virtual void DoState(PointerWrap &p)
+	{
+		p.Do(nmb);
+		p.Do(waitingThreads);
+		p.Do(messageQueue);
+		p.DoMarker("Mbx");
+	}
+
 	NativeMbx nmb;
 
 	std::vector<std::pair<SceUID, u32>> waitingThreads;
 	std::vector<u32> messageQueue;
 };
 
+KernelObject *__KernelMbxObject()
+{
+	return new Mbx;
+}
+
 SceUID sceKernelCreateMbx(const char *name, int memoryPartition, SceUInt attr, int size, u32 optAddr)
 {
 	DEBUG_LOG(HLE, "sceKernelCreateMbx(%s, %i, %08x, %i, %08x)", name, memoryPartition, attr, size, optAddr);
@@ -151,7 +166,7 @@ void sceKernelSendMbx(SceUID id, u32 packetAddr)
 		DEBUG_LOG(HLE, "sceKernelSendMbx(%i, %08x): threads waiting, resuming %d", id, packetAddr, m->waitingThreads.front().first);
 		m->waitingThreads.erase(m->waitingThreads.begin());
 		RETURN(0);
-		__KernelReSchedule();
+		__KernelReSchedule(RESCHED_MBX_SENT);
 	}
 	else
 	{
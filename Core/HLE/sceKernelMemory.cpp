@@ -19,6 +19,7 @@
 #include "../System.h"
 #include "../MIPS/MIPS.h"
 #include "../MemMap.h"
+#include "ChunkFile.h"
 
 #include "sceKernel.h"
 #include "sceKernelThread.h"
@@ -53,6 +54,7 @@ struct FPL : KernelObject
 	const char *GetTypeName() {return "FPL";}
 	static u32 GetMissingErrorCode() { return SCE_KERNEL_ERROR_UNKNOWN_FPLID; }
 	int GetIDType() const { return SCE_KERNEL_TMID_Fpl; }
+	static int GetStaticIDType() { return SCE_KERNEL_TMID_Fpl; }
 	NativeFPL nf;
 	bool *blocks;
 	u32 address;
@@ -79,8 +81,23 @@ struct FPL : KernelObject
 		}
 		return false;
 	}
+
+	virtual void DoState(PointerWrap &p)
+	{
+		p.Do(nf);
+		if (p.mode == p.MODE_READ)
+			blocks = new bool[nf.numBlocks];
+		p.DoArray(blocks, nf.numBlocks);
+		p.Do(address);
+		p.DoMarker("FPL");
+	}
 };
 
+KernelObject *__KernelMemoryFPLObject()
+{
+	return new FPL;
+}
+
 struct SceKernelVplInfo
 {
 	SceSize size;
@@ -97,13 +114,28 @@ struct VPL : KernelObject
 	const char *GetTypeName() {return "VPL";}
 	static u32 GetMissingErrorCode() { return SCE_KERNEL_ERROR_UNKNOWN_VPLID; }
 	int GetIDType() const { return SCE_KERNEL_TMID_Vpl; }
+	static int GetStaticIDType() { return SCE_KERNEL_TMID_Vpl; }
 	SceKernelVplInfo nv;
 	u32 size;
 	bool *freeBlocks;
 	u32 address;
 	BlockAllocator alloc;
+
+	virtual void DoState(PointerWrap &p)
+	{
+		p.Do(nv);
+		p.Do(size);
+		p.Do(address);
+		alloc.DoState(p);
+		p.DoMarker("VPL");
+	}
 };
 
+KernelObject *__KernelMemoryVPLObject()
+{
+	return new VPL;
+}
+
 void __KernelMemoryInit()
 {
 	kernelMemory.Init(PSP_GetKernelMemoryBase(), PSP_GetKernelMemoryEnd()-PSP_GetKernelMemoryBase());
@@ -111,6 +143,15 @@ void __KernelMemoryInit()
 	INFO_LOG(HLE, "Kernel and user memory pools initialized");
 }
 
+void __KernelMemoryDoState(PointerWrap &p)
+{
+	if (!p.Section("sceKernelMemory", 1, 1))
+		return;
+
+	kernelMemory.DoState(p);
+	userMemory.DoState(p);
+}
+
 void __KernelMemoryShutdown()
 {
 	INFO_LOG(HLE,"Shutting down user memory pool: ");
@@ -345,7 +386,10 @@ public:
 	}
 	static u32 GetMissingErrorCode() { return SCE_KERNEL_ERROR_UNKNOWN_MPPID; }	/// ????
 	int GetIDType() const { return 0; }
+	static int GetStaticIDType() { return PPSSPP_KERNEL_TMID_PMB; }
 
+	// Only for loading states.
+	PartitionMemoryBlock() : alloc(NULL), address((u32)-1) {}
 	PartitionMemoryBlock(BlockAllocator *_alloc, u32 size, bool fromEnd)
 	{
 		alloc = _alloc;
@@ -354,14 +398,31 @@ public:
 	}
 	~PartitionMemoryBlock()
 	{
-		alloc->Free(address);
+		if (alloc)
+			alloc->Free(address);
 	}
 	bool IsValid() {return address != (u32)-1;}
+
+	virtual void DoState(PointerWrap &p)
+	{
+		// These are only ever made from user memory.
+		if (p.mode == p.MODE_READ)
+			alloc = &userMemory;
+		p.Do(address);
+		p.DoArray(name, sizeof(name));
+		p.DoMarker("PMB");
+	}
+
 	BlockAllocator *alloc;
 	u32 address;
 	char name[32];
 };
 
+KernelObject *__KernelMemoryPMBObject()
+{
+	return new PartitionMemoryBlock;
+}
+
 
 void sceKernelMaxFreeMemSize() 
 {
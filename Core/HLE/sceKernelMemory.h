@@ -29,6 +29,7 @@ extern BlockAllocator userMemory;
 extern BlockAllocator kernelMemory;
 
 void __KernelMemoryInit();
+void __KernelMemoryDoState(PointerWrap &p);
 void __KernelMemoryShutdown();
 
 void sceKernelCreateVpl();
@@ -51,3 +52,7 @@ void sceKernelReferFplStatus();
 
 
 void Register_SysMemUserForUser();
+
+KernelObject *__KernelMemoryFPLObject();
+KernelObject *__KernelMemoryVPLObject();
+KernelObject *__KernelMemoryPMBObject();
@@ -21,6 +21,7 @@
 #include "HLE.h"
 #include "Common/Action.h"
 #include "Common/FileUtil.h"
+#include "ChunkFile.h"
 #include "../Host.h"
 #include "../MIPS/MIPS.h"
 #include "../MIPS/MIPSAnalyst.h"
@@ -118,12 +119,25 @@ public:
 	}
 	static u32 GetMissingErrorCode() { return SCE_KERNEL_ERROR_UNKNOWN_MODULE; }
 	int GetIDType() const { return 0; }
+	static int GetStaticIDType() { return PPSSPP_KERNEL_TMID_Module; }
+
+	virtual void DoState(PointerWrap &p)
+	{
+		p.Do(nm);
+		p.Do(memoryBlockAddr);
+		p.DoMarker("Module");
+	}
 
 	NativeModule nm;
 
 	u32 memoryBlockAddr;
 };
 
+KernelObject *__KernelModuleObject()
+{
+	return new Module;
+}
+
 //////////////////////////////////////////////////////////////////////////
 // MODULES
 //////////////////////////////////////////////////////////////////////////
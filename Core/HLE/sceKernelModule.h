@@ -24,3 +24,5 @@ u32 __KernelGetModuleGP(SceUID module);
 bool __KernelLoadExec(const char *filename, SceKernelLoadExecParam *param, std::string *error_string);
 
 void Register_ModuleMgrForUser();
+
+KernelObject *__KernelModuleObject();
@@ -19,6 +19,7 @@
 #include "sceKernel.h"
 #include "sceKernelMsgPipe.h"
 #include "sceKernelThread.h"
+#include "ChunkFile.h"
 
 #define SCE_KERNEL_MPA_THFIFO_S 0x0000
 #define SCE_KERNEL_MPA_THPRI_S  0x0100
@@ -55,6 +56,7 @@ struct MsgPipe : public KernelObject
 	const char *GetTypeName() {return "MsgPipe";}
 	static u32 GetMissingErrorCode() { return SCE_KERNEL_ERROR_UNKNOWN_MPPID; }
 	int GetIDType() const { return SCE_KERNEL_TMID_Mpipe; }
+	static int GetStaticIDType() { return SCE_KERNEL_TMID_Mpipe; }
 
 	NativeMsgPipe nmp;
 
@@ -150,9 +152,26 @@ struct MsgPipe : public KernelObject
 		}
 	}
 
+	virtual void DoState(PointerWrap &p)
+	{
+		p.Do(nmp);
+		p.Do(sendWaitingThreads);
+		p.Do(receiveWaitingThreads);
+		if (p.mode == p.MODE_READ)
+			buffer = nmp.bufSize != 0 ? new u8[nmp.bufSize] : 0;
+		if (buffer)
+			p.DoArray(buffer, nmp.bufSize);
+		p.DoMarker("MsgPipe");
+	}
+
 	u8 *buffer;
 };
 
+KernelObject *__KernelMsgPipeObject()
+{
+	return new MsgPipe;
+}
+
 void sceKernelCreateMsgPipe()
 {
 	const char *name = Memory::GetCharPointer(PARAM(0));
@@ -26,4 +26,6 @@ void sceKernelReceiveMsgPipe();
 void sceKernelReceiveMsgPipeCB();
 void sceKernelTryReceiveMsgPipe();
 void sceKernelCancelMsgPipe();
-void sceKernelReferMsgPipeStatus();
\ No newline at end of file
+void sceKernelReferMsgPipeStatus();
+
+KernelObject *__KernelMsgPipeObject();
@@ -20,6 +20,7 @@
 #include "HLE.h"
 #include "../MIPS/MIPS.h"
 #include "../../Core/CoreTiming.h"
+#include "ChunkFile.h"
 #include "sceKernel.h"
 #include "sceKernelMutex.h"
 #include "sceKernelThread.h"
@@ -61,10 +62,24 @@ struct Mutex : public KernelObject
 	const char *GetTypeName() {return "Mutex";}
 	static u32 GetMissingErrorCode() { return PSP_MUTEX_ERROR_NO_SUCH_MUTEX; }
 	int GetIDType() const { return SCE_KERNEL_TMID_Mutex; }
+	static int GetStaticIDType() { return SCE_KERNEL_TMID_Mutex; }
+
+	virtual void DoState(PointerWrap &p)
+	{
+		p.Do(nm);
+		p.Do(waitingThreads);
+		p.DoMarker("Mutex");
+	}
+
 	NativeMutex nm;
 	std::vector<SceUID> waitingThreads;
 };
 
+KernelObject *__KernelMutexObject()
+{
+	return new Mutex;
+}
+
 // Guesswork - not exposed anyway
 struct NativeLwMutex
 {
@@ -102,11 +117,24 @@ struct LwMutex : public KernelObject
 	const char *GetTypeName() {return "LwMutex";}
 	static u32 GetMissingErrorCode() { return PSP_LWMUTEX_ERROR_NO_SUCH_LWMUTEX; }
 	int GetIDType() const { return SCE_KERNEL_TMID_LwMutex; }
+	static int GetStaticIDType() { return SCE_KERNEL_TMID_LwMutex; }
+
+	virtual void DoState(PointerWrap &p)
+	{
+		p.Do(nm);
+		p.Do(waitingThreads);
+		p.DoMarker("LwMutex");
+	}
+
 	NativeLwMutex nm;
 	std::vector<SceUID> waitingThreads;
 };
 
-bool mutexInitComplete = false;
+KernelObject *__KernelLwMutexObject()
+{
+	return new LwMutex;
+}
+
 int mutexWaitTimer = 0;
 int lwMutexWaitTimer = 0;
 // Thread -> Mutex locks for thread end.
@@ -120,8 +148,37 @@ void __KernelMutexInit()
 
 	// TODO: Install on first mutex (if it's slow?)
 	__KernelListenThreadEnd(&__KernelMutexThreadEnd);
+}
 
-	mutexInitComplete = true;
+void __KernelMutexDoState(PointerWrap &p)
+{
+	if (!p.Section("sceKernelMutex", 1, 1))
+		return;
+
+	// Thread -> mutex pairs, in map order.
+	u32 count = (u32)mutexHeldLocks.size();
+	p.Do(count);
+	if (p.mode == p.MODE_READ)
+	{
+		mutexHeldLocks.clear();
+		for (u32 i = 0; i < count; i++)
+		{
+			SceUID threadID = 0, mutexID = 0;
+			p.Do(threadID);
+			p.Do(mutexID);
+			mutexHeldLocks.insert(std::make_pair(threadID, mutexID));
+		}
+	}
+	else
+	{
+		for (MutexMap::iterator iter = mutexHeldLocks.begin(); iter != mutexHeldLocks.end(); ++iter)
+		{
+			SceUID threadID = iter->first, mutexID = iter->second;
+			p.Do(threadID);
+			p.Do(mutexID);
+		}
+	}
+	p.DoMarker("sceKernelMutex");
 }
 
 void __KernelMutexAcquireLock(Mutex *mutex, int count, SceUID thread)
@@ -163,9 +220,6 @@ void __KernelMutexEraseLock(Mutex *mutex)
 
 void sceKernelCreateMutex(const char *name, u32 attr, int initialCount, u32 optionsPtr)
 {
-	if (!mutexInitComplete)
-		__KernelMutexInit();
-
 	u32 error = 0;
 	if (!name)
 		error = SCE_KERNEL_ERROR_ERROR;
@@ -238,7 +292,7 @@ void sceKernelDeleteMutex(SceUID id)
 		RETURN(kernelObjects.Destroy<Mutex>(id));
 
 		if (wokeThreads)
-			__KernelReSchedule("mutex deleted");
+			__KernelReSchedule(RESCHED_MUTEX_DELETED);
 	}
 	else
 		RETURN(error);
@@ -405,7 +459,7 @@ void sceKernelLockMutex(SceUID id, int count, u32 timeoutPtr)
 		mutex->waitingThreads.push_back(__KernelGetCurThread());
 		__KernelWaitMutex(mutex, timeoutPtr);
 		__KernelWaitCurThread(WAITTYPE_MUTEX, id, count, timeoutPtr, false);
-		__KernelReSchedule("mutex locked");
+		__KernelReSchedule(RESCHED_MUTEX_LOCKED);
 	}
 }
 
@@ -429,7 +483,7 @@ void sceKernelLockMutexCB(SceUID id, int count, u32 timeoutPtr)
 		__KernelWaitMutex(mutex, timeoutPtr);
 		__KernelWaitCurThread(WAITTYPE_MUTEX, id, count, timeoutPtr, true);
 		__KernelCheckCallbacks();
-		__KernelReSchedule("mutex locked");
+		__KernelReSchedule(RESCHED_MUTEX_LOCKED);
 	}
 }
 
@@ -481,15 +535,12 @@ void sceKernelUnlockMutex(SceUID id, int count)
 	if (mutex->nm.lockLevel == 0)
 	{
 		if (__KernelUnlockMutex(mutex, error))
-			__KernelReSchedule("mutex locked");
+			__KernelReSchedule(RESCHED_MUTEX_UNLOCKED);
 	}
 }
 
 void sceKernelCreateLwMutex(u32 workareaPtr, const char *name, u32 attr, int initialCount, u32 optionsPtr)
 {
-	if (!mutexInitComplete)
-		__KernelMutexInit();
-
 	DEBUG_LOG(HLE,"sceKernelCreateLwMutex(%08x, %s, %08x, %d, %08x)", workareaPtr, name, attr, initialCount, optionsPtr);
 
 	u32 error = 0;
@@ -577,7 +628,7 @@ void sceKernelDeleteLwMutex(u32 workareaPtr)
 		Memory::WriteStruct(workareaPtr, &workarea);
 
 		if (wokeThreads)
-			__KernelReSchedule("lwmutex deleted");
+			__KernelReSchedule(RESCHED_LWMUTEX_DELETED);
 	}
 	else
 		RETURN(error);
@@ -773,7 +824,7 @@ void sceKernelLockLwMutex(u32 workareaPtr, int count, u32 timeoutPtr)
 			mutex->waitingThreads.push_back(__KernelGetCurThread());
 			__KernelWaitLwMutex(mutex, timeoutPtr);
 			__KernelWaitCurThread(WAITTYPE_LWMUTEX, workarea.uid, count, timeoutPtr, false);
-			__KernelReSchedule("lwmutex locked");
+			__KernelReSchedule(RESCHED_LWMUTEX_LOCKED);
 		}
 		else
 			RETURN(error);
@@ -804,7 +855,7 @@ void sceKernelLockLwMutexCB(u32 workareaPtr, int count, u32 timeoutPtr)
 			__KernelWaitLwMutex(mutex, timeoutPtr);
 			__KernelWaitCurThread(WAITTYPE_LWMUTEX, workarea.uid, count, timeoutPtr, true);
 			__KernelCheckCallbacks();
-			__KernelReSchedule("lwmutex locked");
+			__KernelReSchedule(RESCHED_LWMUTEX_LOCKED);
 		}
 		else
 			RETURN(error);
@@ -842,7 +893,7 @@ void sceKernelUnlockLwMutex(u32 workareaPtr, int count)
 	if (workarea.lockLevel == 0)
 	{
 		if (__KernelUnlockLwMutex(workarea, error))
-			__KernelReSchedule("lwmutex unlocked");
+			__KernelReSchedule(RESCHED_LWMUTEX_UNLOCKED);
 		Memory::WriteStruct(workareaPtr, &workarea);
 	}
 	else
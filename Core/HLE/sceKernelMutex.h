@@ -32,6 +32,11 @@ void sceKernelLockLwMutex(u32 workareaPtr, int count, u32 timeoutPtr);
 void sceKernelLockLwMutexCB(u32 workareaPtr, int count, u32 timeoutPtr);
 void sceKernelUnlockLwMutex(u32 workareaPtr, int count);
 
+void __KernelMutexInit();
+void __KernelMutexDoState(PointerWrap &p);
 void __KernelMutexTimeout(u64 userdata, int cyclesLate);
 void __KernelLwMutexTimeout(u64 userdata, int cyclesLate);
-void __KernelMutexThreadEnd(SceUID thread);
\ No newline at end of file
+void __KernelMutexThreadEnd(SceUID thread);
+
+KernelObject *__KernelMutexObject();
+KernelObject *__KernelLwMutexObject();
@@ -19,6 +19,7 @@
 #include "HLE.h"
 #include "../MIPS/MIPS.h"
 #include "../../Core/CoreTiming.h"
+#include "ChunkFile.h"
 #include "sceKernel.h"
 #include "sceKernelThread.h"
 #include "sceKernelSemaphore.h"
@@ -56,18 +57,31 @@ struct Semaphore : public KernelObject
 
 	static u32 GetMissingErrorCode() { return SCE_KERNEL_ERROR_UNKNOWN_SEMID; }
 	int GetIDType() const { return SCE_KERNEL_TMID_Semaphore; }
+	static int GetStaticIDType() { return SCE_KERNEL_TMID_Semaphore; }
+
+	virtual void DoState(PointerWrap &p)
+	{
+		p.Do(ns);
+		p.Do(waitingThreads);
+		p.DoMarker("Semaphore");
+	}
 
 	NativeSemaphore ns;
 	std::vector<SceUID> waitingThreads;
 };
 
-bool semaInitComplete = false;
+KernelObject *__KernelSemaphoreObject()
+{
+	return new Semaphore;
+}
+
 int semaWaitTimer = 0;
 
+// Registered at boot rather than on the first sema, so event ids are the same in every
+// run and save states can refer to them.
 void __KernelSemaInit()
 {
 	semaWaitTimer = CoreTiming::RegisterEvent("SemaphoreTimeout", &__KernelSemaTimeout);
-	semaInitComplete = true;
 }
 
 // Resume all waiting threads (for delete / cancel.)
@@ -134,7 +148,7 @@ void sceKernelCancelSema(SceUID id, int newCount, u32 numWaitThreadsPtr)
 		RETURN(0);
 
 		if (__KernelClearSemaThreads(s, SCE_KERNEL_ERROR_WAIT_CANCEL))
-			__KernelReSchedule("semaphore canceled");
+			__KernelReSchedule(RESCHED_SEMA_CANCELED);
 	}
 	else
 	{
@@ -147,9 +161,6 @@ void sceKernelCancelSema(SceUID id, int newCount, u32 numWaitThreadsPtr)
 // void because it changes threads.
 void sceKernelCreateSema(const char* name, u32 attr, int initVal, int maxVal, u32 optionPtr)
 {
-	if (!semaInitComplete)
-		__KernelSemaInit();
-
 	if (!name)
 	{
 		RETURN(SCE_KERNEL_ERROR_ERROR);
@@ -190,7 +201,7 @@ void sceKernelDeleteSema(SceUID id)
 		RETURN(kernelObjects.Destroy<Semaphore>(id));
 
 		if (wokeThreads)
-			__KernelReSchedule("semaphore deleted");
+			__KernelReSchedule(RESCHED_SEMA_DELETED);
 	}
 	else
 	{
@@ -277,7 +288,7 @@ retry:
 		}
 
 		if (wokeThreads)
-			__KernelReSchedule("semaphore signaled");
+			__KernelReSchedule(RESCHED_SEMA_SIGNALED);
 	}
 	else
 	{
@@ -349,7 +360,7 @@ void __KernelWaitSema(SceUID id, int wantedCount, u32 timeoutPtr, const char *ba
 			if (processCallbacks)
 				__KernelCheckCallbacks();
 
-			__KernelReSchedule("semaphore waited");
+			__KernelReSchedule(RESCHED_SEMA_WAITED);
 		}
 	}
 	else
@@ -26,4 +26,7 @@ void sceKernelSignalSema(SceUID id, int signal);
 void sceKernelWaitSema(SceUID semaid, int signal, u32 timeoutPtr);
 void sceKernelWaitSemaCB(SceUID semaid, int signal, u32 timeoutPtr);
 
+void __KernelSemaInit();
 void __KernelSemaTimeout(u64 userdata, int cycleslate);
+
+KernelObject *__KernelSemaphoreObject();
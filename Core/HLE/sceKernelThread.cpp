@@ -15,10 +15,15 @@
 // Official git repository and contact information can be found at
 // https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
 
+#include <algorithm>
 #include <set>
 #include <map>
 #include <queue>
 
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
 #include "HLE.h"
 #include "HLETables.h"
 #include "../MIPS/MIPSInt.h"
@@ -27,6 +32,7 @@
 #include "../../Core/CoreTiming.h"
 #include "../../Core/MemMap.h"
 #include "../../Common/Action.h"
+#include "ChunkFile.h"
 
 #include "sceAudio.h"
 #include "sceKernel.h"
@@ -114,6 +120,19 @@ public:
 
 	static u32 GetMissingErrorCode() { return SCE_KERNEL_ERROR_UNKNOWN_CBID; }
 	int GetIDType() const { return SCE_KERNEL_TMID_Callback; }
+	static int GetStaticIDType() { return SCE_KERNEL_TMID_Callback; }
+
+	virtual void DoState(PointerWrap &p)
+	{
+		p.Do(nc);
+		p.Do(savedPC);
+		p.Do(savedRA);
+		p.Do(savedV0);
+		p.Do(savedV1);
+		p.Do(savedIdRegister);
+		p.Do(forceDelete);
+		p.DoMarker("Callback");
+	}
 
 	NativeCallback nc;
 
@@ -133,6 +152,11 @@ public:
 	bool forceDelete;
 };
 
+KernelObject *__KernelCallbackObject()
+{
+	return new Callback;
+}
+
 // Real PSP struct, don't change the fields
 struct NativeThread
 {
@@ -187,6 +211,7 @@ public:
 	static u32 GetMissingErrorCode() { return SCE_KERNEL_ERROR_UNKNOWN_THID; }
   
 	int GetIDType() const { return SCE_KERNEL_TMID_Thread; }
+	static int GetStaticIDType() { return SCE_KERNEL_TMID_Thread; }
 
 	bool AllocateStack(u32 &stackSize)
 	{
@@ -240,6 +265,32 @@ public:
 	bool isReady() const { return (nt.status & THREADSTATUS_DORMANT) != 0; }
 	bool isWaiting() const { return (nt.status & THREADSTATUS_WAIT) != 0; }
 	bool isSuspended() const { return (nt.status & THREADSTATUS_SUSPEND) != 0; }
+
+	// The ready queue and wait lists are saved separately, see __KernelThreadingDoState.
+	virtual void DoState(PointerWrap &p)
+	{
+		p.Do(nt);
+		p.Do(waitInfo);
+		p.Do(sleeping);
+		p.Do(moduleId);
+		p.Do(isProcessingCallbacks);
+		p.Do(context);
+		for (int i = 0; i < THREAD_CALLBACK_NUM_TYPES; i++)
+		{
+			p.Do(registeredCallbacks[i]);
+			p.Do(readyCallbacks[i]);
+		}
+		p.Do(pendingMipsCalls);
+		p.Do(stackBlock);
+
+		if (p.mode == p.MODE_READ)
+		{
+			readyPrev = readyNext = 0;
+			readyBucket = 0;
+			inWaitList = false;
+		}
+		p.DoMarker("Thread");
+	}
 	
 	NativeThread nt;
 
@@ -257,6 +308,214 @@ public:
 	std::list<int> pendingMipsCalls;
 
 	u32 stackBlock;
+
+	// Scheduler bookkeeping, see ThreadReadyQueue and ThreadWaitLists.
+	Thread *readyPrev;
+	Thread *readyNext;
+	int readyBucket;
+	bool inWaitList;
+	WaitType waitListType;
+	SceUID waitListID;
+};
+
+KernelObject *__KernelThreadObject()
+{
+	return new Thread;
+}
+
+// Threads with THREADSTATUS_READY, in one FIFO per priority, plus a bitmap of the
+// non-empty priorities so the best one is found with a couple of bit scans.
+// Like on the PSP, a thread that becomes ready goes to the back of its priority.
+class ThreadReadyQueue
+{
+public:
+	enum
+	{
+		NUM_PRIORITIES = 128,
+		NUM_MASK_WORDS = NUM_PRIORITIES / 32,
+	};
+
+	ThreadReadyQueue() { clear(); }
+
+	void clear()
+	{
+		memset(first_, 0, sizeof(first_));
+		memset(last_, 0, sizeof(last_));
+		memset(mask_, 0, sizeof(mask_));
+	}
+
+	void push_back(Thread *t)
+	{
+		int b = bucketFor(t->nt.currentPriority);
+		t->readyBucket = b;
+		t->readyNext = 0;
+		t->readyPrev = last_[b];
+		if (last_[b])
+			last_[b]->readyNext = t;
+		else
+			first_[b] = t;
+		last_[b] = t;
+		mask_[b >> 5] |= 1 << (b & 31);
+	}
+
+	void remove(Thread *t)
+	{
+		int b = t->readyBucket;
+		if (t->readyPrev)
+			t->readyPrev->readyNext = t->readyNext;
+		else
+			first_[b] = t->readyNext;
+		if (t->readyNext)
+			t->readyNext->readyPrev = t->readyPrev;
+		else
+			last_[b] = t->readyPrev;
+		t->readyPrev = t->readyNext = 0;
+		if (!first_[b])
+			mask_[b >> 5] &= ~(1 << (b & 31));
+	}
+
+	// Front of the best (lowest numbered) non-empty priority, or 0.
+	Thread *front() const
+	{
+		for (int i = 0; i < NUM_MASK_WORDS; i++)
+		{
+			if (mask_[i])
+				return first_[i * 32 + lowestSetBit(mask_[i])];
+		}
+		return 0;
+	}
+
+	Thread *front(int priority) const { return first_[bucketFor(priority)]; }
+
+	// Saved as thread ids, so the order within each priority survives.
+	void DoState(PointerWrap &p)
+	{
+		for (int b = 0; b < NUM_PRIORITIES; b++)
+		{
+			std::vector<SceUID> ids;
+			for (Thread *t = first_[b]; t; t = t->readyNext)
+				ids.push_back(t->GetUID());
+			p.Do(ids);
+
+			if (p.mode != p.MODE_READ)
+				continue;
+			first_[b] = last_[b] = 0;
+			mask_[b >> 5] &= ~(1 << (b & 31));
+			for (size_t i = 0; i < ids.size(); i++)
+			{
+				u32 error;
+				Thread *t = kernelObjects.Get<Thread>(ids[i], error);
+				if (t)
+					push_back(t);
+			}
+		}
+	}
+
+	// Out of range priorities are refused by the real kernel, just keep them last here.
+	static int bucketFor(int priority)
+	{
+		return priority >= 0 && priority < NUM_PRIORITIES ? priority : NUM_PRIORITIES - 1;
+	}
+
+private:
+	static int lowestSetBit(u32 v)
+	{
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanForward(&index, v);
+		return (int)index;
+#else
+		return __builtin_ctz(v);
+#endif
+	}
+
+	Thread *first_[NUM_PRIORITIES];
+	Thread *last_[NUM_PRIORITIES];
+	u32 mask_[NUM_MASK_WORDS];
+};
+
+// Threads with THREADSTATUS_WAIT, by what they wait on, in the order they started waiting.
+class ThreadWaitLists
+{
+public:
+	void clear() { lists_.clear(); }
+
+	void add(Thread *t)
+	{
+		t->inWaitList = true;
+		t->waitListType = t->nt.waitType;
+		t->waitListID = t->nt.waitID;
+		lists_[makeKey(t->waitListType, t->waitListID)].push_back(t);
+	}
+
+	void remove(Thread *t)
+	{
+		t->inWaitList = false;
+		std::map<u64, std::vector<Thread *> >::iterator iter = lists_.find(makeKey(t->waitListType, t->waitListID));
+		if (iter == lists_.end())
+			return;
+		std::vector<Thread *> &waiting = iter->second;
+		waiting.erase(std::remove(waiting.begin(), waiting.end(), t), waiting.end());
+		if (waiting.empty())
+			lists_.erase(iter);
+	}
+
+	// Copies, since waking them up changes the lists.
+	void get(WaitType type, SceUID id, std::vector<Thread *> &waiting) const
+	{
+		std::map<u64, std::vector<Thread *> >::const_iterator iter = lists_.find(makeKey(type, id));
+		if (iter != lists_.end())
+			waiting = iter->second;
+		else
+			waiting.clear();
+	}
+
+	void DoState(PointerWrap &p)
+	{
+		u32 count = (u32)lists_.size();
+		p.Do(count);
+
+		if (p.mode == p.MODE_READ)
+		{
+			lists_.clear();
+			for (u32 i = 0; i < count; i++)
+			{
+				u64 key = 0;
+				std::vector<SceUID> ids;
+				p.Do(key);
+				p.Do(ids);
+				for (size_t j = 0; j < ids.size(); j++)
+				{
+					u32 error;
+					Thread *t = kernelObjects.Get<Thread>(ids[j], error);
+					if (!t)
+						continue;
+					t->inWaitList = true;
+					t->waitListType = (WaitType)(key >> 32);
+					t->waitListID = (SceUID)(u32)key;
+					lists_[key].push_back(t);
+				}
+			}
+		}
+		else
+		{
+			std::map<u64, std::vector<Thread *> >::iterator iter;
+			for (iter = lists_.begin(); iter != lists_.end(); ++iter)
+			{
+				u64 key = iter->first;
+				std::vector<SceUID> ids;
+				for (size_t j = 0; j < iter->second.size(); j++)
+					ids.push_back(iter->second[j]->GetUID());
+				p.Do(key);
+				p.Do(ids);
+			}
+		}
+	}
+
+private:
+	static u64 makeKey(WaitType type, SceUID id) { return ((u64)type << 32) | (u32)id; }
+
+	std::map<u64, std::vector<Thread *> > lists_;
 };
 
 void __KernelExecuteMipsCallOnCurrentThread(int callId);
@@ -275,6 +534,10 @@ u32 threadReturnHackAddr;
 u32 cbReturnHackAddr;
 u32 intReturnHackAddr;
 std::vector<Thread *> threadqueue; //Change to SceUID
+ThreadReadyQueue threadReadyQueue;
+ThreadWaitLists threadWaitLists;
+// Total reschedules, the trace keeps the last RESCHEDULE_TRACE_SIZE.
+static u32 rescheduleTraceCount = 0;
 std::vector<ThreadCallback> threadEndListeners;
 
 SceUID threadIdleID[2];
@@ -361,6 +624,24 @@ void __KernelFireThreadEnd(Thread *thread)
 	}
 }
 
+// All status changes go through here, to keep the ready queue and wait lists in sync.
+// Waiting threads are filed under their current waitType and waitID, so set those first.
+static void __KernelSetThreadStatus(Thread *thread, u32 newStatus)
+{
+	u32 oldStatus = thread->nt.status;
+	if ((oldStatus & THREADSTATUS_READY) && !(newStatus & THREADSTATUS_READY))
+		threadReadyQueue.remove(thread);
+	if (thread->inWaitList && (!(newStatus & THREADSTATUS_WAIT) || thread->waitListType != thread->nt.waitType || thread->waitListID != thread->nt.waitID))
+		threadWaitLists.remove(thread);
+
+	thread->nt.status = newStatus;
+
+	if (!(oldStatus & THREADSTATUS_READY) && (newStatus & THREADSTATUS_READY))
+		threadReadyQueue.push_back(thread);
+	if (!thread->inWaitList && (newStatus & THREADSTATUS_WAIT))
+		threadWaitLists.add(thread);
+}
+
 void __KernelStartIdleThreads()
 {
   for (int i = 0; i < 2; i++)
@@ -370,7 +651,7 @@ void __KernelStartIdleThreads()
     t->nt.gpreg = __KernelGetModuleGP(curModule);
     t->context.r[MIPS_REG_GP] = t->nt.gpreg;
     //t->context.pc += 4;  // ADJUSTPC
-    t->nt.status = THREADSTATUS_READY;
+    __KernelSetThreadStatus(t, THREADSTATUS_READY);
   }
 }
 
@@ -384,7 +665,7 @@ void __KernelIdle()
   // In Advance, we might trigger an interrupt such as vblank.
   // If we end up in an interrupt, we don't want to reschedule.
   // However, we have to reschedule... damn.
-  __KernelReSchedule("idle");
+  __KernelReSchedule(RESCHED_IDLE);
 }
 
 void __KernelThreadingShutdown()
@@ -394,7 +675,11 @@ void __KernelThreadingShutdown()
   cbReturnHackAddr = 0;
 	currentThread = 0;
 	intReturnHackAddr = 0;
+	rescheduleTraceCount = 0;
 	threadqueue.clear();
+	threadReadyQueue.clear();
+	threadWaitLists.clear();
+	threadEndListeners.clear();
 }
 
 u32 __KernelGetWaitValue(SceUID threadID, u32 &error)
@@ -563,10 +848,11 @@ void __KernelLoadContext(ThreadContext *ctx)
 
 void __KernelResumeThreadFromWait(Thread *t)
 {
-	t->nt.status &= ~THREADSTATUS_WAIT;
+	u32 newStatus = t->nt.status & ~THREADSTATUS_WAIT;
 	// TODO: What if DORMANT or DEAD?
-	if (!(t->nt.status & THREADSTATUS_WAITSUSPEND))
-		t->nt.status = THREADSTATUS_READY;
+	if (!(newStatus & THREADSTATUS_WAITSUSPEND))
+		newStatus = THREADSTATUS_READY;
+	__KernelSetThreadStatus(t, newStatus);
 
 	// Non-waiting threads do not process callbacks.
 	t->isProcessingCallbacks = false;
@@ -613,31 +899,25 @@ bool __KernelTriggerWait(WaitType type, int id, bool useRetVal, int retVal, bool
 {
 	bool doneAnything = false;
 
-	for (std::vector<Thread *>::iterator iter = threadqueue.begin(); iter != threadqueue.end(); iter++)
+	static std::vector<Thread *> waiting;
+	threadWaitLists.get(type, id, waiting);
+	for (std::vector<Thread *>::iterator iter = waiting.begin(); iter != waiting.end(); iter++)
 	{
 		Thread *t = *iter;
-		if (t->nt.status & THREADSTATUS_WAIT)
+		if ((t->nt.status & THREADSTATUS_WAIT) && t->nt.waitType == type && t->nt.waitID == id)
 		{
-			if (t->nt.waitType == type && t->nt.waitID == id)
-			{
-				// This thread was waiting for the triggered object.
-				__KernelResumeThreadFromWait(t);
-				if (useRetVal)
-					t->setReturnValue(retVal);
-				doneAnything = true;
-			}
+			// This thread was waiting for the triggered object.
+			__KernelResumeThreadFromWait(t);
+			if (useRetVal)
+				t->setReturnValue(retVal);
+			doneAnything = true;
 		}
 	}
 
 //	if (doneAnything)     // lumines?
 	{
 		if (!dontSwitch)
-		{
-			// TODO: time waster
-			char temp[256];
-			sprintf(temp, "resumed from wait %s", waitTypeStrings[(int)type]);
-			__KernelReSchedule(temp);
-		}
+			__KernelReSchedule(RESCHED_WAIT_END, type);
 	}
 	return true;
 }
@@ -664,11 +944,7 @@ void __KernelWaitCurThread(WaitType type, SceUID waitID, u32 waitValue, u32 time
 
 	RETURN(0); //pretend all went OK
 
-	// TODO: time waster
-	char temp[256];
-	sprintf(temp, "started wait %s", waitTypeStrings[(int)type]);
-  
-	__KernelReSchedule(processCallbacks, temp);
+	__KernelReSchedule(processCallbacks, RESCHED_WAIT_BEGIN, type);
 	// TODO: Remove thread from Ready queue?
 }
 
@@ -685,6 +961,8 @@ void __KernelScheduleWakeup(SceUID threadID, int usFromNow)
 
 void __KernelRemoveFromThreadQueue(Thread *t)
 {
+  // Leaves the ready queue and any wait list.
+  __KernelSetThreadStatus(t, THREADSTATUS_DORMANT);
   for (size_t i = 0; i < threadqueue.size(); i++)
   {
     if (threadqueue[i] == t)
@@ -697,49 +975,106 @@ void __KernelRemoveFromThreadQueue(Thread *t)
 }
 
 Thread *__KernelNextThread() {
-	// round-robin scheduler
-	// seems to work ?
-  // not accurate!
-	int bestthread = -1;
-	int prio = 0xffffff;
+	// The running thread stays at the front of its priority, so like on the PSP it keeps
+	// running until it waits, yields with sceKernelRotateThreadReadyQueue, or something of
+	// strictly better priority gets ready.
+	return threadReadyQueue.front();
+}
+
+static const char *rescheduleReasonNames[RESCHED_NUM_REASONS] =
+{
+	"unspecified",
+	"idle",
+	"started wait",
+	"resumed from wait",
+	"thread started",
+	"return from thread",
+	"exited thread",
+	"exit-deleted thread",
+	"terminate-deleted thread",
+	"rotated ready queue",
+	"return from callback",
+	"checked callbacks",
+	"mutex deleted",
+	"mutex locked",
+	"mutex unlocked",
+	"lwmutex deleted",
+	"lwmutex locked",
+	"lwmutex unlocked",
+	"mbx sent",
+	"semaphore canceled",
+	"semaphore deleted",
+	"semaphore signaled",
+	"semaphore waited",
+	"umd activated",
+	"umd deactivated",
+	"utility loaded module",
+};
 
-	int next = 0;
-	for (size_t i = 0; i < threadqueue.size(); i++)
-	{
-		if (currentThread == threadqueue[i])
-		{
-			next = (int)i;
-			break;
-		}
-	}
+const char *__KernelRescheduleReasonName(RescheduleReason reason)
+{
+	if (reason >= 0 && reason < RESCHED_NUM_REASONS)
+		return rescheduleReasonNames[reason];
+	return "invalid";
+}
 
-	for (size_t i = 0; i < threadqueue.size(); i++)
-	{
-		next = (next + 1) % threadqueue.size();
+enum RescheduleResult
+{
+	RESCHED_RESULT_SKIPPED,  // in an interrupt or callback
+	RESCHED_RESULT_STAYED,
+	RESCHED_RESULT_SWITCHED,
+};
 
-		Thread *t = threadqueue[next];
-		if (t->nt.currentPriority < prio)
-		{
-			if (t->nt.status & THREADSTATUS_READY)
-			{
-				bestthread = next;
-				prio = t->nt.currentPriority;
-			}
-		}
-	}
+struct RescheduleTraceEntry
+{
+	u64 ticks;
+	SceUID fromThread;
+	SceUID toThread;
+	u8 reason;
+	u8 waitType;
+	u8 result;
+};
 
-	if (bestthread != -1)
-		return threadqueue[bestthread];
-	else
-		return 0;
+static const u32 RESCHEDULE_TRACE_SIZE = 4096;
+static RescheduleTraceEntry rescheduleTrace[RESCHEDULE_TRACE_SIZE];
+
+static void __KernelTraceReSchedule(RescheduleReason reason, WaitType waitType, Thread *from, Thread *to, RescheduleResult result)
+{
+	RescheduleTraceEntry &entry = rescheduleTrace[rescheduleTraceCount++ % RESCHEDULE_TRACE_SIZE];
+	entry.ticks = CoreTiming::GetTicks();
+	entry.fromThread = from ? from->GetUID() : 0;
+	entry.toThread = to ? to->GetUID() : 0;
+	entry.reason = (u8)reason;
+	entry.waitType = (u8)waitType;
+	entry.result = (u8)result;
 }
 
-void __KernelReSchedule(const char *reason)
+std::string __KernelGetRescheduleTrace()
+{
+	static const char *resultNames[] = {"skipped", "stayed", "switched"};
+
+	u32 count = std::min(rescheduleTraceCount, RESCHEDULE_TRACE_SIZE);
+	std::string text;
+	text.reserve(count * 80);
+	char line[256];
+	for (u32 i = rescheduleTraceCount - count; i != rescheduleTraceCount; i++)
+	{
+		const RescheduleTraceEntry &entry = rescheduleTrace[i % RESCHEDULE_TRACE_SIZE];
+		const char *waitName = entry.waitType < sizeof(waitTypeStrings) / sizeof(waitTypeStrings[0]) ? waitTypeStrings[entry.waitType] : "?";
+		snprintf(line, sizeof(line), "%12lld %-24s %-12s %5i -> %5i %s\n", (long long)entry.ticks,
+			__KernelRescheduleReasonName((RescheduleReason)entry.reason), entry.waitType != WAITTYPE_NONE ? waitName : "",
+			entry.fromThread, entry.toThread, resultNames[entry.result]);
+		text += line;
+	}
+	return text;
+}
+
+void __KernelReSchedule(RescheduleReason reason, WaitType waitType)
 {
   // cancel rescheduling when in interrupt or callback, otherwise everything will be fucked up
   if (__IsInInterrupt() || __KernelInCallback())
   {
-    reason = "In Interrupt Or Callback";
+    __KernelTraceReSchedule(reason, waitType, currentThread, currentThread, RESCHED_RESULT_SKIPPED);
     return;
   }
 
@@ -747,7 +1082,7 @@ void __KernelReSchedule(const char *reason)
   CoreTiming::Advance();
   if (__IsInInterrupt() || __KernelInCallback())
   {
-    reason = "In Interrupt Or Callback";
+    __KernelTraceReSchedule(reason, waitType, currentThread, currentThread, RESCHED_RESULT_SKIPPED);
     return;
   }
 
@@ -756,6 +1091,7 @@ retry:
 
 	if (nextThread)
 	{
+		__KernelTraceReSchedule(reason, waitType, currentThread, nextThread, nextThread == currentThread ? RESCHED_RESULT_STAYED : RESCHED_RESULT_SWITCHED);
 		__KernelSwitchContext(nextThread, reason);
 		return;
 	}
@@ -768,7 +1104,7 @@ retry:
 	}
 }
 
-void __KernelReSchedule(bool doCallbacks, const char *reason)
+void __KernelReSchedule(bool doCallbacks, RescheduleReason reason, WaitType waitType)
 {
 	Thread *thread = currentThread;
 	if (doCallbacks)
@@ -777,7 +1113,7 @@ void __KernelReSchedule(bool doCallbacks, const char *reason)
 			thread->isProcessingCallbacks = doCallbacks;
 		__KernelCheckCallbacks();
 	}
-	__KernelReSchedule(reason);
+	__KernelReSchedule(reason, waitType);
 	if (doCallbacks && thread == currentThread) {
 		if (thread->isRunning()) {
 			thread->isProcessingCallbacks = false;
@@ -856,6 +1192,9 @@ Thread *__KernelCreateThread(SceUID &id, SceUID moduleId, const char *name, u32
 	t->nt.status = THREADSTATUS_DORMANT;
 	t->nt.waitType = WAITTYPE_NONE;
 	t->nt.waitID = 0;
+	t->readyPrev = t->readyNext = 0;
+	t->readyBucket = 0;
+	t->inWaitList = false;
 	memset(&t->waitInfo, 0, sizeof(t->waitInfo));
 	t->nt.exitStatus = 0;
 	t->nt.numInterruptPreempts = 0;
@@ -883,7 +1222,7 @@ void __KernelSetupRootThread(SceUID moduleID, int args, const char *argp, int pr
 	//grab mips regs
 	SceUID id;
 	currentThread = __KernelCreateThread(id, moduleID, "root", currentMIPS->pc, prio, stacksize, attr);
-	currentThread->nt.status = THREADSTATUS_READY; // do not schedule
+	__KernelSetThreadStatus(currentThread, THREADSTATUS_READY); // do not schedule
 
 	strcpy(currentThread->nt.name, "root");
 
@@ -940,7 +1279,7 @@ void sceKernelStartThread(SceUID threadToStartID, u32 argSize, u32 argBlockPtr)
 		INFO_LOG(HLE,"sceKernelStartThread(thread=%i, argSize=%i, argPtr= %08x )",
 			threadToStartID,argSize,argBlockPtr);
 
-		startThread->nt.status = THREADSTATUS_READY;
+		__KernelSetThreadStatus(startThread, THREADSTATUS_READY);
 		u32 sp = startThread->context.r[MIPS_REG_SP];
 		if (argBlockPtr && argSize > 0)
 		{
@@ -963,7 +1302,7 @@ void sceKernelStartThread(SceUID threadToStartID, u32 argSize, u32 argBlockPtr)
 		}
 		RETURN(0);
 
-		__KernelReSchedule("thread started");
+		__KernelReSchedule(RESCHED_THREAD_STARTED);
 	}
 	else
 	{
@@ -1015,7 +1354,7 @@ void __KernelReturnFromThread()
 	}
 
 	currentThread->nt.exitStatus = currentThread->context.r[2];
-	currentThread->nt.status = THREADSTATUS_DORMANT;
+	__KernelSetThreadStatus(currentThread, THREADSTATUS_DORMANT);
 	__KernelFireThreadEnd(currentThread);
 
 	// TODO: Need to remove the thread from any ready queues.
@@ -1023,7 +1362,7 @@ void __KernelReturnFromThread()
 	// Find threads that waited for me
 	// Wake them
 	if (!__KernelTriggerWait(WAITTYPE_THREADEND, __KernelGetCurThread()))
-		__KernelReSchedule("return from thread");
+		__KernelReSchedule(RESCHED_THREAD_RETURNED);
 
 	// The stack will be deallocated when the thread is deleted.
 }
@@ -1031,14 +1370,14 @@ void __KernelReturnFromThread()
 void sceKernelExitThread()
 {
 	ERROR_LOG(HLE,"sceKernelExitThread FAKED");
-	currentThread->nt.status = THREADSTATUS_DORMANT;
+	__KernelSetThreadStatus(currentThread, THREADSTATUS_DORMANT);
 	currentThread->nt.exitStatus = PARAM(0);
 	__KernelFireThreadEnd(currentThread);
 
 	//Find threads that waited for me
 	// Wake them
 	if (!__KernelTriggerWait(WAITTYPE_THREADEND, __KernelGetCurThread()))
-		__KernelReSchedule("exited thread");
+		__KernelReSchedule(RESCHED_THREAD_EXITED);
 
 	// The stack will be deallocated when the thread is deleted.
 }
@@ -1046,14 +1385,14 @@ void sceKernelExitThread()
 void _sceKernelExitThread()
 {
   ERROR_LOG(HLE,"_sceKernelExitThread FAKED");
-  currentThread->nt.status = THREADSTATUS_DORMANT;
+  __KernelSetThreadStatus(currentThread, THREADSTATUS_DORMANT);
   currentThread->nt.exitStatus = PARAM(0);
   __KernelFireThreadEnd(currentThread);
 
   //Find threads that waited for this one
   // Wake them
   if (!__KernelTriggerWait(WAITTYPE_THREADEND, __KernelGetCurThread()))
-    __KernelReSchedule("exit-deleted thread");
+    __KernelReSchedule(RESCHED_THREAD_EXIT_DELETED);
 
 	// The stack will be deallocated when the thread is deleted.
 }
@@ -1066,7 +1405,7 @@ void sceKernelExitDeleteThread()
   if (t)
   {
     ERROR_LOG(HLE,"sceKernelExitDeleteThread()");
-    currentThread->nt.status = THREADSTATUS_DORMANT;
+    __KernelSetThreadStatus(currentThread, THREADSTATUS_DORMANT);
     currentThread->nt.exitStatus = PARAM(0);
 	__KernelFireThreadEnd(currentThread);
 		//userMemory.Free(currentThread->stackBlock);
@@ -1104,8 +1443,22 @@ u32 sceKernelResumeDispatchThread(u32 suspended)
 
 void sceKernelRotateThreadReadyQueue()
 {
-	DEBUG_LOG(HLE,"sceKernelRotateThreadReadyQueue : rescheduling");
-	__KernelReSchedule("rotatethreadreadyqueue");
+	int priority = PARAM(0);
+	if (priority == 0)
+		priority = currentThread->nt.currentPriority;
+	DEBUG_LOG(HLE,"sceKernelRotateThreadReadyQueue(%i) : rescheduling", priority);
+
+	// Sends the current thread, or else the first one, to the back of that priority.
+	Thread *t = threadReadyQueue.front(priority);
+	if ((currentThread->nt.status & THREADSTATUS_READY) && currentThread->readyBucket == ThreadReadyQueue::bucketFor(priority))
+		t = currentThread;
+	if (t)
+	{
+		threadReadyQueue.remove(t);
+		threadReadyQueue.push_back(t);
+	}
+	RETURN(0);
+	__KernelReSchedule(RESCHED_ROTATE_READY_QUEUE);
 }
 
 void sceKernelDeleteThread()
@@ -1150,7 +1503,7 @@ void sceKernelTerminateDeleteThread()
 
     //TODO: should we really reschedule here?
 		if (!__KernelTriggerWait(WAITTYPE_THREADEND, threadno))
-			__KernelReSchedule("termdeletethread");
+			__KernelReSchedule(RESCHED_THREAD_TERMINATE_DELETED);
 	}
 	else
 	{
@@ -1203,7 +1556,15 @@ void sceKernelChangeThreadPriority()
 	if (thread)
 	{
 		DEBUG_LOG(HLE,"sceKernelChangeThreadPriority(%i, %i)", id, PARAM(1));
-		thread->nt.currentPriority = PARAM(1);
+		if (thread->nt.status & THREADSTATUS_READY)
+		{
+			// Goes to the back of the new priority.
+			threadReadyQueue.remove(thread);
+			thread->nt.currentPriority = PARAM(1);
+			threadReadyQueue.push_back(thread);
+		}
+		else
+			thread->nt.currentPriority = PARAM(1);
 		RETURN(0);
 	}
 	else
@@ -1496,6 +1857,16 @@ public:
 		calls_.erase(id);
 		return temp;
 	}
+	void clear() {
+		std::map<int, MipsCall *>::iterator it, end;
+		for (it = calls_.begin(), end = calls_.end(); it != end; ++it) {
+			if (it->second)
+				delete it->second->doAfter;
+			delete it->second;
+		}
+		calls_.clear();
+	}
+	void DoState(PointerWrap &p);
 
 private:
 	int genId() { return ++idGen_; }
@@ -1505,11 +1876,37 @@ private:
 
 MipsCallManager mipsCalls;
 
+// Action::GetType values, for saving states.
+enum
+{
+	ACTION_AFTER_MIPS_CALL = 1,
+	ACTION_AFTER_CALLBACK = 2,
+};
+
+static void __KernelDoActionState(PointerWrap &p, Action *&action);
 
 class ActionAfterMipsCall : public Action
 {
 public:
 	virtual void run();
+	virtual int GetType() const { return ACTION_AFTER_MIPS_CALL; }
+	virtual void DoState(PointerWrap &p)
+	{
+		SceUID threadID = thread ? thread->GetUID() : 0;
+		p.Do(threadID);
+		p.Do(status);
+		p.Do(waitType);
+		p.Do(waitId);
+		p.Do(waitInfo);
+		p.Do(isProcessingCallbacks);
+		if (p.mode == p.MODE_READ)
+		{
+			u32 error;
+			thread = threadID ? kernelObjects.Get<Thread>(threadID, error) : 0;
+		}
+		__KernelDoActionState(p, chainedAction);
+	}
+
 	Thread *thread;
 
 	// Saved thread state
@@ -1523,9 +1920,9 @@ public:
 };
 
 void ActionAfterMipsCall::run() {
-	thread->nt.status = status;
 	thread->nt.waitType = waitType;
 	thread->nt.waitID = waitId;
+	__KernelSetThreadStatus(thread, status);
 	thread->waitInfo = waitInfo;
 	thread->isProcessingCallbacks = isProcessingCallbacks;
 
@@ -1555,16 +1952,16 @@ void Thread::setReturnValue(u32 retval)
 	}
 }
 
-void __KernelSwitchContext(Thread *target, const char *reason) 
+void __KernelSwitchContext(Thread *target, RescheduleReason reason) 
 {
 	if (currentThread)  // It might just have been deleted.
 	{
 		__KernelSaveContext(&currentThread->context);
-		DEBUG_LOG(HLE,"Context saved (%s): %i - %s - pc: %08x", reason, currentThread->GetUID(), currentThread->GetName(), currentMIPS->pc);
+		DEBUG_LOG(HLE,"Context saved (%s): %i - %s - pc: %08x", __KernelRescheduleReasonName(reason), currentThread->GetUID(), currentThread->GetName(), currentMIPS->pc);
 	}
 	currentThread = target;
 	__KernelLoadContext(&currentThread->context);
-	DEBUG_LOG(HLE,"Context loaded (%s): %i - %s - pc: %08x", reason, currentThread->GetUID(), currentThread->GetName(), currentMIPS->pc);
+	DEBUG_LOG(HLE,"Context loaded (%s): %i - %s - pc: %08x", __KernelRescheduleReasonName(reason), currentThread->GetUID(), currentThread->GetName(), currentMIPS->pc);
 
 	// No longer waiting.
 	currentThread->nt.waitType = WAITTYPE_NONE;
@@ -1574,8 +1971,13 @@ void __KernelSwitchContext(Thread *target, const char *reason)
 }
 
 void __KernelChangeThreadState(Thread *thread, ThreadStatus newStatus) {
-	if (!thread || thread->nt.status == newStatus)
+	if (!thread)
+		return;
+	if (thread->nt.status == newStatus) {
+		// Still waiting, but maybe on something else now.
+		__KernelSetThreadStatus(thread, newStatus);
 		return;
+	}
 
 	if (!dispatchEnabled && thread == currentThread && newStatus != THREADSTATUS_RUNNING) {
 		ERROR_LOG(HLE, "Dispatching suspended, not changing thread state");
@@ -1585,7 +1987,7 @@ void __KernelChangeThreadState(Thread *thread, ThreadStatus newStatus) {
 	// TODO: JPSCP has many conditions here, like removing wait timeout actions etc.
 	// if (thread->nt.status == THREADSTATUS_WAIT && newStatus != THREADSTATUS_WAITSUSPEND) {
 
-	thread->nt.status = newStatus;
+	__KernelSetThreadStatus(thread, newStatus);
 
 	if (newStatus == THREADSTATUS_WAIT) {
 		if (thread->nt.waitType == WAITTYPE_NONE) {
@@ -1700,7 +2102,7 @@ void __KernelReturnFromMipsCall()
 	if (!__KernelExecutePendingMipsCalls())
 	{
 		// We should definitely reschedule as we might still be asleep. - except if we came from checkcallbacks?
-		__KernelReSchedule("return from callback");
+		__KernelReSchedule(RESCHED_CALLBACK_RETURNED);
 	}
 }
 
@@ -1730,9 +2132,138 @@ class ActionAfterCallback : public Action
 public:
 	ActionAfterCallback(SceUID cbId_) : cbId(cbId_) {}
 	virtual void run();
+	virtual int GetType() const { return ACTION_AFTER_CALLBACK; }
+	virtual void DoState(PointerWrap &p)
+	{
+		p.Do(cbId);
+	}
 	SceUID cbId;
 };
 
+static void __KernelDoActionState(PointerWrap &p, Action *&action)
+{
+	int type = action ? action->GetType() : 0;
+	if (action && type == 0)
+		ERROR_LOG(HLE, "Unable to save state of an action, it won't run after loading");
+	p.Do(type);
+
+	if (p.mode == p.MODE_READ)
+	{
+		switch (type)
+		{
+		case ACTION_AFTER_MIPS_CALL:
+			action = new ActionAfterMipsCall();
+			break;
+		case ACTION_AFTER_CALLBACK:
+			action = new ActionAfterCallback(-1);
+			break;
+		default:
+			action = 0;
+			break;
+		}
+	}
+	if (action && type != 0)
+		action->DoState(p);
+}
+
+void MipsCall::DoState(PointerWrap &p)
+{
+	p.Do(entryPoint);
+	p.Do(cbId);
+	p.DoArray(args, sizeof(args) / sizeof(args[0]));
+	p.Do(numArgs);
+	p.Do(savedIdRegister);
+	p.Do(savedRa);
+	p.Do(savedPc);
+	p.Do(savedV0);
+	p.Do(savedV1);
+	p.Do(returnVoid);
+	if (p.mode == p.MODE_READ)
+		tag = "loadedState";
+	__KernelDoActionState(p, doAfter);
+}
+
+void MipsCallManager::DoState(PointerWrap &p)
+{
+	p.Do(idGen_);
+
+	// get() can leave empty entries behind, those aren't saved.
+	u32 count = 0;
+	std::map<int, MipsCall *>::iterator it, end;
+	for (it = calls_.begin(), end = calls_.end(); it != end; ++it)
+		count += it->second ? 1 : 0;
+	p.Do(count);
+
+	if (p.mode == p.MODE_READ)
+	{
+		clear();
+		for (u32 i = 0; i < count; i++)
+		{
+			int id = 0;
+			p.Do(id);
+			MipsCall *call = new MipsCall();
+			call->doAfter = 0;
+			call->DoState(p);
+			calls_[id] = call;
+		}
+	}
+	else
+	{
+		for (it = calls_.begin(), end = calls_.end(); it != end; ++it)
+		{
+			if (!it->second)
+				continue;
+			int id = it->first;
+			p.Do(id);
+			it->second->DoState(p);
+		}
+	}
+	p.DoMarker("MipsCallManager");
+}
+
+// Must come after the object pool, threads are saved there.
+void __KernelThreadingDoState(PointerWrap &p)
+{
+	if (!p.Section("sceKernelThread", 1, 1))
+		return;
+
+	p.Do(idleThreadHackAddr);
+	p.Do(threadReturnHackAddr);
+	p.Do(cbReturnHackAddr);
+	p.Do(intReturnHackAddr);
+	p.DoArray(threadIdleID, sizeof(threadIdleID) / sizeof(threadIdleID[0]));
+	p.Do(dispatchEnabled);
+	p.Do(curModule);
+	p.Do(g_inCbCount);
+
+	SceUID currentThreadID = currentThread ? currentThread->GetUID() : 0;
+	p.Do(currentThreadID);
+
+	std::vector<SceUID> queueIDs;
+	for (size_t i = 0; i < threadqueue.size(); i++)
+		queueIDs.push_back(threadqueue[i]->GetUID());
+	p.Do(queueIDs);
+
+	if (p.mode == p.MODE_READ)
+	{
+		u32 error;
+		currentThread = currentThreadID ? kernelObjects.Get<Thread>(currentThreadID, error) : 0;
+		threadqueue.clear();
+		for (size_t i = 0; i < queueIDs.size(); i++)
+		{
+			Thread *t = kernelObjects.Get<Thread>(queueIDs[i], error);
+			if (t)
+				threadqueue.push_back(t);
+		}
+		threadReadyQueue.clear();
+	}
+
+	threadReadyQueue.DoState(p);
+	threadWaitLists.DoState(p);
+	mipsCalls.DoState(p);
+	p.DoMarker("sceKernelThread");
+}
+
 // Executes the callback, when it next is context switched to.
 void __KernelRunCallbackOnThread(SceUID cbId, Thread *thread)
 {
@@ -1839,7 +2370,7 @@ void sceKernelCheckCallback() {
 	} else {
 		RETURN(0);
 		DEBUG_LOG(HLE,"sceKernelCheckCallback() - no callbacks to process, simply rescheduling");
-		__KernelReSchedule(false, "checkcallbackhack");
+		__KernelReSchedule(false, RESCHED_CHECK_CALLBACK);
 	}
 }
 
@@ -95,6 +95,7 @@ struct ThreadContext
 // Internal API, used by implementations of kernel functions
 
 void __KernelThreadingInit();
+void __KernelThreadingDoState(PointerWrap &p);
 void __KernelThreadingShutdown();
 
 void __KernelScheduleWakeup(int usFromNow, int threadnumber);
@@ -113,8 +114,49 @@ u32 __KernelGetWaitValue(SceUID threadID, u32 &error);
 u32 __KernelGetWaitTimeoutPtr(SceUID threadID, u32 &error);
 SceUID __KernelGetWaitID(SceUID threadID, WaitType type, u32 &error);
 void __KernelWaitCurThread(WaitType type, SceUID waitId, u32 waitValue, u32 timeoutPtr, bool processCallbacks);
-void __KernelReSchedule(const char *reason = "no reason");
-void __KernelReSchedule(bool doCallbacks, const char *reason);
+
+// Why the scheduler ran. Kept as a number so the hot path never formats strings,
+// see __KernelRescheduleReasonName for the text.
+enum RescheduleReason
+{
+	RESCHED_UNSPECIFIED,
+	RESCHED_IDLE,
+	RESCHED_WAIT_BEGIN,
+	RESCHED_WAIT_END,
+	RESCHED_THREAD_STARTED,
+	RESCHED_THREAD_RETURNED,
+	RESCHED_THREAD_EXITED,
+	RESCHED_THREAD_EXIT_DELETED,
+	RESCHED_THREAD_TERMINATE_DELETED,
+	RESCHED_ROTATE_READY_QUEUE,
+	RESCHED_CALLBACK_RETURNED,
+	RESCHED_CHECK_CALLBACK,
+	RESCHED_MUTEX_DELETED,
+	RESCHED_MUTEX_LOCKED,
+	RESCHED_MUTEX_UNLOCKED,
+	RESCHED_LWMUTEX_DELETED,
+	RESCHED_LWMUTEX_LOCKED,
+	RESCHED_LWMUTEX_UNLOCKED,
+	RESCHED_MBX_SENT,
+	RESCHED_SEMA_CANCELED,
+	RESCHED_SEMA_DELETED,
+	RESCHED_SEMA_SIGNALED,
+	RESCHED_SEMA_WAITED,
+	RESCHED_UMD_ACTIVATED,
+	RESCHED_UMD_DEACTIVATED,
+	RESCHED_UTILITY_LOAD_MODULE,
+
+	RESCHED_NUM_REASONS,
+};
+
+const char *__KernelRescheduleReasonName(RescheduleReason reason);
+
+// waitType is only recorded in the trace, for RESCHED_WAIT_BEGIN and RESCHED_WAIT_END.
+void __KernelReSchedule(RescheduleReason reason = RESCHED_UNSPECIFIED, WaitType waitType = WAITTYPE_NONE);
+void __KernelReSchedule(bool doCallbacks, RescheduleReason reason, WaitType waitType = WAITTYPE_NONE);
+
+// The last few thousand reschedules, oldest first, one per line. Meant for tracking down stutter.
+std::string __KernelGetRescheduleTrace();
 
 // Registered callback types
 enum RegisteredCallbackType {
@@ -167,7 +209,7 @@ bool __KernelInCallback();
 bool __KernelCheckCallbacks();
 bool __KernelForceCallbacks();
 class Thread;
-void __KernelSwitchContext(Thread *target, const char *reason);
+void __KernelSwitchContext(Thread *target, RescheduleReason reason);
 bool __KernelExecutePendingMipsCalls();
 void __KernelNotifyCallback(RegisteredCallbackType type, SceUID threadId, SceUID cbId, int notifyArg);
 
@@ -187,6 +229,8 @@ struct MipsCall {
 	u32 savedV1;
 	bool returnVoid;
 	const char *tag;
+
+	void DoState(PointerWrap &p);
 };
 enum ThreadStatus
 {
@@ -204,3 +248,6 @@ void __KernelChangeThreadState(Thread *thread, ThreadStatus newStatus);
 
 typedef void (*ThreadCallback)(SceUID threadID);
 void __KernelListenThreadEnd(ThreadCallback callback);
+
+KernelObject *__KernelThreadObject();
+KernelObject *__KernelCallbackObject();
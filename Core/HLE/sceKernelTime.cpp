@@ -29,6 +29,7 @@
 #include "sceKernelTime.h"
 
 #include "../CoreTiming.h"
+#include "../Replay.h"
 
 //////////////////////////////////////////////////////////////////////////
 // Other clock stuff
@@ -107,17 +108,17 @@ u32 sceKernelUSec2SysClockWide(u32 usec)
 
 u32 sceKernelLibcClock()
 {
-	u32 retVal = clock()*1000;  // TODO: This can't be right
+	u32 retVal = (u32)Replay_Value(REPLAY_LIBC_CLOCK, (u32)(clock()*1000));  // TODO: This can't be right
 	DEBUG_LOG(HLE,"%i = sceKernelLibcClock",retVal);
 	return retVal;
 }
 
 void sceKernelLibcTime()
 {
-	time_t *t = 0;
-	if (PARAM(0))
-		t = (time_t*)Memory::GetPointer(PARAM(0));
-	u32 retVal = (u32)time(t);
+	u32 retVal = (u32)Replay_Value(REPLAY_LIBC_TIME, (u32)time(NULL));
+	// The PSP's time_t is 32 bits, unlike most hosts'.
+	if (Memory::IsValidAddress(PARAM(0)))
+		Memory::Write_U32(retVal, PARAM(0));
 	DEBUG_LOG(HLE,"%i = sceKernelLibcTime()",retVal);
 	RETURN(retVal);
 }
@@ -140,8 +141,10 @@ void sceKernelLibcGettimeofday()
 	DEBUG_LOG(HLE,"sceKernelLibcGettimeofday()");
 
 	GetSystemTimeAsFileTime (&now.ft);
-	tv->tv_usec = (long) ((now.ns100 / 10LL) % 1000000LL);
-	tv->tv_sec = (long) ((now.ns100 - 116444736000000000LL) / 10000000LL);
+	u64 us = (u64)((now.ns100 - 116444736000000000LL) / 10LL);
+	us = Replay_Value(REPLAY_LIBC_TIMEOFDAY, us);
+	tv->tv_usec = (u32)(us % 1000000ULL);
+	tv->tv_sec = (u32)(us / 1000000ULL);
 #endif
 	RETURN(0);
 }
@@ -18,6 +18,7 @@
 #include "sceKernel.h"
 #include "sceKernelVTimer.h"
 #include "HLE.h"
+#include "ChunkFile.h"
 
 //////////////////////////////////////////////////////////////////////////
 // VTIMER
@@ -29,6 +30,19 @@ struct VTimer : public KernelObject
 	const char *GetTypeName() {return "VTimer";}
 	static u32 GetMissingErrorCode() { return SCE_KERNEL_ERROR_UNKNOWN_VTID; }
 	int GetIDType() const { return SCE_KERNEL_TMID_VTimer; }
+	static int GetStaticIDType() { return SCE_KERNEL_TMID_VTimer; }
+
+	virtual void DoState(PointerWrap &p)
+	{
+		p.Do(size);
+		p.DoArray(name, sizeof(name));
+		p.Do(startTime);
+		p.Do(running);
+		p.Do(handler);
+		p.Do(handlerTime);
+		p.Do(argument);
+		p.DoMarker("VTimer");
+	}
 
 	SceSize 	size;
 	char 		name[KERNELOBJECT_MAX_NAME_LENGTH+1];
@@ -39,6 +53,11 @@ struct VTimer : public KernelObject
 	u32 argument;
 };
 
+KernelObject *__KernelVTimerObject()
+{
+	return new VTimer;
+}
+
 void sceKernelCreateVTimer()
 {
 	DEBUG_LOG(HLE,"sceKernelCreateVTimer");
@@ -21,6 +21,7 @@
 
 #include "scePower.h"
 #include "sceKernelThread.h"
+#include "ChunkFile.h"
 
 static bool volatileMemLocked;
 
@@ -34,6 +35,16 @@ void __PowerInit() {
 	memset(powerCbSlots, 0, sizeof(powerCbSlots));
 }
 
+void __PowerDoState(PointerWrap &p)
+{
+	if (!p.Section("scePower", 1, 1))
+		return;
+
+	p.Do(volatileMemLocked);
+	p.DoArray(powerCbSlots, numberOfCBPowerSlots);
+	p.DoMarker("scePower");
+}
+
 int scePowerGetBatteryLifePercent()
 {
 	DEBUG_LOG(HLE, "100=scePowerGetBatteryLifePercent");
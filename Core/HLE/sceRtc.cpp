@@ -30,6 +30,7 @@
 #include "sceKernel.h"
 #include "sceRtc.h"
 #include "../CoreTiming.h"
+#include "../Replay.h"
 
 // Grabbed from JPSCP
 // This is # of microseconds between January 1, 0001 and January 1, 1970.
@@ -215,6 +216,7 @@ u32 sceRtcGetCurrentClock(u32 pspTimePtr, int tz)
 	ScePspDateTime ret;
 	__RtcTmToPspTime(ret, utc);
 	ret.microsecond = tv.tv_usec;
+	Replay_Data(REPLAY_RTC_CLOCK, &ret, sizeof(ret));
 
 	if (Memory::IsValidAddress(pspTimePtr))
 		Memory::WriteStruct(pspTimePtr, &ret);
@@ -234,6 +236,7 @@ u32 sceRtcGetCurrentClockLocalTime(u32 pspTimePtr)
 	ScePspDateTime ret;
 	__RtcTmToPspTime(ret, local);
 	ret.microsecond = tv.tv_usec;
+	Replay_Data(REPLAY_RTC_LOCAL_CLOCK, &ret, sizeof(ret));
 
 	if (Memory::IsValidAddress(pspTimePtr))
 		Memory::WriteStruct(pspTimePtr, &ret);
@@ -20,6 +20,7 @@
 #include "../../Core/CoreTiming.h"
 #include "sceUmd.h"
 #include "sceKernelThread.h"
+#include "ChunkFile.h"
 
 const int PSP_ERROR_UMD_INVALID_PARAM = 0x80010016;
 
@@ -35,7 +36,7 @@ u8 umdActivated = 1;
 u32 umdStatus = 0;
 u32 umdErrorStat = 0;
 static int driveCBId= -1;
-int umdStatTimer = 0;
+static int umdStatTimer = -1;
 
 
 #define PSP_UMD_TYPE_GAME 0x10
@@ -48,13 +49,28 @@ struct PspUmdInfo {
 };
 
 
+void __UmdStatTimeout(u64 userdata, int cyclesLate);
+
 void __UmdInit() {
+	umdStatTimer = CoreTiming::RegisterEvent("UmdTimeout", &__UmdStatTimeout);
 	umdActivated = 1;
 	umdStatus = 0;
 	umdErrorStat = 0;
 	driveCBId = -1;
 }
 
+void __UmdDoState(PointerWrap &p)
+{
+	if (!p.Section("sceUmd", 1, 1))
+		return;
+
+	p.Do(umdActivated);
+	p.Do(umdStatus);
+	p.Do(umdErrorStat);
+	p.Do(driveCBId);
+	p.DoMarker("sceUmd");
+}
+
 u8 __KernelUmdGetState()
 {
 	u8 state = UMD_PRESENT;
@@ -132,7 +148,7 @@ void sceUmdActivate(u32 unknown, const char *name)
 	RETURN(0);
 
 	if (changed)
-		__KernelReSchedule("umd activated");
+		__KernelReSchedule(RESCHED_UMD_ACTIVATED);
 }
 
 void sceUmdDeactivate(u32 unknown, const char *name)
@@ -161,7 +177,7 @@ void sceUmdDeactivate(u32 unknown, const char *name)
 	RETURN(0);
 
 	if (changed)
-		__KernelReSchedule("umd deactivated");
+		__KernelReSchedule(RESCHED_UMD_DEACTIVATED);
 }
 
 u32 sceUmdRegisterUMDCallBack(u32 cbId)
@@ -219,9 +235,6 @@ void __UmdStatTimeout(u64 userdata, int cyclesLate)
 
 void __UmdWaitStat(u32 timeout)
 {
-	if (umdStatTimer == 0)
-		umdStatTimer = CoreTiming::RegisterEvent("MutexTimeout", &__UmdStatTimeout);
-
 	// This happens to be how the hardware seems to time things.
 	if (timeout <= 4)
 		timeout = 15;
@@ -24,6 +24,7 @@
 
 #include "sceCtrl.h"
 #include "../Util/PPGeDraw.h"
+#include "ChunkFile.h"
 
 enum SceUtilitySavedataType
 {
@@ -156,6 +157,16 @@ void __UtilityInit()
 }
 
 
+void __UtilityDoState(PointerWrap &p)
+{
+	if (!p.Section("sceUtility", 1, 1))
+		return;
+
+	p.Do(utilityDialogState);
+	p.Do(messageDialogAddr);
+	p.DoMarker("sceUtility");
+}
+
 void __UtilityInitStart()
 {
 	utilityDialogState = SCE_UTILITY_STATUS_INITIALIZE;
@@ -257,7 +268,7 @@ void sceUtilityLoadAvModule(u32 module)
 {
 	DEBUG_LOG(HLE,"sceUtilityLoadAvModule(%i)", module);
 	RETURN(0);
-	__KernelReSchedule("utilityloadavmodule");
+	__KernelReSchedule(RESCHED_UTILITY_LOAD_MODULE);
 }
 
 //TODO: Shouldn't be void
@@ -265,7 +276,7 @@ void sceUtilityLoadModule(u32 module)
 {
 	DEBUG_LOG(HLE,"sceUtilityLoadModule(%i)", module);
 	RETURN(0);
-	__KernelReSchedule("utilityloadmodule");
+	__KernelReSchedule(RESCHED_UTILITY_LOAD_MODULE);
 }
 
 typedef struct
@@ -15,7 +15,22 @@
 #define _SIZE ((op>>11 ) & 0x1F)
 
 
+// All functions should have CONDITIONAL_DISABLE, so we can narrow things down to a file quickly.
+// Currently known non working ones should have DISABLE.
+
+#define DISABLE Comp_Generic(op); return;
+
 namespace MIPSComp
 {
 
+void Jit::Comp_SV(u32 op) { DISABLE; }
+void Jit::Comp_SVQ(u32 op) { DISABLE; }
+void Jit::Comp_Mftv(u32 op) { DISABLE; }
+void Jit::Comp_VPFX(u32 op) { DISABLE; }
+void Jit::Comp_VecDo3(u32 op) { DISABLE; }
+void Jit::Comp_VDot(u32 op) { DISABLE; }
+void Jit::Comp_VScl(u32 op) { DISABLE; }
+void Jit::Comp_Vmmul(u32 op) { DISABLE; }
+void Jit::Comp_Vtfm(u32 op) { DISABLE; }
+
 }
\ No newline at end of file
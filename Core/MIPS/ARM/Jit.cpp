@@ -21,6 +21,7 @@
 #include "../MIPSCodeUtils.h"
 #include "../MIPSInt.h"
 #include "../MIPSTables.h"
+#include "../JitCommon/JitDiskCache.h"
 
 #include "RegCache.h"
 #include "Jit.h"
@@ -102,6 +103,7 @@ void Jit::Compile(u32 em_address)
 	int block_num = blocks.AllocateBlock(em_address);
 	JitBlock *b = blocks.GetBlock(block_num);
 	blocks.FinalizeBlock(block_num, jo.enableBlocklink, DoJit(em_address, b));
+	jitDiskCache.RecordBlock(b->originalAddress, b->originalSize);
 }
 
 void Jit::RunLoopUntil(u64 globalticks)
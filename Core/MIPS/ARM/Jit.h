@@ -92,10 +92,21 @@ public:
 	void Comp_FPU2op(u32 op);
 	void Comp_mxc1(u32 op);
 
+	void Comp_SV(u32 op);
+	void Comp_SVQ(u32 op);
+	void Comp_Mftv(u32 op);
+	void Comp_VPFX(u32 op);
+	void Comp_VecDo3(u32 op);
+	void Comp_VDot(u32 op);
+	void Comp_VScl(u32 op);
+	void Comp_Vmmul(u32 op);
+	void Comp_Vtfm(u32 op);
+
 	JitBlockCache *GetBlockCache() { return &blocks; }
 	AsmRoutineManager &Asm() { return asm_; }
-private:
+	// Drops every compiled block, e.g. after loading a state.
 	void ClearCache();
+private:
 	void FlushAll();
 
 	void WriteExit(u32 destination, int exit_num);
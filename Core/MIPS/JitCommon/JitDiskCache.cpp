@@ -0,0 +1,131 @@
+// Copyright (c) 2012- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#include "Hash.h"
+#include "base/timeutil.h"
+
+#include "../../MemMap.h"
+#include "../MIPS.h"
+#include "JitCommon.h"
+#include "JitDiskCache.h"
+
+JitDiskCache jitDiskCache;
+
+void JitDiskCache::Open(const std::string &filename)
+{
+	Close();
+	u32 count = file_.OpenAndRead(filename.c_str(), *this);
+	open_ = true;
+	INFO_LOG(JIT, "Jit disk cache: read %u entries (%d blocks) from %s", count, (int)order_.size(), filename.c_str());
+}
+
+void JitDiskCache::Close()
+{
+	if (open_)
+	{
+		file_.Sync();
+		file_.Close();
+	}
+	open_ = false;
+	order_.clear();
+	entries_.clear();
+}
+
+void JitDiskCache::Read(const u32 &key, const JitDiskCacheEntry *value, u32 value_size)
+{
+	if (value_size != 1)
+		return;
+
+	// Blocks get appended again when their code changes, the last entry wins.
+	if (entries_.find(key) == entries_.end())
+		order_.push_back(key);
+	entries_[key] = *value;
+}
+
+u64 JitDiskCache::HashCode(u32 address, u32 numInstructions)
+{
+	// Read_Instruction sees through the block entry ops the jit writes over code.
+	hashBuffer_.resize(numInstructions);
+	for (u32 i = 0; i < numInstructions; i++)
+		hashBuffer_[i] = Memory::Read_Instruction(address + i * 4);
+	return GetMurmurHash3((const u8 *)&hashBuffer_[0], numInstructions * 4, 0);
+}
+
+int JitDiskCache::Precompile()
+{
+	if (!open_ || !MIPSComp::jit)
+		return 0;
+
+	double start = time_now_d();
+	JitBlockCache *blocks = MIPSComp::jit->GetBlockCache();
+	// Compile always starts at the current pc.
+	u32 savedPC = currentMIPS->pc;
+
+	int compiled = 0, mismatched = 0;
+	for (size_t i = 0; i < order_.size(); i++)
+	{
+		u32 address = order_[i];
+		const JitDiskCacheEntry &entry = entries_[address];
+		if (entry.numInstructions == 0 || !Memory::IsValidAddress(address) || !Memory::IsValidAddress(address + entry.numInstructions * 4 - 4))
+			continue;
+		if (blocks->GetBlockNumberFromStartAddress(address) >= 0)
+			continue;
+		// Leave room for the game, Compile would throw everything away when full.
+		if (blocks->IsFull() || MIPSComp::jit->GetSpaceLeft() < 0x100000)
+			break;
+
+		// Not loaded yet (e.g. a module the game loads later), or different code.
+		if (HashCode(address, entry.numInstructions) != entry.hash)
+		{
+			mismatched++;
+			continue;
+		}
+
+		currentMIPS->pc = address;
+		MIPSComp::jit->Compile(address);
+		compiled++;
+	}
+
+	currentMIPS->pc = savedPC;
+	INFO_LOG(JIT, "Jit disk cache: precompiled %d blocks in %0.2f ms, %d didn't match", compiled, (time_now_d() - start) * 1000.0, mismatched);
+	return compiled;
+}
+
+void JitDiskCache::RecordBlock(u32 address, u32 numInstructions)
+{
+	if (!open_)
+		return;
+
+	JitDiskCacheEntry entry;
+	entry.numInstructions = numInstructions;
+	entry.unused = 0;
+	entry.hash = HashCode(address, numInstructions);
+
+	std::map<u32, JitDiskCacheEntry>::iterator iter = entries_.find(address);
+	if (iter != entries_.end())
+	{
+		if (iter->second.numInstructions == numInstructions && iter->second.hash == entry.hash)
+			return;
+		iter->second = entry;
+	}
+	else
+	{
+		entries_[address] = entry;
+		order_.push_back(address);
+	}
+	file_.Append(address, &entry, 1);
+}
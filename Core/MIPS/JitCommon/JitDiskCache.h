@@ -0,0 +1,70 @@
+// Copyright (c) 2012- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "../../../Globals.h"
+#include "LinearDiskCache.h"
+
+// Remembers which blocks a game compiled, so the next run can compile them all up front
+// instead of stopping for each one while the game boots.
+// Only block metadata is stored, never generated code. Each entry has a hash of the
+// MIPS words it was compiled from, and is skipped if the code in memory doesn't match.
+
+struct JitDiskCacheEntry
+{
+	u32 numInstructions;
+	u32 unused;
+	u64 hash;
+};
+
+class JitDiskCache : public LinearDiskCacheReader<u32, JitDiskCacheEntry>
+{
+public:
+	JitDiskCache() : open_(false) {}
+
+	// Reads all entries from filename, and appends new blocks to it from then on.
+	void Open(const std::string &filename);
+	void Close();
+	bool IsOpen() const { return open_; }
+
+	// Compiles every entry whose code is currently in memory, returns how many were.
+	// Must be called on the emu thread, after the game has been loaded.
+	int Precompile();
+
+	// Called by the jit after compiling a block.
+	void RecordBlock(u32 address, u32 numInstructions);
+
+	// LinearDiskCacheReader
+	void Read(const u32 &key, const JitDiskCacheEntry *value, u32 value_size);
+
+private:
+	u64 HashCode(u32 address, u32 numInstructions);
+
+	LinearDiskCache<u32, JitDiskCacheEntry> file_;
+	// In the order they were first compiled, which roughly follows how the game boots.
+	std::vector<u32> order_;
+	std::map<u32, JitDiskCacheEntry> entries_;
+	std::vector<u32> hashBuffer_;
+	bool open_;
+};
+
+extern JitDiskCache jitDiskCache;
@@ -16,8 +16,10 @@
 // https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
 
 #include "Common.h"
+#include "ChunkFile.h"
 #include "MIPS.h"
 #include "MIPSTables.h"
+#include "MIPSIntBlockCache.h"
 #include "MIPSDebugInterface.h"
 #include "MIPSVFPUUtils.h"
 #include "../System.h"
@@ -54,6 +56,8 @@ void MIPSState::Reset()
 {
 	if (!MIPSComp::jit && PSP_CoreParameter().cpuCore == CPU_JIT)
 		MIPSComp::jit = new MIPSComp::Jit(this);
+	intBlockCache.Clear();
+	MIPSInterpret_ClearIdleLoops();
 
 	memset(r, 0, sizeof(r));
 	memset(f, 0, sizeof(f));
@@ -93,6 +97,31 @@ void MIPSState::Reset()
 	rng.Init(0x1337);
 }
 
+void MIPSState::DoState(PointerWrap &p)
+{
+	if (!p.Section("MIPSState", 1, 1))
+		return;
+
+	p.DoArray(r, sizeof(r) / sizeof(r[0]));
+	p.DoArray(f, sizeof(f) / sizeof(f[0]));
+	p.DoArray(v, sizeof(v) / sizeof(v[0]));
+	p.DoArray(vfpuCtrl, sizeof(vfpuCtrl) / sizeof(vfpuCtrl[0]));
+	p.DoArray(vfpuWriteMask, sizeof(vfpuWriteMask) / sizeof(vfpuWriteMask[0]));
+	p.Do(pc);
+	p.Do(nextPC);
+	p.Do(hi);
+	p.Do(lo);
+	p.Do(fpcond);
+	p.Do(fcr0);
+	p.Do(fcr31);
+	p.Do(rng);
+	p.Do(inDelaySlot);
+	p.Do(llBit);
+	p.Do(exceptions);
+	p.Do(debugCount);
+	// SaveState::DoState empties the block caches before RAM is saved or loaded.
+}
+
 void MIPSState::SetWriteMask(const bool wm[4])
 {
 	for (int i = 0; i < 4; i++)
@@ -118,6 +147,9 @@ int MIPSState::RunLoopUntil(u64 globalTicks)
 	case CPU_FASTINTERPRETER:  // For jit-less platforms. Crashier than INTERPRETER.
 		return MIPSInterpret_RunFastUntil(globalTicks);
 
+	case CPU_BLOCKINTERPRETER:  // Also for jit-less platforms, decodes each block only once.
+		return MIPSInterpret_RunBlocksUntil(globalTicks);
+
 	case CPU_INTERPRETER:
 		// INFO_LOG(CPU, "Entering run loop for %i ticks, pc=%08x", (int)globalTicks, mipsr4k.pc);
 		return MIPSInterpret_RunUntil(globalTicks);
@@ -125,6 +157,15 @@ int MIPSState::RunLoopUntil(u64 globalTicks)
 	return 1;
 }
 
+void MIPSState::InvalidateICache(u32 address, int length)
+{
+	// Only really applies to jit and the block interpreter.
+	if (MIPSComp::jit)
+		MIPSComp::jit->GetBlockCache()->InvalidateICache(address, length);
+	intBlockCache.InvalidateICache(address, length);
+	MIPSInterpret_ClearIdleLoops();
+}
+
 void MIPSState::WriteFCR(int reg, int value)
 {
 	if (reg == 31)
@@ -20,6 +20,8 @@
 #include "../../Globals.h"
 #include "../CPU.h"
 
+class PointerWrap;
+
 enum
 {
 	MIPS_REG_ZERO=0,
@@ -104,6 +106,8 @@ public:
 	~MIPSState();
 
 	void Reset();
+	// Compiled and pre-decoded blocks are dropped on load, memory may hold other code now.
+	void DoState(PointerWrap &p);
 
 	u32 r[32];
 	float f[32];
@@ -145,6 +149,10 @@ public:
 
 	void SingleStep();
 	int RunLoopUntil(u64 globalTicks);
+
+	// Call this when code in emulated memory has been modified or reloaded.
+	// Drops any compiled or pre-decoded blocks covering the range.
+	void InvalidateICache(u32 address, int length = 4);
 };
 
 
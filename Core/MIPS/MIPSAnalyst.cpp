@@ -29,10 +29,6 @@ using namespace std;
 
 namespace MIPSAnalyst
 {
-	RegisterAnalysisResults regAnal[32];
-	RegisterAnalysisResults total[32];
-	int numAnalysisDone=0;
-
 	int GetOutReg(u32 op)
 	{
 		u32 opinfo = MIPSGetInfo(op);
@@ -85,90 +81,435 @@ namespace MIPSAnalyst
 		}
 	}
 
-	void Analyze(u32 address)
+	// What an instruction does to the register files, as far as the analysis is concerned.
+	// Anything not decoded here is opaque: treated as reading everything, and it stops
+	// constant propagation.
+	struct RegUsage
 	{
-		//set everything to -1 (FF)
-		memset(regAnal, 255, sizeof(AnalysisResults)*32); 
-		for (int i=0; i<32; i++)
-		{
-			regAnal[i].used=false;
-			regAnal[i].readCount=0;
-			regAnal[i].writeCount=0;
-			regAnal[i].readAsAddrCount=0;
-		}
+		u32 gprIn;
+		u32 gprOut;
+		u32 fprIn;
+		u32 fprOut;
+		bool opaque;
+		// No side effects besides writing gprOut / fprOut, so it can be skipped if those are dead.
+		bool pure;
+		// Ends the block, after the delay slot.
+		bool branch;
+		// Has a base register + simm16 address.
+		bool memAccess;
+	};
 
-		u32 addr = address;
-		bool exitFlag = false;
-		while (true)
-		{
-			u32 op = Memory::Read_Instruction(addr);
-			u32 info = MIPSGetInfo(op);
+	static RegUsage GetRegUsage(u32 op)
+	{
+		RegUsage u = {0, 0, 0, 0, false, false, false, false};
+		int rs = MIPS_GET_RS(op);
+		int rt = MIPS_GET_RT(op);
+		int rd = MIPS_GET_RD(op);
 
-			for (int reg=0; reg < 32; reg++)
+		switch (op >> 26)
+		{
+		case 0: // special
+			switch (op & 0x3F)
 			{
-				int rs = MIPS_GET_RS(op);
-				int rt = MIPS_GET_RT(op);
-				int rd = MIPS_GET_RD(op);
-
-				if (
-					((info & IN_RS) && (rs == reg)) ||
-					((info & IN_RS_SHIFT) && (rs == reg)) ||
-					((info & IN_RT) && (rt == reg)))
-				{
-					if (regAnal[reg].firstRead == -1)
-						regAnal[reg].firstRead = addr;
-					regAnal[reg].lastRead = addr;
-					regAnal[reg].readCount++;
-					regAnal[reg].used=true;
-				}
-				if (
-					((info & IN_RS_ADDR) && (rs == reg))
-					)
+			case 0: case 2: case 3: // sll, srl, sra
+				u.gprIn = 1 << rt;
+				u.gprOut = 1 << rd;
+				u.pure = true;
+				break;
+			case 4: case 6: case 7: // sllv, srlv, srav
+			case 32: case 33: case 34: case 35: case 36: case 37: case 38: case 39: // add ... nor
+			case 42: case 43: case 44: case 45: // slt, sltu, max, min
+				u.gprIn = (1 << rs) | (1 << rt);
+				u.gprOut = 1 << rd;
+				u.pure = true;
+				break;
+			case 10: case 11: // movz, movn - rd is kept if the condition fails.
+				u.gprIn = (1 << rs) | (1 << rt) | (1 << rd);
+				u.gprOut = 1 << rd;
+				u.pure = true;
+				break;
+			case 22: case 23: // clz, clo
+				u.gprIn = 1 << rs;
+				u.gprOut = 1 << rd;
+				u.pure = true;
+				break;
+			case 16: case 18: // mfhi, mflo
+				u.gprOut = 1 << rd;
+				u.pure = true;
+				break;
+			case 17: case 19: // mthi, mtlo
+				u.gprIn = 1 << rs;
+				break;
+			case 24: case 25: case 26: case 27: case 28: case 29: case 46: case 47: // mult ... msubu
+				u.gprIn = (1 << rs) | (1 << rt);
+				break;
+			case 8: // jr
+				u.gprIn = 1 << rs;
+				u.branch = true;
+				break;
+			case 9: // jalr
+				u.gprIn = 1 << rs;
+				u.gprOut = 1 << rd;
+				u.branch = true;
+				break;
+			default:
+				u.opaque = true;
+				break;
+			}
+			break;
+
+		case 1: // regimm branches
+			u.gprIn = 1 << rs;
+			if (rt & 0x10)
+				u.gprOut = 1 << MIPS_REG_RA;
+			u.branch = true;
+			break;
+
+		case 2: // j
+			u.branch = true;
+			break;
+		case 3: // jal
+			u.gprOut = 1 << MIPS_REG_RA;
+			u.branch = true;
+			break;
+
+		case 4: case 5: case 20: case 21: // beq, bne, beql, bnel
+			u.gprIn = (1 << rs) | (1 << rt);
+			u.branch = true;
+			break;
+		case 6: case 7: case 22: case 23: // blez, bgtz, blezl, bgtzl
+			u.gprIn = 1 << rs;
+			u.branch = true;
+			break;
+
+		case 8: case 9: case 10: case 11: case 12: case 13: case 14: // addi ... xori
+			u.gprIn = 1 << rs;
+			u.gprOut = 1 << rt;
+			u.pure = true;
+			break;
+		case 15: // lui
+			u.gprOut = 1 << rt;
+			u.pure = true;
+			break;
+
+		case 17: // cop1
+			switch (rs)
+			{
+			case 0: // mfc1
+				u.fprIn = 1 << MIPS_GET_FS(op);
+				u.gprOut = 1 << rt;
+				u.pure = true;
+				break;
+			case 4: // mtc1
+				u.gprIn = 1 << rt;
+				u.fprOut = 1 << MIPS_GET_FS(op);
+				u.pure = true;
+				break;
+			case 8: // bc1
+				u.branch = true;
+				break;
+			case 16: // s
 				{
-					if (regAnal[reg].firstReadAsAddr == -1)
-						regAnal[reg].firstReadAsAddr = addr;
-					regAnal[reg].lastReadAsAddr = addr;
-					regAnal[reg].readAsAddrCount++;
-					regAnal[reg].used=true;
+					int funct = op & 0x3F;
+					if (funct < 4) // add, sub, mul, div
+					{
+						u.fprIn = (1 << MIPS_GET_FS(op)) | (1 << MIPS_GET_FT(op));
+						u.fprOut = 1 << MIPS_GET_FD(op);
+						u.pure = true;
+					}
+					else if (funct < 8 || (funct >= 12 && funct < 16) || funct == 36) // sqrt, abs, mov, neg, round ... floor, cvt.w.s
+					{
+						u.fprIn = 1 << MIPS_GET_FS(op);
+						u.fprOut = 1 << MIPS_GET_FD(op);
+						u.pure = true;
+					}
+					else if (funct >= 48) // c.cond
+						u.fprIn = (1 << MIPS_GET_FS(op)) | (1 << MIPS_GET_FT(op));
+					else
+						u.opaque = true;
 				}
-				if (
-					((info & OUT_RT) && (rt == reg)) ||
-					((info & OUT_RD) && (rd == reg)) ||
-					((info & OUT_RA) && (reg == MIPS_REG_RA))
-					)
+				break;
+			case 20: // w
+				if ((op & 0x3F) == 32) // cvt.s.w
 				{
-					if (regAnal[reg].firstWrite == -1)
-						regAnal[reg].firstWrite = addr;
-					regAnal[reg].lastWrite = addr;
-					regAnal[reg].writeCount++;
-					regAnal[reg].used=true;
+					u.fprIn = 1 << MIPS_GET_FS(op);
+					u.fprOut = 1 << MIPS_GET_FD(op);
+					u.pure = true;
 				}
+				else
+					u.opaque = true;
+				break;
+			default:
+				u.opaque = true;
+				break;
 			}
+			break;
 
-			if (exitFlag) //delay slot done, let's quit!
+		case 31: // special3
+			switch (op & 0x3F)
+			{
+			case 0: // ext
+				u.gprIn = 1 << rs;
+				u.gprOut = 1 << rt;
+				u.pure = true;
 				break;
+			case 4: // ins
+				u.gprIn = (1 << rs) | (1 << rt);
+				u.gprOut = 1 << rt;
+				u.pure = true;
+				break;
+			default:
+				u.opaque = true;
+				break;
+			}
+			break;
+
+		case 32: case 33: case 35: case 36: case 37: // lb, lh, lw, lbu, lhu
+			u.gprIn = 1 << rs;
+			u.gprOut = 1 << rt;
+			u.memAccess = true;
+			break;
+		case 34: case 38: // lwl, lwr
+			u.gprIn = (1 << rs) | (1 << rt);
+			u.gprOut = 1 << rt;
+			u.memAccess = true;
+			break;
+		case 40: case 41: case 42: case 43: case 46: // sb, sh, swl, sw, swr
+			u.gprIn = (1 << rs) | (1 << rt);
+			u.memAccess = true;
+			break;
+		case 49: // lwc1
+			u.gprIn = 1 << rs;
+			u.fprOut = 1 << MIPS_GET_FT(op);
+			u.memAccess = true;
+			break;
+		case 57: // swc1
+			u.gprIn = 1 << rs;
+			u.fprIn = 1 << MIPS_GET_FT(op);
+			u.memAccess = true;
+			break;
+
+		default:
+			u.opaque = true;
+			break;
+		}
+
+		// Other bits of the state can still depend on these, so keep them as they are.
+		if (u.opaque)
+		{
+			u.gprIn = 0xFFFFFFFF;
+			u.fprIn = 0xFFFFFFFF;
+		}
+		return u;
+	}
+
+	static bool PropagateConstant(u32 op, u32 &knownMask, u32 values[32])
+	{
+		int rs = MIPS_GET_RS(op);
+		int rt = MIPS_GET_RT(op);
+		int rd = MIPS_GET_RD(op);
+		bool rsKnown = (knownMask & (1 << rs)) != 0;
+		bool rtKnown = (knownMask & (1 << rt)) != 0;
+		s32 simm = (s16)(op & 0xFFFF);
+		u32 uimm = op & 0xFFFF;
+
+		switch (op >> 26)
+		{
+		case 9: // addiu
+		case 8: // addi
+			if (!rsKnown)
+				return false;
+			values[rt] = values[rs] + simm;
+			break;
+		case 12: // andi
+			if (!rsKnown)
+				return false;
+			values[rt] = values[rs] & uimm;
+			break;
+		case 13: // ori
+			if (!rsKnown)
+				return false;
+			values[rt] = values[rs] | uimm;
+			break;
+		case 14: // xori
+			if (!rsKnown)
+				return false;
+			values[rt] = values[rs] ^ uimm;
+			break;
+		case 15: // lui
+			values[rt] = uimm << 16;
+			break;
+		case 0:
+			if (!rsKnown || !rtKnown)
+				return false;
+			switch (op & 0x3F)
+			{
+			case 32: case 33: values[rd] = values[rs] + values[rt]; break; // add, addu
+			case 34: case 35: values[rd] = values[rs] - values[rt]; break; // sub, subu
+			case 36: values[rd] = values[rs] & values[rt]; break; // and
+			case 37: values[rd] = values[rs] | values[rt]; break; // or
+			case 38: values[rd] = values[rs] ^ values[rt]; break; // xor
+			default:
+				return false;
+			}
+			return true;
+		default:
+			return false;
+		}
+		return true;
+	}
+
+	void Analyze(u32 address, AnalysisResults &results)
+	{
+		RegUsage usage[AnalysisResults::MAX_ANALYZED_OPS];
+
+		results.start = address;
+		results.numOps = 0;
 
-			if ((info & IS_JUMP) || (info & IS_CONDBRANCH))
+		// Forward: decode and propagate constants, until the op after the first branch.
+		u32 knownMask = 1;
+		u32 values[32] = {0};
+		bool exitFlag = false;
+		for (u32 addr = address; results.numOps < AnalysisResults::MAX_ANALYZED_OPS; addr += 4)
+		{
+			u32 op = Memory::Read_Instruction(addr);
+			int i = results.numOps++;
+			OpAnalysis &info = results.ops[i];
+			RegUsage &u = usage[i];
+			u = GetRegUsage(op);
+
+			info.hasKnownAddress = false;
+			if (u.memAccess && (knownMask & (1 << MIPS_GET_RS(op))))
+			{
+				info.hasKnownAddress = true;
+				info.knownAddress = values[MIPS_GET_RS(op)] + (s16)(op & 0xFFFF);
+			}
+
+			if (u.opaque)
+				knownMask = 1;
+			else if (u.gprOut != 0)
 			{
-				exitFlag = true; // now do the delay slot
+				if (PropagateConstant(op, knownMask, values))
+					knownMask |= u.gprOut;
+				else
+					knownMask &= ~u.gprOut;
+				knownMask |= 1;
+				values[0] = 0;
 			}
 
-			addr += 4;
+			// Syscalls end the block too, without a delay slot.
+			if (exitFlag || ((op >> 26) == 0 && (op & 0x3F) == 12))
+				break;
+			if (u.branch)
+				exitFlag = true;
 		}
 
-		int numUsedRegs=0;
-		static int totalUsedRegs=0;
-		static int numAnalyzings=0;
-		for (int i=0; i<32; i++)
+		// Backward: liveness. Whatever comes after the block may read anything.
+		// The branch and its delay slot are compiled together, so they get it all too.
+		u32 gprLive = 0xFFFFFFFF;
+		u32 fprLive = 0xFFFFFFFF;
+		for (int i = results.numOps - 1; i >= 0; i--)
 		{
-			if (regAnal[i].used) 
-				numUsedRegs++;
+			OpAnalysis &info = results.ops[i];
+			const RegUsage &u = usage[i];
+
+			bool inBranch = u.branch || (i > 0 && usage[i - 1].branch);
+			info.dead = !inBranch && u.pure && (u.gprOut & gprLive) == 0 && (u.fprOut & fprLive) == 0;
+			if (inBranch)
+			{
+				gprLive = 0xFFFFFFFF;
+				fprLive = 0xFFFFFFFF;
+			}
+			else if (!info.dead)
+			{
+				// Live while it runs: its inputs, and its outputs if anyone reads them later.
+				u32 gprOutLive = gprLive & u.gprOut;
+				u32 fprOutLive = fprLive & u.fprOut;
+				// r0 always reads as zero from the register file, so keep it there.
+				gprLive = (gprLive & ~u.gprOut) | u.gprIn | 1;
+				fprLive = (fprLive & ~u.fprOut) | u.fprIn;
+				info.gprLive = gprLive | gprOutLive;
+				info.fprLive = fprLive | fprOutLive;
+				continue;
+			}
+			// Dead ops are skipped, so they don't keep anything alive.
+			info.gprLive = gprLive;
+			info.fprLive = fprLive;
+		}
+
+		results.idleLoop = IsIdleLoop(address);
+	}
+
+	// Static target of a branch that doesn't link, or 0 if it has none.
+	static u32 GetLoopBranchTarget(u32 addr, u32 op)
+	{
+		switch (op >> 26)
+		{
+		case 1: // regimm
+			if ((MIPS_GET_RT(op) & 0x10) != 0) // and link
+				return 0;
+			return addr + 4 + ((s16)(op & 0xFFFF) << 2);
+		case 4: case 5: case 6: case 7: // beq, bne, blez, bgtz
+		case 20: case 21: case 22: case 23: // and likely
+			return addr + 4 + ((s16)(op & 0xFFFF) << 2);
+		case 2: // j
+			return ((addr + 4) & 0xF0000000) | ((op & 0x03FFFFFF) << 2);
+		default:
+			return 0;
 		}
-		totalUsedRegs+=numUsedRegs;
-		numAnalyzings++;
-		DEBUG_LOG(CPU,"[ %08x ] Used regs: %i	 Average: %f",address,numUsedRegs,(float)totalUsedRegs/(float)numAnalyzings);
 	}
 
+	bool IsIdleLoop(u32 address, u32 *branchAddress)
+	{
+		if (!Memory::IsValidAddress(address) || !Memory::IsValidAddress(address + MAX_IDLE_LOOP_OPS * 4 - 4))
+			return false;
+
+		RegUsage usage[MAX_IDLE_LOOP_OPS];
+		int numOps = 0;
+		int branchOp = -1;
+		u32 branchAddr = 0;
+		u32 gprWritten = 0, fprWritten = 0;
+		for (u32 addr = address; numOps < MAX_IDLE_LOOP_OPS; addr += 4)
+		{
+			u32 op = Memory::Read_Instruction(addr);
+			RegUsage &u = usage[numOps++];
+			u = GetRegUsage(op);
+
+			if (u.branch)
+			{
+				if (branchOp >= 0 || GetLoopBranchTarget(addr, op) != address)
+					return false;
+				branchOp = numOps - 1;
+				branchAddr = addr;
+			}
+			// Loads are fine, anything else must only write registers.
+			else if (!u.pure && !(u.memAccess && (u.gprOut | u.fprOut) != 0))
+				return false;
+
+			gprWritten |= u.gprOut;
+			fprWritten |= u.fprOut;
+			if (branchOp >= 0 && numOps > branchOp + 1)
+				break;
+		}
+		if (branchOp < 0 || numOps != branchOp + 2)
+			return false;
+
+		// Every register the loop writes must be written before it's read in the same
+		// iteration, otherwise each iteration depends on the last (like a delay loop.)
+		gprWritten &= ~1;
+		u32 gprSoFar = 0, fprSoFar = 0;
+		for (int i = 0; i < numOps; i++)
+		{
+			const RegUsage &u = usage[i];
+			if ((u.gprIn & gprWritten & ~gprSoFar) != 0 || (u.fprIn & fprWritten & ~fprSoFar) != 0)
+				return false;
+			gprSoFar |= u.gprOut;
+			fprSoFar |= u.fprOut;
+		}
+		if (branchAddress)
+			*branchAddress = branchAddr;
+		return true;
+	}
 
 	struct Function
 	{
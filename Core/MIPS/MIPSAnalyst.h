@@ -21,7 +21,6 @@
 
 namespace MIPSAnalyst
 {
-	void Analyze(u32 address);
 	struct RegisterAnalysisResults
 	{
 		bool used;
@@ -42,11 +41,78 @@ namespace MIPSAnalyst
 		int LastRead() {return lastReadAsAddr > lastRead ? lastReadAsAddr : lastRead;}
 	};
 
+	struct OpAnalysis
+	{
+		// Registers whose current value may still be needed while this instruction runs:
+		// read by it, or written by it and read later before being overwritten.
+		u32 gprLive;
+		u32 fprLive;
+		// Known base + offset of a load or store, found by constant propagation.
+		u32 knownAddress;
+		bool hasKnownAddress;
+		// Only writes registers that are overwritten before anyone reads them.
+		bool dead;
+	};
+
+	// Dataflow results for a single block, as the jit would compile it.
+	// Anything not covered (past the end or unknown instructions) counts as all live.
 	struct AnalysisResults
 	{
-		int x;
+		enum
+		{
+			MAX_ANALYZED_OPS = 256,
+		};
+
+		u32 start;
+		int numOps;
+		// The block is an idle loop, see IsIdleLoop.
+		bool idleLoop;
+		OpAnalysis ops[MAX_ANALYZED_OPS];
+
+		const OpAnalysis *GetOp(u32 addr) const
+		{
+			u32 index = (addr - start) / 4;
+			return index < (u32)numOps ? &ops[index] : 0;
+		}
+		bool IsGPRLive(u32 addr, int reg) const
+		{
+			const OpAnalysis *op = GetOp(addr);
+			return !op || (op->gprLive & (1 << reg)) != 0;
+		}
+		bool IsFPRLive(u32 addr, int reg) const
+		{
+			const OpAnalysis *op = GetOp(addr);
+			return !op || (op->fprLive & (1 << reg)) != 0;
+		}
+		bool IsDeadOp(u32 addr) const
+		{
+			const OpAnalysis *op = GetOp(addr);
+			return op && op->dead;
+		}
+		bool GetKnownAddress(u32 addr, u32 &address) const
+		{
+			const OpAnalysis *op = GetOp(addr);
+			if (!op || !op->hasKnownAddress)
+				return false;
+			address = op->knownAddress;
+			return true;
+		}
+	};
+
+	void Analyze(u32 address, AnalysisResults &results);
+
+	enum
+	{
+		MAX_IDLE_LOOP_OPS = 8,
 	};
 
+	// A short loop starting at address that only loads, computes and branches back.
+	// No stores, calls or syscalls, and nothing it computes depends on the previous
+	// iteration, so it keeps doing the same thing until memory changes. Nothing else runs
+	// before the next CoreTiming event, so that can be skipped to right away.
+	// If branchAddress is given, it gets the address of the loop's branch.
+	bool IsIdleLoop(u32 address, u32 *branchAddress = 0);
+
 	bool IsRegisterUsed(u32 reg, u32 addr);
 	void ScanForFunctions(u32 startAddr, u32 endAddr);
 	void CompileLeafs();
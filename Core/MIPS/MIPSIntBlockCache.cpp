@@ -0,0 +1,378 @@
+// Copyright (c) 2012- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#include "Common.h"
+#include "MIPS.h"
+#include "MIPSTables.h"
+#include "MIPSIntBlockCache.h"
+#include "MIPSAnalyst.h"
+#include "JitCommon/JitCommon.h"
+#include "../MemMap.h"
+#include "../../Core/CoreTiming.h"
+
+IntBlockCache intBlockCache;
+
+#define R(i) (mips->r[i])
+
+static inline void DelayBranchTo(MIPSState *mips, u32 where)
+{
+	mips->pc += 4;
+	mips->nextPC = where;
+	mips->inDelaySlot = true;
+}
+
+// Anything we don't have a specialized handler for goes through the regular
+// interpreter function, which was looked up once when the block was decoded.
+static void Blk_Generic(MIPSState *mips, const IntBlockOp &op) { op.interpret(op.op); }
+static void Blk_Unknown(MIPSState *mips, const IntBlockOp &op) { MIPSInterpret(op.op); }
+static void Blk_Nop(MIPSState *mips, const IntBlockOp &op) { mips->pc += 4; }
+
+// Immediates
+static void Blk_Addiu(MIPSState *mips, const IntBlockOp &op) { R(op.rt) = R(op.rs) + op.simm; mips->pc += 4; }
+static void Blk_Slti(MIPSState *mips, const IntBlockOp &op)  { R(op.rt) = (s32)R(op.rs) < op.simm; mips->pc += 4; }
+static void Blk_Sltiu(MIPSState *mips, const IntBlockOp &op) { R(op.rt) = R(op.rs) < op.uimm; mips->pc += 4; }
+static void Blk_Andi(MIPSState *mips, const IntBlockOp &op)  { R(op.rt) = R(op.rs) & op.uimm; mips->pc += 4; }
+static void Blk_Ori(MIPSState *mips, const IntBlockOp &op)   { R(op.rt) = R(op.rs) | op.uimm; mips->pc += 4; }
+static void Blk_Xori(MIPSState *mips, const IntBlockOp &op)  { R(op.rt) = R(op.rs) ^ op.uimm; mips->pc += 4; }
+static void Blk_Lui(MIPSState *mips, const IntBlockOp &op)   { R(op.rt) = op.uimm; mips->pc += 4; }
+
+// Three-register ALU
+static void Blk_Addu(MIPSState *mips, const IntBlockOp &op) { R(op.rd) = R(op.rs) + R(op.rt); mips->pc += 4; }
+static void Blk_Subu(MIPSState *mips, const IntBlockOp &op) { R(op.rd) = R(op.rs) - R(op.rt); mips->pc += 4; }
+static void Blk_And(MIPSState *mips, const IntBlockOp &op)  { R(op.rd) = R(op.rs) & R(op.rt); mips->pc += 4; }
+static void Blk_Or(MIPSState *mips, const IntBlockOp &op)   { R(op.rd) = R(op.rs) | R(op.rt); mips->pc += 4; }
+static void Blk_Xor(MIPSState *mips, const IntBlockOp &op)  { R(op.rd) = R(op.rs) ^ R(op.rt); mips->pc += 4; }
+static void Blk_Nor(MIPSState *mips, const IntBlockOp &op)  { R(op.rd) = ~(R(op.rs) | R(op.rt)); mips->pc += 4; }
+static void Blk_Slt(MIPSState *mips, const IntBlockOp &op)  { R(op.rd) = (s32)R(op.rs) < (s32)R(op.rt); mips->pc += 4; }
+static void Blk_Sltu(MIPSState *mips, const IntBlockOp &op) { R(op.rd) = R(op.rs) < R(op.rt); mips->pc += 4; }
+static void Blk_Movz(MIPSState *mips, const IntBlockOp &op) { if (R(op.rt) == 0) R(op.rd) = R(op.rs); mips->pc += 4; }
+static void Blk_Movn(MIPSState *mips, const IntBlockOp &op) { if (R(op.rt) != 0) R(op.rd) = R(op.rs); mips->pc += 4; }
+
+// Shifts
+static void Blk_Sll(MIPSState *mips, const IntBlockOp &op)  { R(op.rd) = R(op.rt) << op.sa; mips->pc += 4; }
+static void Blk_Srl(MIPSState *mips, const IntBlockOp &op)  { R(op.rd) = R(op.rt) >> op.sa; mips->pc += 4; }
+static void Blk_Sra(MIPSState *mips, const IntBlockOp &op)  { R(op.rd) = (u32)((s32)R(op.rt) >> op.sa); mips->pc += 4; }
+static void Blk_Sllv(MIPSState *mips, const IntBlockOp &op) { R(op.rd) = R(op.rt) << (R(op.rs) & 0x1F); mips->pc += 4; }
+static void Blk_Srlv(MIPSState *mips, const IntBlockOp &op) { R(op.rd) = R(op.rt) >> (R(op.rs) & 0x1F); mips->pc += 4; }
+static void Blk_Srav(MIPSState *mips, const IntBlockOp &op) { R(op.rd) = (u32)((s32)R(op.rt) >> (R(op.rs) & 0x1F)); mips->pc += 4; }
+
+// Loads and stores. Like the fast interpreter, these skip the address checks.
+static void Blk_Lb(MIPSState *mips, const IntBlockOp &op)  { R(op.rt) = (u32)(s32)(s8)Memory::ReadUnchecked_U8(R(op.rs) + op.simm); mips->pc += 4; }
+static void Blk_Lh(MIPSState *mips, const IntBlockOp &op)  { R(op.rt) = (u32)(s32)(s16)Memory::ReadUnchecked_U16(R(op.rs) + op.simm); mips->pc += 4; }
+static void Blk_Lw(MIPSState *mips, const IntBlockOp &op)  { R(op.rt) = Memory::ReadUnchecked_U32(R(op.rs) + op.simm); mips->pc += 4; }
+static void Blk_Lbu(MIPSState *mips, const IntBlockOp &op) { R(op.rt) = Memory::ReadUnchecked_U8(R(op.rs) + op.simm); mips->pc += 4; }
+static void Blk_Lhu(MIPSState *mips, const IntBlockOp &op) { R(op.rt) = Memory::ReadUnchecked_U16(R(op.rs) + op.simm); mips->pc += 4; }
+static void Blk_Sb(MIPSState *mips, const IntBlockOp &op)  { Memory::WriteUnchecked_U8(R(op.rt), R(op.rs) + op.simm); mips->pc += 4; }
+static void Blk_Sh(MIPSState *mips, const IntBlockOp &op)  { Memory::WriteUnchecked_U16(R(op.rt), R(op.rs) + op.simm); mips->pc += 4; }
+static void Blk_Sw(MIPSState *mips, const IntBlockOp &op)  { Memory::WriteUnchecked_U32(R(op.rt), R(op.rs) + op.simm); mips->pc += 4; }
+
+// Branches and jumps (not the likely variants, those go through Int_RelBranch.)
+static void Blk_Beq(MIPSState *mips, const IntBlockOp &op)  { if (R(op.rt) == R(op.rs)) DelayBranchTo(mips, op.target); else mips->pc += 4; }
+static void Blk_Bne(MIPSState *mips, const IntBlockOp &op)  { if (R(op.rt) != R(op.rs)) DelayBranchTo(mips, op.target); else mips->pc += 4; }
+static void Blk_Blez(MIPSState *mips, const IntBlockOp &op) { if ((s32)R(op.rs) <= 0) DelayBranchTo(mips, op.target); else mips->pc += 4; }
+static void Blk_Bgtz(MIPSState *mips, const IntBlockOp &op) { if ((s32)R(op.rs) > 0) DelayBranchTo(mips, op.target); else mips->pc += 4; }
+static void Blk_Bltz(MIPSState *mips, const IntBlockOp &op) { if ((s32)R(op.rs) < 0) DelayBranchTo(mips, op.target); else mips->pc += 4; }
+static void Blk_Bgez(MIPSState *mips, const IntBlockOp &op) { if ((s32)R(op.rs) >= 0) DelayBranchTo(mips, op.target); else mips->pc += 4; }
+static void Blk_J(MIPSState *mips, const IntBlockOp &op)    { DelayBranchTo(mips, op.target); }
+static void Blk_Jal(MIPSState *mips, const IntBlockOp &op)  { R(MIPS_REG_RA) = mips->pc + 8; DelayBranchTo(mips, op.target); }
+static void Blk_Jr(MIPSState *mips, const IntBlockOp &op)   { DelayBranchTo(mips, R(op.rs)); }
+
+// Ops with a delay slot. The block ends after the delay slot.
+static bool IsBranch(u32 op)
+{
+	switch (op >> 26)
+	{
+	case 0: return (op & 0x3F) == 8 || (op & 0x3F) == 9;  // jr, jalr
+	case 1: return (((op >> 16) & 0x1F) & ~0x13) == 0;     // bltz, bgez, bltzl, bgezl, bltzal, ...
+	case 2: case 3: return true;                           // j, jal
+	case 4: case 5: case 6: case 7: return true;           // beq, bne, blez, bgtz
+	case 20: case 21: case 22: case 23: return true;       // likely variants
+	case 17: case 18: return ((op >> 21) & 0x1F) == 8;    // bc1*, bv*
+	default: return false;
+	}
+}
+
+static bool EndsBlockImmediately(u32 op)
+{
+	// syscall and break
+	if ((op & 0xFC00003E) == 0x0000000C)
+		return true;
+	// cop0 (eret etc) and our own emuhacks can go anywhere.
+	if ((op >> 26) == 16 || MIPS_IS_EMUHACK(op))
+		return true;
+	return false;
+}
+
+static void DecodeOp(u32 address, u32 op, IntBlockOp &out)
+{
+	out.op = op;
+	out.interpret = MIPSGetInterpretFunc(op);
+	out.func = out.interpret ? &Blk_Generic : &Blk_Unknown;
+	out.rs = (op >> 21) & 0x1F;
+	out.rt = (op >> 16) & 0x1F;
+	out.rd = (op >> 11) & 0x1F;
+	out.sa = (op >> 6) & 0x1F;
+	out.simm = (s32)(s16)(op & 0xFFFF);
+
+	u32 branchTarget = address + 4 + ((s32)(s16)(op & 0xFFFF) << 2);
+	switch (op >> 26)
+	{
+	case 0:
+		{
+			if ((op & 0x3F) == 8 && out.sa == 0)
+			{
+				out.func = &Blk_Jr;
+				break;
+			}
+			// The remaining specials we handle all write rd.
+			IntBlockFunc func = 0;
+			switch (op & 0x3F)
+			{
+			case 0: func = &Blk_Sll; break;
+			case 2: if (out.rs == 0) func = &Blk_Srl; break;  // not rotr
+			case 3: func = &Blk_Sra; break;
+			case 4: func = &Blk_Sllv; break;
+			case 6: if (out.sa == 0) func = &Blk_Srlv; break; // not rotrv
+			case 7: func = &Blk_Srav; break;
+			case 10: func = &Blk_Movz; break;
+			case 11: func = &Blk_Movn; break;
+			case 33: func = &Blk_Addu; break;
+			case 35: func = &Blk_Subu; break;
+			case 36: func = &Blk_And; break;
+			case 37: func = &Blk_Or; break;
+			case 38: func = &Blk_Xor; break;
+			case 39: func = &Blk_Nor; break;
+			case 42: func = &Blk_Slt; break;
+			case 43: func = &Blk_Sltu; break;
+			}
+			if (func)
+				out.func = out.rd == 0 ? &Blk_Nop : func;
+		}
+		break;
+
+	case 1:
+		out.target = branchTarget;
+		if (out.rt == 0)
+			out.func = &Blk_Bltz;
+		else if (out.rt == 1)
+			out.func = &Blk_Bgez;
+		break;
+
+	case 2: out.target = (address & 0xF0000000) | ((op & 0x03FFFFFF) << 2); out.func = &Blk_J; break;
+	case 3: out.target = (address & 0xF0000000) | ((op & 0x03FFFFFF) << 2); out.func = &Blk_Jal; break;
+	case 4: out.target = branchTarget; out.func = &Blk_Beq; break;
+	case 5: out.target = branchTarget; out.func = &Blk_Bne; break;
+	case 6: out.target = branchTarget; out.func = &Blk_Blez; break;
+	case 7: out.target = branchTarget; out.func = &Blk_Bgtz; break;
+
+	case 8:
+	case 9:  out.func = out.rt == 0 ? &Blk_Nop : &Blk_Addiu; break;
+	case 10: out.func = out.rt == 0 ? &Blk_Nop : &Blk_Slti; break;
+	case 11: out.uimm = (u32)out.simm; out.func = out.rt == 0 ? &Blk_Nop : &Blk_Sltiu; break;
+	case 12: out.uimm = op & 0xFFFF; out.func = out.rt == 0 ? &Blk_Nop : &Blk_Andi; break;
+	case 13: out.uimm = op & 0xFFFF; out.func = out.rt == 0 ? &Blk_Nop : &Blk_Ori; break;
+	case 14: out.uimm = op & 0xFFFF; out.func = out.rt == 0 ? &Blk_Nop : &Blk_Xori; break;
+	case 15: out.uimm = (op & 0xFFFF) << 16; out.func = out.rt == 0 ? &Blk_Nop : &Blk_Lui; break;
+
+	case 32: out.func = out.rt == 0 ? &Blk_Nop : &Blk_Lb; break;
+	case 33: out.func = out.rt == 0 ? &Blk_Nop : &Blk_Lh; break;
+	case 35: out.func = out.rt == 0 ? &Blk_Nop : &Blk_Lw; break;
+	case 36: out.func = out.rt == 0 ? &Blk_Nop : &Blk_Lbu; break;
+	case 37: out.func = out.rt == 0 ? &Blk_Nop : &Blk_Lhu; break;
+	case 40: out.func = &Blk_Sb; break;
+	case 41: out.func = &Blk_Sh; break;
+	case 43: out.func = &Blk_Sw; break;
+	}
+}
+
+IntBlockCache::IntBlockCache()
+{
+	memset(fastLookup_, -1, sizeof(fastLookup_));
+}
+
+void IntBlockCache::Clear()
+{
+	// Note: clear() keeps the capacity, so ops of a block that is currently
+	// running (one that ended in a syscall that cleared the cache) stay readable.
+	blocks_.clear();
+	ops_.clear();
+	block_map_.clear();
+	memset(fastLookup_, -1, sizeof(fastLookup_));
+}
+
+IntBlock *IntBlockCache::GetOrCompile(u32 em_address)
+{
+	int block_num = fastLookup_[FastLookupIndex(em_address)];
+	if (block_num >= 0 && blocks_[block_num].originalAddress == em_address)
+		return &blocks_[block_num];
+
+	std::map<u32, int>::iterator iter = block_map_.find(em_address & 0x1FFFFFFF);
+	if (iter != block_map_.end())
+	{
+		block_num = iter->second;
+		// Same physical code, but reached through a different mirror. Targets might differ.
+		if (blocks_[block_num].originalAddress != em_address)
+		{
+			DestroyBlock(block_num);
+			block_num = Compile(em_address);
+		}
+	}
+	else
+		block_num = Compile(em_address);
+
+	if (block_num < 0)
+		return 0;
+	fastLookup_[FastLookupIndex(em_address)] = block_num;
+	return &blocks_[block_num];
+}
+
+int IntBlockCache::Compile(u32 em_address)
+{
+	if (ops_.size() + MAX_BLOCK_INSTRUCTIONS > MAX_OPS)
+		Clear();
+
+	IntBlock b;
+	b.originalAddress = em_address;
+	b.firstOp = (int)ops_.size();
+	b.numOps = 0;
+	b.cycles = 0;
+	b.runCount = 0;
+	b.idleLoop = MIPSAnalyst::IsIdleLoop(em_address);
+	b.invalid = false;
+
+	u32 addr = em_address;
+	bool delaySlot = false;
+	while (b.numOps < MAX_BLOCK_INSTRUCTIONS && Memory::IsValidAddress(addr))
+	{
+		u32 op = Memory::Read_Instruction(addr);
+		IntBlockOp decoded;
+		DecodeOp(addr, op, decoded);
+		b.numOps++;
+		b.cycles += MIPSGetInstructionCycleEstimate(op);
+		decoded.cyclesSoFar = b.cycles;
+		ops_.push_back(decoded);
+		addr += 4;
+
+		if (delaySlot || EndsBlockImmediately(op))
+			break;
+		delaySlot = IsBranch(op);
+	}
+
+	if (b.numOps == 0)
+		return -1;
+
+	int block_num = (int)blocks_.size();
+	blocks_.push_back(b);
+	block_map_[em_address & 0x1FFFFFFF] = block_num;
+	return block_num;
+}
+
+void IntBlockCache::DestroyBlock(int block_num)
+{
+	IntBlock &b = blocks_[block_num];
+	if (b.invalid)
+		return;
+	b.invalid = true;
+	block_map_.erase(b.originalAddress & 0x1FFFFFFF);
+	int &fast = fastLookup_[FastLookupIndex(b.originalAddress)];
+	if (fast == block_num)
+		fast = -1;
+}
+
+void IntBlockCache::InvalidateICache(u32 address, const u32 length)
+{
+	// Convert the logical address to a physical address for the block map
+	u32 pAddr = address & 0x1FFFFFFF;
+	u32 maxBlockSize = MAX_BLOCK_INSTRUCTIONS * 4;
+	u32 searchStart = pAddr > maxBlockSize ? pAddr - maxBlockSize : 0;
+
+	std::map<u32, int>::iterator iter = block_map_.lower_bound(searchStart);
+	while (iter != block_map_.end() && iter->first < pAddr + length)
+	{
+		// Advance first, DestroyBlock erases from the map.
+		int block_num = iter->second;
+		++iter;
+		const IntBlock &b = blocks_[block_num];
+		if ((b.originalAddress & 0x1FFFFFFF) + 4 * b.numOps > pAddr)
+			DestroyBlock(block_num);
+	}
+}
+
+void MIPSInterpret_RunBlock(MIPSState *curMips, const IntBlock *block)
+{
+	if (!block)
+	{
+		// We're entering in a delay slot (from the debugger probably) or memory is bad.
+		// Step one op with the normal interpreter, it knows how to handle both.
+		bool wasInDelaySlot = curMips->inDelaySlot;
+		MIPSInterpret(Memory::Read_Instruction(curMips->pc));
+		if (curMips->inDelaySlot && wasInDelaySlot)
+		{
+			curMips->pc = curMips->nextPC;
+			curMips->inDelaySlot = false;
+		}
+		CoreTiming::downcount -= 1;
+		return;
+	}
+
+	const IntBlockOp *begin = intBlockCache.GetOps(block);
+	const IntBlockOp *end = begin + block->numOps;
+	const IntBlockOp *op = begin;
+	u32 expectedPC = block->originalAddress;
+	for (; op != end; ++op)
+	{
+		bool wasInDelaySlot = curMips->inDelaySlot;
+		op->func(curMips, *op);
+		expectedPC += 4;
+
+		if (curMips->inDelaySlot)
+		{
+			if (!wasInDelaySlot)
+				continue;
+			// The delay slot is always the last op of the block.
+			curMips->pc = curMips->nextPC;
+			curMips->inDelaySlot = false;
+			if (block->idleLoop && curMips->pc == block->originalAddress)
+				CoreTiming::Idle();
+			break;
+		}
+		// Not-taken likely branches, syscalls that rescheduled, etc.
+		if (curMips->pc != expectedPC)
+			break;
+	}
+
+	if (op == end)
+		CoreTiming::downcount -= block->cycles;
+	else
+		CoreTiming::downcount -= op->cyclesSoFar;
+}
+
+int MIPSInterpret_RunBlocksUntil(u64 globalTicks)
+{
+	MIPSState *curMips = currentMIPS;
+	while (coreState == CORE_RUNNING)
+	{
+		while (CoreTiming::downcount >= 0 && coreState == CORE_RUNNING)
+		{
+			const IntBlock *block = curMips->inDelaySlot ? 0 : intBlockCache.GetOrCompile(curMips->pc);
+			MIPSInterpret_RunBlock(curMips, block);
+		}
+
+		CoreTiming::Advance();
+	}
+	return 1;
+}
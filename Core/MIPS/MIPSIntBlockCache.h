@@ -0,0 +1,110 @@
+// Copyright (c) 2012- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#pragma once
+
+#include <map>
+#include <vector>
+
+#include "../../Globals.h"
+#include "MIPSTables.h"
+
+// Block interpreter for jit-less platforms.
+// Each basic block is decoded once into an array of IntBlockOps, each holding a
+// direct pointer to a small handler plus the operands already extracted from the
+// opcode. Running a block is then just a walk over that array calling the handlers,
+// with no table lookups or re-decoding.
+
+class MIPSState;
+struct IntBlockOp;
+
+typedef void (*IntBlockFunc)(MIPSState *mips, const IntBlockOp &op);
+
+struct IntBlockOp
+{
+	IntBlockFunc func;
+	// Used by the generic handler, which simply calls the regular interpreter.
+	MIPSInterpretFunc interpret;
+	u32 op;
+	union
+	{
+		s32 simm;
+		u32 uimm;
+		u32 target;	// branch and jump targets are resolved at decode time
+	};
+	u8 rs;
+	u8 rt;
+	u8 rd;
+	u8 sa;
+	// Cycle estimate of the block from its start up to and including this op,
+	// charged when the block is left early here.
+	int cyclesSoFar;
+};
+
+struct IntBlock
+{
+	u32 originalAddress;
+	int firstOp;
+	int numOps;
+	int cycles;
+	// Only counted by the tiered jit, which compiles blocks once they get hot.
+	int runCount;
+	// Loops back to itself without doing anything, see MIPSAnalyst::IsIdleLoop.
+	bool idleLoop;
+	bool invalid;
+};
+
+class IntBlockCache
+{
+public:
+	IntBlockCache();
+
+	// Returns 0 if no block could be decoded at em_address (bad memory.)
+	IntBlock *GetOrCompile(u32 em_address);
+	const IntBlockOp *GetOps(const IntBlock *block) const { return &ops_[block->firstOp]; }
+
+	void InvalidateICache(u32 address, const u32 length);
+	void Clear();
+
+	int GetNumBlocks() const { return (int)block_map_.size(); }
+
+	enum
+	{
+		MAX_BLOCK_INSTRUCTIONS = 128,
+		MAX_OPS = 0x100000,
+		FAST_LOOKUP_SIZE = 0x4000,
+		FAST_LOOKUP_MASK = FAST_LOOKUP_SIZE - 1,
+	};
+
+private:
+	int Compile(u32 em_address);
+	void DestroyBlock(int block_num);
+
+	static int FastLookupIndex(u32 em_address) { return (em_address >> 2) & FAST_LOOKUP_MASK; }
+
+	std::vector<IntBlock> blocks_;
+	std::vector<IntBlockOp> ops_;
+	std::map<u32, int> block_map_; // physical start address -> block number
+	int fastLookup_[FAST_LOOKUP_SIZE];
+};
+
+extern IntBlockCache intBlockCache;
+
+int MIPSInterpret_RunBlocksUntil(u64 globalTicks);
+// Runs block once and charges its cycles to downcount. With no block (bad memory or
+// entering in a delay slot), steps a single op with the regular interpreter instead.
+void MIPSInterpret_RunBlock(MIPSState *mips, const IntBlock *block);
@@ -57,6 +57,8 @@ void MIPSDisAsm(u32 op, u32 pc, char *out);
 u32  MIPSGetInfo(u32 op);
 void MIPSInterpret(u32 op); //only for those rare ones
 int MIPSInterpret_RunFastUntil(u64 globalTicks);
+// Forgets which loops the fast interpreter found to be idle loops.
+void MIPSInterpret_ClearIdleLoops();
 int MIPSInterpret_RunUntil(u64 globalTicks);
 MIPSInterpretFunc MIPSGetInterpretFunc(u32 op);
 
@@ -51,9 +51,10 @@ static bool enableDebug = false;
 
 extern volatile CoreState coreState;
 
-void Jit()
+// Returns 0 if the block was run in the interpreter tier instead of being compiled.
+u32 JitOrInterpret()
 {
-	MIPSComp::jit->Compile(currentMIPS->pc);
+	return MIPSComp::jit->CompileOrInterpret(currentMIPS->pc) ? 1 : 0;
 }
 
 // IDEA, NOT IMPLEMENTED: no more block numbers - hack opcodes just contain offset within
@@ -98,6 +99,7 @@ void AsmRoutineManager::Generate(MIPSState *mips, MIPSComp::Jit *jit)
 			}*/
 
 			SetJumpTarget(skipToRealDispatch);
+			ADD(32, M(&jitExitStats.dispatches), Imm8(1));
 
 			dispatcherNoCheck = GetCodePtr();
 
@@ -136,14 +138,21 @@ void AsmRoutineManager::Generate(MIPSState *mips, MIPSComp::Jit *jit)
 			//Ok, no block, let's jit
 #ifdef _M_IX86
 			ABI_AlignStack(0);
-			CALL(reinterpret_cast<void *>(&Jit));
+			CALL(reinterpret_cast<void *>(&JitOrInterpret));
 			ABI_RestoreStack(0);
 #elif _M_X64
-			CALL((void *)&Jit);
+			CALL((void *)&JitOrInterpret);
 #endif
-			JMP(dispatcherNoCheck); // Let's just dispatch again, we'll enter the block since we know it's there.
+			TEST(32, R(EAX), R(EAX));
+			J_CC(CC_NZ, dispatcherNoCheck, true); // Let's just dispatch again, we'll enter the block since we know it's there.
+
+			// Interpreted instead, which moved the PC on and used up some downcount.
+			CMP(32, M(&CoreTiming::downcount), Imm8(0));
+			J_CC(CC_G, dispatcherNoCheck, true);
+			FixupBranch interpretedBail = J(true);
 
 		SetJumpTarget(bail);
+		SetJumpTarget(interpretedBail);
 		
 		CMP(32, M((void*)&coreState), Imm8(0));
 		J_CC(CC_Z, outerLoop, true);
@@ -417,7 +417,11 @@ void Jit::Comp_JumpReg(u32 op)
 		break;
 	}
 
-	WriteExitDestInEAX();
+	// Returns usually go back to the same place, so they get an inline cache.
+	if ((op & 0x3f) == 8 && rs == MIPS_REG_RA)
+		WriteReturnExitDestInEAX();
+	else
+		WriteExitDestInEAX();
 	js.compiling = false;
 }
 
@@ -426,7 +430,17 @@ void Jit::Comp_Syscall(u32 op)
 	// This will most often be called from Comp_JumpReg (jr ra) so we take over the exit sequence...
 
 	FlushAll();
-	ABI_CallFunctionC((void *)(&CallSyscall), op);
+
+	// Call the function directly, unless CallSyscall has to log it or count it.
+	const HLEFunction *info = GetSyscallInfo(op);
+	if (info && info->func && !SyscallStatsEnabled())
+		ABI_CallFunction((void *)info->func);
+	else
+		ABI_CallFunctionC((void *)(&CallSyscall), op);
+
+	// Nothing changed behind our back, so just keep going.
+	if (info && (info->flags & HLE_NOT_RESCHEDULE) != 0)
+		return;
 
 	WriteSyscallExit();
 	js.compiling = false;
@@ -103,8 +103,10 @@ void Jit::Comp_FPULS(u32 op)
 		AND(32, R(EAX), Imm32(Memory::MEMVIEW32_MASK));
 		MOVSS(fpr.RX(ft), MDisp(EAX, (u32)Memory::base + offset));
 #else
-		MOV(32, R(EAX), gpr.R(rs));
-		MOVSS(fpr.RX(ft), MComplex(RBX, RAX, SCALE_1, offset));
+		{
+			X64Reg dest = fpr.RX(ft);
+			CompFPMemAccess(rs, offset, &dest, 1, false);
+		}
 #endif
 		gpr.UnlockAll();
 		fpr.UnlockAll();
@@ -118,8 +120,10 @@ void Jit::Comp_FPULS(u32 op)
 		AND(32, R(EAX), Imm32(Memory::MEMVIEW32_MASK));
 		MOVSS(MDisp(EAX, (u32)Memory::base + offset), fpr.RX(ft));
 #else
-		MOV(32, R(EAX), gpr.R(rs));
-		MOVSS(MComplex(RBX, RAX, SCALE_1, offset), fpr.RX(ft));
+		{
+			X64Reg src = fpr.RX(ft);
+			CompFPMemAccess(rs, offset, &src, 1, true);
+		}
 #endif
 		gpr.UnlockAll();
 		fpr.UnlockAll();
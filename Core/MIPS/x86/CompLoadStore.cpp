@@ -15,6 +15,8 @@
 // Official git repository and contact information can be found at
 // https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
 
+#include <string.h>
+
 #include "../../MemMap.h"
 #include "../MIPSAnalyst.h"
 
@@ -40,6 +42,173 @@
 
 namespace MIPSComp
 {
+	// If the analysis found the address of the current load/store, we can address it directly.
+	bool Jit::GetKnownAddressArg(OpArg &arg)
+	{
+		u32 addr;
+		if (!analysis_.GetKnownAddress(js.compilerPC, addr))
+			return false;
+		// Only main RAM, it's always mapped so this can't fault.
+		if (addr < PSP_GetKernelMemoryBase() || addr >= PSP_GetKernelMemoryBase() + Memory::RAM_SIZE)
+			return false;
+#ifdef _M_IX86
+		arg = M((void *)(Memory::base + (addr & Memory::MEMVIEW32_MASK)));
+#else
+		arg = MDisp(RBX, addr);
+#endif
+		return true;
+	}
+
+#ifdef _M_X64
+	static void EmitLoad(XEmitter *emit, X64Reg dest, OpArg src, int bits, bool signExtend)
+	{
+		if (bits == 32)
+			emit->MOV(32, R(dest), src);
+		else if (signExtend)
+			emit->MOVSX(32, bits, dest, src);
+		else
+			emit->MOVZX(32, bits, dest, src);
+	}
+
+	// Describes an access like DisassembleMov would, for calling the slow path directly.
+	static InstructionInfo SlowPathInfo(X64Reg reg, int bits, bool signExtend)
+	{
+		InstructionInfo info;
+		memset(&info, 0, sizeof(info));
+		info.operandSize = bits / 8;
+		info.regOperandReg = reg;
+		info.otherReg = RBX;
+		info.scaledReg = RAX;
+		info.signExtend = signExtend;
+		info.zeroExtend = !signExtend && bits != 32;
+		return info;
+	}
+
+	// Fastmem: a plain access, padded so the fault handler has room to patch in a call.
+	// Otherwise: a range check for main RAM, and a call to the slow path for anything else.
+	void Jit::CompITypeMemRead(u32 op, int bits, bool signExtend)
+	{
+		int offset = (signed short)(op&0xFFFF);
+		int rt = _RT;
+		int rs = _RS;
+
+		gpr.Lock(rt, rs);
+		gpr.BindToRegister(rt, rt == rs, true);
+		X64Reg dest = gpr.RX(rt);
+
+		OpArg knownAddress;
+		if (GetKnownAddressArg(knownAddress))
+			EmitLoad(this, dest, knownAddress, bits, signExtend);
+		else if (jo.enableFastmem)
+		{
+			MOV(32, R(EAX), gpr.R(rs));
+			const u8 *start = GetCodePtr();
+			EmitLoad(this, dest, MComplex(RBX, EAX, SCALE_1, offset), bits, signExtend);
+			int size = (int)(GetCodePtr() - start);
+			if (size < BACKPATCH_SIZE)
+				NOP(BACKPATCH_SIZE - size);
+		}
+		else
+		{
+			MOV(32, R(EAX), gpr.R(rs));
+			if (offset)
+				ADD(32, R(EAX), Imm32(offset));
+			CMP(32, R(EAX), Imm32(PSP_GetKernelMemoryBase()));
+			FixupBranch tooLow = J_CC(CC_B);
+			CMP(32, R(EAX), Imm32(PSP_GetKernelMemoryBase() + Memory::RAM_SIZE));
+			FixupBranch tooHigh = J_CC(CC_AE);
+			EmitLoad(this, dest, MRegSum(RBX, EAX), bits, signExtend);
+			FixupBranch done = J();
+			SetJumpTarget(tooLow);
+			SetJumpTarget(tooHigh);
+			CALL((const void *)trampolines_.GetReadTrampoline(SlowPathInfo(dest, bits, signExtend)));
+			SetJumpTarget(done);
+		}
+		gpr.UnlockAll();
+	}
+
+	void Jit::CompITypeMemWrite(u32 op, int bits)
+	{
+		int offset = (signed short)(op&0xFFFF);
+		int rt = _RT;
+		int rs = _RS;
+
+		gpr.Lock(rt, rs);
+		gpr.BindToRegister(rt, true, false);
+		X64Reg src = gpr.RX(rt);
+
+		OpArg knownAddress;
+		if (GetKnownAddressArg(knownAddress))
+			MOV(bits, knownAddress, R(src));
+		else if (jo.enableFastmem)
+		{
+			MOV(32, R(EAX), gpr.R(rs));
+			const u8 *start = GetCodePtr();
+			MOV(bits, MComplex(RBX, EAX, SCALE_1, offset), R(src));
+			int size = (int)(GetCodePtr() - start);
+			if (size < BACKPATCH_SIZE)
+				NOP(BACKPATCH_SIZE - size);
+		}
+		else
+		{
+			MOV(32, R(EAX), gpr.R(rs));
+			if (offset)
+				ADD(32, R(EAX), Imm32(offset));
+			CMP(32, R(EAX), Imm32(PSP_GetKernelMemoryBase()));
+			FixupBranch tooLow = J_CC(CC_B);
+			CMP(32, R(EAX), Imm32(PSP_GetKernelMemoryBase() + Memory::RAM_SIZE));
+			FixupBranch tooHigh = J_CC(CC_AE);
+			MOV(bits, MRegSum(RBX, EAX), R(src));
+			FixupBranch done = J();
+			SetJumpTarget(tooLow);
+			SetJumpTarget(tooHigh);
+			CALL((const void *)trampolines_.GetWriteTrampoline(SlowPathInfo(src, bits, false)));
+			SetJumpTarget(done);
+		}
+		gpr.UnlockAll();
+	}
+
+	// Loads or stores count consecutive floats at rs + offset, to or from already bound registers.
+	// These never use fastmem, the fault handler only knows how to patch integer MOVs. Outside RAM
+	// the slow path passes the bits through EDX, which the register cache never allocates.
+	void Jit::CompFPMemAccess(int rs, s32 offset, const X64Reg *regs, int count, bool isWrite)
+	{
+		MOV(32, R(EAX), gpr.R(rs));
+		if (offset)
+			ADD(32, R(EAX), Imm32(offset));
+		CMP(32, R(EAX), Imm32(PSP_GetKernelMemoryBase()));
+		FixupBranch tooLow = J_CC(CC_B);
+		CMP(32, R(EAX), Imm32(PSP_GetKernelMemoryBase() + Memory::RAM_SIZE - (count - 1) * 4));
+		FixupBranch tooHigh = J_CC(CC_AE);
+		for (int i = 0; i < count; i++)
+		{
+			if (isWrite)
+				MOVSS(MComplex(RBX, RAX, SCALE_1, i * 4), regs[i]);
+			else
+				MOVSS(regs[i], MComplex(RBX, RAX, SCALE_1, i * 4));
+		}
+		FixupBranch done = J();
+		SetJumpTarget(tooLow);
+		SetJumpTarget(tooHigh);
+		for (int i = 0; i < count; i++)
+		{
+			InstructionInfo info = SlowPathInfo(EDX, 32, false);
+			info.displacement = i * 4;
+			if (isWrite)
+			{
+				MOVD_xmm(R(EDX), regs[i]);
+				CALL((const void *)trampolines_.GetWriteTrampoline(info));
+			}
+			else
+			{
+				CALL((const void *)trampolines_.GetReadTrampoline(info));
+				MOVD_xmm(regs[i], R(EDX));
+			}
+		}
+		SetJumpTarget(done);
+	}
+#endif
+
 	void Jit::Comp_ITypeMem(u32 op)
 	{
 		// OLDD
@@ -47,8 +216,35 @@ namespace MIPSComp
 		int rt = _RT;
 		int rs = _RS;
 		int o = op>>26;
+		OpArg knownAddress;
 		switch (o)
 		{
+#ifdef _M_X64
+		case 32: //R(rt) = (u32)(s32)(s8) ReadMem8 (addr); break; //lb
+			CompITypeMemRead(op, 8, true);
+			break;
+		case 33: //R(rt) = (u32)(s32)(s16)ReadMem16(addr); break; //lh
+			CompITypeMemRead(op, 16, true);
+			break;
+		case 35: //R(rt) = ReadMem32(addr); break; //lw
+			CompITypeMemRead(op, 32, false);
+			break;
+		case 36: //R(rt) = ReadMem8 (addr); break; //lbu
+			CompITypeMemRead(op, 8, false);
+			break;
+		case 37: //R(rt) = ReadMem16(addr); break; //lhu
+			CompITypeMemRead(op, 16, false);
+			break;
+		case 40: //WriteMem8 (addr, R(rt)); break; //sb
+			CompITypeMemWrite(op, 8);
+			break;
+		case 41: //WriteMem16(addr, R(rt)); break; //sh
+			CompITypeMemWrite(op, 16);
+			break;
+		case 43: //WriteMem32(addr, R(rt)); break; //sw
+			CompITypeMemWrite(op, 32);
+			break;
+#else
 		case 37: //R(rt) = ReadMem16(addr); break; //lhu
 		case 36: //R(rt) = ReadMem8 (addr); break; //lbu
 			Comp_Generic(op);
@@ -57,22 +253,17 @@ namespace MIPSComp
 		case 35: //R(rt) = ReadMem32(addr); break; //lw
 			gpr.Lock(rt, rs);
 			gpr.BindToRegister(rt, rt == rs, true);
-#ifdef _M_IX86
-			MOV(32, R(EAX), gpr.R(rs));
-			AND(32, R(EAX), Imm32(Memory::MEMVIEW32_MASK));
-			MOV(32, gpr.R(rt), MDisp(EAX, (u32)Memory::base + offset));
-#else
-			MOV(32, R(EAX), gpr.R(rs));
-			MOV(32, gpr.R(rt), MComplex(RBX, EAX, SCALE_1, offset));
-#endif
+			if (GetKnownAddressArg(knownAddress))
+				MOV(32, gpr.R(rt), knownAddress);
+			else
+			{
+				MOV(32, R(EAX), gpr.R(rs));
+				AND(32, R(EAX), Imm32(Memory::MEMVIEW32_MASK));
+				MOV(32, gpr.R(rt), MDisp(EAX, (u32)Memory::base + offset));
+			}
 			gpr.UnlockAll();
 			break;
 
-		case 132: //R(rt) = (u32)(s32)(s8) ReadMem8 (addr); break; //lb
-		case 133: //R(rt) = (u32)(s32)(s16)ReadMem16(addr); break; //lh
-		case 136: //R(rt) = ReadMem8 (addr); break; //lbu
-		case 140: //WriteMem8 (addr, R(rt)); break; //sb
-			
 		case 40:
 		case 41: //WriteMem16(addr, R(rt)); break; //sh
 			Comp_Generic(op);
@@ -82,17 +273,25 @@ namespace MIPSComp
 			{
 				gpr.Lock(rt, rs);
 				gpr.BindToRegister(rt, true, false);
-#ifdef _M_IX86
-				MOV(32, R(EAX), gpr.R(rs));
-				AND(32, R(EAX), Imm32(Memory::MEMVIEW32_MASK));
-				MOV(32, MDisp(EAX, (u32)Memory::base + offset), gpr.R(rt));
-#else
-				MOV(32, R(EAX), gpr.R(rs));
-				MOV(32, MComplex(RBX, EAX, SCALE_1, offset), gpr.R(rt));
-#endif
+				if (GetKnownAddressArg(knownAddress))
+					MOV(32, knownAddress, gpr.R(rt));
+				else
+				{
+					MOV(32, R(EAX), gpr.R(rs));
+					AND(32, R(EAX), Imm32(Memory::MEMVIEW32_MASK));
+					MOV(32, MDisp(EAX, (u32)Memory::base + offset), gpr.R(rt));
+				}
 				gpr.UnlockAll();
 			}
 			break;
+#endif
+
+		case 132: //R(rt) = (u32)(s32)(s8) ReadMem8 (addr); break; //lb
+		case 133: //R(rt) = (u32)(s32)(s16)ReadMem16(addr); break; //lh
+		case 136: //R(rt) = ReadMem8 (addr); break; //lbu
+		case 140: //WriteMem8 (addr, R(rt)); break; //sb
+			Comp_Generic(op);
+			return;
 
 		case 134: //lwl
 			{
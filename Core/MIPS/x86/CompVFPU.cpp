@@ -17,6 +17,9 @@
 
 #include "../../MemMap.h"
 #include "../MIPSAnalyst.h"
+#include "../MIPSTables.h"
+#include "../MIPSIntVFPU.h"
+#include "../MIPSVFPUUtils.h"
 
 #include "Jit.h"
 #include "RegCache.h"
@@ -42,4 +45,664 @@
 namespace MIPSComp
 {
 
-}
\ No newline at end of file
+static const float constantArray[8] = {0.f, 1.f, 2.f, 0.5f, 3.f, 1.f/3.f, 0.25f, 1.f/6.f};
+static const u32 GC_ALIGNED16(noSignMask[4]) = {0x7FFFFFFF, 0x7FFFFFFF, 0x7FFFFFFF, 0x7FFFFFFF};
+static const u32 GC_ALIGNED16(signBitAll[4]) = {0x80000000, 0x80000000, 0x80000000, 0x80000000};
+
+// Temps used by the ops below. S and T prefixes get four each, then results.
+enum
+{
+	TEMP_S = FPURegCache::TEMP0,
+	TEMP_T = FPURegCache::TEMP0 + 4,
+	TEMP_D = FPURegCache::TEMP0 + 8,
+};
+
+// Like GetVectorRegs / GetMatrixRegs, but gives fpr cache indices.
+static void GetVectorRegsV(u8 regs[4], VectorSize sz, int vectorReg)
+{
+	GetVectorRegs(regs, sz, vectorReg);
+	for (int i = 0; i < GetNumVectorElements(sz); i++)
+		regs[i] += FPURegCache::VREG0;
+}
+
+static void GetMatrixRegsV(u8 regs[16], MatrixSize sz, int matrixReg)
+{
+	GetMatrixRegs(regs, sz, matrixReg);
+	int n = GetMatrixSide(sz);
+	for (int i = 0; i < n; i++)
+		for (int j = 0; j < n; j++)
+			regs[j * 4 + i] += FPURegCache::VREG0;
+}
+
+// Lanes are written in order, so dreg can be written as lane di only if no later lane still reads it.
+static bool IsOverlapSafe(u8 dreg, int di, int n, const u8 *sregs, const u8 *tregs)
+{
+	for (int i = di + 1; i < n; i++)
+	{
+		if (sregs[i] == dreg || (tregs && tregs[i] == dreg))
+			return false;
+	}
+	return true;
+}
+
+static bool IsInRegs(u8 reg, int n, const u8 *regs)
+{
+	for (int i = 0; i < n; i++)
+	{
+		if (regs[i] == reg)
+			return true;
+	}
+	return false;
+}
+
+// Swizzles from lanes outside the vector read garbage in the interpreter, leave those to it.
+static bool IsPrefixSTSupported(u32 prefix, VectorSize sz)
+{
+	int n = GetNumVectorElements(sz);
+	for (int i = 0; i < n; i++)
+	{
+		int regnum = (prefix >> (i*2)) & 3;
+		int constants = (prefix >> (12+i)) & 1;
+		if (!constants && regnum >= n)
+			return false;
+	}
+	return true;
+}
+
+void Jit::FlushPrefixV()
+{
+	if ((js.prefixSFlag & JitState::PREFIX_DIRTY) != 0)
+	{
+		MOV(32, M(&mips_->vfpuCtrl[VFPU_CTRL_SPREFIX]), Imm32(js.prefixS));
+		js.prefixSFlag = JitState::PREFIX_KNOWN;
+	}
+	if ((js.prefixTFlag & JitState::PREFIX_DIRTY) != 0)
+	{
+		MOV(32, M(&mips_->vfpuCtrl[VFPU_CTRL_TPREFIX]), Imm32(js.prefixT));
+		js.prefixTFlag = JitState::PREFIX_KNOWN;
+	}
+	if ((js.prefixDFlag & JitState::PREFIX_DIRTY) != 0)
+	{
+		MOV(32, M(&mips_->vfpuCtrl[VFPU_CTRL_DPREFIX]), Imm32(js.prefixD));
+		js.prefixDFlag = JitState::PREFIX_KNOWN;
+	}
+}
+
+void Jit::UpdatePrefixesAfterGeneric(u32 op)
+{
+	MIPSInterpretFunc func = MIPSGetInterpretFunc(op);
+	if (func == &MIPSInt::Int_VPFX || func == &MIPSInt::Int_Mftv || func == &MIPSInt::Int_Vmtvc)
+	{
+		// These can write the prefix registers.
+		js.PrefixUnknown();
+	}
+	else if ((MIPSGetInfo(op) & IS_VFPU) != 0)
+	{
+		// Loads and stores and a few others don't touch the prefixes, the rest eat them.
+		if (func == &MIPSInt::Int_SV || func == &MIPSInt::Int_SVQ || func == &MIPSInt::Int_Vflush ||
+			func == &MIPSInt::Int_Vrnds || func == &MIPSInt::Int_Vmfvc)
+			return;
+		js.prefixS = 0xE4;
+		js.prefixT = 0xE4;
+		js.prefixD = 0x0;
+		js.prefixSFlag = JitState::PREFIX_KNOWN;
+		js.prefixTFlag = JitState::PREFIX_KNOWN;
+		js.prefixDFlag = JitState::PREFIX_KNOWN;
+	}
+}
+
+// Check IsPrefixSTSupported() first. Lanes that need work go to temps starting at tempBase.
+void Jit::ApplyPrefixST(u8 *vregs, u32 prefix, VectorSize sz, int tempBase)
+{
+	if (prefix == 0xE4)
+		return;
+
+	int n = GetNumVectorElements(sz);
+	u8 origV[4];
+	for (int i = 0; i < n; i++)
+		origV[i] = vregs[i];
+
+	for (int i = 0; i < n; i++)
+	{
+		int regnum = (prefix >> (i*2)) & 3;
+		int abs    = (prefix >> (8+i)) & 1;
+		int negate = (prefix >> (16+i)) & 1;
+		int constants = (prefix >> (12+i)) & 1;
+
+		// Plain swizzles don't need any code.
+		if (!constants && !abs && !negate)
+		{
+			vregs[i] = origV[regnum];
+			continue;
+		}
+
+		vregs[i] = tempBase + i;
+		fpr.BindToRegister(vregs[i], false, true);
+		if (!constants)
+		{
+			MOVSS(fpr.RX(vregs[i]), fpr.R(origV[regnum]));
+			if (abs)
+				ANDPS(fpr.RX(vregs[i]), M((void *)&noSignMask));
+		}
+		else
+			MOVSS(fpr.RX(vregs[i]), M((void *)&constantArray[regnum + (abs<<2)]));
+
+		if (negate)
+			XORPS(fpr.RX(vregs[i]), M((void *)&signBitAll));
+	}
+}
+
+// Returns false if the D prefix saturates, only the write mask is handled here.
+bool Jit::GetPrefixDWriteMask(bool writeMask[4], VectorSize sz)
+{
+	int n = GetNumVectorElements(sz);
+	for (int i = 0; i < n; i++)
+	{
+		if (((js.prefixD >> (i * 2)) & 3) != 0)
+			return false;
+		writeMask[i] = ((js.prefixD >> (8 + i)) & 1) != 0;
+	}
+	return true;
+}
+
+void Jit::Comp_SV(u32 op)
+{
+	CONDITIONAL_DISABLE;
+
+	s32 imm = (signed short)(op&0xFFFC);
+	int vt = ((op >> 16) & 0x1f) | ((op & 3) << 5);
+	int rs = _RS;
+	int fv = FPURegCache::VREG0 + vt;
+
+	switch (op >> 26)
+	{
+	case 50: //lv.s  // VI(vt) = Memory::Read_U32(addr);
+		gpr.Lock(rs);
+		fpr.BindToRegister(fv, false, true);
+#ifdef _M_IX86
+		MOV(32, R(EAX), gpr.R(rs));
+		AND(32, R(EAX), Imm32(Memory::MEMVIEW32_MASK));
+		MOVSS(fpr.RX(fv), MDisp(EAX, (u32)Memory::base + imm));
+#else
+		{
+			X64Reg dest = fpr.RX(fv);
+			CompFPMemAccess(rs, imm, &dest, 1, false);
+		}
+#endif
+		gpr.UnlockAll();
+		break;
+
+	case 58: //sv.s   // Memory::Write_U32(VI(vt), addr);
+		gpr.Lock(rs);
+		fpr.BindToRegister(fv, true, false);
+#ifdef _M_IX86
+		MOV(32, R(EAX), gpr.R(rs));
+		AND(32, R(EAX), Imm32(Memory::MEMVIEW32_MASK));
+		MOVSS(MDisp(EAX, (u32)Memory::base + imm), fpr.RX(fv));
+#else
+		{
+			X64Reg src = fpr.RX(fv);
+			CompFPMemAccess(rs, imm, &src, 1, true);
+		}
+#endif
+		gpr.UnlockAll();
+		break;
+
+	default:
+		DISABLE;
+	}
+}
+
+void Jit::Comp_SVQ(u32 op)
+{
+	CONDITIONAL_DISABLE;
+
+	int imm = (signed short)(op&0xFFFC);
+	int vt = (((op >> 16) & 0x1f)) | ((op&1) << 5);
+	int rs = _RS;
+
+	u8 vregs[4];
+	GetVectorRegsV(vregs, V_Quad, vt);
+
+	switch (op >> 26)
+	{
+	case 54: //lv.q
+		gpr.Lock(rs);
+#ifdef _M_IX86
+		MOV(32, R(EAX), gpr.R(rs));
+		AND(32, R(EAX), Imm32(Memory::MEMVIEW32_MASK));
+		for (int i = 0; i < 4; i++)
+		{
+			fpr.BindToRegister(vregs[i], false, true);
+			MOVSS(fpr.RX(vregs[i]), MDisp(EAX, (u32)Memory::base + imm + i * 4));
+		}
+#else
+		{
+			// All four have to stay put until the access is done.
+			fpr.Lock(vregs[0], vregs[1], vregs[2], vregs[3]);
+			X64Reg dest[4];
+			for (int i = 0; i < 4; i++)
+			{
+				fpr.BindToRegister(vregs[i], false, true);
+				dest[i] = fpr.RX(vregs[i]);
+			}
+			CompFPMemAccess(rs, imm, dest, 4, false);
+			fpr.UnlockAll();
+		}
+#endif
+		gpr.UnlockAll();
+		break;
+
+	case 62: //sv.q
+		gpr.Lock(rs);
+#ifdef _M_IX86
+		MOV(32, R(EAX), gpr.R(rs));
+		AND(32, R(EAX), Imm32(Memory::MEMVIEW32_MASK));
+		for (int i = 0; i < 4; i++)
+		{
+			fpr.BindToRegister(vregs[i], true, false);
+			MOVSS(MDisp(EAX, (u32)Memory::base + imm + i * 4), fpr.RX(vregs[i]));
+		}
+#else
+		{
+			// All four have to stay put until the access is done.
+			fpr.Lock(vregs[0], vregs[1], vregs[2], vregs[3]);
+			X64Reg src[4];
+			for (int i = 0; i < 4; i++)
+			{
+				fpr.BindToRegister(vregs[i], true, false);
+				src[i] = fpr.RX(vregs[i]);
+			}
+			CompFPMemAccess(rs, imm, src, 4, true);
+			fpr.UnlockAll();
+		}
+#endif
+		gpr.UnlockAll();
+		break;
+
+	default:
+		// lvl.q/lvr.q/svl.q/svr.q
+		DISABLE;
+	}
+}
+
+void Jit::Comp_Mftv(u32 op)
+{
+	CONDITIONAL_DISABLE;
+
+	int imm = op & 0xFF;
+	int rt = _RT;
+	int fv = FPURegCache::VREG0 + imm;
+
+	// The control registers (and the interlock hack) are left to the interpreter.
+	if (imm >= 128)
+	{
+		DISABLE;
+	}
+
+	switch ((op >> 21) & 0x1f)
+	{
+	case 3: //mfv  // R(rt) = VI(imm);
+		if (rt == 0)
+		{
+			DISABLE;
+		}
+		// Cross move! slightly tricky
+		fpr.StoreFromRegister(fv);
+		gpr.Lock(rt);
+		gpr.BindToRegister(rt, false, true);
+		MOV(32, gpr.R(rt), fpr.R(fv));
+		gpr.UnlockAll();
+		break;
+
+	case 7: //mtv  // VI(imm) = R(rt);
+		// Cross move! slightly tricky
+		gpr.StoreFromRegister(rt);
+		fpr.BindToRegister(fv, false, true);
+		MOVSS(fpr.RX(fv), gpr.R(rt));
+		break;
+
+	default:
+		DISABLE;
+	}
+}
+
+void Jit::Comp_VPFX(u32 op)
+{
+	CONDITIONAL_DISABLE;
+
+	int data = op & 0xFFFFF;
+	int regnum = (op >> 24) & 3;
+	switch (regnum)
+	{
+	case 0:  // S
+		js.prefixS = data;
+		js.prefixSFlag = JitState::PREFIX_KNOWN_DIRTY;
+		break;
+	case 1:  // T
+		js.prefixT = data;
+		js.prefixTFlag = JitState::PREFIX_KNOWN_DIRTY;
+		break;
+	case 2:  // D
+		js.prefixD = data;
+		js.prefixDFlag = JitState::PREFIX_KNOWN_DIRTY;
+		break;
+	default:
+		DISABLE;
+	}
+}
+
+void Jit::Comp_VecDo3(u32 op)
+{
+	CONDITIONAL_DISABLE;
+
+	if (js.HasUnknownPrefix())
+	{
+		DISABLE;
+	}
+
+	void (XEmitter::*xmmop)(X64Reg, OpArg) = NULL;
+	switch (op >> 26)
+	{
+	case 24: //VFPU0
+		switch ((op >> 23)&7)
+		{
+		case 0: xmmop = &XEmitter::ADDSS; break; //vadd
+		case 1: xmmop = &XEmitter::SUBSS; break; //vsub
+		case 7: xmmop = &XEmitter::DIVSS; break; //vdiv
+		}
+		break;
+	case 25: //VFPU1
+		switch ((op >> 23)&7)
+		{
+		case 0: xmmop = &XEmitter::MULSS; break; //vmul
+		}
+		break;
+	}
+
+	VectorSize sz = GetVecSize(op);
+	int n = GetNumVectorElements(sz);
+	bool writeMask[4];
+	if (xmmop == NULL || !GetPrefixDWriteMask(writeMask, sz) ||
+		!IsPrefixSTSupported(js.prefixS, sz) || !IsPrefixSTSupported(js.prefixT, sz))
+	{
+		DISABLE;
+	}
+
+	u8 sregs[4], tregs[4], dregs[4];
+	GetVectorRegsV(sregs, sz, _VS);
+	GetVectorRegsV(tregs, sz, _VT);
+	GetVectorRegsV(dregs, sz, _VD);
+	ApplyPrefixST(sregs, js.prefixS, sz, TEMP_S);
+	ApplyPrefixST(tregs, js.prefixT, sz, TEMP_T);
+
+	// If a result would overwrite an input we still need, compute everything into temps first.
+	bool useTemps = false;
+	for (int i = 0; i < n; i++)
+	{
+		if (!writeMask[i] && !IsOverlapSafe(dregs[i], i, n, sregs, tregs))
+			useTemps = true;
+	}
+
+	for (int i = 0; i < n; i++)
+	{
+		if (writeMask[i])
+			continue;
+		int out = useTemps ? TEMP_D + i : dregs[i];
+		MOVSS(XMM0, fpr.R(sregs[i]));
+		(this->*xmmop)(XMM0, fpr.R(tregs[i]));
+		fpr.BindToRegister(out, false, true);
+		MOVSS(fpr.RX(out), R(XMM0));
+	}
+
+	if (useTemps)
+	{
+		for (int i = 0; i < n; i++)
+		{
+			if (writeMask[i])
+				continue;
+			fpr.BindToRegister(dregs[i], false, true);
+			MOVSS(fpr.RX(dregs[i]), fpr.R(TEMP_D + i));
+		}
+	}
+
+	fpr.DiscardTemps();
+	js.EatPrefix();
+}
+
+void Jit::Comp_VDot(u32 op)
+{
+	CONDITIONAL_DISABLE;
+
+	if (js.HasUnknownPrefix())
+	{
+		DISABLE;
+	}
+
+	VectorSize sz = GetVecSize(op);
+	int n = GetNumVectorElements(sz);
+	bool writeMask[4];
+	if (!GetPrefixDWriteMask(writeMask, V_Single) ||
+		!IsPrefixSTSupported(js.prefixS, sz) || !IsPrefixSTSupported(js.prefixT, sz))
+	{
+		DISABLE;
+	}
+
+	u8 sregs[4], tregs[4], dregs[1];
+	GetVectorRegsV(sregs, sz, _VS);
+	GetVectorRegsV(tregs, sz, _VT);
+	GetVectorRegsV(dregs, V_Single, _VD);
+	ApplyPrefixST(sregs, js.prefixS, sz, TEMP_S);
+	ApplyPrefixST(tregs, js.prefixT, sz, TEMP_T);
+
+	// Same order of operations as the interpreter, starting from 0.0f.
+	XORPS(XMM0, R(XMM0));
+	for (int i = 0; i < n; i++)
+	{
+		MOVSS(XMM1, fpr.R(sregs[i]));
+		MULSS(XMM1, fpr.R(tregs[i]));
+		ADDSS(XMM0, R(XMM1));
+	}
+
+	// Int_VDot stores the result whatever the D prefix mask says, so does this.
+	fpr.BindToRegister(dregs[0], false, true);
+	MOVSS(fpr.RX(dregs[0]), R(XMM0));
+
+	fpr.DiscardTemps();
+	js.EatPrefix();
+}
+
+void Jit::Comp_VScl(u32 op)
+{
+	CONDITIONAL_DISABLE;
+
+	if (js.HasUnknownPrefix())
+	{
+		DISABLE;
+	}
+
+	VectorSize sz = GetVecSize(op);
+	int n = GetNumVectorElements(sz);
+	bool writeMask[4];
+	if (!GetPrefixDWriteMask(writeMask, sz) || !IsPrefixSTSupported(js.prefixS, sz))
+	{
+		DISABLE;
+	}
+
+	// The T prefix isn't applied to the scale.
+	u8 sregs[4], tregs[4], dregs[4];
+	GetVectorRegsV(sregs, sz, _VS);
+	GetVectorRegsV(tregs, V_Single, _VT);
+	GetVectorRegsV(dregs, sz, _VD);
+	ApplyPrefixST(sregs, js.prefixS, sz, TEMP_S);
+	for (int i = 1; i < n; i++)
+		tregs[i] = tregs[0];
+
+	bool useTemps = false;
+	for (int i = 0; i < n; i++)
+	{
+		if (!writeMask[i] && !IsOverlapSafe(dregs[i], i, n, sregs, tregs))
+			useTemps = true;
+	}
+
+	for (int i = 0; i < n; i++)
+	{
+		if (writeMask[i])
+			continue;
+		int out = useTemps ? TEMP_D + i : dregs[i];
+		MOVSS(XMM0, fpr.R(sregs[i]));
+		MULSS(XMM0, fpr.R(tregs[i]));
+		fpr.BindToRegister(out, false, true);
+		MOVSS(fpr.RX(out), R(XMM0));
+	}
+
+	if (useTemps)
+	{
+		for (int i = 0; i < n; i++)
+		{
+			if (writeMask[i])
+				continue;
+			fpr.BindToRegister(dregs[i], false, true);
+			MOVSS(fpr.RX(dregs[i]), fpr.R(TEMP_D + i));
+		}
+	}
+
+	fpr.DiscardTemps();
+	js.EatPrefix();
+}
+
+void Jit::Comp_Vmmul(u32 op)
+{
+	CONDITIONAL_DISABLE;
+
+	// Prefixes aren't applied here, just eaten, so we don't care if they're unknown.
+	MatrixSize sz = GetMtxSize(op);
+	int n = GetMatrixSide(sz);
+
+	u8 sregs[16], tregs[16], dregs[16];
+	GetMatrixRegsV(sregs, sz, _VS);
+	GetMatrixRegsV(tregs, sz, _VT);
+	GetMatrixRegsV(dregs, sz, _VD);
+
+	bool useTemps = false;
+	for (int a = 0; a < n; a++)
+	{
+		for (int b = 0; b < n; b++)
+		{
+			u8 dreg = dregs[a * 4 + b];
+			for (int c = 0; c < n; c++)
+			{
+				if (IsInRegs(dreg, n, &sregs[c * 4]) || IsInRegs(dreg, n, &tregs[c * 4]))
+					useTemps = true;
+			}
+		}
+	}
+
+	for (int a = 0; a < n; a++)
+	{
+		for (int b = 0; b < n; b++)
+		{
+			XORPS(XMM0, R(XMM0));
+			for (int c = 0; c < n; c++)
+			{
+				MOVSS(XMM1, fpr.R(sregs[b * 4 + c]));
+				MULSS(XMM1, fpr.R(tregs[a * 4 + c]));
+				ADDSS(XMM0, R(XMM1));
+			}
+			int out = useTemps ? FPURegCache::TEMP0 + a * 4 + b : dregs[a * 4 + b];
+			fpr.BindToRegister(out, false, true);
+			MOVSS(fpr.RX(out), R(XMM0));
+		}
+	}
+
+	if (useTemps)
+	{
+		for (int a = 0; a < n; a++)
+		{
+			for (int b = 0; b < n; b++)
+			{
+				u8 dreg = dregs[a * 4 + b];
+				fpr.BindToRegister(dreg, false, true);
+				MOVSS(fpr.RX(dreg), fpr.R(FPURegCache::TEMP0 + a * 4 + b));
+			}
+		}
+	}
+
+	fpr.DiscardTemps();
+	js.EatPrefix();
+}
+
+void Jit::Comp_Vtfm(u32 op)
+{
+	CONDITIONAL_DISABLE;
+
+	int ins = (op >> 23) & 7;
+	VectorSize sz = GetVecSize(op);
+	MatrixSize msz = GetMtxSize(op);
+	int n = GetNumVectorElements(sz);
+
+	bool homogenous = false;
+	if (n == ins && n < 4)
+	{
+		n++;
+		sz = (VectorSize)((int)(sz) + 1);
+		msz = (MatrixSize)((int)(msz) + 1);
+		homogenous = true;
+	}
+	else if (n != ins + 1)
+	{
+		DISABLE;
+	}
+
+	u8 sregs[16], tregs[4], dregs[4];
+	GetMatrixRegsV(sregs, msz, _VS);
+	GetVectorRegsV(tregs, sz, _VT);
+	GetVectorRegsV(dregs, sz, _VD);
+
+	bool useTemps = false;
+	for (int i = 0; i < n; i++)
+	{
+		if (IsInRegs(dregs[i], n, tregs))
+			useTemps = true;
+		for (int k = 0; k < n; k++)
+		{
+			if (IsInRegs(dregs[i], n, &sregs[k * 4]))
+				useTemps = true;
+		}
+	}
+
+	for (int i = 0; i < n; i++)
+	{
+		XORPS(XMM0, R(XMM0));
+		for (int k = 0; k < n; k++)
+		{
+			if (homogenous && k == n - 1)
+			{
+				ADDSS(XMM0, fpr.R(sregs[i * 4 + k]));
+			}
+			else
+			{
+				MOVSS(XMM1, fpr.R(sregs[i * 4 + k]));
+				MULSS(XMM1, fpr.R(tregs[k]));
+				ADDSS(XMM0, R(XMM1));
+			}
+		}
+		int out = useTemps ? TEMP_D + i : dregs[i];
+		fpr.BindToRegister(out, false, true);
+		MOVSS(fpr.RX(out), R(XMM0));
+	}
+
+	if (useTemps)
+	{
+		for (int i = 0; i < n; i++)
+		{
+			fpr.BindToRegister(dregs[i], false, true);
+			MOVSS(fpr.RX(dregs[i]), fpr.R(TEMP_D + i));
+		}
+	}
+
+	fpr.DiscardTemps();
+	js.EatPrefix();
+}
+
+}
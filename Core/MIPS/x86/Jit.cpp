@@ -15,12 +15,19 @@
 // Official git repository and contact information can be found at
 // https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
 
+#include <string.h>
+
+#include "base/timeutil.h"
+
 #include "../../Core.h"
+#include "../../Config.h"
 #include "../../CoreTiming.h"
 #include "../MIPS.h"
 #include "../MIPSCodeUtils.h"
 #include "../MIPSInt.h"
+#include "../MIPSIntBlockCache.h"
 #include "../MIPSTables.h"
+#include "../JitCommon/JitDiskCache.h"
 
 #include "RegCache.h"
 #include "Jit.h"
@@ -38,18 +45,26 @@ Jit::Jit(MIPSState *mips) : blocks(mips), mips_(mips)
 	gpr.SetEmitter(this);
 	fpr.SetEmitter(this);
 	AllocCodeSpace(1024 * 1024 * 16);
+	trampolines_.Init();
+	jo.enableFastmem = g_Config.bFastMemory && InstallFastmemHandler();
+	jo.tierThreshold = g_Config.iTieredJitThreshold;
+	memset(&tierStats_, 0, sizeof(tierStats_));
 }
 
 void Jit::FlushAll()
 {
 	gpr.Flush(FLUSH_ALL);
 	fpr.Flush(FLUSH_ALL);
+	FlushPrefixV();
 }
 
 void Jit::ClearCache()
 {
+	LogExitStats();
+	LogTierStats();
 	blocks.Clear();
 	ClearCodeSpace();
+	trampolines_.Clear();
 }
 
 u8 *codeCache;
@@ -62,20 +77,69 @@ void Jit::CompileAt(u32 addr)
 
 void Jit::Compile(u32 em_address)
 {
+	double start = time_now_d();
 	if (GetSpaceLeft() < 0x10000 || blocks.IsFull())
 	{
 		ClearCache();
 	}
+#ifdef _M_X64
+	else if (trampolines_.GetSpaceLeft() < 0x10000)
+	{
+		ClearCache();
+	}
+#endif
 
 	int block_num = blocks.AllocateBlock(em_address);
 	JitBlock *b = blocks.GetBlock(block_num);
 	blocks.FinalizeBlock(block_num, jo.enableBlocklink, DoJit(em_address, b));
+	jitDiskCache.RecordBlock(b->originalAddress, b->originalSize);
+
+	tierStats_.compiledBlocks++;
+	tierStats_.compileTime += time_now_d() - start;
+}
+
+bool Jit::CompileOrInterpret(u32 em_address)
+{
+	if (jo.tierThreshold <= 0 || mips_->inDelaySlot)
+	{
+		Compile(em_address);
+		return true;
+	}
+
+	IntBlock *block = intBlockCache.GetOrCompile(em_address);
+	if (!block || block->runCount >= jo.tierThreshold)
+	{
+		Compile(em_address);
+		if (block)
+		{
+			// Keep counting where the interpreter left off.
+			blocks.GetBlock(blocks.GetNumBlocks() - 1)->runCount = block->runCount;
+			tierStats_.promotedBlocks++;
+		}
+		return true;
+	}
+
+	block->runCount++;
+	// Reading the clock costs about as much as running a small block, so only a sample is timed.
+	if ((tierStats_.interpretedRuns++ & (TIER_TIME_SAMPLE_RATE - 1)) != 0)
+	{
+		MIPSInterpret_RunBlock(mips_, block);
+		return false;
+	}
+	double start = time_now_d();
+	MIPSInterpret_RunBlock(mips_, block);
+	tierStats_.interpretTime += (time_now_d() - start) * TIER_TIME_SAMPLE_RATE;
+	return false;
 }
 
 void Jit::RunLoopUntil(u64 globalticks)
 {
+	double start = time_now_d();
+	double otherTiers = tierStats_.interpretTime + tierStats_.compileTime;
 	// TODO: copy globalticks somewhere
 	((void (*)())asm_.enterCode)();
+	otherTiers = tierStats_.interpretTime + tierStats_.compileTime - otherTiers;
+	tierStats_.jitTime += time_now_d() - start - otherTiers;
 }
 
 const u8 *Jit::DoJit(u32 em_address, JitBlock *b)
@@ -86,14 +150,22 @@ const u8 *Jit::DoJit(u32 em_address, JitBlock *b)
 	js.curBlock = b;
 	js.compiling = true;
 	js.inDelaySlot = false;
+	js.PrefixUnknown();
+
+	// Linked exits jump here with the flags from their downcount subtraction,
+	// so we need to do the dispatcher's check before running the block.
+	b->checkedEntry = GetCodePtr();
+	FixupBranch skip = J_CC(CC_NBE);
+	MOV(32, M(&mips_->pc), Imm32(js.blockStart));
+	JMP(asm_.dispatcher, true);
+	SetJumpTarget(skip);
 
 	b->normalEntry = GetCodePtr();
 
-	// TODO: this needs work
-	MIPSAnalyst::AnalysisResults analysis; // = MIPSAnalyst::Analyze(em_address);
+	MIPSAnalyst::Analyze(js.blockStart, analysis_);
 
-	gpr.Start(mips_, analysis);
-	fpr.Start(mips_, analysis);
+	gpr.Start(mips_, analysis_);
+	fpr.Start(mips_, analysis_);
 
 	int numInstructions = 0;
 	while (js.compiling)
@@ -101,7 +173,11 @@ const u8 *Jit::DoJit(u32 em_address, JitBlock *b)
 		u32 inst = Memory::Read_Instruction(js.compilerPC);
 		js.downcountAmount += MIPSGetInstructionCycleEstimate(inst);
 
-		MIPSCompileOp(inst);
+		gpr.SetCompilerPC(js.compilerPC);
+		fpr.SetCompilerPC(js.compilerPC);
+		// Its result is overwritten before it's read, so it doesn't need to run at all.
+		if (!analysis_.IsDeadOp(js.compilerPC))
+			MIPSCompileOp(inst);
 
 		js.compilerPC += 4;
 		numInstructions++;
@@ -128,11 +204,16 @@ void Jit::Comp_Generic(u32 op)
 	{
 		MOV(32, M(&mips_->pc), Imm32(js.compilerPC));
 		ABI_CallFunctionC((void *)func, op);
+		UpdatePrefixesAfterGeneric(op);
 	}
 }
 
 void Jit::WriteExit(u32 destination, int exit_num)
 {
+	// Looping back means nothing changed, skip ahead to the next event. Everything's flushed here.
+	if (destination == js.blockStart && analysis_.idleLoop)
+		ABI_CallFunctionC((void *)&CoreTiming::Idle, 0);
+
 	SUB(32, M(&CoreTiming::downcount), js.downcountAmount > 127 ? Imm32(js.downcountAmount) : Imm8(js.downcountAmount));
 
 	//If nobody has taken care of this yet (this can be removed when all branches are done)
@@ -140,20 +221,41 @@ void Jit::WriteExit(u32 destination, int exit_num)
 	b->exitAddress[exit_num] = destination;
 	b->exitPtrs[exit_num] = GetWritableCodePtr();
 
-	// Link opportunity!
-	int block = blocks.GetBlockNumberFromStartAddress(destination);
-	if (jo.enableBlocklink)
+	// Always emit the unlinked version, FinalizeBlock links it if it can. This keeps
+	// the space needed to unlink it again later.
+	MOV(32, M(&mips_->pc), Imm32(destination));
+	JMP(asm_.dispatcher, true);
+}
+
+static void JitPredictReturn(u32 block_num)
+{
+	MIPSComp::jit->GetBlockCache()->PredictReturn((int)block_num, currentMIPS->pc);
+}
+
+void Jit::WriteReturnExitDestInEAX()
+{
+	MOV(32, M(&mips_->pc), R(EAX));
+	if (!jo.enableBlocklink)
 	{
-		if (block >= 0 && jo.enableBlocklink)
-		{
-			// It exists! Joy of joy!
-			JMP(blocks.GetBlock(block)->checkedEntry, true);
-			b->linkStatus[exit_num] = true;
-			return;
-		}
+		SUB(32, M(&CoreTiming::downcount), js.downcountAmount > 127 ? Imm32(js.downcountAmount) : Imm8(js.downcountAmount));
+		JMP(asm_.dispatcher, true);
+		return;
 	}
-	// No blocklinking.
-	MOV(32, M(&mips_->pc), Imm32(destination));
+
+	// Inline cache, patched by JitBlockCache::PredictReturn to the last address we returned to.
+	JitBlock *b = js.curBlock;
+	b->returnCmpPtr = GetWritableCodePtr();
+	CMP(32, R(EAX), Imm32(INVALID_EXIT));
+	FixupBranch miss = J_CC(CC_NE, true);
+	ADD(32, M(&jitExitStats.returnHits), Imm8(1));
+	SUB(32, M(&CoreTiming::downcount), Imm32(js.downcountAmount));
+	b->returnJmpPtr = GetWritableCodePtr();
+	JMP(asm_.dispatcher, true);
+
+	SetJumpTarget(miss);
+	ADD(32, M(&jitExitStats.returnMisses), Imm8(1));
+	ABI_CallFunctionC((void *)&JitPredictReturn, b->blockNum);
+	SUB(32, M(&CoreTiming::downcount), Imm32(js.downcountAmount));
 	JMP(asm_.dispatcher, true);
 }
 
@@ -165,6 +267,22 @@ void Jit::WriteExitDestInEAX()
 	JMP(asm_.dispatcher, true);
 }
 
+void Jit::LogExitStats()
+{
+	int exits, linked;
+	blocks.GetLinkStats(exits, linked);
+	u32 returns = jitExitStats.returnHits + jitExitStats.returnMisses;
+	INFO_LOG(JIT, "Block exits: %d/%d linked, %u dispatches, %u/%u returns predicted",
+		linked, exits, jitExitStats.dispatches, jitExitStats.returnHits, returns);
+}
+
+void Jit::LogTierStats()
+{
+	const JitTierStats &s = tierStats_;
+	INFO_LOG(JIT, "Tiers: %u interpreted runs in %0.2f ms, %u blocks compiled (%u promoted) in %0.2f ms, %0.2f ms in the jit",
+		s.interpretedRuns, s.interpretTime * 1000.0, s.compiledBlocks, s.promotedBlocks, s.compileTime * 1000.0, s.jitTime * 1000.0);
+}
+
 void Jit::WriteSyscallExit()
 {
 	SUB(32, M(&CoreTiming::downcount), js.downcountAmount > 127 ? Imm32(js.downcountAmount) : Imm8(js.downcountAmount));
@@ -26,7 +26,9 @@
 
 #include "x64Emitter.h"
 #include "JitCache.h"
+#include "JitBackpatch.h"
 #include "RegCache.h"
+#include "../MIPSVFPUUtils.h"
 
 namespace MIPSComp
 {
@@ -35,10 +37,31 @@ struct JitOptions
 {
 	JitOptions()
 	{
-		enableBlocklink = false;
+		enableBlocklink = true;
+		enableFastmem = false;
+		tierThreshold = 0;
 	}
 
 	bool enableBlocklink;
+	// Set up by the Jit depending on the config and whether the platform supports it.
+	bool enableFastmem;
+	// With tiered compilation, blocks run in the block interpreter until they've run
+	// this many times, and only then get compiled. 0 compiles everything right away.
+	int tierThreshold;
+};
+
+#define TIER_TIME_SAMPLE_RATE 64
+
+// Where the time goes with tiered compilation. The jit tier also includes everything
+// called from compiled code and the dispatcher loop (HLE, CoreTiming events.)
+struct JitTierStats
+{
+	u32 interpretedRuns;
+	u32 compiledBlocks;
+	u32 promotedBlocks;	// compiled after running in the interpreter first
+	double interpretTime;	// estimated, one run in TIER_TIME_SAMPLE_RATE is timed
+	double compileTime;
+	double jitTime;
 };
 
 struct JitState
@@ -50,6 +73,52 @@ struct JitState
 	int downcountAmount;
 	bool compiling;	// TODO: get rid of this in favor of using analysis results to determine end of block
 	JitBlock *curBlock;
+
+	// VFPU prefixes are tracked at compile time so compiled ops can apply them statically.
+	// Dirty ones have not been written back to vfpuCtrl yet.
+	enum PrefixState
+	{
+		PREFIX_UNKNOWN = 0x00,
+		PREFIX_KNOWN = 0x01,
+		PREFIX_DIRTY = 0x10,
+		PREFIX_KNOWN_DIRTY = 0x11,
+	};
+
+	u32 prefixS;
+	u32 prefixT;
+	u32 prefixD;
+	PrefixState prefixSFlag;
+	PrefixState prefixTFlag;
+	PrefixState prefixDFlag;
+
+	void PrefixUnknown()
+	{
+		prefixSFlag = PREFIX_UNKNOWN;
+		prefixTFlag = PREFIX_UNKNOWN;
+		prefixDFlag = PREFIX_UNKNOWN;
+	}
+	bool HasUnknownPrefix() const
+	{
+		return (prefixSFlag & PREFIX_KNOWN) == 0 || (prefixTFlag & PREFIX_KNOWN) == 0 || (prefixDFlag & PREFIX_KNOWN) == 0;
+	}
+	void EatPrefix()
+	{
+		if ((prefixSFlag & PREFIX_KNOWN) == 0 || prefixS != 0xE4)
+		{
+			prefixSFlag = PREFIX_KNOWN_DIRTY;
+			prefixS = 0xE4;
+		}
+		if ((prefixTFlag & PREFIX_KNOWN) == 0 || prefixT != 0xE4)
+		{
+			prefixTFlag = PREFIX_KNOWN_DIRTY;
+			prefixT = 0xE4;
+		}
+		if ((prefixDFlag & PREFIX_KNOWN) == 0 || prefixD != 0x0)
+		{
+			prefixDFlag = PREFIX_KNOWN_DIRTY;
+			prefixD = 0x0;
+		}
+	}
 };
 
 class Jit : public Gen::XCodeBlock
@@ -65,6 +134,9 @@ public:
 	void RunLoopUntil(u64 globalticks);
 
 	void Compile(u32 em_address);	// Compiles a block at current MIPS PC
+	// Called by the dispatcher when there's no block at the current PC. Either compiles
+	// one and returns true, or runs the code in the interpreter tier and returns false.
+	bool CompileOrInterpret(u32 em_address);
 	const u8 *DoJit(u32 em_address, JitBlock *b);
 
 	void CompileAt(u32 addr);
@@ -91,14 +163,32 @@ public:
 	void Comp_FPU2op(u32 op);
 	void Comp_mxc1(u32 op);
 
+	void Comp_SV(u32 op);
+	void Comp_SVQ(u32 op);
+	void Comp_Mftv(u32 op);
+	void Comp_VPFX(u32 op);
+	void Comp_VecDo3(u32 op);
+	void Comp_VDot(u32 op);
+	void Comp_VScl(u32 op);
+	void Comp_Vmmul(u32 op);
+	void Comp_Vtfm(u32 op);
+
 	JitBlockCache *GetBlockCache() { return &blocks; }
 	AsmRoutineManager &Asm() { return asm_; }
-private:
+	void LogExitStats();
+	void LogTierStats();
+	const JitTierStats &GetTierStats() const { return tierStats_; }
+
+	// Called from the fault handler, rewrites a fastmem access into a call to the slow path.
+	bool BackPatch(u8 *codePtr, bool isWrite);
+	// Drops every compiled block, e.g. after loading a state.
 	void ClearCache();
+private:
 	void FlushAll();
 
 	void WriteExit(u32 destination, int exit_num);
 	void WriteExitDestInEAX();
+	void WriteReturnExitDestInEAX();
 //	void WriteRfiExitDestInEAX();
 	void WriteSyscallExit();
 
@@ -115,6 +205,16 @@ private:
 	void CompShiftVar(u32 op, void (XEmitter::*shift)(int, OpArg, OpArg));
 
 	void CompFPTriArith(u32 op, void (XEmitter::*arith)(X64Reg reg, OpArg), bool orderMatters);
+	bool GetKnownAddressArg(OpArg &arg);
+	void CompITypeMemRead(u32 op, int bits, bool signExtend);
+	void CompITypeMemWrite(u32 op, int bits);
+	void CompFPMemAccess(int rs, s32 offset, const X64Reg *regs, int count, bool isWrite);
+
+	// VFPU utilities
+	void FlushPrefixV();
+	void UpdatePrefixesAfterGeneric(u32 op);
+	void ApplyPrefixST(u8 *vregs, u32 prefix, VectorSize sz, int tempBase);
+	bool GetPrefixDWriteMask(bool writeMask[4], VectorSize sz);
 
 	JitBlockCache blocks;
 	JitOptions jo;
@@ -122,8 +222,12 @@ private:
 
 	GPRRegCache gpr;
 	FPURegCache fpr;
+	// Dataflow info for the block being compiled.
+	MIPSAnalyst::AnalysisResults analysis_;
 
 	AsmRoutineManager asm_;
+	TrampolineCache trampolines_;
+	JitTierStats tierStats_;
 
 	MIPSState *mips_;
 };
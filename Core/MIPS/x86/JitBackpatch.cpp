@@ -0,0 +1,328 @@
+// Copyright (c) 2012- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#include <string.h>
+
+#include "ABI.h"
+#include "x64Analyzer.h"
+
+#include "../../MemMap.h"
+#include "../JitCommon/JitCommon.h"
+#include "Jit.h"
+#include "JitBackpatch.h"
+
+#if defined(_M_X64) && defined(__linux__) && !defined(ANDROID)
+#define FASTMEM_HANDLER
+#include <signal.h>
+#include <ucontext.h>
+#endif
+
+using namespace Gen;
+
+namespace MIPSComp
+{
+
+#ifdef _M_X64
+
+static const X64Reg callerSavedRegs[] =
+{
+#ifdef _WIN32
+	RAX, RCX, RDX, R8, R9, R10, R11,
+#else
+	RAX, RCX, RDX, RSI, RDI, R8, R9, R10, R11,
+#endif
+};
+static const int numCallerSavedRegs = sizeof(callerSavedRegs) / sizeof(callerSavedRegs[0]);
+
+#ifdef _WIN32
+static const int shadowSpace = 0x20;
+#else
+static const int shadowSpace = 0;
+#endif
+
+void TrampolineCache::Init()
+{
+	AllocCodeSpace(1024 * 1024 * 4);
+}
+
+void TrampolineCache::Clear()
+{
+	ClearCodeSpace();
+	cache_.clear();
+}
+
+// Everything the emitted code depends on. Writes of an immediate aren't cached,
+// they'd need the value in the key too and nothing asks for them twice.
+static u64 TrampolineKey(const InstructionInfo &info, bool isWrite)
+{
+	u64 key = (u32)info.displacement;
+	key |= (u64)(info.operandSize & 7) << 32;
+	key |= (u64)(info.regOperandReg & 15) << 35;
+	key |= (u64)(info.scaledReg & 15) << 39;
+	key |= (u64)(info.signExtend ? 1 : 0) << 43;
+	key |= (u64)(isWrite ? 1 : 0) << 44;
+	return key;
+}
+
+// Saves everything a C function may clobber, returns the extra stack used.
+int TrampolineCache::PushRegs(X64Reg except)
+{
+	int pushed = 0;
+	for (int i = 0; i < numCallerSavedRegs; i++)
+	{
+		if (callerSavedRegs[i] != except)
+		{
+			PUSH(callerSavedRegs[i]);
+			pushed++;
+		}
+	}
+
+	// The jit calls us with an aligned stack, so the return address is counted too.
+	int frameSize = 16 * ABI_GetNumXMMRegs() + shadowSpace;
+	if (((pushed + 1) * 8 + frameSize) & 15)
+		frameSize += 8;
+	SUB(64, R(RSP), Imm32(frameSize));
+	for (int i = 0; i < ABI_GetNumXMMRegs(); i++)
+		MOVUPS(MDisp(RSP, shadowSpace + i * 16), (X64Reg)(XMM0 + i));
+	return frameSize;
+}
+
+void TrampolineCache::PopRegs(X64Reg except, int frameSize)
+{
+	for (int i = 0; i < ABI_GetNumXMMRegs(); i++)
+		MOVUPS((X64Reg)(XMM0 + i), MDisp(RSP, shadowSpace + i * 16));
+	ADD(64, R(RSP), Imm32(frameSize));
+	for (int i = numCallerSavedRegs - 1; i >= 0; i--)
+	{
+		if (callerSavedRegs[i] != except)
+			POP(callerSavedRegs[i]);
+	}
+}
+
+const u8 *TrampolineCache::GetReadTrampoline(const InstructionInfo &info)
+{
+	u64 key = TrampolineKey(info, false);
+	std::map<u64, const u8 *>::iterator iter = cache_.find(key);
+	if (iter != cache_.end())
+		return iter->second;
+
+	const u8 *trampoline = EmitReadTrampoline(info);
+	cache_[key] = trampoline;
+	return trampoline;
+}
+
+const u8 *TrampolineCache::GetWriteTrampoline(const InstructionInfo &info)
+{
+	if (info.hasImmediate)
+		return EmitWriteTrampoline(info);
+
+	u64 key = TrampolineKey(info, true);
+	std::map<u64, const u8 *>::iterator iter = cache_.find(key);
+	if (iter != cache_.end())
+		return iter->second;
+
+	const u8 *trampoline = EmitWriteTrampoline(info);
+	cache_[key] = trampoline;
+	return trampoline;
+}
+
+const u8 *TrampolineCache::EmitReadTrampoline(const InstructionInfo &info)
+{
+	const u8 *trampoline = GetCodePtr();
+	X64Reg addrReg = (X64Reg)info.scaledReg;
+	X64Reg dataReg = (X64Reg)info.regOperandReg;
+
+	int frameSize = PushRegs(dataReg);
+	MOV(32, R(ABI_PARAM1), R(addrReg));
+	if (info.displacement)
+		ADD(32, R(ABI_PARAM1), Imm32(info.displacement));
+
+	switch (info.operandSize)
+	{
+	case 4:
+		ABI_CallFunction((void *)&Memory::Read_U32);
+		if (dataReg != EAX)
+			MOV(32, R(dataReg), R(EAX));
+		break;
+	case 2:
+		ABI_CallFunction((void *)&Memory::Read_U16);
+		if (info.signExtend)
+			MOVSX(32, 16, dataReg, R(EAX));
+		else
+			MOVZX(32, 16, dataReg, R(EAX));
+		break;
+	case 1:
+		ABI_CallFunction((void *)&Memory::Read_U8);
+		if (info.signExtend)
+			MOVSX(32, 8, dataReg, R(EAX));
+		else
+			MOVZX(32, 8, dataReg, R(EAX));
+		break;
+	default:
+		_assert_msg_(DYNA_REC, 0, "GetReadTrampoline: bad operand size %d", info.operandSize);
+		break;
+	}
+
+	PopRegs(dataReg, frameSize);
+	RET();
+	return trampoline;
+}
+
+const u8 *TrampolineCache::EmitWriteTrampoline(const InstructionInfo &info)
+{
+	const u8 *trampoline = GetCodePtr();
+	X64Reg addrReg = (X64Reg)info.scaledReg;
+	X64Reg dataReg = (X64Reg)info.regOperandReg;
+
+	int frameSize = PushRegs(INVALID_REG);
+	// Data first, the address is in RAX so it can't be clobbered by this.
+	if (info.hasImmediate)
+		MOV(32, R(ABI_PARAM1), Imm32((u32)info.immediate));
+	else if (info.operandSize == 4)
+		MOV(32, R(ABI_PARAM1), R(dataReg));
+	else
+		MOVZX(32, info.operandSize * 8, ABI_PARAM1, R(dataReg));
+	MOV(32, R(ABI_PARAM2), R(addrReg));
+	if (info.displacement)
+		ADD(32, R(ABI_PARAM2), Imm32(info.displacement));
+
+	switch (info.operandSize)
+	{
+	case 4:
+		ABI_CallFunction((void *)&Memory::Write_U32);
+		break;
+	case 2:
+		ABI_CallFunction((void *)&Memory::Write_U16);
+		break;
+	case 1:
+		ABI_CallFunction((void *)&Memory::Write_U8);
+		break;
+	default:
+		_assert_msg_(DYNA_REC, 0, "GetWriteTrampoline: bad operand size %d", info.operandSize);
+		break;
+	}
+
+	PopRegs(INVALID_REG, frameSize);
+	RET();
+	return trampoline;
+}
+
+bool Jit::BackPatch(u8 *codePtr, bool isWrite)
+{
+	if (!IsInCodeSpace(codePtr))
+		return false;
+
+	InstructionInfo info;
+	memset(&info, 0, sizeof(info));
+	if (!DisassembleMov(codePtr, info, isWrite ? OP_ACCESS_WRITE : OP_ACCESS_READ))
+	{
+		ERROR_LOG(JIT, "BackPatch: unable to disassemble the access at %p", codePtr);
+		return false;
+	}
+	// Only the [RBX + RAX + offset] form Comp_ITypeMem emits, anything else is a real crash.
+	if (info.otherReg != RBX || info.scaledReg != RAX || info.hasImmediate)
+		return false;
+
+	const u8 *trampoline = isWrite ? trampolines_.GetWriteTrampoline(info) : trampolines_.GetReadTrampoline(info);
+	XEmitter emitter(codePtr);
+	emitter.CALL((const void *)trampoline);
+	// Accesses are padded with NOPs up to BACKPATCH_SIZE, so only longer ones need more.
+	if (info.instructionSize > BACKPATCH_SIZE)
+		emitter.NOP(info.instructionSize - BACKPATCH_SIZE);
+	return true;
+}
+
+#else
+
+void TrampolineCache::Init()
+{
+}
+
+void TrampolineCache::Clear()
+{
+}
+
+const u8 *TrampolineCache::GetReadTrampoline(const InstructionInfo &info)
+{
+	return 0;
+}
+
+const u8 *TrampolineCache::GetWriteTrampoline(const InstructionInfo &info)
+{
+	return 0;
+}
+
+bool Jit::BackPatch(u8 *codePtr, bool isWrite)
+{
+	return false;
+}
+
+#endif
+
+#ifdef FASTMEM_HANDLER
+
+static struct sigaction oldSegvAction;
+
+static void SegvHandler(int sig, siginfo_t *info, void *rawContext)
+{
+	ucontext_t *context = (ucontext_t *)rawContext;
+	u8 *faultAddress = (u8 *)info->si_addr;
+	u8 *codePtr = (u8 *)context->uc_mcontext.gregs[REG_RIP];
+	// Bit 1 of the page fault error code is set for writes.
+	bool isWrite = (context->uc_mcontext.gregs[REG_ERR] & 2) != 0;
+
+	if (MIPSComp::jit && Memory::base && faultAddress >= Memory::base && (u64)(faultAddress - Memory::base) < 0x100000000ULL)
+	{
+		// Leave RIP alone, the patched instruction is now a call to the slow path.
+		if (MIPSComp::jit->BackPatch(codePtr, isWrite))
+			return;
+	}
+
+	// Not ours. Put the old handler back and let the access fault again.
+	sigaction(SIGSEGV, &oldSegvAction, NULL);
+}
+
+bool InstallFastmemHandler()
+{
+	static bool installed = false;
+	if (installed)
+		return true;
+
+	struct sigaction sa;
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_sigaction = &SegvHandler;
+	sa.sa_flags = SA_SIGINFO;
+	sigemptyset(&sa.sa_mask);
+	if (sigaction(SIGSEGV, &sa, &oldSegvAction) != 0)
+	{
+		ERROR_LOG(JIT, "Failed to install the fastmem signal handler");
+		return false;
+	}
+	installed = true;
+	return true;
+}
+
+#else
+
+bool InstallFastmemHandler()
+{
+	return false;
+}
+
+#endif
+
+}	// namespace MIPSComp
@@ -0,0 +1,64 @@
+// Copyright (c) 2012- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#pragma once
+
+#include <map>
+
+#include "x64Emitter.h"
+#include "x64Analyzer.h"
+
+// Fastmem: with it enabled, the jit emits loads and stores as plain accesses against
+// the memory base, [RBX + RAX + offset]. Anything outside the mapped views faults, and the
+// signal handler rewrites the faulting instruction into a call to a trampoline that goes
+// through the regular Memory:: functions. Without it, accesses are range checked inline
+// and call the same trampolines when outside RAM.
+
+namespace MIPSComp
+{
+
+// Size of the CALL that replaces a faulting access, accesses are padded to at least this.
+#define BACKPATCH_SIZE 5
+
+// The trampolines preserve every register except the destination of a load,
+// so the jit can call them without flushing its register caches.
+// Each distinct access shape is emitted once and shared by every site that needs it.
+class TrampolineCache : public Gen::XCodeBlock
+{
+public:
+	void Init();
+	void Clear();
+
+	// info describes the access, as DisassembleMov returns it.
+	const u8 *GetReadTrampoline(const InstructionInfo &info);
+	const u8 *GetWriteTrampoline(const InstructionInfo &info);
+
+private:
+	const u8 *EmitReadTrampoline(const InstructionInfo &info);
+	const u8 *EmitWriteTrampoline(const InstructionInfo &info);
+	int PushRegs(Gen::X64Reg except);
+	void PopRegs(Gen::X64Reg except, int frameSize);
+
+	// Keyed by direction, size, registers, sign extension and displacement.
+	std::map<u64, const u8 *> cache_;
+};
+
+// Installs the SIGSEGV handler that backpatches fastmem accesses.
+// Returns false where fastmem isn't supported (only x64 Linux for now.)
+bool InstallFastmemHandler();
+
+}	// namespace MIPSComp
@@ -58,7 +58,7 @@ op_agent_t agent;
 
 using namespace Gen;
 
-#define INVALID_EXIT 0xFFFFFFFF
+JitExitStats jitExitStats;
 
 bool JitBlock::ContainsAddress(u32 em_address)
 {
@@ -80,6 +80,7 @@ void JitBlockCache::Init()
 #endif
 	blocks = new JitBlock[MAX_NUM_BLOCKS];
 	blockCodePointers = new const u8*[MAX_NUM_BLOCKS];
+	memset(&jitExitStats, 0, sizeof(jitExitStats));
 	Clear();
 }
 
@@ -109,12 +110,16 @@ JitBlockCache::~JitBlockCache()
 // is full and when saving and loading states.
 void JitBlockCache::Clear()
 {
+	// Drop the indexes first, no point unlinking blocks that are all going away.
+	for (int i = 0; i < JIT_NUM_PAGES; i++)
+	{
+		codePages[i].clear();
+		linkPages[i].clear();
+	}
 	for (int i = 0; i < num_blocks; i++)
 	{
 		DestroyBlock(i, false);
 	}
-	links_to.clear();
-	block_map.clear();
 	num_blocks = 0;
 	memset(blockCodePointers, 0, sizeof(u8*)*MAX_NUM_BLOCKS);
 }
@@ -169,6 +174,10 @@ int JitBlockCache::AllocateBlock(u32 em_address)
 	b.exitPtrs[1] = 0;
 	b.linkStatus[0] = false;
 	b.linkStatus[1] = false;
+	b.returnCmpPtr = 0;
+	b.returnJmpPtr = 0;
+	b.returnAddress = INVALID_EXIT;
+	b.runCount = 0;
 	b.blockNum = num_blocks;
 	num_blocks++; //commit the current block
 	return num_blocks - 1;
@@ -183,17 +192,16 @@ void JitBlockCache::FinalizeBlock(int block_num, bool block_link, const u8 *code
 	u32 opcode = MIPS_MAKE_EMUHACK(0, block_num);
 	Memory::Write_Opcode_JIT(b.originalAddress, opcode);
 	
-	// Convert the logical address to a physical address for the block map
-	// Yeah, this'll work fine for PSP too I think.
-	u32 pAddr = b.originalAddress & 0x1FFFFFFF;
+	u32 endAddress = b.originalAddress + 4 * b.originalSize;
+	for (u32 addr = b.originalAddress & ~((1 << JIT_PAGE_SHIFT) - 1); addr < endAddress; addr += 1 << JIT_PAGE_SHIFT)
+		AddToPage(codePages[GetPageIndex(addr)], block_num);
 
-	block_map[std::make_pair(pAddr + 4 * b.originalSize - 1, pAddr)] = block_num;
 	if (block_link)
 	{
 		for (int i = 0; i < 2; i++)
 		{
 			if (b.exitAddress[i] != INVALID_EXIT) 
-				links_to.insert(std::pair<u32, int>(b.exitAddress[i], block_num));
+				AddToPage(linkPages[GetPageIndex(b.exitAddress[i])], block_num);
 		}
 			
 		LinkBlock(block_num);
@@ -245,9 +253,10 @@ int JitBlockCache::GetBlockNumberFromStartAddress(u32 addr)
 
 void JitBlockCache::GetBlockNumbersFromAddress(u32 em_address, std::vector<int> *block_numbers)
 {
-	for (int i = 0; i < num_blocks; i++)
-		if (blocks[i].ContainsAddress(em_address))
-			block_numbers->push_back(i);
+	const std::vector<int> &page = codePages[GetPageIndex(em_address)];
+	for (size_t i = 0; i < page.size(); i++)
+		if (blocks[page[i]].ContainsAddress(em_address))
+			block_numbers->push_back(page[i]);
 }
 
 u32 JitBlockCache::GetOriginalFirstOp(int block_num)
@@ -265,6 +274,59 @@ CompiledCode JitBlockCache::GetCompiledCodeFromBlock(int block_num)
 	return (CompiledCode)blockCodePointers[block_num];
 }
 
+void JitBlockCache::PredictReturn(int block_num, u32 target)
+{
+	JitBlock &b = blocks[block_num];
+	if (b.invalid || !b.returnCmpPtr || b.returnAddress == target)
+		return;
+
+	// Nothing to link to until the dispatcher has compiled it. We'll get another chance.
+	int destinationBlock = GetBlockNumberFromStartAddress(target);
+	if (destinationBlock == -1)
+		return;
+
+	// The old prediction's page no longer needs to know about us, unless another link is on it too.
+	if (b.returnAddress != INVALID_EXIT)
+	{
+		int oldPage = GetPageIndex(b.returnAddress);
+		bool stillLinked = oldPage == GetPageIndex(target);
+		for (int e = 0; e < 2; e++)
+		{
+			if (b.exitAddress[e] != INVALID_EXIT && GetPageIndex(b.exitAddress[e]) == oldPage)
+				stillLinked = true;
+		}
+		if (!stillLinked)
+			RemoveFromPage(linkPages[oldPage], block_num);
+	}
+	AddToPage(linkPages[GetPageIndex(target)], block_num);
+	b.returnAddress = target;
+
+	XEmitter emit(b.returnCmpPtr);
+	emit.CMP(32, R(EAX), Imm32(target));
+	emit.SetCodePtr(b.returnJmpPtr);
+	emit.JMP(blocks[destinationBlock].checkedEntry, true);
+}
+
+void JitBlockCache::GetLinkStats(int &exits, int &linked) const
+{
+	exits = 0;
+	linked = 0;
+	for (int i = 0; i < num_blocks; i++)
+	{
+		const JitBlock &b = blocks[i];
+		if (b.invalid)
+			continue;
+		for (int e = 0; e < 2; e++)
+		{
+			if (b.exitAddress[e] == INVALID_EXIT)
+				continue;
+			exits++;
+			if (b.linkStatus[e])
+				linked++;
+		}
+	}
+}
+
 
 
 //Block linker
@@ -302,37 +364,56 @@ void JitBlockCache::LinkBlock(int i)
 {
 	LinkBlockExits(i);
 	JitBlock &b = blocks[i];
-	std::map<u32, int>::iterator iter;
-	pair<multimap<u32, int>::iterator, multimap<u32, int>::iterator> ppp;
-	// equal_range(b) returns pair<iterator,iterator> representing the range
-	// of element with key b
-	ppp = links_to.equal_range(b.originalAddress);
-	if (ppp.first == ppp.second)
-		return;
-	for (multimap<u32, int>::iterator iter2 = ppp.first; iter2 != ppp.second; ++iter2) {
-		// PanicAlert("Linking block %i to block %i", iter2->second, i);
-		LinkBlockExits(iter2->second);
+	const std::vector<int> &sources = linkPages[GetPageIndex(b.originalAddress)];
+	for (size_t j = 0; j < sources.size(); j++)
+	{
+		const JitBlock &sourceBlock = blocks[sources[j]];
+		if (sourceBlock.exitAddress[0] == b.originalAddress || sourceBlock.exitAddress[1] == b.originalAddress)
+			LinkBlockExits(sources[j]);
 	}
 }
 
 void JitBlockCache::UnlinkBlock(int i)
 {
 	JitBlock &b = blocks[i];
-	std::map<u32, int>::iterator iter;
-	pair<multimap<u32, int>::iterator, multimap<u32, int>::iterator> ppp;
-	ppp = links_to.equal_range(b.originalAddress);
-	if (ppp.first == ppp.second)
-		return;
-	for (multimap<u32, int>::iterator iter2 = ppp.first; iter2 != ppp.second; ++iter2) {
-		JitBlock &sourceBlock = blocks[iter2->second];
+	std::vector<int> &sources = linkPages[GetPageIndex(b.originalAddress)];
+	for (size_t j = 0; j < sources.size(); j++)
+	{
+		JitBlock &sourceBlock = blocks[sources[j]];
 		for (int e = 0; e < 2; e++)
 		{
-			if (sourceBlock.exitAddress[e] == b.originalAddress)
-				sourceBlock.linkStatus[e] = false;
+			if (sourceBlock.exitAddress[e] == b.originalAddress && sourceBlock.linkStatus[e])
+				UnlinkExit(sourceBlock, e);
 		}
+		// Predictions are simply forgotten, they'll be relearned if the block comes back.
+		if (sourceBlock.returnAddress == b.originalAddress)
+			ResetReturnPrediction(sourceBlock);
 	}
 }
 
+// Puts back the exit code WriteExit generated, so the source block doesn't
+// bounce through the dead block on its way to the dispatcher.
+void JitBlockCache::UnlinkExit(JitBlock &b, int e)
+{
+	b.linkStatus[e] = false;
+	if (b.invalid)
+		return;
+	XEmitter emit(b.exitPtrs[e]);
+	emit.MOV(32, M(&mips->pc), Imm32(b.exitAddress[e]));
+	emit.JMP(MIPSComp::jit->Asm().dispatcher, true);
+}
+
+void JitBlockCache::ResetReturnPrediction(JitBlock &b)
+{
+	b.returnAddress = INVALID_EXIT;
+	if (b.invalid)
+		return;
+	XEmitter emit(b.returnCmpPtr);
+	emit.CMP(32, R(EAX), Imm32(INVALID_EXIT));
+	emit.SetCodePtr(b.returnJmpPtr);
+	emit.JMP(MIPSComp::jit->Asm().dispatcher, true);
+}
+
 void JitBlockCache::DestroyBlock(int block_num, bool invalidate)
 {
 	if (block_num < 0 || block_num >= num_blocks)
@@ -351,12 +432,24 @@ void JitBlockCache::DestroyBlock(int block_num, bool invalidate)
 #ifdef JIT_UNLIMITED_ICACHE
 	Memory::Write_Opcode_JIT(b.originalAddress, b.originalFirstOpcode?b.originalFirstOpcode:JIT_ICACHE_INVALID_WORD);
 #else
-	if (Memory::ReadUnchecked_U32(b.originalAddress) == (u32)block_num)
+	if (Memory::ReadUnchecked_U32(b.originalAddress) == MIPS_MAKE_EMUHACK(0, block_num))
 		Memory::WriteUnchecked_U32(b.originalFirstOpcode, b.originalAddress);
 #endif
 
 	UnlinkBlock(block_num);
 
+	// This block won't jump anywhere anymore, so drop it from the indexes.
+	u32 endAddress = b.originalAddress + 4 * b.originalSize;
+	for (u32 addr = b.originalAddress & ~((1 << JIT_PAGE_SHIFT) - 1); addr < endAddress; addr += 1 << JIT_PAGE_SHIFT)
+		RemoveFromPage(codePages[GetPageIndex(addr)], block_num);
+	for (int e = 0; e < 2; e++)
+	{
+		if (b.exitAddress[e] != INVALID_EXIT)
+			RemoveFromPage(linkPages[GetPageIndex(b.exitAddress[e])], block_num);
+	}
+	if (b.returnAddress != INVALID_EXIT)
+		RemoveFromPage(linkPages[GetPageIndex(b.returnAddress)], block_num);
+
 	// Send anyone who tries to run this block back to the dispatcher.
 	// Not entirely ideal, but .. pretty good.
 	// Spurious entrances from previously linked blocks can only come through checkedEntry
@@ -374,19 +467,61 @@ void JitBlockCache::DestroyBlock(int block_num, bool invalidate)
 
 void JitBlockCache::InvalidateICache(u32 address, const u32 length)
 {
-	// Convert the logical address to a physical address for the block map
+	// Convert the logical address to a physical address for the page index
 	u32 pAddr = address & 0x1FFFFFFF;
+	u32 pEnd = pAddr + length;
+
+	const u32 ramStart = PSP_GetKernelMemoryBase();
+	const u32 ramEnd = ramStart + Memory::RAM_SIZE;
+	u32 first = std::max(pAddr, ramStart);
+	u32 last = std::min(pEnd, ramEnd);
+	if (first < last)
+	{
+		int firstPage = (first - ramStart) >> JIT_PAGE_SHIFT;
+		int lastPage = (last - 1 - ramStart) >> JIT_PAGE_SHIFT;
+		for (int page = firstPage; page <= lastPage; page++)
+			InvalidatePage(page, pAddr, pEnd);
+	}
+	if (pAddr < ramStart || pEnd > ramEnd)
+		InvalidatePage(JIT_NUM_PAGES - 1, pAddr, pEnd);
+}
 
-	// destroy JIT blocks
-	// !! this works correctly under assumption that any two overlapping blocks end at the same address
-	std::map<pair<u32,u32>, u32>::iterator it1 = block_map.lower_bound(std::make_pair(pAddr, 0)), it2 = it1, it;
-	while (it2 != block_map.end() && it2->first.second < pAddr + length)
+void JitBlockCache::InvalidatePage(int page, u32 pAddr, u32 pEnd)
+{
+	std::vector<int> &blockList = codePages[page];
+	for (size_t i = 0; i < blockList.size(); )
 	{
-		DestroyBlock(it2->second, true);
-		it2++;
+		const JitBlock &b = blocks[blockList[i]];
+		u32 blockStart = b.originalAddress & 0x1FFFFFFF;
+		u32 blockEnd = blockStart + 4 * b.originalSize;
+		// DestroyBlock removes it from the list, so don't advance in that case.
+		if (blockStart < pEnd && blockEnd > pAddr)
+			DestroyBlock(blockList[i], true);
+		else
+			i++;
 	}
-	if (it1 != it2)
+}
+
+int JitBlockCache::GetPageIndex(u32 em_address)
+{
+	u32 offset = (em_address & 0x1FFFFFFF) - PSP_GetKernelMemoryBase();
+	if (offset < Memory::RAM_SIZE)
+		return offset >> JIT_PAGE_SHIFT;
+	return JIT_NUM_PAGES - 1;
+}
+
+void JitBlockCache::AddToPage(std::vector<int> &page, int block_num)
+{
+	if (std::find(page.begin(), page.end(), block_num) == page.end())
+		page.push_back(block_num);
+}
+
+void JitBlockCache::RemoveFromPage(std::vector<int> &page, int block_num)
+{
+	std::vector<int>::iterator iter = std::find(page.begin(), page.end(), block_num);
+	if (iter != page.end())
 	{
-		block_map.erase(it1, it2);
+		*iter = page.back();
+		page.pop_back();
 	}
 }
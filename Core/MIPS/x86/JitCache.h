@@ -17,11 +17,13 @@
 
 #pragma once
 
+#include <algorithm>
 #include <map>
 #include <vector>
 #include <string>
 
 #include "../MIPSAnalyst.h"
+#include "../../MemMap.h"
 
 // Define this in order to get VTune profile support for the Jit generated code.
 // Add the VTune include/lib directories to the project directories to get this to build.
@@ -42,6 +44,8 @@
 
 #define JIT_OPCODE 0xFFCCCCCC	// yeah this ain't gonna work
 
+#define INVALID_EXIT 0xFFFFFFFF
+
 struct JitBlock
 {
 	const u8 *checkedEntry;
@@ -50,6 +54,12 @@ struct JitBlock
 	u8 *exitPtrs[2];		 // to be able to rewrite the exit jum
 	u32 exitAddress[2];	// 0xFFFFFFFF == unknown
 
+	// Blocks ending in jr ra have an inline cache in front of the exit: a compare
+	// against the predicted return address and a jump that gets linked to that block.
+	u8 *returnCmpPtr;
+	u8 *returnJmpPtr;
+	u32 returnAddress;	// INVALID_EXIT == no prediction yet
+
 	u32 originalAddress;
 	u32 originalFirstOpcode; //to be able to restore
 	u32 codeSize; 
@@ -77,14 +87,34 @@ struct JitBlock
 
 typedef void (*CompiledCode)();
 
+// Counted by the generated code. Linked exits jump straight to the next block and
+// never show up here, everything else goes through the dispatcher.
+struct JitExitStats
+{
+	u32 dispatches;
+	u32 returnHits;
+	u32 returnMisses;
+};
+
+extern JitExitStats jitExitStats;
+
 class JitBlockCache
 {
 	MIPSState *mips;
 	const u8 **blockCodePointers;
 	JitBlock *blocks;
 	int num_blocks;
-	std::multimap<u32, int> links_to;
-	std::map<std::pair<u32,u32>, u32> block_map; // (end_addr, start_addr) -> number
+
+	// Page granular indexes over physical RAM. Anything outside RAM shares the last page.
+	// codePages lists the blocks whose code overlaps each page, linkPages the blocks
+	// that have an exit or a return prediction into it (those may be stale, check.)
+	enum
+	{
+		JIT_PAGE_SHIFT = 12,
+		JIT_NUM_PAGES = (Memory::RAM_SIZE >> JIT_PAGE_SHIFT) + 1,
+	};
+	std::vector<int> codePages[JIT_NUM_PAGES];
+	std::vector<int> linkPages[JIT_NUM_PAGES];
 
 	int MAX_NUM_BLOCKS;
 
@@ -92,6 +122,13 @@ class JitBlockCache
 	void LinkBlockExits(int i);
 	void LinkBlock(int i);
 	void UnlinkBlock(int i);
+	void UnlinkExit(JitBlock &b, int e);
+	void ResetReturnPrediction(JitBlock &b);
+
+	static int GetPageIndex(u32 em_address);
+	void AddToPage(std::vector<int> &page, int block_num);
+	void RemoveFromPage(std::vector<int> &page, int block_num);
+	void InvalidatePage(int page, u32 pAddr, u32 pEnd);
 
 public:
 	JitBlockCache(MIPSState *mips_) :
@@ -120,12 +157,17 @@ public:
 	// slower, but can get numbers from within blocks, not just the first instruction.
 	// WARNING! WILL NOT WORK WITH INLINING ENABLED (not yet a feature but will be soon)
 	// Returns a list of block numbers - only one block can start at a particular address, but they CAN overlap.
-	// This one is slow so should only be used for one-shots from the debugger UI, not for anything during runtime.
 	void GetBlockNumbersFromAddress(u32 em_address, std::vector<int> *block_numbers);
 
 	u32 GetOriginalFirstOp(int block_num);
 	CompiledCode GetCompiledCodeFromBlock(int block_num);
 
+	// Called from the generated code when a jr ra exit missed its prediction.
+	void PredictReturn(int block_num, u32 target);
+
+	// Static counts of direct exits, and how many of them are currently linked.
+	void GetLinkStats(int &exits, int &linked) const;
+
 	// DOES NOT WORK CORRECTLY WITH INLINING
 	void InvalidateICache(u32 address, const u32 length);
 	void DestroyBlock(int block_num, bool invalidate);
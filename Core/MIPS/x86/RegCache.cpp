@@ -38,7 +38,7 @@ static const int allocationOrder[] =
 #endif
 };
 
-RegCache::RegCache() : emit(0), mips(0) {
+RegCache::RegCache() : numRegs(NUM_MIPS_GPRS), emit(0), analysis(0), compilerPC(0), mips(0) {
 	memset(locks, 0, sizeof(locks));
 	memset(xlocks, 0, sizeof(xlocks));
 	memset(saved_locks, 0, sizeof(saved_locks));
@@ -52,13 +52,15 @@ RegCache::RegCache() : emit(0), mips(0) {
 void RegCache::Start(MIPSState *mips, MIPSAnalyst::AnalysisResults &stats)
 {
   this->mips = mips;
+	analysis = &stats;
+	compilerPC = stats.start;
 	for (int i = 0; i < NUMXREGS; i++)
 	{
 		xregs[i].free = true;
 		xregs[i].dirty = false;
 		xlocks[i] = false;
 	}
-	for (int i = 0; i < 32; i++)
+	for (int i = 0; i < numRegs; i++)
 	{
 		regs[i].location = GetDefaultLocation(i);
 		regs[i].away = false;
@@ -109,7 +111,7 @@ bool RegCache::IsFreeX(int xreg) const
 
 void RegCache::UnlockAll()
 {
-	for (int i = 0; i < 32; i++)
+	for (int i = 0; i < numRegs; i++)
 		locks[i] = false;
 }
 
@@ -142,7 +144,10 @@ X64Reg RegCache::GetFreeXReg()
 		int preg = xregs[xr].mipsReg;
 		if (!locks[preg])
 		{
-			StoreFromRegister(preg);
+			if (IsLive(preg))
+				StoreFromRegister(preg);
+			else
+				DiscardRegContentsIfCached(preg);
 			return xr;
 		}
 	}
@@ -179,7 +184,7 @@ void RegCache::FlushR(X64Reg reg)
 
 int RegCache::SanityCheck() const
 {
-	for (int i = 0; i < 32; i++) {
+	for (int i = 0; i < numRegs; i++) {
 		if (regs[i].away) {
 			if (regs[i].location.IsSimpleReg()) {
 				Gen::X64Reg simple = regs[i].location.GetSimpleReg();
@@ -221,11 +226,29 @@ void GPRRegCache::Start(MIPSState *mips, MIPSAnalyst::AnalysisResults &stats)
 	RegCache::Start(mips, stats);
 }
 
+static float tempValues[FPURegCache::NUM_TEMPS];
+
+FPURegCache::FPURegCache()
+{
+	numRegs = NUM_MIPS_FPRS;
+}
+
 void FPURegCache::Start(MIPSState *mips, MIPSAnalyst::AnalysisResults &stats)
 {
 	RegCache::Start(mips, stats);
 }
 
+bool GPRRegCache::IsLive(int preg) const
+{
+	return !analysis || analysis->IsGPRLive(compilerPC, preg);
+}
+
+bool FPURegCache::IsLive(int preg) const
+{
+	// Only the FPU regs are analyzed, VFPU regs and temps are always kept.
+	return !analysis || preg >= 32 || analysis->IsFPRLive(compilerPC, preg);
+}
+
 const int *GPRRegCache::GetAllocationOrder(int &count)
 {
 	count = sizeof(allocationOrder) / sizeof(const int);
@@ -253,7 +276,12 @@ OpArg GPRRegCache::GetDefaultLocation(int reg) const
 
 OpArg FPURegCache::GetDefaultLocation(int reg) const
 {
-	return M(&mips->f[reg]);
+	if (reg < VREG0)
+		return M(&mips->f[reg]);
+	else if (reg < TEMP0)
+		return M(&mips->v[reg - VREG0]);
+	else
+		return M(&tempValues[reg - TEMP0]);
 }
 
 void RegCache::KillImmediate(int preg, bool doLoad, bool makeDirty)
@@ -281,7 +309,7 @@ void GPRRegCache::BindToRegister(int i, bool doLoad, bool makeDirty)
 		xregs[xr].mipsReg = i;
 		xregs[xr].dirty = makeDirty || regs[i].location.IsImm();
 		OpArg newloc = ::Gen::R(xr);
-		if (doLoad)
+		if (doLoad && IsLive(i))
 			emit->MOV(32, newloc, regs[i].location);
 		for (int j = 0; j < 32; j++)
 		{
@@ -342,7 +370,7 @@ void FPURegCache::BindToRegister(int i, bool doLoad, bool makeDirty)
 		xregs[xr].free = false;
 		xregs[xr].dirty = makeDirty;
 		OpArg newloc = ::Gen::R(xr);
-		if (doLoad)
+		if (doLoad && IsLive(i))
 		{
 			if (!regs[i].location.IsImm() && (regs[i].location.offset & 0x3))
 			{
@@ -385,13 +413,20 @@ void RegCache::Flush(FlushMode mode)
 		if (xlocks[i])
 			PanicAlert("Someone forgot to unlock X64 reg %i.", i);
 	}
-	for (int i = 0; i < 32; i++)
+	for (int i = 0; i < numRegs; i++)
 	{
 		if (locks[i])
 		{
 			PanicAlert("Somebody forgot to unlock PPC reg %i.", i);
 		}
-		if (regs[i].away)
+		if (regs[i].away && !IsLive(i))
+		{
+			// Overwritten later in the block anyway, no need to write it back.
+			DiscardRegContentsIfCached(i);
+			regs[i].away = false;
+			regs[i].location = GetDefaultLocation(i);
+		}
+		else if (regs[i].away)
 		{
 			if (regs[i].location.IsSimpleReg())
 			{
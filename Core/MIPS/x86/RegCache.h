@@ -54,24 +54,34 @@ typedef int PReg;
 #define NUMXREGS 8
 #endif
 
+// The FPU cache also holds the VFPU regs, one lane each, plus some temps.
+#define NUM_MIPS_GPRS 32
+#define NUM_MIPS_FPRS (32 + 128 + 16)
+
 class RegCache
 {
 private:
-	bool locks[32];
-	bool saved_locks[32];
+	bool locks[NUM_MIPS_FPRS];
+	bool saved_locks[NUM_MIPS_FPRS];
 	bool saved_xlocks[NUMXREGS];
 
 protected:
 	bool xlocks[NUMXREGS];
-	MIPSCachedReg regs[32];
+	MIPSCachedReg regs[NUM_MIPS_FPRS];
 	X64CachedReg xregs[NUMXREGS];
+	int numRegs;
 
-	MIPSCachedReg saved_regs[32];
+	MIPSCachedReg saved_regs[NUM_MIPS_FPRS];
 	X64CachedReg saved_xregs[NUMXREGS];
 
 	virtual const int *GetAllocationOrder(int &count) = 0;
+	// False if the analysis says the value will be overwritten before anyone reads it,
+	// in which case it doesn't need to be loaded or stored back.
+	virtual bool IsLive(int preg) const = 0;
 	
 	XEmitter *emit;
+	const MIPSAnalyst::AnalysisResults *analysis;
+	u32 compilerPC;
 
 public:
   MIPSState *mips;
@@ -82,6 +92,7 @@ public:
 
 	void DiscardRegContentsIfCached(int preg);
 	void SetEmitter(XEmitter *emitter) {emit = emitter;}
+	void SetCompilerPC(u32 pc) {compilerPC = pc;}
 
 	void FlushR(X64Reg reg); 
 	void FlushR(X64Reg reg, X64Reg reg2) {FlushR(reg); FlushR(reg2);}
@@ -135,6 +146,7 @@ public:
 	void StoreFromRegister(int preg);
 	OpArg GetDefaultLocation(int reg) const;
 	const int *GetAllocationOrder(int &count);
+	bool IsLive(int preg) const;
 	void SetImmediate32(int preg, u32 immValue);
 };
 
@@ -142,9 +154,26 @@ public:
 class FPURegCache : public RegCache
 {
 public:
+	enum
+	{
+		// VFPU reg v is cached as VREG0 + v.
+		VREG0 = 32,
+		// Scratch values, for prefixes and results that can't be written directly.
+		TEMP0 = 32 + 128,
+		NUM_TEMPS = 16,
+	};
+
+	FPURegCache();
 	void Start(MIPSState *mips, MIPSAnalyst::AnalysisResults &stats);
 	void BindToRegister(int preg, bool doLoad = true, bool makeDirty = true);
 	void StoreFromRegister(int preg);
 	const int *GetAllocationOrder(int &count);
 	OpArg GetDefaultLocation(int reg) const;
+	bool IsLive(int preg) const;
+
+	void DiscardTemps()
+	{
+		for (int i = TEMP0; i < TEMP0 + NUM_TEMPS; i++)
+			DiscardRegContentsIfCached(i);
+	}
 };
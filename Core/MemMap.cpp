@@ -84,6 +84,9 @@ void Init()
 
 void DoState(PointerWrap &p)
 {
+	if (!p.Section("Memory", 1, 1))
+		return;
+
 	p.DoArray(m_pRAM, RAM_SIZE);
 	p.DoMarker("RAM");
 	p.DoArray(m_pVRAM, VRAM_SIZE);
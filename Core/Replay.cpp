@@ -0,0 +1,257 @@
+// Copyright (c) 2012- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#include <cstring>
+#include <vector>
+
+#include "FileUtil.h"
+
+#include "Replay.h"
+
+// The stream is a small header and then items: a one byte ReplayAction and its payload.
+// Controller samples repeat most of the time, those are a single REPLAY_CTRL_UNCHANGED.
+static const u32 REPLAY_MAGIC = 0x50525050;  // "PPRP"
+static const u32 REPLAY_VERSION = 1;
+// Recordings are written out in pieces of about this size.
+static const size_t REPLAY_FLUSH_SIZE = 256 * 1024;
+
+enum ReplayState
+{
+	REPLAY_STATE_IDLE,
+	REPLAY_STATE_RECORDING,
+	REPLAY_STATE_PLAYING,
+};
+
+struct ReplayHeader
+{
+	u32 magic;
+	u32 version;
+};
+
+static ReplayState replayState = REPLAY_STATE_IDLE;
+static bool replayDesynced = false;
+static File::IOFile replayFile;
+static std::vector<u8> replayBuffer;
+static size_t replayPos;
+static u32 lastButtons;
+static u8 lastAnalog[2];
+
+static void ResetLastCtrl()
+{
+	lastButtons = 0;
+	lastAnalog[0] = 128;
+	lastAnalog[1] = 128;
+}
+
+static void FlushRecording()
+{
+	if (!replayBuffer.empty())
+		replayFile.WriteBytes(&replayBuffer[0], replayBuffer.size());
+	replayBuffer.clear();
+}
+
+static void RecordBytes(const void *data, size_t size)
+{
+	const u8 *p = (const u8 *)data;
+	replayBuffer.insert(replayBuffer.end(), p, p + size);
+}
+
+static void RecordAction(ReplayAction action)
+{
+	replayBuffer.push_back((u8)action);
+	if (replayBuffer.size() >= REPLAY_FLUSH_SIZE)
+		FlushRecording();
+}
+
+static void Desync(ReplayAction action)
+{
+	ERROR_LOG(HLE, "Replay desynced at offset %d, wanted action %d", (int)replayPos, (int)action);
+	replayDesynced = true;
+	replayState = REPLAY_STATE_IDLE;
+	replayBuffer.clear();
+}
+
+// Consumes the next action if it's one of the wanted ones. Returns 0 if not.
+static ReplayAction PlayAction(ReplayAction wanted, ReplayAction alternative = (ReplayAction)0)
+{
+	if (replayPos < replayBuffer.size())
+	{
+		ReplayAction action = (ReplayAction)replayBuffer[replayPos];
+		if (action == wanted || (alternative != 0 && action == alternative))
+		{
+			replayPos++;
+			return action;
+		}
+	}
+	Desync(wanted);
+	return (ReplayAction)0;
+}
+
+static bool PlayBytes(ReplayAction action, void *data, size_t size)
+{
+	if (replayPos + size > replayBuffer.size())
+	{
+		Desync(action);
+		return false;
+	}
+	memcpy(data, &replayBuffer[replayPos], size);
+	replayPos += size;
+	return true;
+}
+
+bool Replay_BeginRecord(const std::string &filename)
+{
+	Replay_End();
+
+	replayFile.Open(filename, "wb");
+	ReplayHeader header = {REPLAY_MAGIC, REPLAY_VERSION};
+	if (!replayFile || !replayFile.WriteArray(&header, 1))
+	{
+		ERROR_LOG(HLE, "Unable to create replay %s", filename.c_str());
+		replayFile.Close();
+		return false;
+	}
+
+	replayBuffer.clear();
+	replayBuffer.reserve(REPLAY_FLUSH_SIZE + 1024);
+	ResetLastCtrl();
+	replayDesynced = false;
+	replayState = REPLAY_STATE_RECORDING;
+	return true;
+}
+
+bool Replay_BeginPlayback(const std::string &filename)
+{
+	Replay_End();
+
+	File::IOFile file(filename, "rb");
+	u64 size = file ? file.GetSize() : 0;
+	ReplayHeader header;
+	if (size < sizeof(header) || !file.ReadArray(&header, 1) || header.magic != REPLAY_MAGIC || header.version != REPLAY_VERSION)
+	{
+		ERROR_LOG(HLE, "Unable to read replay %s", filename.c_str());
+		return false;
+	}
+
+	replayBuffer.resize((size_t)size - sizeof(header));
+	if (!replayBuffer.empty() && !file.ReadBytes(&replayBuffer[0], replayBuffer.size()))
+	{
+		ERROR_LOG(HLE, "Unable to read replay %s", filename.c_str());
+		replayBuffer.clear();
+		return false;
+	}
+
+	replayPos = 0;
+	ResetLastCtrl();
+	replayDesynced = false;
+	replayState = REPLAY_STATE_PLAYING;
+	return true;
+}
+
+void Replay_End()
+{
+	if (replayState == REPLAY_STATE_RECORDING)
+	{
+		FlushRecording();
+		replayFile.Close();
+	}
+	else if (replayState == REPLAY_STATE_PLAYING && replayPos != replayBuffer.size())
+		WARN_LOG(HLE, "Replay stopped with %d bytes left", (int)(replayBuffer.size() - replayPos));
+
+	replayBuffer.clear();
+	replayState = REPLAY_STATE_IDLE;
+}
+
+bool Replay_IsRecording()
+{
+	return replayState == REPLAY_STATE_RECORDING;
+}
+
+bool Replay_IsPlaying()
+{
+	return replayState == REPLAY_STATE_PLAYING;
+}
+
+bool Replay_HasDesynced()
+{
+	return replayDesynced;
+}
+
+void Replay_Ctrl(u32 &buttons, u8 analog[2])
+{
+	switch (replayState)
+	{
+	case REPLAY_STATE_RECORDING:
+		if (buttons == lastButtons && analog[0] == lastAnalog[0] && analog[1] == lastAnalog[1])
+			RecordAction(REPLAY_CTRL_UNCHANGED);
+		else
+		{
+			RecordAction(REPLAY_CTRL);
+			RecordBytes(&buttons, sizeof(buttons));
+			RecordBytes(analog, 2);
+			lastButtons = buttons;
+			lastAnalog[0] = analog[0];
+			lastAnalog[1] = analog[1];
+		}
+		break;
+
+	case REPLAY_STATE_PLAYING:
+		{
+			ReplayAction action = PlayAction(REPLAY_CTRL, REPLAY_CTRL_UNCHANGED);
+			if (action == REPLAY_CTRL)
+			{
+				if (!PlayBytes(action, &lastButtons, sizeof(lastButtons)) || !PlayBytes(action, lastAnalog, 2))
+					break;
+			}
+			else if (action != REPLAY_CTRL_UNCHANGED)
+				break;
+			buttons = lastButtons;
+			analog[0] = lastAnalog[0];
+			analog[1] = lastAnalog[1];
+		}
+		break;
+
+	default:
+		break;
+	}
+}
+
+u64 Replay_Value(ReplayAction action, u64 value)
+{
+	Replay_Data(action, &value, sizeof(value));
+	return value;
+}
+
+void Replay_Data(ReplayAction action, void *data, u32 size)
+{
+	switch (replayState)
+	{
+	case REPLAY_STATE_RECORDING:
+		RecordAction(action);
+		RecordBytes(data, size);
+		break;
+
+	case REPLAY_STATE_PLAYING:
+		// PlayBytes leaves data alone if the recording ends early.
+		if (PlayAction(action) == action)
+			PlayBytes(action, data, size);
+		break;
+
+	default:
+		break;
+	}
+}
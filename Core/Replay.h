@@ -0,0 +1,60 @@
+// Copyright (c) 2012- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#pragma once
+
+#include <string>
+
+#include "../Globals.h"
+
+// Records everything the host feeds into the emulated machine that isn't a function of
+// emulated time: controller state as it's latched each vblank, wall clock reads and file
+// stats. Playing that back makes a run repeat exactly, as long as it starts from the same
+// boot (or save state) with the same settings.
+//
+// The hooks below are called where those values enter the machine, always on the cpu
+// thread. When recording they log the value, when playing back they replace it with
+// the logged one, and otherwise they do nothing.
+
+enum ReplayAction
+{
+	REPLAY_CTRL = 1,
+	REPLAY_CTRL_UNCHANGED = 2,
+	REPLAY_CTRL_PEEK = 3,
+	REPLAY_RTC_CLOCK = 4,
+	REPLAY_RTC_LOCAL_CLOCK = 5,
+	REPLAY_LIBC_CLOCK = 6,
+	REPLAY_LIBC_TIME = 7,
+	REPLAY_LIBC_TIMEOFDAY = 8,
+	REPLAY_IO_STAT = 9,
+};
+
+bool Replay_BeginRecord(const std::string &filename);
+bool Replay_BeginPlayback(const std::string &filename);
+// Writes out the rest of a recording, or stops playback.
+void Replay_End();
+
+bool Replay_IsRecording();
+bool Replay_IsPlaying();
+// True once playback asked for something the recording doesn't have next. Playback
+// stops there and the run continues with live values.
+bool Replay_HasDesynced();
+
+// Controller state sampled at vblank.
+void Replay_Ctrl(u32 &buttons, u8 analog[2]);
+u64 Replay_Value(ReplayAction action, u64 value);
+void Replay_Data(ReplayAction action, void *data, u32 size);
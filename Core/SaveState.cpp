@@ -0,0 +1,510 @@
+// Copyright (c) 2012- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#include <algorithm>
+#include <cstring>
+
+#include "ChunkFile.h"
+#include "FileUtil.h"
+#include "StdThread.h"
+#include "zlib.h"
+
+#include "SaveState.h"
+#include "CoreTiming.h"
+#include "MemMap.h"
+#include "System.h"
+#include "MIPS/MIPS.h"
+#include "MIPS/MIPSIntBlockCache.h"
+#include "MIPS/MIPSTables.h"
+#include "MIPS/JitCommon/JitCommon.h"
+#include "HLE/sceKernel.h"
+#include "../GPU/GPUState.h"
+
+namespace SaveState
+{
+	// Bump on any change that makes old states unreadable, sections version themselves.
+	static const int STATE_REVISION = 2;
+
+	// State files are a header, a table of chunks and then the chunks, each deflated on
+	// its own so they can be compressed and decompressed in parallel. Pages that are all
+	// zero, like most of untouched RAM, are left out and only marked in the table.
+	static const u32 STATE_FILE_MAGIC = 0x54535050;  // "PPST"
+	static const int STATE_PAGE_SIZE = 4096;
+	static const int STATE_PAGES_PER_CHUNK = 32;
+	static const size_t STATE_CHUNK_SIZE = STATE_PAGE_SIZE * STATE_PAGES_PER_CHUNK;
+	static const unsigned MAX_STATE_THREADS = 8;
+
+	struct StateFileHeader
+	{
+		u32 magic;
+		int revision;
+		u32 size;
+		u32 numChunks;
+	};
+
+	struct StateChunkInfo
+	{
+		// 0 if every page is zero.
+		u32 compressedSize;
+		// Bit n is set when page n of the chunk is all zero.
+		u32 zeroPages;
+	};
+
+	// Worker n does chunks n, n + step, n + step * 2, ...
+	struct StateChunkJob
+	{
+		u8 *state;
+		size_t stateSize;
+		StateChunkInfo *info;
+		u32 numChunks;
+		// Per chunk output when saving.
+		std::vector<u8> *compressed;
+		// The whole file and where each chunk starts in it when loading.
+		const u8 *fileData;
+		const size_t *offsets;
+		u32 first;
+		u32 step;
+		bool failed;
+	};
+
+	static bool IsZeroPage(const u8 *page, size_t size)
+	{
+		// States are padded to whole words, see SaveToRam.
+		const u32 *words = (const u32 *)page;
+		for (size_t i = 0; i < size / 4; i++)
+		{
+			if (words[i] != 0)
+				return false;
+		}
+		return true;
+	}
+
+	static void CompressChunks(StateChunkJob *job)
+	{
+		std::vector<u8> packed(STATE_CHUNK_SIZE);
+		for (u32 c = job->first; c < job->numChunks; c += job->step)
+		{
+			size_t start = c * STATE_CHUNK_SIZE;
+			size_t size = std::min(STATE_CHUNK_SIZE, job->stateSize - start);
+
+			u32 zeroPages = 0;
+			size_t packedSize = 0;
+			for (int page = 0; page * STATE_PAGE_SIZE < (int)size; page++)
+			{
+				const u8 *data = job->state + start + page * STATE_PAGE_SIZE;
+				size_t pageSize = std::min((size_t)STATE_PAGE_SIZE, size - page * STATE_PAGE_SIZE);
+				if (IsZeroPage(data, pageSize))
+					zeroPages |= 1 << page;
+				else
+				{
+					memcpy(&packed[packedSize], data, pageSize);
+					packedSize += pageSize;
+				}
+			}
+
+			std::vector<u8> &out = job->compressed[c];
+			job->info[c].zeroPages = zeroPages;
+			job->info[c].compressedSize = 0;
+			out.clear();
+			if (packedSize == 0)
+				continue;
+
+			// Speed over size, a save should fit in a frame or so.
+			uLongf outSize = compressBound((uLong)packedSize);
+			out.resize(outSize);
+			if (compress2(&out[0], &outSize, &packed[0], (uLong)packedSize, Z_BEST_SPEED) != Z_OK)
+			{
+				job->failed = true;
+				return;
+			}
+			out.resize(outSize);
+			job->info[c].compressedSize = (u32)outSize;
+		}
+	}
+
+	static void DecompressChunks(StateChunkJob *job)
+	{
+		std::vector<u8> packed(STATE_CHUNK_SIZE);
+		for (u32 c = job->first; c < job->numChunks; c += job->step)
+		{
+			size_t start = c * STATE_CHUNK_SIZE;
+			size_t size = std::min(STATE_CHUNK_SIZE, job->stateSize - start);
+			const StateChunkInfo &info = job->info[c];
+
+			size_t expected = 0;
+			for (int page = 0; page * STATE_PAGE_SIZE < (int)size; page++)
+			{
+				if (!(info.zeroPages & (1 << page)))
+					expected += std::min((size_t)STATE_PAGE_SIZE, size - page * STATE_PAGE_SIZE);
+			}
+
+			uLongf packedSize = 0;
+			if (info.compressedSize != 0)
+			{
+				packedSize = STATE_CHUNK_SIZE;
+				if (uncompress(&packed[0], &packedSize, job->fileData + job->offsets[c], info.compressedSize) != Z_OK)
+				{
+					job->failed = true;
+					return;
+				}
+			}
+			if (packedSize != expected)
+			{
+				job->failed = true;
+				return;
+			}
+
+			const u8 *in = &packed[0];
+			for (int page = 0; page * STATE_PAGE_SIZE < (int)size; page++)
+			{
+				u8 *data = job->state + start + page * STATE_PAGE_SIZE;
+				size_t pageSize = std::min((size_t)STATE_PAGE_SIZE, size - page * STATE_PAGE_SIZE);
+				if (info.zeroPages & (1 << page))
+					memset(data, 0, pageSize);
+				else
+				{
+					memcpy(data, in, pageSize);
+					in += pageSize;
+				}
+			}
+		}
+	}
+
+	// Runs func over all chunks on up to MAX_STATE_THREADS threads, this one included.
+	static bool RunStateChunkJobs(void (*func)(StateChunkJob *), const StateChunkJob &proto)
+	{
+		unsigned numThreads = std::max(1U, std::min(std::thread::hardware_concurrency(), MAX_STATE_THREADS));
+		numThreads = std::max(1U, std::min(numThreads, (unsigned)proto.numChunks));
+
+		std::vector<StateChunkJob> jobs(numThreads, proto);
+		std::vector<std::thread *> threads;
+		for (unsigned i = 0; i < numThreads; i++)
+		{
+			jobs[i].first = i;
+			jobs[i].step = numThreads;
+			jobs[i].failed = false;
+			if (i != 0)
+				threads.push_back(new std::thread(func, &jobs[i]));
+		}
+		func(&jobs[0]);
+
+		for (size_t i = 0; i < threads.size(); i++)
+		{
+			threads[i]->join();
+			delete threads[i];
+		}
+
+		for (unsigned i = 0; i < numThreads; i++)
+		{
+			if (jobs[i].failed)
+				return false;
+		}
+		return true;
+	}
+
+	void DoState(PointerWrap &p)
+	{
+		if (!p.Section("SaveState", 1, 1))
+			return;
+
+		// Compiled blocks leave emuhack ops in RAM. Dropping them all first means a saved state
+		// only holds the original code, and a loaded one can't get this session's ops written over it.
+		if (MIPSComp::jit)
+			MIPSComp::jit->ClearCache();
+		intBlockCache.Clear();
+		MIPSInterpret_ClearIdleLoops();
+
+		Memory::DoState(p);
+		CoreTiming::DoState(p);
+		mipsr4k.DoState(p);
+		// The kernel before the file system, loading objects closes the old files.
+		__KernelDoState(p);
+		pspFileSystem.DoState(p);
+		GPU_DoState(p);
+		p.DoMarker("SaveState");
+	}
+
+	bool Save(const std::string &filename)
+	{
+		std::vector<u8> state;
+		SaveToRam(state);
+
+		StateFileHeader header;
+		header.magic = STATE_FILE_MAGIC;
+		header.revision = STATE_REVISION;
+		header.size = (u32)state.size();
+		header.numChunks = (u32)((state.size() + STATE_CHUNK_SIZE - 1) / STATE_CHUNK_SIZE);
+
+		std::vector<StateChunkInfo> info(header.numChunks);
+		std::vector<std::vector<u8> > compressed(header.numChunks);
+
+		StateChunkJob job = {0};
+		job.state = &state[0];
+		job.stateSize = state.size();
+		job.info = &info[0];
+		job.numChunks = header.numChunks;
+		job.compressed = &compressed[0];
+		if (!RunStateChunkJobs(&CompressChunks, job))
+		{
+			ERROR_LOG(HLE, "Failed to compress state %s", filename.c_str());
+			return false;
+		}
+
+		File::IOFile file(filename, "wb");
+		bool success = file && file.WriteArray(&header, 1) && file.WriteArray(&info[0], info.size());
+		for (u32 c = 0; success && c < header.numChunks; c++)
+		{
+			if (!compressed[c].empty())
+				success = file.WriteBytes(&compressed[c][0], compressed[c].size());
+		}
+		if (!success)
+			ERROR_LOG(HLE, "Failed to write state %s", filename.c_str());
+		return success;
+	}
+
+	bool Load(const std::string &filename)
+	{
+		// Everything is checked and decompressed before any of the running state is touched.
+		std::vector<u8> fileData;
+		{
+			File::IOFile file(filename, "rb");
+			u64 fileSize = file ? file.GetSize() : 0;
+			if (fileSize < sizeof(StateFileHeader))
+			{
+				ERROR_LOG(HLE, "Unable to read state %s", filename.c_str());
+				return false;
+			}
+			fileData.resize((size_t)fileSize);
+			if (!file.ReadBytes(&fileData[0], fileData.size()))
+			{
+				ERROR_LOG(HLE, "Unable to read state %s", filename.c_str());
+				return false;
+			}
+		}
+
+		StateFileHeader header;
+		memcpy(&header, &fileData[0], sizeof(header));
+		if (header.magic != STATE_FILE_MAGIC || header.revision != STATE_REVISION)
+		{
+			ERROR_LOG(HLE, "State %s is not a state, or from an incompatible version", filename.c_str());
+			return false;
+		}
+		if (header.numChunks != (header.size + STATE_CHUNK_SIZE - 1) / STATE_CHUNK_SIZE || (header.size & 3) != 0 ||
+			sizeof(header) + header.numChunks * sizeof(StateChunkInfo) > fileData.size())
+		{
+			ERROR_LOG(HLE, "State %s is corrupt", filename.c_str());
+			return false;
+		}
+
+		std::vector<StateChunkInfo> info(header.numChunks);
+		std::vector<size_t> offsets(header.numChunks);
+		size_t offset = sizeof(header) + header.numChunks * sizeof(StateChunkInfo);
+		if (header.numChunks != 0)
+			memcpy(&info[0], &fileData[sizeof(header)], header.numChunks * sizeof(StateChunkInfo));
+		for (u32 c = 0; c < header.numChunks; c++)
+		{
+			offsets[c] = offset;
+			offset += info[c].compressedSize;
+		}
+		if (offset != fileData.size())
+		{
+			ERROR_LOG(HLE, "State %s is corrupt", filename.c_str());
+			return false;
+		}
+
+		std::vector<u8> state(header.size);
+		StateChunkJob job = {0};
+		job.state = header.size == 0 ? 0 : &state[0];
+		job.stateSize = state.size();
+		job.info = header.numChunks == 0 ? 0 : &info[0];
+		job.numChunks = header.numChunks;
+		job.fileData = &fileData[0];
+		job.offsets = header.numChunks == 0 ? 0 : &offsets[0];
+		if (!RunStateChunkJobs(&DecompressChunks, job))
+		{
+			ERROR_LOG(HLE, "State %s is corrupt", filename.c_str());
+			return false;
+		}
+
+		// The compressed data isn't needed anymore.
+		std::vector<u8>().swap(fileData);
+		return LoadFromRam(state);
+	}
+
+	bool SaveToRam(std::vector<u8> &data)
+	{
+		u8 *ptr = 0;
+		PointerWrap p(&ptr, PointerWrap::MODE_MEASURE);
+		DoState(p);
+		size_t size = ((size_t)ptr + 3) & ~3;
+
+		// Keeps the capacity, so after the first save this doesn't allocate.
+		data.resize(size);
+		ptr = &data[0];
+		p.SetMode(PointerWrap::MODE_WRITE);
+		DoState(p);
+		size_t written = ptr - &data[0];
+		if (written != size)
+			memset(&data[written], 0, size - written);
+		return true;
+	}
+
+	bool LoadFromRam(std::vector<u8> &data)
+	{
+		if (data.empty())
+			return false;
+
+		u8 *ptr = &data[0];
+		PointerWrap p(&ptr, PointerWrap::MODE_READ);
+		DoState(p);
+		if (p.GetMode() != PointerWrap::MODE_READ || p.error == PointerWrap::ERROR_FAILURE)
+		{
+			ERROR_LOG(HLE, "Failed to load state from memory, the emulated machine may be inconsistent now");
+			return false;
+		}
+		return true;
+	}
+
+	// A delta is the size of the older state, then (zero words, literal words, literals...)
+	// runs of the older state XOR the newer one. Words past the end of the newer state
+	// are XORed with zero. Both are whole words, see SaveToRam.
+	static void EncodeDelta(const std::vector<u8> &older, const std::vector<u8> &newer, std::vector<u8> &delta)
+	{
+		const u32 *a = (const u32 *)&older[0];
+		const u32 *b = (const u32 *)&newer[0];
+		size_t aWords = older.size() / 4;
+		size_t bWords = std::min(aWords, newer.size() / 4);
+
+		// Worst case is all literals in one run, plus the headers.
+		delta.resize(4 + 8 + older.size());
+		u32 *out = (u32 *)&delta[0];
+		*out++ = (u32)older.size();
+
+		size_t i = 0;
+		while (i < aWords)
+		{
+			size_t zeroStart = i;
+			while (i < bWords && a[i] == b[i])
+				i++;
+			u32 zeros = (u32)(i - zeroStart);
+
+			u32 *literalCount = out + 1;
+			out[0] = zeros;
+			out += 2;
+			size_t literalStart = i;
+			// Stay in the literal run across short matches, a new run costs two words.
+			while (i < aWords)
+			{
+				if (i + 2 < bWords && a[i] == b[i] && a[i + 1] == b[i + 1] && a[i + 2] == b[i + 2])
+					break;
+				*out++ = a[i] ^ (i < bWords ? b[i] : 0);
+				i++;
+			}
+			*literalCount = (u32)(i - literalStart);
+		}
+
+		delta.resize((u8 *)out - &delta[0]);
+	}
+
+	// Turns state (the newer one) into the older one, in place.
+	static void ApplyDelta(const std::vector<u8> &delta, std::vector<u8> &state)
+	{
+		const u32 *in = (const u32 *)&delta[0];
+		const u32 *end = (const u32 *)(&delta[0] + delta.size());
+		size_t size = *in++;
+		size_t oldSize = state.size();
+		state.resize(size);
+		// Whatever the newer state had here was XORed as zero.
+		if (size > oldSize)
+			memset(&state[oldSize], 0, size - oldSize);
+
+		u32 *out = (u32 *)&state[0];
+		while (in < end)
+		{
+			out += in[0];
+			u32 literals = in[1];
+			in += 2;
+			for (u32 j = 0; j < literals; j++)
+				*out++ ^= *in++;
+		}
+	}
+
+	RewindBuffer::RewindBuffer(int maxStates, size_t maxBytes)
+		: maxStates_(maxStates), maxBytes_(maxBytes), deltaBytes_(0)
+	{
+	}
+
+	bool RewindBuffer::Save()
+	{
+		if (!SaveToRam(scratch_))
+			return false;
+
+		if (!newest_.empty())
+		{
+			// Encode into a buffer sized for the worst case, and keep only what was used.
+			EncodeDelta(newest_, scratch_, encodeBuffer_);
+			deltas_.push_back(encodeBuffer_);
+			deltaBytes_ += encodeBuffer_.size();
+		}
+		newest_.swap(scratch_);
+		Trim();
+		return true;
+	}
+
+	bool RewindBuffer::Rewind(int n)
+	{
+		if (n < 1 || n > Size())
+			return false;
+
+		scratch_ = newest_;
+		for (int i = 1; i < n; i++)
+		{
+			ApplyDelta(deltas_.back(), scratch_);
+			deltaBytes_ -= deltas_.back().size();
+			deltas_.pop_back();
+		}
+		newest_.swap(scratch_);
+		return LoadFromRam(newest_);
+	}
+
+	void RewindBuffer::Clear()
+	{
+		newest_.clear();
+		deltas_.clear();
+		deltaBytes_ = 0;
+	}
+
+	int RewindBuffer::Size() const
+	{
+		return newest_.empty() ? 0 : 1 + (int)deltas_.size();
+	}
+
+	size_t RewindBuffer::MemoryUsage() const
+	{
+		// Just the stored states, the scratch buffers are the same size whatever is kept.
+		return newest_.size() + deltaBytes_;
+	}
+
+	void RewindBuffer::Trim()
+	{
+		while (!deltas_.empty() && (Size() > maxStates_ || MemoryUsage() > maxBytes_))
+		{
+			deltaBytes_ -= deltas_.front().size();
+			deltas_.pop_front();
+		}
+	}
+}
@@ -0,0 +1,77 @@
+// Copyright (c) 2012- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#pragma once
+
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "../Globals.h"
+
+class PointerWrap;
+
+// Save states hold the whole emulated machine: memory, timing, the cpu, the kernel
+// and HLE modules, the gpu and open file handles. They don't hold mounts or loaded
+// game data, so a state can only be loaded into a boot of the same game.
+// Both must be called from the cpu thread, between slices.
+
+namespace SaveState
+{
+	// Files are deflated in chunks on several threads, and zero pages are skipped.
+	bool Save(const std::string &filename);
+	bool Load(const std::string &filename);
+
+	// For callers that keep states in memory instead of files.
+	void DoState(PointerWrap &p);
+
+	// Serializes into data, reusing its capacity. The size is padded to a multiple of 4.
+	bool SaveToRam(std::vector<u8> &data);
+	bool LoadFromRam(std::vector<u8> &data);
+
+	// Keeps the last few states in memory for rewinding. Only the newest state is kept
+	// whole, each older one is stored as the XOR against its successor, run length encoded.
+	// Little of RAM changes between frames, so those are mostly a few zero runs.
+	class RewindBuffer
+	{
+	public:
+		// Old states are dropped when there are more than maxStates, or they take more than maxBytes.
+		RewindBuffer(int maxStates, size_t maxBytes);
+
+		bool Save();
+		// Restores the state saved n saves ago, 1 being the newest, and forgets the newer ones.
+		bool Rewind(int n);
+		void Clear();
+
+		int Size() const;
+		size_t MemoryUsage() const;
+		// Encoded size of the delta made by the last Save().
+		size_t LastDeltaSize() const { return deltas_.empty() ? 0 : deltas_.back().size(); }
+
+	private:
+		void Trim();
+
+		int maxStates_;
+		size_t maxBytes_;
+		size_t deltaBytes_;
+		std::vector<u8> newest_;
+		std::vector<u8> scratch_;
+		std::vector<u8> encodeBuffer_;
+		// Oldest first.
+		std::deque<std::vector<u8> > deltas_;
+	};
+}
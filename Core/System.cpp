@@ -20,6 +20,7 @@
 #include "MIPS/MIPS.h"
 
 #include "MIPS/JitCommon/JitCommon.h"
+#include "MIPS/JitCommon/JitDiskCache.h"
 
 #include "System.h"
 // Bad dependency
@@ -37,6 +38,10 @@
 #include "CoreParameter.h"
 #include "FileSystems/MetaFileSystem.h"
 #include "Loaders.h"
+#include "Config.h"
+#include "CommonPaths.h"
+#include "FileUtil.h"
+#include "StringUtil.h"
 
 
 MetaFileSystem pspFileSystem;
@@ -76,6 +81,16 @@ bool PSP_Init(const CoreParameter &coreParam, std::string *error_string)
 		return false;
 	}
 
+	if (coreParameter.cpuCore == CPU_JIT && g_Config.bJitDiskCache)
+	{
+		std::string cacheDir = File::GetUserPath(D_USER_IDX) + CACHE_DIR DIR_SEP;
+		std::string gameName;
+		SplitPath(coreParameter.fileToStart, 0, &gameName, 0);
+		File::CreateFullPath(cacheDir);
+		jitDiskCache.Open(cacheDir + gameName + ".jitcache");
+		jitDiskCache.Precompile();
+	}
+
 	shaderManager.DirtyShader();
 	shaderManager.DirtyUniform(DIRTY_ALL);
 
@@ -96,6 +111,9 @@ void PSP_Shutdown()
 {
 	pspFileSystem.UnmountAll();
 
+	INFO_LOG(CPU, "Idle loops skipped %lld cycles", (long long)CoreTiming::GetIdleTicks());
+
+	jitDiskCache.Close();
 	TextureCache_Clear(true);
 	shaderManager.ClearCache(true);
 
@@ -1,4 +1,5 @@
 #include "Log.h"
+#include "ChunkFile.h"
 #include "BlockAllocator.h"
 
 // Slow freaking thing but works (eventually) :)
@@ -297,3 +298,31 @@ u32 BlockAllocator::GetTotalFreeBytes()
 	}
 	return sum;
 }
+
+void BlockAllocator::DoState(PointerWrap &p)
+{
+	u32 count = (u32)blocks.size();
+	p.Do(count);
+
+	if (p.mode == p.MODE_READ)
+	{
+		blocks.clear();
+		for (u32 i = 0; i < count; ++i)
+			blocks.push_back(Block(0, 0, false));
+	}
+	for (std::list<Block>::iterator it = blocks.begin(), end = blocks.end(); it != end; ++it)
+		it->DoState(p);
+
+	p.Do(rangeStart_);
+	p.Do(rangeSize_);
+	p.Do(grain_);
+	p.DoMarker("BlockAllocator");
+}
+
+void BlockAllocator::Block::DoState(PointerWrap &p)
+{
+	p.Do(start);
+	p.Do(size);
+	p.Do(taken);
+	p.DoArray(tag, sizeof(tag));
+}
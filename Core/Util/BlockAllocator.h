@@ -7,6 +7,7 @@
 #include <list>
 #include <cstring>
 
+class PointerWrap;
 
 // Generic allocator thingy
 // Allocates blocks from a range
@@ -42,6 +43,8 @@ public:
 	u32 GetLargestFreeBlockSize();
 	u32 GetTotalFreeBytes();
 
+	void DoState(PointerWrap &p);
+
 private:
 	void CheckBlocks();
 
@@ -58,6 +61,7 @@ private:
 				strncpy(tag, "---", 32);
 			tag[31] = 0;
 		}
+		void DoState(PointerWrap &p);
 		u32 start;
 		u32 size;
 		bool taken;
@@ -29,9 +29,11 @@
 #include "Framebuffer.h"
 #include "TransformPipeline.h"
 #include "TextureCache.h"
+#include "VertexDecoder.h"
 
 #include "../../Core/HLE/sceKernelThread.h"
 #include "../../Core/HLE/sceKernelInterrupt.h"
+#include "ChunkFile.h"
 
 inline void glEnDis(GLuint cmd, int value)
 {
@@ -45,6 +47,8 @@ extern u32 curTextureHeight;
 
 GLES_GPU::GLES_GPU(int renderWidth, int renderHeight)
 	: interruptsEnabled_(true),
+		skipDrawing_(false),
+		texturePrefetchPending_(false),
 		renderWidth_(renderWidth),
 		renderHeight_(renderHeight),
 		dlIdGenerator(1)
@@ -53,6 +57,7 @@ GLES_GPU::GLES_GPU(int renderWidth, int renderHeight)
 	renderHeightFactor_ = (float)renderHeight / 272.0f;
 	shaderManager_ = &shaderManager;
 	TextureCache_Init();
+	VertexDecoderJit_Init();
 	// Sanity check gstate
 	if ((int *)&gstate.transferstart - (int *)&gstate != 0xEA) {
 		ERROR_LOG(G3D, "gstate has drifted out of sync!");
@@ -62,6 +67,8 @@ GLES_GPU::GLES_GPU(int renderWidth, int renderHeight)
 GLES_GPU::~GLES_GPU()
 {
 	TextureCache_Shutdown();
+	VertexCache_Clear();
+	VertexDecoderJit_Shutdown();
 	for (auto iter = vfbs_.begin(); iter != vfbs_.end(); ++iter)
 	{
 		fbo_destroy((*iter)->fbo);
@@ -84,6 +91,7 @@ void GLES_GPU::InitClear()
 void GLES_GPU::BeginFrame()
 {
 	TextureCache_Decimate();
+	VertexCache_Decimate();
 
 	// NOTE - this is all wrong. At the beginning of the frame is a TERRIBLE time to draw the fb.
 	if (g_Config.bDisplayFramebuffer && displayFramebufPtr_)
@@ -225,6 +233,8 @@ void GLES_GPU::SetRenderFrameBuffer()
 
 bool GLES_GPU::ProcessDLQueue()
 {
+	// The CPU has run since the last lists, so earlier prefetches may be stale.
+	TextureCache_DropPrefetches();
 	std::vector<DisplayList>::iterator iter = dlQueue.begin();
 	while (!(iter == dlQueue.end()))
 	{
@@ -391,7 +401,15 @@ void GLES_GPU::ExecuteOp(u32 op, u32 diff)
 			// Seems we have to advance the vertex addr, at least in some cases. 
 			// Question: Should we also advance the index addr?
 			int bytesRead;
-			TransformAndDrawPrim(verts, inds, type, count, 0, -1, &bytesRead);
+			if (skipDrawing_)
+			{
+				// Nothing is drawn, but the next prim may still rely on the address advancing.
+				VertexDecoder dec;
+				dec.SetVertexType(gstate.vertType);
+				bytesRead = count * dec.VertexSize();
+			}
+			else
+				TransformAndDrawPrim(verts, inds, type, count, 0, -1, &bytesRead);
 			gstate_c.vertexAddr += bytesRead;
 		}
 		break;
@@ -401,7 +419,8 @@ void GLES_GPU::ExecuteOp(u32 op, u32 diff)
 		{
 			int bz_ucount = data & 0xFF;
 			int bz_vcount = (data >> 8) & 0xFF;
-			DrawBezier(bz_ucount, bz_vcount);
+			if (!skipDrawing_)
+				DrawBezier(bz_ucount, bz_vcount);
 			DEBUG_LOG(G3D,"DL DRAW BEZIER: %i x %i", bz_ucount, bz_vcount);
 		}
 		break;
@@ -650,6 +669,7 @@ void GLES_GPU::ExecuteOp(u32 op, u32 diff)
 
 	case GE_CMD_TEXADDR0:
 		gstate_c.textureChanged = true;
+		texturePrefetchPending_ = true;
 	case GE_CMD_TEXADDR1:
 	case GE_CMD_TEXADDR2:
 	case GE_CMD_TEXADDR3:
@@ -1009,6 +1029,13 @@ void GLES_GPU::ExecuteOp(u32 op, u32 diff)
 		break;
 	case GE_CMD_TEXFLUSH:
 		DEBUG_LOG(G3D,"DL TexFlush");
+		// sceGuTexImage sends the address first, then the width and upper address bits, then the size,
+		// and flushes last. Only now are all the texture's parameters in place.
+		if (texturePrefetchPending_)
+		{
+			texturePrefetchPending_ = false;
+			TextureCache_Prefetch();
+		}
 		break;
 	case GE_CMD_TEXWRAP:
 		DEBUG_LOG(G3D,"DL TexWrap %08x", data);
@@ -1173,16 +1200,22 @@ void GLES_GPU::UpdateStats()
 	gpuStats.numFragmentShaders = shaderManager.NumFragmentShaders();
 	gpuStats.numShaders = shaderManager.NumPrograms();
 	gpuStats.numTextures = TextureCache_NumLoadedTextures();
+	gpuStats.numVertexCacheEntries = VertexCache_NumEntries();
 }
 
+void GLES_GPU::InvalidateCache(u32 addr, int size)
+{
+	TextureCache_Invalidate(addr, size);
+	VertexCache_Invalidate(addr, size);
+}
 
 void GLES_GPU::DoBlockTransfer()
 {
 	u32 srcBasePtr = (gstate.transfersrc & 0xFFFFFF) | ((gstate.transfersrcw & 0xFF0000) << 8);
 	u32 srcStride = gstate.transfersrcw & 0x3FF;
 
-	u32 dstBasePtr = (gstate.transfersrc & 0xFFFFFF) | ((gstate.transfersrcw & 0xFF0000) << 8);
-	u32 dstStride = gstate.transfersrcw & 0x3FF;
+	u32 dstBasePtr = (gstate.transferdst & 0xFFFFFF) | ((gstate.transferdstw & 0xFF0000) << 8);
+	u32 dstStride = gstate.transferdstw & 0x3FF;
 
 	int srcX = gstate.transfersrcpos & 0x3FF;
 	int srcY = (gstate.transfersrcpos >> 10) & 0x3FF;
@@ -1200,9 +1233,40 @@ void GLES_GPU::DoBlockTransfer()
 	// Do the copy!
 	for (int y = 0; y < height; y++) {
 		const u8 *src = Memory::GetPointer(srcBasePtr + ((y + srcY) * srcStride + srcX) * bpp);
-		u8 *dst = Memory::GetPointer(dstBasePtr + ((y + dstY) * srcStride + dstX) * bpp);
+		u8 *dst = Memory::GetPointer(dstBasePtr + ((y + dstY) * dstStride + dstX) * bpp);
 		memcpy(dst, src, width * bpp);
 	}
 
-	// TODO: Notify all overlapping textures that it's time to die/reload.
+	// TODO: Framebuffers overlapping the destination should be reloaded too.
+	u32 dstStart = dstBasePtr + (dstY * dstStride + dstX) * bpp;
+	u32 dstEnd = dstBasePtr + ((dstY + height - 1) * dstStride + dstX + width) * bpp;
+	InvalidateCache(dstStart, dstEnd - dstStart);
+}
+
+void GLES_GPU::DoState(PointerWrap &p)
+{
+	p.Do(dlQueue);
+	p.Do(dcontext);
+	p.DoArray(stack, ARRAY_SIZE(stack));
+	p.Do(stackptr);
+	p.Do(dlIdGenerator);
+	p.Do(interruptsEnabled_);
+	p.Do(displayFramebufPtr_);
+	p.Do(displayStride_);
+	p.Do(displayFormat_);
+	p.DoMarker("GLES_GPU");
+
+	if (p.mode == p.MODE_READ)
+	{
+		// Textures and render targets are rebuilt from the restored memory as they're used.
+		TextureCache_Clear(true);
+		VertexCache_Clear();
+		for (auto iter = vfbs_.begin(); iter != vfbs_.end(); ++iter)
+		{
+			fbo_destroy((*iter)->fbo);
+			delete (*iter);
+		}
+		vfbs_.clear();
+		currentRenderVfb_ = 0;
+	}
 }
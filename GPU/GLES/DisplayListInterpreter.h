@@ -45,8 +45,13 @@ public:
 
 	virtual void SetDisplayFramebuffer(u32 framebuf, u32 stride, int format);
 	virtual void CopyDisplayToOutput();
+	virtual void SetSkipDrawing(bool skip) {
+		skipDrawing_ = skip;
+	}
 	virtual void BeginFrame();
+	virtual void InvalidateCache(u32 addr, int size);
 	virtual void UpdateStats();
+	virtual void DoState(PointerWrap &p);
 
 private:
 	// TransformPipeline.cpp
@@ -60,6 +65,9 @@ private:
 
 	ShaderManager *shaderManager_;
 	bool interruptsEnabled_;
+	bool skipDrawing_;
+	// TEXADDR0 changed and the texture hasn't been prefetched since.
+	bool texturePrefetchPending_;
 
 	u32 displayFramebufPtr_;
 	u32 displayStride_;
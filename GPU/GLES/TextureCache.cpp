@@ -15,94 +15,291 @@
 // Official git repository and contact information can be found at
 // https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
 
-#include <map>
+#include <algorithm>
+#include <deque>
+#include <vector>
 
+#include "Hash.h"
 #include "../../Core/MemMap.h"
+#include "../../Core/Config.h"
 #include "../ge_constants.h"
 #include "../GPUState.h"
 #include "TextureCache.h"
+#include "TextureDecoder.h"
+#include "StdMutex.h"
+#include "StdConditionVariable.h"
+#include "StdThread.h"
 
 
 // If a texture hasn't been seen for 200 frames, get rid of it.
 #define TEXTURE_KILL_AGE 200
 
+// Textures bigger than this only hash a sample of their 16-byte blocks.
+#define TEXTURE_FULL_HASH_BYTES (256 * 1024)
+#define TEXTURE_HASH_SAMPLES 8192
+// The CPU can write textures without us noticing, so even unchanged-looking ones get rehashed this often.
+#define TEXTURE_RECHECK_FRAMES 20
+
+// Prefetched levels waiting to be used, beyond this new prefetches are ignored.
+#define MAX_DECODE_JOBS 32
+#define MAX_DECODE_THREADS 8
+
 // TODO: Speed up by switching to ReadUnchecked*.
 
 struct TexCacheEntry
 {
 	u32 addr;
-	u32 hash;
+	u64 hash;
 	int frameCounter;
 	u32 numMips;
 	u32 format;
 	u32 clutaddr;
 	u32 clutformat;
-	u32 cluthash;
+	u64 cluthash;
 	int dim;
+	int maxLevel;
+	u32 sizeInRAM;
+	u32 clutSizeInRAM;
+	// With full hashing, cheap checks done on every use between the full rehashes.
+	u32 firstWord;
+	u32 clutFirstWord;
+	int lastHashFrame;
+	// Set when something wrote over the texture or its clut, forces a rehash even within the same frame.
+	bool invalid;
 	GLuint texture;
 };
 
-typedef std::map<u64, TexCacheEntry> TexCache;
+// Open addressing with linear probing, keeps the entries in one flat array.
+// Pointers into it are only good until the next Insert.
+class TexCache
+{
+public:
+	TexCache() : count_(0) {
+		slots_.resize(256);
+	}
+
+	TexCacheEntry *Find(u64 key) {
+		size_t mask = slots_.size() - 1;
+		for (size_t i = Bucket(key); slots_[i].used; i = (i + 1) & mask) {
+			if (slots_[i].key == key)
+				return &slots_[i].entry;
+		}
+		return 0;
+	}
+
+	void Insert(u64 key, const TexCacheEntry &entry) {
+		if ((count_ + 1) * 2 > slots_.size())
+			Grow();
+		size_t mask = slots_.size() - 1;
+		size_t i = Bucket(key);
+		while (slots_[i].used && slots_[i].key != key)
+			i = (i + 1) & mask;
+		if (!slots_[i].used)
+			count_++;
+		slots_[i].used = true;
+		slots_[i].key = key;
+		slots_[i].entry = entry;
+	}
+
+	// Shifts the following entries back instead of leaving a tombstone. If the slot gets
+	// refilled this way, returns true, so a loop over the slots should look at it again.
+	bool EraseSlot(size_t i) {
+		size_t mask = slots_.size() - 1;
+		slots_[i].used = false;
+		count_--;
+		bool refilled = false;
+		for (size_t j = (i + 1) & mask; slots_[j].used; j = (j + 1) & mask) {
+			size_t home = Bucket(slots_[j].key);
+			// Only move entries whose probe sequence passes over the hole.
+			if (((j - home) & mask) >= ((j - i) & mask)) {
+				slots_[i] = slots_[j];
+				slots_[j].used = false;
+				i = j;
+				refilled = true;
+			}
+		}
+		return refilled;
+	}
+
+	void Erase(u64 key) {
+		size_t mask = slots_.size() - 1;
+		for (size_t i = Bucket(key); slots_[i].used; i = (i + 1) & mask) {
+			if (slots_[i].key == key) {
+				EraseSlot(i);
+				return;
+			}
+		}
+	}
+
+	void Clear() {
+		for (size_t i = 0; i < slots_.size(); i++)
+			slots_[i].used = false;
+		count_ = 0;
+	}
+
+	size_t size() const { return count_; }
+	size_t NumSlots() const { return slots_.size(); }
+	bool IsUsed(size_t i) const { return slots_[i].used; }
+	TexCacheEntry &At(size_t i) { return slots_[i].entry; }
+
+private:
+	struct Slot {
+		Slot() : used(false) {}
+		u64 key;
+		bool used;
+		TexCacheEntry entry;
+	};
+
+	size_t Bucket(u64 key) const {
+		// The keys are mostly addresses, so mix the bits before masking.
+		u64 h = key * 0x9E3779B97F4A7C15ULL;
+		return (size_t)(h >> 32) & (slots_.size() - 1);
+	}
+
+	void Grow() {
+		std::vector<Slot> old;
+		old.swap(slots_);
+		slots_.resize(old.size() * 2);
+		count_ = 0;
+		for (size_t i = 0; i < old.size(); i++) {
+			if (old[i].used)
+				Insert(old[i].key, old[i].entry);
+		}
+	}
+
+	std::vector<Slot> slots_;
+	size_t count_;
+};
+
 static TexCache cache;
 
-u32 *tmpTexBuf32;
-u16 *tmpTexBuf16;
+// Everything decoding a texture level reads besides PSP memory, captured from gstate
+// so that it can be done on a decode thread.
+struct TexDecodeParams
+{
+	u32 texaddr;
+	u32 format;
+	u32 texmode;
+	u32 bufw;
+	u32 dim;
+	// Zero for formats without a clut.
+	u32 clutformat;
+	u32 clutbase;
+	u32 loadclut;
+
+	bool operator == (const TexDecodeParams &other) const {
+		return texaddr == other.texaddr && format == other.format && texmode == other.texmode &&
+			bufw == other.bufw && dim == other.dim && clutformat == other.clutformat &&
+			clutbase == other.clutbase && loadclut == other.loadclut;
+	}
+};
+
+// Scratch space for decoding, each thread that decodes has its own.
+struct TexDecodeBuffers
+{
+	TexDecodeBuffers() {
+		// TODO: Switch to aligned allocations for alignment. AllocateMemoryPages would do the trick.
+		tmpTexBuf32 = new u32[1024 * 512];
+		tmpTexBuf16 = new u16[1024 * 512];
+		tmpTexBufRearrange = new u32[1024 * 512];
+		clutBuf32 = new u32[4096];
+		clutBuf16 = new u16[4096];
+	}
+	~TexDecodeBuffers() {
+		delete [] tmpTexBuf32;
+		delete [] tmpTexBuf16;
+		delete [] tmpTexBufRearrange;
+		delete [] clutBuf32;
+		delete [] clutBuf16;
+	}
 
-u32 *tmpTexBufRearrange;
+	u32 *tmpTexBuf32;
+	u16 *tmpTexBuf16;
+	u32 *tmpTexBufRearrange;
+	u32 *clutBuf32;
+	u16 *clutBuf16;
+};
 
-u32 *clutBuf32;
-u16 *clutBuf16;
+// A decoded level, w x h pixels ready for glTexImage2D.
+struct TexDecodeResult
+{
+	const void *pixels;
+	GLenum dstFmt;
+	u32 texByteAlign;
+	int w;
+	int h;
+};
+
+// Used for decoding on the GPU thread.
+static TexDecodeBuffers *decodeBuffers;
+
+static void StartDecodeThreads();
+static void StopDecodeThreads();
 
 void TextureCache_Init()
 {
-	// TODO: Switch to aligned allocations for alignment. AllocateMemoryPages would do the trick.
-	tmpTexBuf32 = new u32[1024 * 512];
-	tmpTexBuf16 = new u16[1024 * 512];
-	tmpTexBufRearrange = new u32[1024 * 512];
-	clutBuf32 = new u32[4096];
-	clutBuf16 = new u16[4096];
+	decodeBuffers = new TexDecodeBuffers();
+	TextureDecoder_Init();
+	StartDecodeThreads();
 }
 
 void TextureCache_Shutdown()
 {
-	delete [] tmpTexBuf32;
-	tmpTexBuf32 = 0;
-	delete [] tmpTexBuf16;
-	tmpTexBuf16 = 0;
-	delete [] tmpTexBufRearrange;
-	tmpTexBufRearrange = 0;
-	delete [] clutBuf32;
-	delete [] clutBuf16;
+	StopDecodeThreads();
+	delete decodeBuffers;
+	decodeBuffers = 0;
 }
 
 void TextureCache_Clear(bool delete_them)
 {
 	if (delete_them)
 	{
-		for (TexCache::iterator iter = cache.begin(); iter != cache.end(); ++iter)
+		for (size_t i = 0; i < cache.NumSlots(); i++)
 		{
-			DEBUG_LOG(G3D, "Deleting texture %i", iter->second.texture);
-			glDeleteTextures(1, &iter->second.texture);
+			if (!cache.IsUsed(i))
+				continue;
+			DEBUG_LOG(G3D, "Deleting texture %i", cache.At(i).texture);
+			glDeleteTextures(1, &cache.At(i).texture);
 		}
 	}
 	if (cache.size()) {
 		INFO_LOG(G3D, "Texture cached cleared from %i textures", (int)cache.size());
-		cache.clear();
+		cache.Clear();
 	}
+	TextureCache_DropPrefetches();
 }
 
 // Removes old textures.
 void TextureCache_Decimate()
 {
-	for (TexCache::iterator iter = cache.begin(); iter != cache.end(); )
+	for (size_t i = 0; i < cache.NumSlots(); )
 	{
-		if (iter->second.frameCounter + TEXTURE_KILL_AGE < gpuStats.numFrames)
+		if (cache.IsUsed(i) && cache.At(i).frameCounter + TEXTURE_KILL_AGE < gpuStats.numFrames)
 		{
-			glDeleteTextures(1, &iter->second.texture);
-			cache.erase(iter++);
+			glDeleteTextures(1, &cache.At(i).texture);
+			if (!cache.EraseSlot(i))
+				i++;
 		}
 		else
-			++iter;
+			i++;
+	}
+}
+
+void TextureCache_Invalidate(u32 addr, int size)
+{
+	// Prefetched levels might have read the old data.
+	TextureCache_DropPrefetches();
+	addr &= 0x0FFFFFFF;
+	for (size_t i = 0; i < cache.NumSlots(); i++)
+	{
+		if (!cache.IsUsed(i))
+			continue;
+		TexCacheEntry &entry = cache.At(i);
+		if (addr < entry.addr + entry.sizeInRAM && entry.addr < addr + size)
+			entry.invalid = true;
+		// The palette may have been overwritten too.
+		if (entry.clutaddr && addr < (entry.clutaddr & 0x0FFFFFFF) + entry.clutSizeInRAM && (entry.clutaddr & 0x0FFFFFFF) < addr + size)
+			entry.invalid = true;
 	}
 }
 
@@ -117,39 +314,67 @@ u32 GetClutAddr(u32 clutEntrySize)
 	return ((gstate.clutaddr & 0xFFFFFF) | ((gstate.clutaddrupper << 8) & 0x0F000000)) + ((gstate.clutformat >> 16) & 0x1f) * clutEntrySize;
 }
 
-u32 GetClutIndex(u32 index)
+static inline u32 GetClutIndex(u32 clutformat, u32 index)
+{
+	return ((((clutformat >> 16) & 0x1f) + index) >> ((clutformat >> 2) & 0x1f)) & ((clutformat >> 8) & 0xff);
+}
+
+// Direct pointer to a texture in PSP memory, or NULL if any of it is outside. The decoders
+// fall back to the checked reads then.
+static const u8 *GetTexturePointer(u32 addr, u32 size)
 {
-	return ((((gstate.clutformat >> 16) & 0x1f) + index) >> ((gstate.clutformat >> 2) & 0x1f)) & ((gstate.clutformat >> 8) & 0xff);
+	if (size == 0 || !Memory::IsValidAddress(addr) || !Memory::IsValidAddress(addr + size - 1))
+		return NULL;
+	return Memory::GetPointer(addr);
 }
 
-u16 *ReadClut16()
+// Applies the clut index shift, mask and start up front, so the decoders can index directly.
+template <typename T>
+static void ResolvePalette(T *palette, const T *clut, u32 clutformat, int count)
 {
-	u32 clutNumEntries = (gstate.loadclut & 0x3f) * 16;
-	u32 clutAddr = GetClutAddr(2);
-	for (u32 i = ((gstate.clutformat >> 16) & 0x1f); i < clutNumEntries; i++)
-		clutBuf16[i] = Memory::Read_U16(clutAddr + i * 2);
-	return clutBuf16;
+	for (int i = 0; i < count; i++)
+		palette[i] = clut[GetClutIndex(clutformat, i)];
 }
 
-u32 *ReadClut32()
+u16 *ReadClut16(const TexDecodeParams &p, TexDecodeBuffers &b)
 {
-	u32 clutNumEntries = (gstate.loadclut & 0x3f) * 8;
-	u32 clutAddr = GetClutAddr(4);
-	for (u32 i = ((gstate.clutformat >> 16) & 0x1f); i < clutNumEntries; i++)
-		clutBuf32[i] = Memory::Read_U32(clutAddr + i * 4);
-	return clutBuf32;
+	u32 clutNumEntries = (p.loadclut & 0x3f) * 16;
+	u32 clutAddr = p.clutbase + ((p.clutformat >> 16) & 0x1f) * 2;
+	for (u32 i = ((p.clutformat >> 16) & 0x1f); i < clutNumEntries; i++)
+		b.clutBuf16[i] = Memory::Read_U16(clutAddr + i * 2);
+	return b.clutBuf16;
 }
 
-void *UnswizzleFromMem(u32 texaddr, u32 bytesPerPixel, u32 level)
+u32 *ReadClut32(const TexDecodeParams &p, TexDecodeBuffers &b)
 {
+	u32 clutNumEntries = (p.loadclut & 0x3f) * 8;
+	u32 clutAddr = p.clutbase + ((p.clutformat >> 16) & 0x1f) * 4;
+	for (u32 i = ((p.clutformat >> 16) & 0x1f); i < clutNumEntries; i++)
+		b.clutBuf32[i] = Memory::Read_U32(clutAddr + i * 4);
+	return b.clutBuf32;
+}
+
+void *UnswizzleFromMem(const TexDecodeParams &p, TexDecodeBuffers &b, u32 bytesPerPixel)
+{
+	u32 texaddr = p.texaddr;
 	u32 addr = texaddr;
-	u32 rowWidth = (bytesPerPixel > 0) ? ((gstate.texbufwidth[level] & 0x3FF) * bytesPerPixel) : ((gstate.texbufwidth[level] & 0x3FF) / 2);
+	u32 rowWidth = (bytesPerPixel > 0) ? (p.bufw * bytesPerPixel) : (p.bufw / 2);
 	u32 pitch = rowWidth / 4;
 	u32 bxc = rowWidth / 16;
-	u32 byc = ((1 << ((gstate.texsize[level] >> 8) & 0xf)) + 7) / 8;
+	u32 byc = ((1 << ((p.dim >> 8) & 0xf)) + 7) / 8;
 	if (byc == 0)
 		byc = 1;
 
+	if (rowWidth >= 16)
+	{
+		const u8 *src = GetTexturePointer(texaddr, rowWidth * 8 * byc);
+		if (src)
+		{
+			UnswizzleBlocks(b.tmpTexBuf32, src, rowWidth, byc);
+			return b.tmpTexBuf32;
+		}
+	}
+
 	u32 ydest = 0;
 
 	u32 by;
@@ -167,7 +392,7 @@ void *UnswizzleFromMem(u32 texaddr, u32 bytesPerPixel, u32 level)
 				{
 					u32 k;
 					for (k = 0; k < 4; k++) {
-						tmpTexBuf32[dest + k] = Memory::Read_U32(addr);
+						b.tmpTexBuf32[dest + k] = Memory::Read_U32(addr);
 						addr += 4;
 					}
 					dest += pitch;
@@ -181,8 +406,8 @@ void *UnswizzleFromMem(u32 texaddr, u32 bytesPerPixel, u32 level)
 			u32 n;
 			for (n = 0; n < 8; n++, ydest += 2)
 			{
-				tmpTexBuf32[ydest + 0] = Memory::Read_U32(addr + 0);
-				tmpTexBuf32[ydest + 1] = Memory::Read_U32(addr + 4);
+				b.tmpTexBuf32[ydest + 0] = Memory::Read_U32(addr + 0);
+				b.tmpTexBuf32[ydest + 1] = Memory::Read_U32(addr + 4);
 				addr += 16; // skip two u32
 			}
 		}
@@ -190,7 +415,7 @@ void *UnswizzleFromMem(u32 texaddr, u32 bytesPerPixel, u32 level)
 		{
 			u32 n;
 			for (n = 0; n < 8; n++, ydest++) {
-				tmpTexBuf32[ydest] = Memory::Read_U32(addr);
+				b.tmpTexBuf32[ydest] = Memory::Read_U32(addr);
 				addr += 16;
 			}
 		}
@@ -201,7 +426,7 @@ void *UnswizzleFromMem(u32 texaddr, u32 bytesPerPixel, u32 level)
 			{
 				u16 n1 = Memory::Read_U32(addr +  0) & 0xffff;
 				u16 n2 = Memory::Read_U32(addr + 16) & 0xffff;
-				tmpTexBuf32[ydest] = (u32)n1 | ((u32)n2 << 16);
+				b.tmpTexBuf32[ydest] = (u32)n1 | ((u32)n2 << 16);
 				addr += 32;
 			}
 		}
@@ -215,26 +440,39 @@ void *UnswizzleFromMem(u32 texaddr, u32 bytesPerPixel, u32 level)
 				u8 n3 = Memory::Read_U32(addr + 32) & 0xf;
 				u8 n4 = Memory::Read_U32(addr + 48) & 0xf;
 
-				tmpTexBuf32[ydest] = (u32)n1 | ((u32)n2 << 8) | ((u32)n3 << 16) | ((u32)n4 << 24);
+				b.tmpTexBuf32[ydest] = (u32)n1 | ((u32)n2 << 8) | ((u32)n3 << 16) | ((u32)n4 << 24);
 			}
 		}
 	}
-	return tmpTexBuf32;
+	return b.tmpTexBuf32;
 }
 
-void *readIndexedTex(u32 level, u32 texaddr, u32 bytesPerIndex)
+void *readIndexedTex(const TexDecodeParams &p, TexDecodeBuffers &b, u32 bytesPerIndex)
 {
-	u32 length = (gstate.texbufwidth[level] & 0x3FF) * (1 << ((gstate.texsize[level] >> 8) & 0xf));
+	u32 texaddr = p.texaddr;
+	u32 length = p.bufw * (1 << ((p.dim >> 8) & 0xf));
 	void *buf = NULL;
 
-	switch ((gstate.clutformat & 3))
+	switch ((p.clutformat & 3))
 	{
 	case GE_CMODE_16BIT_BGR5650:
 	case GE_CMODE_16BIT_ABGR5551:
 	case GE_CMODE_16BIT_ABGR4444:
 		{
-		u16 *clut = ReadClut16();
-		if (!(gstate.texmode & 1))
+		u16 *clut = ReadClut16(p, b);
+		if (bytesPerIndex == 1)
+		{
+			u16 palette[256];
+			ResolvePalette(palette, clut, p.clutformat, 256);
+			const u8 *src = (p.texmode & 1) ? (const u8 *)UnswizzleFromMem(p, b, 1) : GetTexturePointer(texaddr, length);
+			if (src)
+			{
+				DeIndex8To16(b.tmpTexBuf16, src, length, palette);
+				buf = b.tmpTexBuf16;
+				break;
+			}
+		}
+		if (!(p.texmode & 1))
 		{
 			u32 i;
 			switch (bytesPerIndex)
@@ -242,21 +480,21 @@ void *readIndexedTex(u32 level, u32 texaddr, u32 bytesPerIndex)
 			case 1:
 				for (i = 0; i < length; i++) {
 					u8 index = Memory::Read_U8(texaddr + i);
-					tmpTexBuf16[i] = clut[GetClutIndex(index)];
+					b.tmpTexBuf16[i] = clut[GetClutIndex(p.clutformat, index)];
 				}
 				break;
 
 			case 2:
 				for (i = 0; i < length; i++) {
 					u16 index = Memory::Read_U16(texaddr + i * 2);
-					tmpTexBuf16[i] = clut[GetClutIndex(index)];
+					b.tmpTexBuf16[i] = clut[GetClutIndex(p.clutformat, index)];
 				}
 				break;
 
 			case 4:
 				for (i = 0; i < length; i++) {
 					u32 index = Memory::Read_U32(texaddr + i * 4);
-					tmpTexBuf16[i] = clut[GetClutIndex(index)];
+					b.tmpTexBuf16[i] = clut[GetClutIndex(p.clutformat, index)];
 				}
 				break;
 			}
@@ -264,17 +502,17 @@ void *readIndexedTex(u32 level, u32 texaddr, u32 bytesPerIndex)
 		else
 		{
 			u32 i, j;
-			UnswizzleFromMem(texaddr, bytesPerIndex, level);
+			UnswizzleFromMem(p, b, bytesPerIndex);
 			switch (bytesPerIndex)
 			{
 			case 1:
 				for (i = 0, j = 0; i < length; i += 4, j++)
 				{
-					u32 n = tmpTexBuf32[j];
+					u32 n = b.tmpTexBuf32[j];
 					u32 k;
 					for (k = 0; k < 4; k++) {
 						u8 index = (n >> (k * 8)) & 0xff;
-						tmpTexBuf16[i + k] = clut[GetClutIndex(index)];
+						b.tmpTexBuf16[i + k] = clut[GetClutIndex(p.clutformat, index)];
 					}
 				}
 				break;
@@ -282,28 +520,40 @@ void *readIndexedTex(u32 level, u32 texaddr, u32 bytesPerIndex)
 			case 2:
 				for (i = 0, j = 0; i < length; i += 2, j++)
 				{
-					u32 n = tmpTexBuf32[j];
-					tmpTexBuf16[i + 0] = clut[GetClutIndex(n & 0xffff)];
-					tmpTexBuf16[i + 1] = clut[GetClutIndex(n >> 16)];
+					u32 n = b.tmpTexBuf32[j];
+					b.tmpTexBuf16[i + 0] = clut[GetClutIndex(p.clutformat, n & 0xffff)];
+					b.tmpTexBuf16[i + 1] = clut[GetClutIndex(p.clutformat, n >> 16)];
 				}
 				break;
 
 			case 4:
 				for (i = 0; i < length; i++) {
-					u32 n = tmpTexBuf32[i];
-					tmpTexBuf16[i] = clut[GetClutIndex(n)];
+					u32 n = b.tmpTexBuf32[i];
+					b.tmpTexBuf16[i] = clut[GetClutIndex(p.clutformat, n)];
 				}
 				break;
 			}
 		}
-		buf = tmpTexBuf16;
+		buf = b.tmpTexBuf16;
 		}
 		break;
 
 	case GE_CMODE_32BIT_ABGR8888:
 		{
-		u32 *clut = ReadClut32();
-		if (!(gstate.texmode & 1))
+		u32 *clut = ReadClut32(p, b);
+		if (bytesPerIndex == 1)
+		{
+			u32 palette[256];
+			ResolvePalette(palette, clut, p.clutformat, 256);
+			const u8 *src = (p.texmode & 1) ? (const u8 *)UnswizzleFromMem(p, b, 1) : GetTexturePointer(texaddr, length);
+			if (src)
+			{
+				DeIndex8To32(b.tmpTexBuf32, src, length, palette);
+				buf = b.tmpTexBuf32;
+				break;
+			}
+		}
+		if (!(p.texmode & 1))
 		{
 			u32 i;
 			switch (bytesPerIndex)
@@ -311,21 +561,21 @@ void *readIndexedTex(u32 level, u32 texaddr, u32 bytesPerIndex)
 			case 1:
 				for (i = 0; i < length; i++) {
 					u8 index = Memory::Read_U8(texaddr + i);
-					tmpTexBuf32[i] = clut[GetClutIndex(index)];
+					b.tmpTexBuf32[i] = clut[GetClutIndex(p.clutformat, index)];
 				}
 				break;
 
 			case 2:
 				for (i = 0; i < length; i++) {
 					u16 index = Memory::Read_U16(texaddr + i * 2);
-					tmpTexBuf32[i] = clut[GetClutIndex(index)];
+					b.tmpTexBuf32[i] = clut[GetClutIndex(p.clutformat, index)];
 				}
 				break;
 
 			case 4:
 				for (i = 0; i < length; i++) {
 					u32 index = Memory::Read_U32(texaddr + i * 4);
-					tmpTexBuf32[i] = clut[GetClutIndex(index)];
+					b.tmpTexBuf32[i] = clut[GetClutIndex(p.clutformat, index)];
 				}
 				break;
 			}
@@ -334,17 +584,17 @@ void *readIndexedTex(u32 level, u32 texaddr, u32 bytesPerIndex)
 		{
 			u32 j;
 			s32 i;
-			UnswizzleFromMem(texaddr, bytesPerIndex, level);
+			UnswizzleFromMem(p, b, bytesPerIndex);
 			switch (bytesPerIndex)
 			{
 			case 1:
 				for (i = length - 4, j = (length / 4) - 1; i >= 0; i -= 4, j--)
 				{
-					u32 n = tmpTexBuf32[j];
+					u32 n = b.tmpTexBuf32[j];
 					u32 k;
 					for (k = 0; k < 4; k++) {
 						u32 index = (n >> (k * 8)) & 0xff;
-						tmpTexBuf32[i + k] = clut[GetClutIndex(index)];
+						b.tmpTexBuf32[i + k] = clut[GetClutIndex(p.clutformat, index)];
 					}
 				}
 				break;
@@ -352,26 +602,26 @@ void *readIndexedTex(u32 level, u32 texaddr, u32 bytesPerIndex)
 			case 2:
 				for (i = length - 2, j = (length / 2) - 1; i >= 0; i -= 2, j--)
 				{
-					u32 n = tmpTexBuf32[j];
-					tmpTexBuf32[i + 0] = clut[GetClutIndex(n & 0xffff)];
-					tmpTexBuf32[i + 1] = clut[GetClutIndex(n >> 16)];
+					u32 n = b.tmpTexBuf32[j];
+					b.tmpTexBuf32[i + 0] = clut[GetClutIndex(p.clutformat, n & 0xffff)];
+					b.tmpTexBuf32[i + 1] = clut[GetClutIndex(p.clutformat, n >> 16)];
 				}
 				break;
 
 			case 4:
 				for (i = 0; (u32)i < length; i++) {
-					u32 n = tmpTexBuf32[i];
-					tmpTexBuf32[i] = clut[GetClutIndex(n)];
+					u32 n = b.tmpTexBuf32[i];
+					b.tmpTexBuf32[i] = clut[GetClutIndex(p.clutformat, n)];
 				}
 				break;
 			}
 		}
-		buf = tmpTexBuf32;
+		buf = b.tmpTexBuf32;
 		}
 		break;
 
 	default:
-		ERROR_LOG(G3D, "Unhandled clut texture mode %d!!!", (gstate.clutformat & 3));
+		ERROR_LOG(G3D, "Unhandled clut texture mode %d!!!", (p.clutformat & 3));
 		break;
 	}
 
@@ -398,18 +648,23 @@ u32 texByteAlignMap[] = {2, 2, 2, 4};
 
 // This should not have to be done per texture! OpenGL is silly yo
 // TODO: Dirty-check this against the current texture.
-void UpdateSamplingParams()
+void UpdateSamplingParams(bool hasMips)
 {
 	int minFilt = gstate.texfilter & 0x7;
 	int magFilt = (gstate.texfilter>>8)&1;
-	minFilt &= 1; //no mipmaps yet
+	if (!hasMips)
+		minFilt &= 1;
+	static const GLenum minFilters[8] = {
+		GL_NEAREST, GL_LINEAR, GL_NEAREST, GL_LINEAR,
+		GL_NEAREST_MIPMAP_NEAREST, GL_LINEAR_MIPMAP_NEAREST, GL_NEAREST_MIPMAP_LINEAR, GL_LINEAR_MIPMAP_LINEAR,
+	};
 
 	int sClamp = gstate.texwrap & 1;
 	int tClamp = (gstate.texwrap>>8) & 1;
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, sClamp ? GL_CLAMP_TO_EDGE : GL_REPEAT);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, tClamp ? GL_CLAMP_TO_EDGE : GL_REPEAT);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, magFilt ? GL_LINEAR : GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, minFilt ? GL_LINEAR : GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, minFilters[minFilt]);
 }
 
 
@@ -557,35 +812,15 @@ void decodeDXT5Block(u32 *dst, const DXT5Block *src, int pitch)
 
 void convertColors(u8 *finalBuf, GLuint dstFmt, int numPixels)
 {
-	// TODO: All these can be massively sped up with SSE, or even
-	// somewhat sped up using "manual simd" in 32 or 64-bit gprs.
 	switch (dstFmt) {
 	case GL_UNSIGNED_SHORT_4_4_4_4:
-		{
-			u16 *p = (u16 *)finalBuf;
-			for (int i = 0; i < numPixels; i++) {
-				u16 c = p[i];
-				p[i] = (c >> 12) | ((c >> 4) & 0xF0) | ((c << 4) & 0xF00) | (c << 12);
-			}
-		}
+		Convert4444((u16 *)finalBuf, numPixels);
 		break;
 	case GL_UNSIGNED_SHORT_5_5_5_1:
-		{
-			u16 *p = (u16 *)finalBuf;
-			for (int i = 0; i < numPixels; i++) {
-				u16 c = p[i];
-				p[i] = ((c & 0x8000) >> 15) | ((c >> 9) & 0x3E) | ((c << 1) & 0x7C0) | ((c << 11) & 0xF800);
-			}
-		}
+		Convert5551((u16 *)finalBuf, numPixels);
 		break;
 	case GL_UNSIGNED_SHORT_5_6_5:
-		{
-			u16 *p = (u16 *)finalBuf;
-			for (int i = 0; i < numPixels; i++) {
-				u16 c = p[i];
-				p[i] = (c >> 11) | (c & 0x07E0) | (c << 11);
-			}
-		}
+		Convert565((u16 *)finalBuf, numPixels);
 		break;
 	default:
 		{
@@ -595,96 +830,17 @@ void convertColors(u8 *finalBuf, GLuint dstFmt, int numPixels)
 	}
 }
 
-void PSPSetTexture()
+// Decodes one level, out points into b afterwards. Only reads p and PSP memory,
+// so decode threads can run it with their own buffers.
+static bool DecodeTextureLevel(const TexDecodeParams &p, TexDecodeBuffers &b, TexDecodeResult &out)
 {
-	u32 texaddr = (gstate.texaddr[0] & 0xFFFFF0) | ((gstate.texbufwidth[0]<<8) & 0xFF000000);
-	texaddr &= 0xFFFFFFF;
-
-	if (!texaddr) return;
-
-	u8 level = 0;
-	u32 format = gstate.texformat & 0xF;
-	u32 clutformat = gstate.clutformat & 3;
-	u32 clutaddr = GetClutAddr(clutformat == GE_CMODE_32BIT_ABGR8888 ? 4 : 2);
-
-	DEBUG_LOG(G3D,"Texture at %08x",texaddr);
-	u8 *texptr = Memory::GetPointer(texaddr);
-	u32 texhash = texptr ? *(u32*)texptr : 0;
+	u32 texaddr = p.texaddr;
+	u32 format = p.format;
+	int bufw = p.bufw;
+	int w = 1 << (p.dim & 0xf);
+	int h = 1 << ((p.dim >> 8) & 0xf);
+	const u8 *texptr = Memory::GetPointer(texaddr);
 
-	u64 cachekey = texaddr ^ clutaddr;
-	cachekey |= (u64) texhash << 32;
-	TexCache::iterator iter = cache.find(cachekey);
-	if (iter != cache.end())
-	{
-		//Validate the texture here (width, height etc)
-		TexCacheEntry &entry = iter->second;
-
-		int dim = gstate.texsize[0] & 0xF0F;
-		bool match = true;
-		
-		//TODO: Check more texture parameters, compute real texture hash
-		if (dim != entry.dim || entry.hash != texhash || entry.format != format)
-			match = false;
-
-		//TODO: Check more clut parameters, compute clut hash
-		if (match && (format >= GE_TFMT_CLUT4 && format <= GE_TFMT_CLUT32) &&
-			 (entry.clutformat != clutformat ||
-				entry.clutaddr != clutaddr ||
-				entry.cluthash != Memory::Read_U32(entry.clutaddr))) 
-			match = false;
-
-		if (match) {
-			//got one!
-			entry.frameCounter = gpuStats.numFrames;
-			glBindTexture(GL_TEXTURE_2D, entry.texture);
-			UpdateSamplingParams();
-			DEBUG_LOG(G3D, "Texture at %08x Found in Cache, applying", texaddr);
-			return; //Done!
-		} else {
-			INFO_LOG(G3D, "Texture different or overwritten, reloading at %08x", texaddr);
-			glDeleteTextures(1, &entry.texture);
-			cache.erase(iter);
-		}
-	}
-	else
-	{
-		INFO_LOG(G3D,"No texture in cache, decoding...");
-	}
-
-	//we have to decode it
-
-	TexCacheEntry entry;
-
-	entry.addr = texaddr;
-	entry.hash = texhash;
-	entry.format = format;
-	entry.frameCounter = gpuStats.numFrames;
-
-	if(format >= GE_TFMT_CLUT4 && format <= GE_TFMT_CLUT32)
-	{
-		entry.clutformat = clutformat;
-		entry.clutaddr = GetClutAddr(clutformat == GE_CMODE_32BIT_ABGR8888 ? 4 : 2);
-		entry.cluthash = Memory::Read_U32(entry.clutaddr);
-	}
-	else
-	{
-		entry.clutaddr = 0;
-	}
-
-	glGenTextures(1, &entry.texture);
-	glBindTexture(GL_TEXTURE_2D, entry.texture);
-			
-	int bufw = gstate.texbufwidth[0] & 0x3ff;
-	
-	entry.dim = gstate.texsize[0] & 0xF0F;
-
-	int w = 1 << (gstate.texsize[0] & 0xf);
-	int h = 1 << ((gstate.texsize[0]>>8) & 0xf);
-
-	INFO_LOG(G3D, "Creating texture %i from %08x: %i x %i (stride: %i). fmt: %i", entry.texture, entry.addr, w, h, bufw, entry.format);
-
-	gstate_c.curTextureWidth=w;
-	gstate_c.curTextureHeight=h;
 	GLenum dstFmt = 0;
 	u32 texByteAlign = 1;
 
@@ -692,104 +848,101 @@ void PSPSetTexture()
 
 	// TODO: Look into using BGRA for 32-bit textures when the GL_EXT_texture_format_BGRA8888 extension is available, as it's faster than RGBA on some chips.
 
-	// TODO: Actually decode the mipmaps.
-
 	switch (format)
 	{
 	case GE_TFMT_CLUT4:
-		dstFmt = getClutDestFormat((GEPaletteFormat)(gstate.clutformat & 3));
+		dstFmt = getClutDestFormat((GEPaletteFormat)(p.clutformat & 3));
 
-		switch (clutformat)
+		switch (p.clutformat & 3)
 		{
 		case GE_CMODE_16BIT_BGR5650:
 		case GE_CMODE_16BIT_ABGR5551:
 		case GE_CMODE_16BIT_ABGR4444:
 			{
-			u16 *clut = ReadClut16();
+			u16 *clut = ReadClut16(p, b);
 			u32 clutSharingOff = 0;//gstate.mipmapShareClut ? 0 : level * 16;
+			u16 palette[16];
+			ResolvePalette(palette, clut + clutSharingOff, p.clutformat, 16);
 			texByteAlign = 2;
-			if (!(gstate.texmode & 1))
+			const u8 *src = GetTexturePointer(texaddr, bufw * h / 2);
+			if (p.texmode & 1)
+			{
+				UnswizzleFromMem(p, b, 0);
+				DeIndex4To16(b.tmpTexBuf16, (const u8 *)b.tmpTexBuf32, bufw * h, palette);
+			}
+			else if (src)
+			{
+				DeIndex4To16(b.tmpTexBuf16, src, bufw * h, palette);
+			}
+			else
 			{
 				u32 addr = texaddr;
 				for (int i = 0; i < bufw * h; i += 2)
 				{
 					u8 index = Memory::Read_U8(addr);
-					tmpTexBuf16[i + 0] = clut[GetClutIndex((index >> 0) & 0xf) + clutSharingOff];
-					tmpTexBuf16[i + 1] = clut[GetClutIndex((index >> 4) & 0xf) + clutSharingOff];
+					b.tmpTexBuf16[i + 0] = clut[GetClutIndex(p.clutformat, (index >> 0) & 0xf) + clutSharingOff];
+					b.tmpTexBuf16[i + 1] = clut[GetClutIndex(p.clutformat, (index >> 4) & 0xf) + clutSharingOff];
 					addr++;
 				}
 			}
-			else
-			{
-				UnswizzleFromMem(texaddr, 0, level);
-				for (int i = 0, j = 0; i < bufw * h; i += 8, j++)
-				{
-					u32 n = tmpTexBuf32[j];
-					u32 k, index;
-					for (k = 0; k < 8; k++) {
-						index = (n >> (k * 4)) & 0xf;
-						tmpTexBuf16[i + k] = clut[GetClutIndex(index) + clutSharingOff];
-					}
-				}
-			}
-			finalBuf = tmpTexBuf16;
+			finalBuf = b.tmpTexBuf16;
 			}
 			break;
 
 		case GE_CMODE_32BIT_ABGR8888:
 			{
-			u32 *clut = ReadClut32();
+			u32 *clut = ReadClut32(p, b);
 			u32 clutSharingOff = 0;//gstate.mipmapShareClut ? 0 : level * 16;
-			if (!(gstate.texmode & 1))
+			u32 palette[16];
+			ResolvePalette(palette, clut + clutSharingOff, p.clutformat, 16);
+			const u8 *src = GetTexturePointer(texaddr, bufw * h / 2);
+			if (p.texmode & 1)
+			{
+				// Expands in place, the decoder works from the back.
+				UnswizzleFromMem(p, b, 0);
+				DeIndex4To32(b.tmpTexBuf32, (const u8 *)b.tmpTexBuf32, bufw * h, palette);
+			}
+			else if (src)
+			{
+				DeIndex4To32(b.tmpTexBuf32, src, bufw * h, palette);
+			}
+			else
 			{
 				u32 addr = texaddr;
 				for (int i = 0; i < bufw * h; i += 2)
 				{
 					u8 index = Memory::Read_U8(addr);
-					tmpTexBuf32[i + 0] = clut[GetClutIndex((index >> 0) & 0xf) + clutSharingOff];
-					tmpTexBuf32[i + 1] = clut[GetClutIndex((index >> 4) & 0xf) + clutSharingOff];
+					b.tmpTexBuf32[i + 0] = clut[GetClutIndex(p.clutformat, (index >> 0) & 0xf) + clutSharingOff];
+					b.tmpTexBuf32[i + 1] = clut[GetClutIndex(p.clutformat, (index >> 4) & 0xf) + clutSharingOff];
 					addr++;
 				}
 			}
-			else
-			{
-				u32 pixels = bufw * h;
-				UnswizzleFromMem(texaddr, 0, level);
-				for (int i = pixels - 8, j = (pixels / 8) - 1; i >= 0; i -= 8, j--)
-				{
-					u32 n = tmpTexBuf32[j];
-					for (int k = 0; k < 8; k++) {
-						u32 index = (n >> (k * 4)) & 0xf;
-						tmpTexBuf32[i + k] = clut[GetClutIndex(index) + clutSharingOff];
-					}
-				}
-			}
-			finalBuf = tmpTexBuf32;
+			finalBuf = b.tmpTexBuf32;
 			}
 			break;
 
 		default:
-			ERROR_LOG(G3D, "Unknown CLUT4 texture mode %d", (gstate.clutformat & 3));
-			return;
+			ERROR_LOG(G3D, "Unknown CLUT4 texture mode %d", (p.clutformat & 3));
+			return false;
 		}
 		break;
 
 	case GE_TFMT_CLUT8:
-		finalBuf = readIndexedTex(level, texaddr, 1);
-		dstFmt = getClutDestFormat((GEPaletteFormat)(gstate.clutformat & 3));
-		texByteAlign = texByteAlignMap[(gstate.clutformat & 3)];
+		finalBuf = readIndexedTex(p, b, 1);
+		dstFmt = getClutDestFormat((GEPaletteFormat)(p.clutformat & 3));
+		texByteAlign = texByteAlignMap[(p.clutformat & 3)];
 		break;
 
 	case GE_TFMT_CLUT16:
-		finalBuf = readIndexedTex(level, texaddr, 2);
-		dstFmt = getClutDestFormat((GEPaletteFormat)(gstate.clutformat & 3));
-		texByteAlign = texByteAlignMap[(gstate.clutformat & 3)];
+		finalBuf = readIndexedTex(p, b, 2);
+		dstFmt = getClutDestFormat((GEPaletteFormat)(p.clutformat & 3));
+		texByteAlign = texByteAlignMap[(p.clutformat & 3)];
 		break;
 
 	case GE_TFMT_CLUT32:
-		finalBuf = readIndexedTex(level, texaddr, 4);
-		dstFmt = getClutDestFormat((GEPaletteFormat)(gstate.clutformat & 3));
-		texByteAlign = texByteAlignMap[(gstate.clutformat & 3)];
+		finalBuf = readIndexedTex(p, b, 4);
+		dstFmt = getClutDestFormat((GEPaletteFormat)(p.clutformat & 3));
+		texByteAlign = texByteAlignMap[(p.clutformat & 3)];
 		break;
 
 	case GE_TFMT_4444:
@@ -803,35 +956,47 @@ void PSPSetTexture()
 			dstFmt = GL_UNSIGNED_SHORT_5_6_5;
 		texByteAlign = 2;
 
-		if (!(gstate.texmode & 1))
+		if (!(p.texmode & 1))
 		{
 			int len = std::max(bufw, w) * h;
-			for (int i = 0; i < len; i++)
-				tmpTexBuf16[i] = Memory::Read_U16(texaddr + i * 2);
-			finalBuf = tmpTexBuf16;
+			const u8 *src = GetTexturePointer(texaddr, len * 2);
+			if (src)
+				memcpy(b.tmpTexBuf16, src, len * 2);
+			else
+			{
+				for (int i = 0; i < len; i++)
+					b.tmpTexBuf16[i] = Memory::Read_U16(texaddr + i * 2);
+			}
+			finalBuf = b.tmpTexBuf16;
 		}
 		else
-			finalBuf = UnswizzleFromMem(texaddr, 2, level);
+			finalBuf = UnswizzleFromMem(p, b, 2);
 		break;
 
 	case GE_TFMT_8888:
 		dstFmt = GL_UNSIGNED_BYTE;
-		if (!(gstate.texmode & 1))
+		if (!(p.texmode & 1))
 		{
 			int len = bufw * h;
-			for (int i = 0; i < len; i++)
-				tmpTexBuf32[i] = Memory::Read_U32(texaddr + i * 4);
-			finalBuf = tmpTexBuf32;
+			const u8 *src = GetTexturePointer(texaddr, len * 4);
+			if (src)
+				memcpy(b.tmpTexBuf32, src, len * 4);
+			else
+			{
+				for (int i = 0; i < len; i++)
+					b.tmpTexBuf32[i] = Memory::Read_U32(texaddr + i * 4);
+			}
+			finalBuf = b.tmpTexBuf32;
 		}
 		else
-			finalBuf = UnswizzleFromMem(texaddr, 4, level);
+			finalBuf = UnswizzleFromMem(p, b, 4);
 		break;
 
 	case GE_TFMT_DXT1:
 		dstFmt = GL_UNSIGNED_BYTE;
 		{
-			u32 *dst = tmpTexBuf32;
-			DXT1Block *src = (DXT1Block*)texptr;
+			u32 *dst = b.tmpTexBuf32;
+			const DXT1Block *src = (const DXT1Block *)texptr;
 
 			for (int y = 0; y < h; y += 4)
 			{
@@ -842,7 +1007,7 @@ void PSPSetTexture()
 					blockIndex++;
 				}
 			}
-			finalBuf = tmpTexBuf32;
+			finalBuf = b.tmpTexBuf32;
 			w = (w + 3) & ~3;
 		}
 		break;
@@ -850,8 +1015,8 @@ void PSPSetTexture()
 	case GE_TFMT_DXT3:
 		dstFmt = GL_UNSIGNED_BYTE;
 		{
-			u32 *dst = tmpTexBuf32;
-			DXT3Block *src = (DXT3Block*)texptr;
+			u32 *dst = b.tmpTexBuf32;
+			const DXT3Block *src = (const DXT3Block *)texptr;
 
 			// Alpha is off
 			for (int y = 0; y < h; y += 4)
@@ -864,16 +1029,16 @@ void PSPSetTexture()
 				}
 			}
 			w = (w + 3) & ~3;
-			finalBuf = tmpTexBuf32;
+			finalBuf = b.tmpTexBuf32;
 		}
 		break;
 
 	case GE_TFMT_DXT5:
-		ERROR_LOG(G3D, "Unhandled compressed texture, format %i! swizzle=%i", format, gstate.texmode & 1);
+		ERROR_LOG(G3D, "Unhandled compressed texture, format %i! swizzle=%i", format, p.texmode & 1);
 		dstFmt = GL_UNSIGNED_BYTE;
 		{
-			u32 *dst = tmpTexBuf32;
-			DXT5Block *src = (DXT5Block*)texptr;
+			u32 *dst = b.tmpTexBuf32;
+			const DXT5Block *src = (const DXT5Block *)texptr;
 
 			// Alpha is almost right
 			for (int y = 0; y < h; y += 4)
@@ -886,18 +1051,18 @@ void PSPSetTexture()
 				}
 			}
 			w = (w + 3) & ~3;
-			finalBuf = tmpTexBuf32;
+			finalBuf = b.tmpTexBuf32;
 		}
 		break;
 
 	default:
 		ERROR_LOG(G3D, "Unknown Texture Format %d!!!", format);
-		finalBuf = tmpTexBuf32;
-		return;
+		return false;
 	}
 
 	if (!finalBuf) {
-		ERROR_LOG(G3D, "NO finalbuf! Will crash!");
+		ERROR_LOG(G3D, "NO finalbuf!");
+		return false;
 	}
 
 	convertColors((u8*)finalBuf, dstFmt, bufw * h);
@@ -920,8 +1085,8 @@ void PSPSetTexture()
 		const u8 *read = (const u8 *)finalBuf;
 		u8 *write = 0;
 		if (w > bufw) {
-			write = (u8 *)tmpTexBufRearrange;
-			finalBuf = tmpTexBufRearrange;
+			write = (u8 *)b.tmpTexBufRearrange;
+			finalBuf = b.tmpTexBufRearrange;
 		} else {
 			write = (u8 *)finalBuf;
 		}
@@ -932,26 +1097,469 @@ void PSPSetTexture()
 		}
 	}
 
-	// Can restore these and remove the above fixup on some platforms.
-	//glPixelStorei(GL_UNPACK_ROW_LENGTH, bufw);
-	glPixelStorei(GL_UNPACK_ALIGNMENT, texByteAlign);
-	//glPixelStorei(GL_PACK_ROW_LENGTH, bufw);
-	glPixelStorei(GL_PACK_ALIGNMENT, texByteAlign);
+	out.pixels = finalBuf;
+	out.dstFmt = dstFmt;
+	out.texByteAlign = texByteAlign;
+	out.w = w;
+	out.h = h;
+	return true;
+}
+
+// A level decoded ahead of time on a decode thread.
+struct TexDecodeJob
+{
+	TexDecodeParams params;
+	// decodeGeneration when it was queued. Once that changes, memory may have been written since.
+	u32 generation;
+	bool started;
+	bool done;
+	bool ok;
+	TexDecodeResult result;
+	std::vector<u8> data;
+};
+
+static std::mutex decodeLock;
+// Workers wait on decodeWake for jobs, the GPU thread on decodeDone for running ones.
+static std::condition_variable decodeWake;
+static std::condition_variable decodeDone;
+static std::deque<TexDecodeJob *> decodeQueue;
+// Every job, queued, running or done, until it's used or dropped.
+static std::vector<TexDecodeJob *> decodeJobs;
+static std::vector<std::thread *> decodeThreads;
+static bool decodeQuit;
+static u32 decodeGeneration;
+
+static void RunDecodeJob(TexDecodeJob *job, TexDecodeBuffers &b)
+{
+	TexDecodeResult result;
+	job->ok = DecodeTextureLevel(job->params, b, result);
+	if (job->ok)
+	{
+		// The buffers get reused for the next job, so keep a copy.
+		size_t size = result.w * result.h * (result.dstFmt == GL_UNSIGNED_BYTE ? 4 : 2);
+		const u8 *pixels = (const u8 *)result.pixels;
+		job->data.assign(pixels, pixels + size);
+		job->result = result;
+		job->result.pixels = job->data.empty() ? NULL : &job->data[0];
+	}
+}
+
+static void DecodeThread()
+{
+	TexDecodeBuffers buffers;
+	std::unique_lock<std::mutex> guard(decodeLock);
+	while (true)
+	{
+		while (!decodeQuit && decodeQueue.empty())
+			decodeWake.wait(guard);
+		if (decodeQuit)
+			break;
+
+		TexDecodeJob *job = decodeQueue.front();
+		decodeQueue.pop_front();
+		job->started = true;
+
+		guard.unlock();
+		RunDecodeJob(job, buffers);
+		guard.lock();
+
+		job->done = true;
+		decodeDone.notify_all();
+	}
+}
+
+static void StartDecodeThreads()
+{
+	decodeQuit = false;
+	int numThreads = std::min(g_Config.iTextureDecodeThreads, MAX_DECODE_THREADS);
+	for (int i = 0; i < numThreads; i++)
+		decodeThreads.push_back(new std::thread(&DecodeThread));
+}
+
+static void StopDecodeThreads()
+{
+	{
+		std::lock_guard<std::mutex> guard(decodeLock);
+		decodeQuit = true;
+		decodeWake.notify_all();
+	}
+	for (size_t i = 0; i < decodeThreads.size(); i++)
+	{
+		decodeThreads[i]->join();
+		delete decodeThreads[i];
+	}
+	decodeThreads.clear();
+
+	for (size_t i = 0; i < decodeJobs.size(); i++)
+		delete decodeJobs[i];
+	decodeJobs.clear();
+	decodeQueue.clear();
+}
+
+void TextureCache_DropPrefetches()
+{
+	if (decodeThreads.empty())
+		return;
+	std::lock_guard<std::mutex> guard(decodeLock);
+	decodeGeneration++;
+	// Running jobs still belong to their thread, they get cleaned up by FindDecodeJob later.
+	for (size_t i = 0; i < decodeQueue.size(); i++)
+	{
+		decodeJobs.erase(std::find(decodeJobs.begin(), decodeJobs.end(), decodeQueue[i]));
+		delete decodeQueue[i];
+	}
+	decodeQueue.clear();
+}
+
+// decodeLock must be held.
+static TexDecodeJob *FindDecodeJob(const TexDecodeParams &params)
+{
+	TexDecodeJob *found = NULL;
+	for (size_t i = 0; i < decodeJobs.size(); )
+	{
+		TexDecodeJob *job = decodeJobs[i];
+		if (job->generation != decodeGeneration)
+		{
+			if (job->done)
+			{
+				decodeJobs.erase(decodeJobs.begin() + i);
+				delete job;
+				continue;
+			}
+		}
+		else if (job->params == params)
+			found = job;
+		i++;
+	}
+	return found;
+}
+
+// decodeLock must be held.
+static void QueueDecodeJob(const TexDecodeParams &params)
+{
+	// Looking first also cleans out stale jobs.
+	if (FindDecodeJob(params) || decodeJobs.size() >= MAX_DECODE_JOBS)
+		return;
+	TexDecodeJob *job = new TexDecodeJob();
+	job->params = params;
+	job->generation = decodeGeneration;
+	job->started = false;
+	job->done = false;
+	job->ok = false;
+	decodeJobs.push_back(job);
+	decodeQueue.push_back(job);
+	decodeWake.notify_one();
+}
+
+// Returns the decoded level if a thread has it or is working on it, the caller deletes it.
+// One nobody started on yet is dropped, the caller can decode it sooner itself.
+static TexDecodeJob *TakeDecodeJob(const TexDecodeParams &params)
+{
+	if (decodeThreads.empty())
+		return NULL;
+	std::unique_lock<std::mutex> guard(decodeLock);
+	TexDecodeJob *job = FindDecodeJob(params);
+	if (!job)
+		return NULL;
+	decodeJobs.erase(std::find(decodeJobs.begin(), decodeJobs.end(), job));
+	if (!job->started)
+	{
+		decodeQueue.erase(std::find(decodeQueue.begin(), decodeQueue.end(), job));
+		delete job;
+		return NULL;
+	}
+	while (!job->done)
+		decodeDone.wait(guard);
+	return job;
+}
+
+static TexDecodeParams GetDecodeParams(int level)
+{
+	TexDecodeParams params;
+	params.texaddr = ((gstate.texaddr[level] & 0xFFFFF0) | ((gstate.texbufwidth[level] << 8) & 0xFF000000)) & 0x0FFFFFFF;
+	params.format = gstate.texformat & 0xF;
+	params.texmode = gstate.texmode & 1;
+	params.bufw = gstate.texbufwidth[level] & 0x3FF;
+	params.dim = gstate.texsize[level] & 0xF0F;
+	if (params.format >= GE_TFMT_CLUT4 && params.format <= GE_TFMT_CLUT32)
+	{
+		params.clutformat = gstate.clutformat & 0xFFFFFF;
+		params.clutbase = (gstate.clutaddr & 0xFFFFFF) | ((gstate.clutaddrupper << 8) & 0x0F000000);
+		params.loadclut = gstate.loadclut & 0x3F;
+	}
+	else
+	{
+		params.clutformat = 0;
+		params.clutbase = 0;
+		params.loadclut = 0;
+	}
+	return params;
+}
+
+// How many levels to upload. GL needs each one half the size of the last, so stop where the game's don't.
+static int GetNumMipLevels(u32 format)
+{
+	if (!g_Config.bTextureMipmaps)
+		return 1;
+	// DXT levels get rounded up to whole blocks.
+	int minSize = format >= GE_TFMT_DXT1 ? 2 : 0;
+	int maxLevel = (gstate.texmode >> 16) & 7;
+	int w = gstate.texsize[0] & 0xf;
+	int h = (gstate.texsize[0] >> 8) & 0xf;
+	int numLevels = 1;
+	for (int level = 1; level <= maxLevel; level++)
+	{
+		w = std::max(w - 1, 0);
+		h = std::max(h - 1, 0);
+		if ((gstate.texsize[level] & 0xF0F) != (u32)((h << 8) | w) || w < minSize || h < minSize)
+			break;
+		if (!Memory::IsValidAddress(GetDecodeParams(level).texaddr))
+			break;
+		numLevels++;
+	}
+#if defined(USING_GLES2)
+	// No GL_TEXTURE_MAX_LEVEL, an incomplete chain would sample as black.
+	int lastW = (gstate.texsize[0] & 0xf) - (numLevels - 1);
+	int lastH = ((gstate.texsize[0] >> 8) & 0xf) - (numLevels - 1);
+	if (lastW > 0 || lastH > 0)
+		return 1;
+#endif
+	return numLevels;
+}
+
+// texhash gets the texture's first word.
+static u64 GetCacheKey(u32 texaddr, u32 clutaddr, bool hasClut, bool fullHash, u64 &texhash)
+{
+	const u8 *texptr = Memory::GetPointer(texaddr);
+	texhash = texptr ? *(const u32 *)texptr : 0;
+	// The content hash isn't part of the key, it's checked (lazily) against the entry instead.
+	if (fullHash)
+		return texaddr | ((u64)(hasClut ? clutaddr : 0) << 32);
+	return (texaddr ^ clutaddr) | (texhash << 32);
+}
+
+// Starts decoding the texture that was just set, so it's ready by the time a draw needs it.
+void TextureCache_Prefetch()
+{
+	if (decodeThreads.empty())
+		return;
+
+	TexDecodeParams params = GetDecodeParams(0);
+	if (!params.texaddr || !Memory::IsValidAddress(params.texaddr))
+		return;
+
+	// Most textures will already be in the cache, only look at cheap things to check that.
+	bool hasClut = params.format >= GE_TFMT_CLUT4 && params.format <= GE_TFMT_CLUT32;
+	u32 clutaddr = GetClutAddr((gstate.clutformat & 3) == GE_CMODE_32BIT_ABGR8888 ? 4 : 2);
+	u64 texhash;
+	TexCacheEntry *entry = cache.Find(GetCacheKey(params.texaddr, clutaddr, hasClut, g_Config.bTextureFullHash, texhash));
+	if (entry && entry->dim == (int)params.dim && entry->format == params.format && !entry->invalid && entry->firstWord == (u32)texhash)
+		return;
+
+	int numLevels = GetNumMipLevels(params.format);
+	std::lock_guard<std::mutex> guard(decodeLock);
+	QueueDecodeJob(params);
+	for (int level = 1; level < numLevels; level++)
+		QueueDecodeJob(GetDecodeParams(level));
+}
+
+// Bytes the texture covers in PSP memory, rows are bufw texels apart.
+static u32 TextureSizeInRAM(u32 format, int bufw, int dim)
+{
+	static const u8 bitsPerTexel[16] = {16, 16, 16, 32, 4, 8, 16, 32, 4, 8, 8};
+	int w = 1 << (dim & 0xf);
+	int h = 1 << ((dim >> 8) & 0xf);
+	return std::max(bufw, w) * h * bitsPerTexel[format] / 8;
+}
+
+static u64 HashTexture(u32 addr, u32 size)
+{
+	if (size == 0 || !Memory::IsValidAddress(addr) || !Memory::IsValidAddress(addr + size - 1))
+		return 0;
+	const u8 *data = Memory::GetPointer(addr);
+	return GetTextureHash(data, size, size > TEXTURE_FULL_HASH_BYTES ? TEXTURE_HASH_SAMPLES : 0);
+}
+
+void PSPSetTexture()
+{
+	u32 texaddr = (gstate.texaddr[0] & 0xFFFFF0) | ((gstate.texbufwidth[0]<<8) & 0xFF000000);
+	texaddr &= 0xFFFFFFF;
+
+	if (!texaddr) return;
+
+	u32 format = gstate.texformat & 0xF;
+	u32 clutformat = gstate.clutformat & 3;
+	u32 clutaddr = GetClutAddr(clutformat == GE_CMODE_32BIT_ABGR8888 ? 4 : 2);
+
+	DEBUG_LOG(G3D,"Texture at %08x",texaddr);
+	bool hasClut = format >= GE_TFMT_CLUT4 && format <= GE_TFMT_CLUT32;
+	bool fullHash = g_Config.bTextureFullHash;
+	int dim = gstate.texsize[0] & 0xF0F;
+
+	u64 texhash;
+	u64 cachekey = GetCacheKey(texaddr, clutaddr, hasClut, fullHash, texhash);
+
+	TexCacheEntry *found = cache.Find(cachekey);
+	if (found)
+	{
+		//Validate the texture here (width, height etc)
+		TexCacheEntry &entry = *found;
+
+		bool match = true;
+		
+		//TODO: Check more texture parameters
+		if (dim != entry.dim || entry.format != format)
+			match = false;
+
+		if (match && hasClut && (entry.clutformat != clutformat || entry.clutaddr != clutaddr))
+			match = false;
+
+		if (match && fullHash)
+		{
+			// The first words are cheap enough to check every time and catch most rewrites.
+			// Only hash all the data again if something wrote to it, or if it's been a while.
+			if (entry.firstWord != (u32)texhash || (hasClut && entry.clutFirstWord != Memory::Read_U32(clutaddr)))
+				match = false;
+			else if (entry.invalid || entry.lastHashFrame + TEXTURE_RECHECK_FRAMES <= gpuStats.numFrames)
+			{
+				match = entry.hash == HashTexture(texaddr, entry.sizeInRAM) &&
+					(!hasClut || entry.cluthash == HashTexture(clutaddr, entry.clutSizeInRAM));
+				entry.invalid = false;
+				entry.lastHashFrame = gpuStats.numFrames;
+			}
+		}
+		else if (match)
+		{
+			if (entry.hash != texhash || (hasClut && entry.cluthash != Memory::Read_U32(entry.clutaddr)))
+				match = false;
+		}
+
+		if (match) {
+			//got one!
+			entry.frameCounter = gpuStats.numFrames;
+			glBindTexture(GL_TEXTURE_2D, entry.texture);
+			UpdateSamplingParams(entry.maxLevel > 0);
+			DEBUG_LOG(G3D, "Texture at %08x Found in Cache, applying", texaddr);
+			return; //Done!
+		} else {
+			INFO_LOG(G3D, "Texture different or overwritten, reloading at %08x", texaddr);
+			glDeleteTextures(1, &entry.texture);
+			cache.Erase(cachekey);
+		}
+	}
+	else
+	{
+		INFO_LOG(G3D,"No texture in cache, decoding...");
+	}
+
+	//we have to decode it
+
+	TexCacheEntry entry;
+
+	entry.addr = texaddr;
+	entry.format = format;
+	entry.frameCounter = gpuStats.numFrames;
+	entry.lastHashFrame = gpuStats.numFrames;
+	entry.invalid = false;
+	entry.sizeInRAM = TextureSizeInRAM(format, gstate.texbufwidth[0] & 0x3ff, dim);
+	entry.firstWord = (u32)texhash;
+	entry.hash = fullHash ? HashTexture(texaddr, entry.sizeInRAM) : texhash;
+
+	if (hasClut)
+	{
+		entry.clutformat = clutformat;
+		entry.clutaddr = clutaddr;
+		entry.clutSizeInRAM = (gstate.loadclut & 0x3f) * 32;
+		entry.clutFirstWord = Memory::Read_U32(clutaddr);
+		if (fullHash)
+			entry.cluthash = HashTexture(clutaddr, entry.clutSizeInRAM);
+		else
+			entry.cluthash = Memory::Read_U32(entry.clutaddr);
+	}
+	else
+	{
+		entry.clutaddr = 0;
+		entry.clutSizeInRAM = 0;
+		entry.clutFirstWord = 0;
+	}
+
+	int bufw = gstate.texbufwidth[0] & 0x3ff;
+	
+	entry.dim = dim;
+
+	int w = 1 << (gstate.texsize[0] & 0xf);
+	int h = 1 << ((gstate.texsize[0]>>8) & 0xf);
+
+	gstate_c.curTextureWidth=w;
+	gstate_c.curTextureHeight=h;
+
+	// Get the decode threads going on the smaller levels while this thread does the first one.
+	int numLevels = GetNumMipLevels(format);
+	if (numLevels > 1 && !decodeThreads.empty())
+	{
+		std::lock_guard<std::mutex> guard(decodeLock);
+		for (int level = 1; level < numLevels; level++)
+			QueueDecodeJob(GetDecodeParams(level));
+	}
+
+	glGenTextures(1, &entry.texture);
+	glBindTexture(GL_TEXTURE_2D, entry.texture);
+
+	INFO_LOG(G3D, "Creating texture %i from %08x: %i x %i (stride: %i). fmt: %i", entry.texture, entry.addr, w, h, bufw, entry.format);
+
+	for (int level = 0; level < numLevels; level++)
+	{
+		TexDecodeParams params = GetDecodeParams(level);
+		TexDecodeJob *job = TakeDecodeJob(params);
+		TexDecodeResult result;
+		bool ok;
+		if (job)
+		{
+			ok = job->ok;
+			result = job->result;
+		}
+		else
+			ok = DecodeTextureLevel(params, *decodeBuffers, result);
+
+		if (!ok)
+		{
+			delete job;
+			if (level == 0)
+			{
+				glDeleteTextures(1, &entry.texture);
+				return;
+			}
+			// Just use the levels we have.
+			numLevels = level;
+			break;
+		}
+
+		// Can restore these and remove the fixup in DecodeTextureLevel on some platforms.
+		//glPixelStorei(GL_UNPACK_ROW_LENGTH, bufw);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, result.texByteAlign);
+		//glPixelStorei(GL_PACK_ROW_LENGTH, bufw);
+		glPixelStorei(GL_PACK_ALIGNMENT, result.texByteAlign);
+
+		GLuint components = result.dstFmt == GL_UNSIGNED_SHORT_5_6_5 ? GL_RGB : GL_RGBA;
+		glTexImage2D(GL_TEXTURE_2D, level, components, result.w, result.h, 0, components, result.dstFmt, result.pixels);
+		delete job;
+	}
 
-	GLuint components = dstFmt == GL_UNSIGNED_SHORT_5_6_5 ? GL_RGB : GL_RGBA;
-	glTexImage2D(GL_TEXTURE_2D, 0, components, w, h, 0, components, dstFmt, finalBuf);
+	entry.maxLevel = numLevels - 1;
+#if !defined(USING_GLES2)
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, entry.maxLevel);
+#endif
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 
-	// glGenerateMipmap(GL_TEXTURE_2D);
-	UpdateSamplingParams();
+	UpdateSamplingParams(entry.maxLevel > 0);
 
 	//glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
 	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
 	//glPixelStorei(GL_PACK_ROW_LENGTH, 0);
 	glPixelStorei(GL_PACK_ALIGNMENT, 1);
 
-	cache[cachekey] = entry;
+	cache.Insert(cachekey, entry);
 }
@@ -25,4 +25,7 @@ void TextureCache_Init();
 void TextureCache_Shutdown();
 void TextureCache_Clear(bool delete_them);
 void TextureCache_Decimate();  // Run this once per frame to get rid of old textures.
+void TextureCache_Invalidate(u32 addr, int size);  // Marks textures in the range for a rehash.
+void TextureCache_Prefetch();  // Starts decoding the current texture on the decode threads, if any.
+void TextureCache_DropPrefetches();  // Throws away decodes that may have read memory that changed since.
 int TextureCache_NumLoadedTextures();
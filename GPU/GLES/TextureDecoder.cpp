@@ -0,0 +1,357 @@
+// Copyright (c) 2012- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#include "Common.h"
+#include "TextureDecoder.h"
+
+#if defined(_M_SSE) || defined(__SSE2__)
+#define TEXDEC_SSE2
+#include "CPUDetect.h"
+#include <emmintrin.h>
+#endif
+
+// The SSSE3 kernels are always built on x86 and only used when cpu_info says the CPU has it.
+// GCC and clang need the target attribute since the rest of the file is built for SSE2 only,
+// and without -mssse3 _mm_shuffle_epi8 comes from CommonFuncs.h instead of tmmintrin.h.
+#if defined(TEXDEC_SSE2) && (defined(_MSC_VER) || defined(__GNUC__))
+#define TEXDEC_SSSE3
+#if defined(_MSC_VER) || defined(__SSSE3__)
+#include <tmmintrin.h>
+#endif
+#ifdef _MSC_VER
+#define TEXDEC_SSSE3_FUNC
+#else
+#define TEXDEC_SSSE3_FUNC __attribute__((target("ssse3")))
+#endif
+#endif
+
+static void UnswizzleBlocks_Generic(u32 *dst, const u8 *src, u32 rowWidth, u32 blockRows)
+{
+	const u32 *s = (const u32 *)src;
+	const u32 pitch = rowWidth / 4;
+	const u32 bxc = rowWidth / 16;
+	u32 ydest = 0;
+	for (u32 by = 0; by < blockRows; by++)
+	{
+		u32 xdest = ydest;
+		for (u32 bx = 0; bx < bxc; bx++)
+		{
+			u32 dest = xdest;
+			for (int n = 0; n < 8; n++)
+			{
+				dst[dest + 0] = s[0];
+				dst[dest + 1] = s[1];
+				dst[dest + 2] = s[2];
+				dst[dest + 3] = s[3];
+				s += 4;
+				dest += pitch;
+			}
+			xdest += 4;
+		}
+		ydest += (rowWidth * 8) / 4;
+	}
+}
+
+static void DeIndex4To16_Generic(u16 *dst, const u8 *src, int pixels, const u16 *palette)
+{
+	int i = 0;
+	for (; i + 2 <= pixels; i += 2)
+	{
+		u8 index = src[i / 2];
+		dst[i + 0] = palette[index & 0xf];
+		dst[i + 1] = palette[index >> 4];
+	}
+	if (i < pixels)
+		dst[i] = palette[src[i / 2] & 0xf];
+}
+
+static void DeIndex4To32_Generic(u32 *dst, const u8 *src, int pixels, const u32 *palette)
+{
+	// Read each byte before writing anything over it.
+	if (pixels & 1)
+		dst[pixels - 1] = palette[src[pixels / 2] & 0xf];
+	for (int i = (pixels & ~1) - 2; i >= 0; i -= 2)
+	{
+		u8 index = src[i / 2];
+		dst[i + 1] = palette[index >> 4];
+		dst[i + 0] = palette[index & 0xf];
+	}
+}
+
+static void DeIndex8To16_Generic(u16 *dst, const u8 *src, int pixels, const u16 *palette)
+{
+	for (int i = 0; i < pixels; i++)
+		dst[i] = palette[src[i]];
+}
+
+static void DeIndex8To32_Generic(u32 *dst, const u8 *src, int pixels, const u32 *palette)
+{
+	for (int i = pixels - 1; i >= 0; i--)
+		dst[i] = palette[src[i]];
+}
+
+static void Convert4444_Generic(u16 *p, int pixels)
+{
+	for (int i = 0; i < pixels; i++)
+	{
+		u16 c = p[i];
+		p[i] = (c >> 12) | ((c >> 4) & 0xF0) | ((c << 4) & 0xF00) | (c << 12);
+	}
+}
+
+static void Convert5551_Generic(u16 *p, int pixels)
+{
+	for (int i = 0; i < pixels; i++)
+	{
+		u16 c = p[i];
+		p[i] = ((c & 0x8000) >> 15) | ((c >> 9) & 0x3E) | ((c << 1) & 0x7C0) | ((c << 11) & 0xF800);
+	}
+}
+
+static void Convert565_Generic(u16 *p, int pixels)
+{
+	for (int i = 0; i < pixels; i++)
+	{
+		u16 c = p[i];
+		p[i] = (c >> 11) | (c & 0x07E0) | (c << 11);
+	}
+}
+
+#ifdef TEXDEC_SSE2
+
+static void UnswizzleBlocks_SSE2(u32 *dst, const u8 *src, u32 rowWidth, u32 blockRows)
+{
+	const __m128i *s = (const __m128i *)src;
+	const u32 pitch = rowWidth / 4;
+	const u32 bxc = rowWidth / 16;
+	u32 ydest = 0;
+	for (u32 by = 0; by < blockRows; by++)
+	{
+		u32 xdest = ydest;
+		for (u32 bx = 0; bx < bxc; bx++)
+		{
+			u32 *d = dst + xdest;
+			for (int n = 0; n < 8; n++)
+			{
+				_mm_storeu_si128((__m128i *)d, _mm_loadu_si128(s++));
+				d += pitch;
+			}
+			xdest += 4;
+		}
+		ydest += (rowWidth * 8) / 4;
+	}
+}
+
+// Each lane is handled the same way as the generic versions, the shifts just do 8 at a time.
+static void Convert4444_SSE2(u16 *p, int pixels)
+{
+	const __m128i maskF0 = _mm_set1_epi16(0xF0);
+	const __m128i maskF00 = _mm_set1_epi16(0xF00);
+	int i = 0;
+	for (; i + 8 <= pixels; i += 8)
+	{
+		__m128i c = _mm_loadu_si128((const __m128i *)(p + i));
+		__m128i r = _mm_or_si128(_mm_srli_epi16(c, 12), _mm_slli_epi16(c, 12));
+		r = _mm_or_si128(r, _mm_and_si128(_mm_srli_epi16(c, 4), maskF0));
+		r = _mm_or_si128(r, _mm_and_si128(_mm_slli_epi16(c, 4), maskF00));
+		_mm_storeu_si128((__m128i *)(p + i), r);
+	}
+	Convert4444_Generic(p + i, pixels - i);
+}
+
+static void Convert5551_SSE2(u16 *p, int pixels)
+{
+	const __m128i mask3E = _mm_set1_epi16(0x3E);
+	const __m128i mask7C0 = _mm_set1_epi16(0x7C0);
+	int i = 0;
+	for (; i + 8 <= pixels; i += 8)
+	{
+		__m128i c = _mm_loadu_si128((const __m128i *)(p + i));
+		// The logical shifts already drop the bits the generic version masks off here.
+		__m128i r = _mm_or_si128(_mm_srli_epi16(c, 15), _mm_slli_epi16(c, 11));
+		r = _mm_or_si128(r, _mm_and_si128(_mm_srli_epi16(c, 9), mask3E));
+		r = _mm_or_si128(r, _mm_and_si128(_mm_slli_epi16(c, 1), mask7C0));
+		_mm_storeu_si128((__m128i *)(p + i), r);
+	}
+	Convert5551_Generic(p + i, pixels - i);
+}
+
+static void Convert565_SSE2(u16 *p, int pixels)
+{
+	const __m128i mask7E0 = _mm_set1_epi16(0x07E0);
+	int i = 0;
+	for (; i + 8 <= pixels; i += 8)
+	{
+		__m128i c = _mm_loadu_si128((const __m128i *)(p + i));
+		__m128i r = _mm_or_si128(_mm_srli_epi16(c, 11), _mm_slli_epi16(c, 11));
+		r = _mm_or_si128(r, _mm_and_si128(c, mask7E0));
+		_mm_storeu_si128((__m128i *)(p + i), r);
+	}
+	Convert565_Generic(p + i, pixels - i);
+}
+
+#endif
+
+#ifdef TEXDEC_SSSE3
+
+// Splits the 16 byte source into 32 nibble indices, in pixel order.
+TEXDEC_SSSE3_FUNC static inline void SplitNibbles(__m128i bytes, __m128i &first, __m128i &second)
+{
+	const __m128i mask = _mm_set1_epi8(0xf);
+	__m128i lo = _mm_and_si128(bytes, mask);
+	__m128i hi = _mm_and_si128(_mm_srli_epi16(bytes, 4), mask);
+	first = _mm_unpacklo_epi8(lo, hi);
+	second = _mm_unpackhi_epi8(lo, hi);
+}
+
+// With only 16 entries, each byte plane of the palette fits in one register and pshufb looks it up.
+TEXDEC_SSSE3_FUNC static void DeIndex4To16_SSSE3(u16 *dst, const u8 *src, int pixels, const u16 *palette)
+{
+	u8 planes[2][16];
+	for (int i = 0; i < 16; i++)
+	{
+		planes[0][i] = palette[i] & 0xff;
+		planes[1][i] = palette[i] >> 8;
+	}
+	const __m128i plane0 = _mm_loadu_si128((const __m128i *)planes[0]);
+	const __m128i plane1 = _mm_loadu_si128((const __m128i *)planes[1]);
+
+	int i = 0;
+	for (; i + 32 <= pixels; i += 32)
+	{
+		__m128i idx[2];
+		SplitNibbles(_mm_loadu_si128((const __m128i *)(src + i / 2)), idx[0], idx[1]);
+		for (int j = 0; j < 2; j++)
+		{
+			__m128i b0 = _mm_shuffle_epi8(plane0, idx[j]);
+			__m128i b1 = _mm_shuffle_epi8(plane1, idx[j]);
+			_mm_storeu_si128((__m128i *)(dst + i + j * 16), _mm_unpacklo_epi8(b0, b1));
+			_mm_storeu_si128((__m128i *)(dst + i + j * 16 + 8), _mm_unpackhi_epi8(b0, b1));
+		}
+	}
+	DeIndex4To16_Generic(dst + i, src + i / 2, pixels - i, palette);
+}
+
+TEXDEC_SSSE3_FUNC static void DeIndex4To32_SSSE3(u32 *dst, const u8 *src, int pixels, const u32 *palette)
+{
+	u8 planes[4][16];
+	for (int i = 0; i < 16; i++)
+	{
+		for (int b = 0; b < 4; b++)
+			planes[b][i] = (palette[i] >> (b * 8)) & 0xff;
+	}
+	const __m128i plane0 = _mm_loadu_si128((const __m128i *)planes[0]);
+	const __m128i plane1 = _mm_loadu_si128((const __m128i *)planes[1]);
+	const __m128i plane2 = _mm_loadu_si128((const __m128i *)planes[2]);
+	const __m128i plane3 = _mm_loadu_si128((const __m128i *)planes[3]);
+
+	// Backwards like the generic one: the tail first, then whole 32 pixel chunks.
+	// Each chunk loads all of its source before storing, and stores only past earlier chunks' source.
+	int full = pixels & ~31;
+	DeIndex4To32_Generic(dst + full, src + full / 2, pixels - full, palette);
+	for (int i = full - 32; i >= 0; i -= 32)
+	{
+		__m128i idx[2];
+		SplitNibbles(_mm_loadu_si128((const __m128i *)(src + i / 2)), idx[0], idx[1]);
+		for (int j = 0; j < 2; j++)
+		{
+			__m128i b0 = _mm_shuffle_epi8(plane0, idx[j]);
+			__m128i b1 = _mm_shuffle_epi8(plane1, idx[j]);
+			__m128i b2 = _mm_shuffle_epi8(plane2, idx[j]);
+			__m128i b3 = _mm_shuffle_epi8(plane3, idx[j]);
+			__m128i lo01 = _mm_unpacklo_epi8(b0, b1);
+			__m128i lo23 = _mm_unpacklo_epi8(b2, b3);
+			__m128i hi01 = _mm_unpackhi_epi8(b0, b1);
+			__m128i hi23 = _mm_unpackhi_epi8(b2, b3);
+			u32 *d = dst + i + j * 16;
+			_mm_storeu_si128((__m128i *)(d + 0), _mm_unpacklo_epi16(lo01, lo23));
+			_mm_storeu_si128((__m128i *)(d + 4), _mm_unpackhi_epi16(lo01, lo23));
+			_mm_storeu_si128((__m128i *)(d + 8), _mm_unpacklo_epi16(hi01, hi23));
+			_mm_storeu_si128((__m128i *)(d + 12), _mm_unpackhi_epi16(hi01, hi23));
+		}
+	}
+}
+
+#endif
+
+void (*UnswizzleBlocks)(u32 *dst, const u8 *src, u32 rowWidth, u32 blockRows) = &UnswizzleBlocks_Generic;
+void (*DeIndex4To16)(u16 *dst, const u8 *src, int pixels, const u16 *palette) = &DeIndex4To16_Generic;
+void (*DeIndex4To32)(u32 *dst, const u8 *src, int pixels, const u32 *palette) = &DeIndex4To32_Generic;
+// A 256 entry table can't live in registers, plain lookups from the resolved palette are as good as it gets.
+void (*DeIndex8To16)(u16 *dst, const u8 *src, int pixels, const u16 *palette) = &DeIndex8To16_Generic;
+void (*DeIndex8To32)(u32 *dst, const u8 *src, int pixels, const u32 *palette) = &DeIndex8To32_Generic;
+void (*Convert4444)(u16 *p, int pixels) = &Convert4444_Generic;
+void (*Convert5551)(u16 *p, int pixels) = &Convert5551_Generic;
+void (*Convert565)(u16 *p, int pixels) = &Convert565_Generic;
+
+void TextureDecoder_Init()
+{
+#ifdef TEXDEC_SSE2
+	if (cpu_info.bSSE2)
+	{
+		UnswizzleBlocks = &UnswizzleBlocks_SSE2;
+		Convert4444 = &Convert4444_SSE2;
+		Convert5551 = &Convert5551_SSE2;
+		Convert565 = &Convert565_SSE2;
+	}
+#endif
+#ifdef TEXDEC_SSSE3
+	if (cpu_info.bSSSE3)
+	{
+		DeIndex4To16 = &DeIndex4To16_SSSE3;
+		DeIndex4To32 = &DeIndex4To32_SSSE3;
+	}
+#endif
+}
+
+int TextureDecoder_GetKernels(const TextureDecoderKernels **kernels)
+{
+	static TextureDecoderKernels sets[3];
+	int count = 0;
+
+	TextureDecoderKernels generic = {
+		"Generic", &UnswizzleBlocks_Generic,
+		&DeIndex4To16_Generic, &DeIndex4To32_Generic, &DeIndex8To16_Generic, &DeIndex8To32_Generic,
+		&Convert4444_Generic, &Convert5551_Generic, &Convert565_Generic,
+	};
+	sets[count++] = generic;
+#ifdef TEXDEC_SSE2
+	if (cpu_info.bSSE2)
+	{
+		TextureDecoderKernels sse2 = {
+			"SSE2", &UnswizzleBlocks_SSE2,
+			0, 0, 0, 0,
+			&Convert4444_SSE2, &Convert5551_SSE2, &Convert565_SSE2,
+		};
+		sets[count++] = sse2;
+	}
+#endif
+#ifdef TEXDEC_SSSE3
+	if (cpu_info.bSSSE3)
+	{
+		TextureDecoderKernels ssse3 = {
+			"SSSE3", 0,
+			&DeIndex4To16_SSSE3, &DeIndex4To32_SSSE3, 0, 0,
+			0, 0, 0,
+		};
+		sets[count++] = ssse3;
+	}
+#endif
+
+	*kernels = sets;
+	return count;
+}
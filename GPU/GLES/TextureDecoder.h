@@ -0,0 +1,58 @@
+// Copyright (c) 2012- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#pragma once
+
+#include "../Globals.h"
+
+// Inner loops of texture decoding. TextureDecoder_Init points these at the
+// fastest versions the host CPU supports, all of them give identical output.
+void TextureDecoder_Init();
+
+// Swizzled textures are stored as 16 byte x 8 row blocks. Unswizzles blockRows rows of them,
+// rowWidth is the texture stride in bytes and should be at least 16.
+extern void (*UnswizzleBlocks)(u32 *dst, const u8 *src, u32 rowWidth, u32 blockRows);
+
+// Palette lookups. The palettes already have the clut shift, mask and start applied,
+// so they have 16 entries for 4-bit indices and 256 for 8-bit ones.
+// The 32-bit ones work backwards, so dst may start at the same address as src.
+extern void (*DeIndex4To16)(u16 *dst, const u8 *src, int pixels, const u16 *palette);
+extern void (*DeIndex4To32)(u32 *dst, const u8 *src, int pixels, const u32 *palette);
+extern void (*DeIndex8To16)(u16 *dst, const u8 *src, int pixels, const u16 *palette);
+extern void (*DeIndex8To32)(u32 *dst, const u8 *src, int pixels, const u32 *palette);
+
+// Reorders 16-bit PSP colors in place into the channel order GL expects.
+extern void (*Convert4444)(u16 *p, int pixels);
+extern void (*Convert5551)(u16 *p, int pixels);
+extern void (*Convert565)(u16 *p, int pixels);
+
+// Every set of kernels this build has and the CPU can run, for self checks and benchmarks.
+// The first set is the generic one and has all of them, the others leave out (null) what they don't speed up.
+struct TextureDecoderKernels
+{
+	const char *name;
+	void (*unswizzleBlocks)(u32 *dst, const u8 *src, u32 rowWidth, u32 blockRows);
+	void (*deIndex4To16)(u16 *dst, const u8 *src, int pixels, const u16 *palette);
+	void (*deIndex4To32)(u32 *dst, const u8 *src, int pixels, const u32 *palette);
+	void (*deIndex8To16)(u16 *dst, const u8 *src, int pixels, const u16 *palette);
+	void (*deIndex8To32)(u32 *dst, const u8 *src, int pixels, const u32 *palette);
+	void (*convert4444)(u16 *p, int pixels);
+	void (*convert5551)(u16 *p, int pixels);
+	void (*convert565)(u16 *p, int pixels);
+};
+
+int TextureDecoder_GetKernels(const TextureDecoderKernels **kernels);
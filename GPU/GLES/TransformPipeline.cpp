@@ -15,7 +15,13 @@
 // Official git repository and contact information can be found at
 // https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
 
+#include <algorithm>
+#include <map>
+#include <vector>
+
+#include "Hash.h"
 #include "../../Core/MemMap.h"
+#include "../../Core/Config.h"
 #include "../../Core/Host.h"
 #include "../../Core/System.h"
 #include "../../native/gfx_es2/gl_state.h"
@@ -192,6 +198,215 @@ void Lighter::Light(float colorOut0[4], float colorOut1[4], const float colorIn[
 	}
 }
 
+// Static geometry tends to be drawn from the same place every frame, so the decoded vertices
+// are kept and reused as long as the vertex and index data hash the same.
+#define VERTEXCACHE_KILL_AGE 120
+// Frames an entry's data has to stay the same before it's only rehashed now and then.
+#define VERTEXCACHE_STABLE_FRAMES 4
+#define VERTEXCACHE_RECHECK_FRAMES 8
+
+enum VertexCacheStatus
+{
+	VERTEXCACHE_NEW,         // Rehashed on every draw until it has been stable for a few frames.
+	VERTEXCACHE_RELIABLE,    // Only rehashed every VERTEXCACHE_RECHECK_FRAMES, or when invalidated.
+	VERTEXCACHE_UNRELIABLE,  // Changed behind our back before, decoded every time.
+};
+
+struct VertexCacheKey
+{
+	u32 vertexAddr;
+	u32 indexAddr;
+	u32 vertType;
+	int count;
+	// Other state that ends up in the decoded vertices: the texture size through mode UVs
+	// are divided by, and whether normals are reversed.
+	u32 texSize;
+	bool reverseNormals;
+
+	bool operator <(const VertexCacheKey &other) const
+	{
+		if (vertexAddr != other.vertexAddr)
+			return vertexAddr < other.vertexAddr;
+		if (indexAddr != other.indexAddr)
+			return indexAddr < other.indexAddr;
+		if (vertType != other.vertType)
+			return vertType < other.vertType;
+		if (count != other.count)
+			return count < other.count;
+		if (texSize != other.texSize)
+			return texSize < other.texSize;
+		return reverseNormals < other.reverseNormals;
+	}
+};
+
+struct VertexCacheEntry
+{
+	std::vector<DecodedVertex> decoded;
+	int indexLowerBound;
+	int indexUpperBound;
+	u64 hash;
+	int status;
+	bool invalid;
+	int lastFrame;
+	int lastHashFrame;
+	int stableSince;
+	// Memory the hash covers, for invalidation.
+	u32 vertexStart, vertexEnd;
+	u32 indexStart, indexEnd;
+};
+
+typedef std::map<VertexCacheKey, VertexCacheEntry> VertexCache;
+static VertexCache vertexCache;
+
+static int IndexSize(u32 vertType)
+{
+	switch (vertType & GE_VTYPE_IDX_MASK)
+	{
+	case GE_VTYPE_IDX_8BIT:
+		return 1;
+	case GE_VTYPE_IDX_16BIT:
+		return 2;
+	default:
+		return 0;
+	}
+}
+
+static u64 HashVertexData(const void *inds, const VertexCacheEntry &entry)
+{
+	u64 hash = GetTextureHash((const u8 *)Memory::GetPointer(entry.vertexStart), entry.vertexEnd - entry.vertexStart, 0);
+	if (entry.indexEnd != entry.indexStart)
+		hash ^= GetTextureHash((const u8 *)inds, entry.indexEnd - entry.indexStart, 0) * 0x9E3779B97F4A7C15ULL;
+	return hash;
+}
+
+static void DecodeIntoEntry(VertexCacheEntry &entry, const VertexDecoder &dec, const VertexCacheKey &key, void *verts, void *inds, int prim)
+{
+	// Decode into the scratch buffer first, the bounds aren't known until afterwards.
+	dec.DecodeVerts(decoded, verts, inds, prim, key.count, &entry.indexLowerBound, &entry.indexUpperBound);
+	int numVerts = std::max(0, entry.indexUpperBound - entry.indexLowerBound + 1);
+	entry.decoded.assign(decoded, decoded + numVerts);
+
+	entry.vertexStart = (key.vertexAddr + entry.indexLowerBound * dec.VertexSize()) & 0x0FFFFFFF;
+	entry.vertexEnd = entry.vertexStart + numVerts * dec.VertexSize();
+	entry.indexStart = key.indexAddr & 0x0FFFFFFF;
+	entry.indexEnd = entry.indexStart + (inds ? key.count * IndexSize(key.vertType) : 0);
+	entry.hash = HashVertexData(inds, entry);
+	entry.status = VERTEXCACHE_NEW;
+	entry.invalid = false;
+	entry.lastHashFrame = gpuStats.numFrames;
+	entry.stableSince = gpuStats.numFrames;
+}
+
+// Returns the decoded vertices, either from the cache or freshly decoded into the scratch buffer.
+static const DecodedVertex *DecodeVertsCached(const VertexDecoder &dec, void *verts, void *inds, int prim, int count, int *indexLowerBound, int *indexUpperBound)
+{
+	VertexCacheKey key;
+	// Only GE_CMD_PRIM draws come through here, so the addresses are the current ones.
+	key.vertexAddr = gstate_c.vertexAddr;
+	key.indexAddr = inds ? gstate_c.indexAddr : 0;
+	key.vertType = gstate.vertType;
+	key.count = count;
+	key.texSize = 0;
+	if ((gstate.vertType & GE_VTYPE_THROUGH_MASK) && (gstate.vertType & GE_VTYPE_TC_MASK))
+		key.texSize = gstate_c.curTextureWidth | (gstate_c.curTextureHeight << 16);
+	key.reverseNormals = (gstate.reversenormals & 0xFFFFFF) != 0;
+
+	VertexCache::iterator iter = vertexCache.find(key);
+	if (iter == vertexCache.end())
+	{
+		VertexCacheEntry &entry = vertexCache[key];
+		DecodeIntoEntry(entry, dec, key, verts, inds, prim);
+		entry.lastFrame = gpuStats.numFrames;
+		gpuStats.numVertexCacheMisses++;
+		*indexLowerBound = entry.indexLowerBound;
+		*indexUpperBound = entry.indexUpperBound;
+		if (entry.decoded.empty())
+		{
+			vertexCache.erase(key);
+			return decoded;
+		}
+		return &entry.decoded[0];
+	}
+
+	VertexCacheEntry &entry = iter->second;
+	entry.lastFrame = gpuStats.numFrames;
+	if (entry.status == VERTEXCACHE_UNRELIABLE)
+	{
+		dec.DecodeVerts(decoded, verts, inds, prim, count, indexLowerBound, indexUpperBound);
+		gpuStats.numVertexCacheMisses++;
+		return decoded;
+	}
+
+	bool recheck = entry.invalid || entry.status == VERTEXCACHE_NEW || entry.lastHashFrame + VERTEXCACHE_RECHECK_FRAMES <= gpuStats.numFrames;
+	if (recheck)
+	{
+		if (HashVertexData(inds, entry) != entry.hash)
+		{
+			if (entry.invalid)
+			{
+				// Someone we know about (DMA, block transfer) wrote to it, start over.
+				DecodeIntoEntry(entry, dec, key, verts, inds, prim);
+			}
+			else
+			{
+				// The CPU rewrites this one, stop caching it.
+				entry.status = VERTEXCACHE_UNRELIABLE;
+				std::vector<DecodedVertex>().swap(entry.decoded);
+				dec.DecodeVerts(decoded, verts, inds, prim, count, indexLowerBound, indexUpperBound);
+				gpuStats.numVertexCacheMisses++;
+				return decoded;
+			}
+			gpuStats.numVertexCacheMisses++;
+			*indexLowerBound = entry.indexLowerBound;
+			*indexUpperBound = entry.indexUpperBound;
+			return &entry.decoded[0];
+		}
+
+		if (entry.status == VERTEXCACHE_NEW && entry.stableSince + VERTEXCACHE_STABLE_FRAMES <= gpuStats.numFrames)
+			entry.status = VERTEXCACHE_RELIABLE;
+		entry.invalid = false;
+		entry.lastHashFrame = gpuStats.numFrames;
+	}
+
+	gpuStats.numVertexCacheHits++;
+	*indexLowerBound = entry.indexLowerBound;
+	*indexUpperBound = entry.indexUpperBound;
+	return &entry.decoded[0];
+}
+
+void VertexCache_Clear()
+{
+	vertexCache.clear();
+}
+
+void VertexCache_Decimate()
+{
+	for (VertexCache::iterator iter = vertexCache.begin(); iter != vertexCache.end(); )
+	{
+		if (iter->second.lastFrame + VERTEXCACHE_KILL_AGE < gpuStats.numFrames)
+			vertexCache.erase(iter++);
+		else
+			++iter;
+	}
+}
+
+void VertexCache_Invalidate(u32 addr, int size)
+{
+	addr &= 0x0FFFFFFF;
+	u32 end = addr + size;
+	for (VertexCache::iterator iter = vertexCache.begin(); iter != vertexCache.end(); ++iter)
+	{
+		VertexCacheEntry &entry = iter->second;
+		if ((addr < entry.vertexEnd && end > entry.vertexStart) || (addr < entry.indexEnd && end > entry.indexStart))
+			entry.invalid = true;
+	}
+}
+
+int VertexCache_NumEntries()
+{
+	return (int)vertexCache.size();
+}
+
 // This is the software transform pipeline, which is necessary for supporting RECT
 // primitives correctly. Other primitives are possible to transform and light in hardware
 // using vertex shader, which will be way, way faster, especially on mobile. This has
@@ -199,13 +414,19 @@ void Lighter::Light(float colorOut0[4], float colorOut1[4], const float colorIn[
 void GLES_GPU::TransformAndDrawPrim(void *verts, void *inds, int prim, int vertexCount, float *customUV, int forceIndexType, int *bytesRead)
 {
 	int indexLowerBound, indexUpperBound;
-	// First, decode the verts and apply morphing
+	// First, decode the verts and apply morphing. decodedVerts[0] is the vertex at indexLowerBound.
 	VertexDecoder dec;
 	dec.SetVertexType(gstate.vertType);
-	dec.DecodeVerts(decoded, verts, inds, prim, vertexCount, &indexLowerBound, &indexUpperBound);
+	const DecodedVertex *decodedVerts = decoded;
+	// Morph weights change from draw to draw, so morphing types aren't worth caching.
+	bool morphing = (gstate.vertType & GE_VTYPE_MORPHCOUNT_MASK) != 0;
+	if (g_Config.bVertexCache && !customUV && forceIndexType == -1 && !morphing)
+		decodedVerts = DecodeVertsCached(dec, verts, inds, prim, vertexCount, &indexLowerBound, &indexUpperBound);
+	else
+		dec.DecodeVerts(decoded, verts, inds, prim, vertexCount, &indexLowerBound, &indexUpperBound);
 #if 0
 	for (int i = indexLowerBound; i <= indexUpperBound; i++) {
-		PrintDecodedVertex(decoded[i], gstate.vertType);
+		PrintDecodedVertex(decodedVerts[i - indexLowerBound], gstate.vertType);
 	}
 #endif
 	bool useTexCoord = false;
@@ -260,15 +481,16 @@ void GLES_GPU::TransformAndDrawPrim(void *verts, void *inds, int prim, int verte
 		float c0[4] = {1, 1, 1, 1};
 		float c1[4] = {0, 0, 0, 0};
 		float uv[2] = {0, 0};
+		const DecodedVertex &vert = decodedVerts[index - indexLowerBound];
 
 		if (throughmode)
 		{
 			// Do not touch the coordinates or the colors. No lighting.
 			for (int j=0; j<3; j++)
-				v[j] = decoded[index].pos[j];
+				v[j] = vert.pos[j];
 			if(dec.hasColor()) {
 				for (int j=0; j<4; j++) {
-					c0[j] = decoded[index].color[j] / 255.0f;
+					c0[j] = vert.color[j] / 255.0f;
 					c1[j] = 0.0f;
 				}
 			}
@@ -282,7 +504,7 @@ void GLES_GPU::TransformAndDrawPrim(void *verts, void *inds, int prim, int verte
 
 			// TODO : check if has uv
 			for (int j=0; j<2; j++)
-				uv[j] = decoded[index].uv[j];
+				uv[j] = vert.uv[j];
 			// Rescale UV?
 		}
 		else
@@ -291,8 +513,8 @@ void GLES_GPU::TransformAndDrawPrim(void *verts, void *inds, int prim, int verte
 			float out[3], norm[3];
 			if ((gstate.vertType & GE_VTYPE_WEIGHT_MASK) == GE_VTYPE_WEIGHT_NONE)
 			{
-				Vec3ByMatrix43(out, decoded[index].pos, gstate.worldMatrix);
-				Norm3ByMatrix43(norm, decoded[index].normal, gstate.worldMatrix);
+				Vec3ByMatrix43(out, vert.pos, gstate.worldMatrix);
+				Norm3ByMatrix43(norm, vert.normal, gstate.worldMatrix);
 			}
 			else
 			{
@@ -302,12 +524,12 @@ void GLES_GPU::TransformAndDrawPrim(void *verts, void *inds, int prim, int verte
 				int nweights = ((gstate.vertType & GE_VTYPE_WEIGHTCOUNT_MASK) >> GE_VTYPE_WEIGHTCOUNT_SHIFT) + 1;
 				for (int i = 0; i < nweights; i++)
 				{
-					if (decoded[index].weights[i] != 0.0f) {
-						Vec3ByMatrix43(out, decoded[index].pos, gstate.boneMatrix+i*12);
-						Norm3ByMatrix43(norm, decoded[index].normal, gstate.boneMatrix+i*12);
+					if (vert.weights[i] != 0.0f) {
+						Vec3ByMatrix43(out, vert.pos, gstate.boneMatrix+i*12);
+						Norm3ByMatrix43(norm, vert.normal, gstate.boneMatrix+i*12);
 						Vec3 tpos(out), tnorm(norm);
-						psum += tpos*decoded[index].weights[i];
-						nsum += tnorm*decoded[index].weights[i];
+						psum += tpos*vert.weights[i];
+						nsum += tnorm*vert.weights[i];
 					}
 				}
 
@@ -321,7 +543,7 @@ void GLES_GPU::TransformAndDrawPrim(void *verts, void *inds, int prim, int verte
 			float dots[4] = {0,0,0,0};
 			float unlitColor[4];
 			for (int j = 0; j < 4; j++) {
-				unlitColor[j] = decoded[index].color[j] / 255.0f;
+				unlitColor[j] = vert.color[j] / 255.0f;
 			}
 			float litColor0[4];
 			float litColor1[4];
@@ -368,8 +590,8 @@ void GLES_GPU::TransformAndDrawPrim(void *verts, void *inds, int prim, int verte
 				{
 				case 0:	// UV mapping
 					// Texture scale/offset is only performed in this mode.
-					uv[0] = decoded[index].uv[0]*gstate_c.uScale + gstate_c.uOff;
-					uv[1] = decoded[index].uv[1]*gstate_c.vScale + gstate_c.vOff;
+					uv[0] = vert.uv[0]*gstate_c.uScale + gstate_c.uOff;
+					uv[1] = vert.uv[1]*gstate_c.vScale + gstate_c.vOff;
 					break;
 				case 1:
 					{
@@ -378,10 +600,10 @@ void GLES_GPU::TransformAndDrawPrim(void *verts, void *inds, int prim, int verte
 						switch ((gstate.texmapmode >> 8) & 0x3)
 						{
 						case 0: // Use model space XYZ as source
-							source = decoded[index].pos;
+							source = vert.pos;
 							break;
 						case 1: // Use unscaled UV as source
-							source = Vec3(decoded[index].uv[0], decoded[index].uv[1], 0.0f);
+							source = Vec3(vert.uv[0], vert.uv[1], 0.0f);
 							break;
 						case 2: // Use normalized normal as source
 							source = Vec3(norm).Normalized();
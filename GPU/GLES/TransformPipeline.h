@@ -17,4 +17,12 @@
 
 #pragma once
 
+#include "../Globals.h"
+
 struct LinkedShader;
+
+// Decoded vertex arrays kept between draws, see DecodeVertsCached.
+void VertexCache_Clear();
+void VertexCache_Decimate();  // Run this once per frame to get rid of old entries.
+void VertexCache_Invalidate(u32 addr, int size);
+int VertexCache_NumEntries();
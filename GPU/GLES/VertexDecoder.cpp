@@ -17,6 +17,7 @@
 
 #include "math/lin/matrix4x4.h"
 
+#include "../../Core/Config.h"
 #include "../../Core/MemMap.h"
 #include "../ge_constants.h"
 
@@ -44,7 +45,7 @@ inline int align(int n, int align)
 
 void VertexDecoder::SetVertexType(u32 fmt)
 {
-	fmt = fmt;
+	this->fmt = fmt;
 	throughmode = (fmt & GE_VTYPE_THROUGH) != 0;
 
 	int biggest = 0;
@@ -113,6 +114,8 @@ void VertexDecoder::SetVertexType(u32 fmt)
 	onesize_ = size;
 	size *= morphcount;
 	DEBUG_LOG(G3D,"SVT : size = %i, aligned to biggest %i", size, biggest);
+
+	jitted_ = g_Config.bVertexDecoderJit ? VertexDecoderJit_Get(*this) : 0;
 }
 
 void VertexDecoder::DecodeVerts(DecodedVertex *decoded, const void *verts, const void *inds, int prim, int count, int *indexLowerBound, int *indexUpperBound) const
@@ -149,13 +152,29 @@ void VertexDecoder::DecodeVerts(DecodedVertex *decoded, const void *verts, const
 	*indexLowerBound = lowerBound;
 	*indexUpperBound = upperBound;
 
+	if (jitted_)
+	{
+		VertexDecoderJitParams params;
+		params.uvScale[0] = (float)gstate_c.curTextureWidth;
+		params.uvScale[1] = (float)gstate_c.curTextureHeight;
+		params.uvScale[2] = params.uvScale[0];
+		params.uvScale[3] = params.uvScale[1];
+		float multiplier = gstate_c.morphWeights[0];
+		if (gstate.reversenormals & 0xFFFFFF)
+			multiplier = -multiplier;
+		for (int i = 0; i < 4; i++)
+			params.normalScale[i] = multiplier;
+		jitted_((const u8 *)verts + lowerBound * size, decoded, upperBound - lowerBound + 1, &params);
+		return;
+	}
+
 	// Decode the vertices within the found bounds, once each (unlike the previous way..)
 	for (int index = lowerBound; index <= upperBound; index++)
 	{
 		ptr = (char*)verts + (index * size);
 
 		// TODO: Should weights be morphed?
-		float *wt = decoded[index].weights;
+		float *wt = decoded[index - lowerBound].weights;
 		switch (weighttype)
 		{
 		case GE_VTYPE_WEIGHT_NONE >> 9:
@@ -187,7 +206,7 @@ void VertexDecoder::DecodeVerts(DecodedVertex *decoded, const void *verts, const
 		}
 
 		// TODO: Not morphing UV yet
-		float *uv = decoded[index].uv;
+		float *uv = decoded[index - lowerBound].uv;
 		switch (tc)
 		{
 		case GE_VTYPE_TC_NONE:
@@ -234,7 +253,7 @@ void VertexDecoder::DecodeVerts(DecodedVertex *decoded, const void *verts, const
 		}
 
 		// TODO: Not morphing color yet
-		u8 *c = decoded[index].color;
+		u8 *c = decoded[index - lowerBound].color;
 		switch (col)
 		{
 		case GE_VTYPE_COL_4444 >> 2:
@@ -282,7 +301,7 @@ void VertexDecoder::DecodeVerts(DecodedVertex *decoded, const void *verts, const
 			break;
 		}
 
-		float *normal = decoded[index].normal;
+		float *normal = decoded[index - lowerBound].normal;
 		memset(normal, 0, sizeof(float)*3);
 		for (int n = 0; n < morphcount; n++)
 		{
@@ -292,7 +311,7 @@ void VertexDecoder::DecodeVerts(DecodedVertex *decoded, const void *verts, const
 			}
 			switch (nrm)
 			{
-			case GE_VTYPE_NRM_8BIT:
+			case GE_VTYPE_NRM_8BIT >> 5:
 				{
 					const s8 *sv = (const s8*)(ptr + onesize_*n + nrmoff);
 					for (int j = 0; j < 3; j++)
@@ -318,7 +337,7 @@ void VertexDecoder::DecodeVerts(DecodedVertex *decoded, const void *verts, const
 			}
 		}
 
-		float *v = decoded[index].pos;
+		float *v = decoded[index - lowerBound].pos;
 
 		if (morphcount == 1) {
 			switch (pos)
@@ -20,6 +20,7 @@
 #include "../GPUState.h"
 #include "../Globals.h"
 #include "base/basictypes.h"
+#include "VertexDecoderJit.h"
 
 struct DecodedVertex
 {
@@ -42,9 +43,10 @@ struct TransformedVertex
 
 // Right now
 //   - only contains computed information
-//   - does decoding in nasty branchfilled loops
+//   - does decoding in nasty branchfilled loops, except on x86 where
+//     VertexDecoderJit compiles a specialized loop per vertex type
 // Future TODO
-//   - will compile into lighting fast specialized x86 and ARM
+//   - will compile into lighting fast specialized ARM too
 //   - will not bother translating components that can be read directly
 //     by OpenGL ES. Will still have to translate 565 colors, and things
 //     like that. DecodedVertex will not be a fixed struct. Will have to
@@ -54,14 +56,17 @@ struct TransformedVertex
 class VertexDecoder
 {
 public:
-	VertexDecoder() : coloff(0), nrmoff(0), posoff(0) {}
+	VertexDecoder() : coloff(0), nrmoff(0), posoff(0), jitted_(0) {}
 	~VertexDecoder() {}
 	void SetVertexType(u32 vtype);
+	// Decodes the vertices the indices refer to, decoded[0] gets the one at *indexLowerBound.
 	void DecodeVerts(DecodedVertex *decoded, const void *verts, const void *inds, int prim, int count, int *indexLowerBound, int *indexUpperBound) const;
 	bool hasColor() const { return col != 0; }
 	int VertexSize() const { return size; }
 
 private:
+	friend class VertexDecoderJitCache;
+
 	u32 fmt;
 	bool throughmode;
 	int biggest;
@@ -82,6 +87,8 @@ private:
 	int idx;
 	int morphcount;
 	int nweights;
+
+	JittedVertexDecoder jitted_;
 };
 
 // Debugging utilities
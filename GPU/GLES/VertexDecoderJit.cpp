@@ -0,0 +1,537 @@
+// Copyright (c) 2012- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#include <map>
+#include <stddef.h>
+#include <string.h>
+
+#include "Common.h"
+#include "../ge_constants.h"
+
+#include "VertexDecoder.h"
+#include "VertexDecoderJit.h"
+
+#if defined(_M_IX86) || defined(_M_X64)
+
+#include "ABI.h"
+#include "x64Emitter.h"
+
+using namespace Gen;
+
+// Generates one loop per vertex type, with the component formats, offsets and scales
+// folded in. The results match VertexDecoder::DecodeVerts bit for bit: wherever the C++
+// decoder divides, so does the generated code.
+//
+// The stores run in struct order and may spill one float into the next member, which
+// is always written afterwards: pos -> normal -> uv -> color, weights last.
+class VertexDecoderJitCache : public XCodeBlock
+{
+public:
+	VertexDecoderJitCache();
+	~VertexDecoderJitCache();
+
+	JittedVertexDecoder Get(const VertexDecoder &dec);
+
+private:
+	void Reset();
+	void WriteConstants();
+	const float *WriteFloat4(float value);
+	const u16 *WriteWord8(const u16 *values);
+	JittedVertexDecoder Compile(const VertexDecoder &dec);
+
+	void LoadS8x3(X64Reg dest, int off);
+	void LoadS16x3(X64Reg dest, int off);
+	void LoadFloatx3(X64Reg dest, int off);
+
+	void Jit_Weights(const VertexDecoder &dec);
+	void Jit_TexCoord(const VertexDecoder &dec);
+	void Jit_Color(const VertexDecoder &dec);
+	void Jit_Normal(const VertexDecoder &dec);
+	void Jit_Position(const VertexDecoder &dec);
+
+	std::map<u32, JittedVertexDecoder> decoders_;
+
+	// Constants live at the start of the code space, so they're always in RIP range.
+	const float *by127_;
+	const float *by32767_;
+	const float *by128_;
+	const float *by32768_;
+	const float *pos16Scale_;
+	// Per colour format: word multipliers that move each channel to the top of its lane,
+	// the lane masks, multipliers that bring the top bits back down, and a constant to OR in.
+	const u16 *colorShiftUp_[3];
+	const u16 *colorMask_[3];
+	const u16 *colorShiftDown_[3];
+	const u16 *colorOr_[3];
+};
+
+#define VERTEXJIT_CODE_SIZE (256 * 1024)
+// A decoder with 8 weights and everything else on is a little over 400 bytes.
+#define VERTEXJIT_MAX_DECODER_SIZE 1024
+
+#ifdef _M_X64
+static const int ptrBits = 64;
+static const X64Reg srcReg = R10;
+static const X64Reg dstReg = R11;
+static const X64Reg counterReg = RAX;
+static const X64Reg paramsReg = R9;
+#else
+static const int ptrBits = 32;
+static const X64Reg srcReg = ESI;
+static const X64Reg dstReg = EDI;
+static const X64Reg counterReg = EAX;
+static const X64Reg paramsReg = EBX;
+#endif
+static const X64Reg tempReg1 = ECX;
+static const X64Reg tempReg2 = EDX;
+
+// XMM6 and up are callee saved on Win64, so stay below them.
+static const X64Reg uvScaleReg = XMM3;
+static const X64Reg normalScaleReg = XMM4;
+static const X64Reg zeroReg = XMM5;
+
+enum
+{
+	COLOR_4444,
+	COLOR_565,
+	COLOR_5551,
+};
+
+static const u16 colorShiftUpTable[3][4] = {
+	{1 << 12, 1 << 8, 1 << 4, 1},
+	{1 << 11, 1 << 5, 1, 0},
+	{1 << 11, 1 << 6, 1 << 1, 1},
+};
+static const u16 colorMaskTable[3][4] = {
+	{0xF000, 0xF000, 0xF000, 0xF000},
+	{0xF800, 0xFC00, 0xF800, 0x0000},
+	{0xF800, 0xF800, 0xF800, 0x8000},
+};
+// Top bits >> 8 plus top bits >> (16 - n) replicates the channel's high bits into its low
+// bits, same as Convert4To8 etc. The 5551 alpha gets 0x80 | 0x7F.
+static const u16 colorShiftDownTable[3][4] = {
+	{1 << 4, 1 << 4, 1 << 4, 1 << 4},
+	{1 << 3, 1 << 2, 1 << 3, 0},
+	{1 << 3, 1 << 3, 1 << 3, 0xFE},
+};
+// DecodeVerts stores 1.0f into the u8 alpha of 565 colors, which comes out as 1.
+static const u16 colorOrTable[3][4] = {
+	{0, 0, 0, 0},
+	{0, 0, 0, 1},
+	{0, 0, 0, 0},
+};
+
+VertexDecoderJitCache::VertexDecoderJitCache()
+{
+	AllocCodeSpace(VERTEXJIT_CODE_SIZE);
+	WriteConstants();
+}
+
+VertexDecoderJitCache::~VertexDecoderJitCache()
+{
+	FreeCodeSpace();
+}
+
+void VertexDecoderJitCache::Reset()
+{
+	decoders_.clear();
+	ClearCodeSpace();
+	WriteConstants();
+}
+
+const float *VertexDecoderJitCache::WriteFloat4(float value)
+{
+	const float *p = (const float *)AlignCode16();
+	u32 bits;
+	memcpy(&bits, &value, 4);
+	for (int i = 0; i < 4; i++)
+		Write32(bits);
+	return p;
+}
+
+const u16 *VertexDecoderJitCache::WriteWord8(const u16 *values)
+{
+	const u16 *p = (const u16 *)AlignCode16();
+	for (int i = 0; i < 8; i++)
+		Write16(values[i & 3]);
+	return p;
+}
+
+void VertexDecoderJitCache::WriteConstants()
+{
+	by127_ = WriteFloat4(127.0f);
+	by32767_ = WriteFloat4(32767.0f);
+	by128_ = WriteFloat4(1.0f / 128.0f);
+	by32768_ = WriteFloat4(1.0f / 32768.0f);
+	pos16Scale_ = WriteFloat4(1.0f / 32767.0f);
+	for (int i = 0; i < 3; i++)
+	{
+		colorShiftUp_[i] = WriteWord8(colorShiftUpTable[i]);
+		colorMask_[i] = WriteWord8(colorMaskTable[i]);
+		colorShiftDown_[i] = WriteWord8(colorShiftDownTable[i]);
+		colorOr_[i] = WriteWord8(colorOrTable[i]);
+	}
+	AlignCode16();
+}
+
+JittedVertexDecoder VertexDecoderJitCache::Get(const VertexDecoder &dec)
+{
+	// The index format doesn't change how vertices are decoded.
+	u32 key = dec.fmt & ~GE_VTYPE_IDX_MASK;
+	std::map<u32, JittedVertexDecoder>::iterator iter = decoders_.find(key);
+	if (iter != decoders_.end())
+		return iter->second;
+
+	if (GetSpaceLeft() < VERTEXJIT_MAX_DECODER_SIZE)
+	{
+		INFO_LOG(G3D, "Vertex decoder jit cache full, clearing");
+		Reset();
+	}
+
+	JittedVertexDecoder jitted = Compile(dec);
+	decoders_[key] = jitted;
+	return jitted;
+}
+
+JittedVertexDecoder VertexDecoderJitCache::Compile(const VertexDecoder &dec)
+{
+	if (dec.morphcount != 1 || dec.pos == 0)
+		return 0;
+
+	const u8 *start = AlignCode16();
+
+#ifdef _M_X64
+	// Nothing we use is callee saved, just shuffle the arguments out of the way.
+	if (ABI_PARAM4 != paramsReg)
+		MOV(64, R(paramsReg), R(ABI_PARAM4));
+	MOV(64, R(srcReg), R(ABI_PARAM1));
+	MOV(64, R(dstReg), R(ABI_PARAM2));
+	MOV(32, R(counterReg), R(ABI_PARAM3));
+#else
+	PUSH(EBX);
+	PUSH(ESI);
+	PUSH(EDI);
+	MOV(32, R(srcReg), MDisp(ESP, 16));
+	MOV(32, R(dstReg), MDisp(ESP, 20));
+	MOV(32, R(counterReg), MDisp(ESP, 24));
+	MOV(32, R(paramsReg), MDisp(ESP, 28));
+#endif
+
+	XORPS(zeroReg, R(zeroReg));
+	MOVUPS(normalScaleReg, MDisp(paramsReg, offsetof(VertexDecoderJitParams, normalScale)));
+	MOVUPS(uvScaleReg, MDisp(paramsReg, offsetof(VertexDecoderJitParams, uvScale)));
+
+	TEST(32, R(counterReg), R(counterReg));
+	FixupBranch skip = J_CC(CC_LE);
+
+	const u8 *loopStart = GetCodePtr();
+	Jit_Position(dec);
+	Jit_Normal(dec);
+	Jit_TexCoord(dec);
+	Jit_Color(dec);
+	Jit_Weights(dec);
+
+	ADD(ptrBits, R(srcReg), Imm32(dec.size));
+	ADD(ptrBits, R(dstReg), Imm32(sizeof(DecodedVertex)));
+	SUB(32, R(counterReg), Imm8(1));
+	J_CC(CC_NZ, loopStart, true);
+
+	SetJumpTarget(skip);
+#ifdef _M_IX86
+	POP(EDI);
+	POP(ESI);
+	POP(EBX);
+#endif
+	RET();
+
+	return (JittedVertexDecoder)start;
+}
+
+// Sign extends three bytes into the low three lanes of dest. Reads exactly three bytes,
+// the last vertex may end right at the end of memory.
+void VertexDecoderJitCache::LoadS8x3(X64Reg dest, int off)
+{
+	MOVZX(32, 16, tempReg1, MDisp(srcReg, off));
+	MOVZX(32, 8, tempReg2, MDisp(srcReg, off + 2));
+	SHL(32, R(tempReg2), Imm8(16));
+	OR(32, R(tempReg1), R(tempReg2));
+	MOVD_xmm(dest, R(tempReg1));
+	PUNPCKLBW(dest, R(dest));
+	PUNPCKLWD(dest, R(dest));
+	PSRAD(dest, 24);
+}
+
+void VertexDecoderJitCache::LoadS16x3(X64Reg dest, int off)
+{
+	MOVD_xmm(dest, MDisp(srcReg, off));
+	PINSRW(dest, MDisp(srcReg, off + 4), 2);
+	PUNPCKLWD(dest, R(dest));
+	PSRAD(dest, 16);
+}
+
+void VertexDecoderJitCache::LoadFloatx3(X64Reg dest, int off)
+{
+	MOVQ_xmm(dest, MDisp(srcReg, off));
+	MOVSS(XMM2, MDisp(srcReg, off + 8));
+	// x y z 0, from the low halves of both.
+	SHUFPS(dest, R(XMM2), 0x44);
+}
+
+void VertexDecoderJitCache::Jit_Weights(const VertexDecoder &dec)
+{
+	const int dstoff = offsetof(DecodedVertex, weights);
+	int j = 0;
+	switch (dec.weighttype)
+	{
+	case GE_VTYPE_WEIGHT_NONE >> 9:
+		break;
+
+	case GE_VTYPE_WEIGHT_8BIT >> 9:
+		for (; j + 4 <= dec.nweights; j += 4)
+		{
+			MOVD_xmm(XMM0, MDisp(srcReg, j));
+			PUNPCKLBW(XMM0, R(zeroReg));
+			PUNPCKLWD(XMM0, R(zeroReg));
+			CVTDQ2PS(XMM0, R(XMM0));
+			MULPS(XMM0, M((void *)by128_));
+			MOVUPS(MDisp(dstReg, dstoff + j * 4), XMM0);
+		}
+		for (; j < dec.nweights; j++)
+		{
+			MOVZX(32, 8, tempReg1, MDisp(srcReg, j));
+			MOVD_xmm(XMM0, R(tempReg1));
+			CVTDQ2PS(XMM0, R(XMM0));
+			MULSS(XMM0, M((void *)by128_));
+			MOVSS(MDisp(dstReg, dstoff + j * 4), XMM0);
+		}
+		break;
+
+	case GE_VTYPE_WEIGHT_16BIT >> 9:
+		for (; j + 4 <= dec.nweights; j += 4)
+		{
+			MOVQ_xmm(XMM0, MDisp(srcReg, j * 2));
+			PUNPCKLWD(XMM0, R(zeroReg));
+			CVTDQ2PS(XMM0, R(XMM0));
+			MULPS(XMM0, M((void *)by32768_));
+			MOVUPS(MDisp(dstReg, dstoff + j * 4), XMM0);
+		}
+		for (; j < dec.nweights; j++)
+		{
+			MOVZX(32, 16, tempReg1, MDisp(srcReg, j * 2));
+			MOVD_xmm(XMM0, R(tempReg1));
+			CVTDQ2PS(XMM0, R(XMM0));
+			MULSS(XMM0, M((void *)by32768_));
+			MOVSS(MDisp(dstReg, dstoff + j * 4), XMM0);
+		}
+		break;
+
+	case GE_VTYPE_WEIGHT_FLOAT >> 9:
+		for (; j + 4 <= dec.nweights; j += 4)
+		{
+			MOVUPS(XMM0, MDisp(srcReg, j * 4));
+			MOVUPS(MDisp(dstReg, dstoff + j * 4), XMM0);
+		}
+		for (; j < dec.nweights; j++)
+		{
+			MOV(32, R(tempReg1), MDisp(srcReg, j * 4));
+			MOV(32, MDisp(dstReg, dstoff + j * 4), R(tempReg1));
+		}
+		break;
+	}
+}
+
+void VertexDecoderJitCache::Jit_TexCoord(const VertexDecoder &dec)
+{
+	const int dstoff = offsetof(DecodedVertex, uv);
+	switch (dec.tc)
+	{
+	case GE_VTYPE_TC_NONE:
+		MOVQ_xmm(MDisp(dstReg, dstoff), zeroReg);
+		break;
+
+	case GE_VTYPE_TC_8BIT:
+		MOVZX(32, 16, tempReg1, MDisp(srcReg, dec.tcoff));
+		MOVD_xmm(XMM0, R(tempReg1));
+		PUNPCKLBW(XMM0, R(zeroReg));
+		PUNPCKLWD(XMM0, R(zeroReg));
+		CVTDQ2PS(XMM0, R(XMM0));
+		MULPS(XMM0, M((void *)by128_));
+		MOVQ_xmm(MDisp(dstReg, dstoff), XMM0);
+		break;
+
+	case GE_VTYPE_TC_16BIT:
+		MOVD_xmm(XMM0, MDisp(srcReg, dec.tcoff));
+		PUNPCKLWD(XMM0, R(zeroReg));
+		CVTDQ2PS(XMM0, R(XMM0));
+		if (dec.throughmode)
+			DIVPS(XMM0, R(uvScaleReg));
+		else
+			MULPS(XMM0, M((void *)by32768_));
+		MOVQ_xmm(MDisp(dstReg, dstoff), XMM0);
+		break;
+
+	case GE_VTYPE_TC_FLOAT:
+		MOVQ_xmm(XMM0, MDisp(srcReg, dec.tcoff));
+		if (dec.throughmode)
+			DIVPS(XMM0, R(uvScaleReg));
+		MOVQ_xmm(MDisp(dstReg, dstoff), XMM0);
+		break;
+	}
+}
+
+void VertexDecoderJitCache::Jit_Color(const VertexDecoder &dec)
+{
+	const int dstoff = offsetof(DecodedVertex, color);
+	int format;
+	switch (dec.col)
+	{
+	case GE_VTYPE_COL_4444 >> 2:
+		format = COLOR_4444;
+		break;
+	case GE_VTYPE_COL_565 >> 2:
+		format = COLOR_565;
+		break;
+	case GE_VTYPE_COL_5551 >> 2:
+		format = COLOR_5551;
+		break;
+
+	case GE_VTYPE_COL_8888 >> 2:
+		MOV(32, R(tempReg1), MDisp(srcReg, dec.coloff));
+		MOV(32, MDisp(dstReg, dstoff), R(tempReg1));
+		return;
+
+	default:
+		MOV(32, MDisp(dstReg, dstoff), Imm32(0xFFFFFFFF));
+		return;
+	}
+
+	// One channel per word lane: shift it to the top, mask, then OR together two right shifts
+	// of it to widen to 8 bits.
+	MOVZX(32, 16, tempReg1, MDisp(srcReg, dec.coloff));
+	MOVD_xmm(XMM0, R(tempReg1));
+	PSHUFLW(XMM0, R(XMM0), 0);
+	PMULLW(XMM0, M((void *)colorShiftUp_[format]));
+	PAND(XMM0, M((void *)colorMask_[format]));
+	MOVAPS(XMM1, R(XMM0));
+	PSRLW(XMM0, 8);
+	PMULHUW(XMM1, M((void *)colorShiftDown_[format]));
+	POR(XMM0, R(XMM1));
+	if (format == COLOR_565)
+		POR(XMM0, M((void *)colorOr_[format]));
+	PACKUSWB(XMM0, R(XMM0));
+	MOVD_xmm(MDisp(dstReg, dstoff), XMM0);
+}
+
+void VertexDecoderJitCache::Jit_Normal(const VertexDecoder &dec)
+{
+	const int dstoff = offsetof(DecodedVertex, normal);
+	switch (dec.nrm)
+	{
+	case GE_VTYPE_NRM_8BIT >> 5:
+		LoadS8x3(XMM0, dec.nrmoff);
+		CVTDQ2PS(XMM0, R(XMM0));
+		DIVPS(XMM0, M((void *)by127_));
+		break;
+
+	case GE_VTYPE_NRM_16BIT >> 5:
+		LoadS16x3(XMM0, dec.nrmoff);
+		CVTDQ2PS(XMM0, R(XMM0));
+		DIVPS(XMM0, M((void *)by32767_));
+		break;
+
+	case GE_VTYPE_NRM_FLOAT >> 5:
+		LoadFloatx3(XMM0, dec.nrmoff);
+		break;
+
+	default:
+		// Also clears uv[0], which gets written next anyway.
+		MOVUPS(MDisp(dstReg, dstoff), zeroReg);
+		return;
+	}
+
+	MULPS(XMM0, R(normalScaleReg));
+	// DecodeVerts accumulates onto 0.0f, which turns -0.0f into 0.0f.
+	ADDPS(XMM0, R(zeroReg));
+	MOVUPS(MDisp(dstReg, dstoff), XMM0);
+}
+
+void VertexDecoderJitCache::Jit_Position(const VertexDecoder &dec)
+{
+	const int dstoff = offsetof(DecodedVertex, pos);
+	switch (dec.pos)
+	{
+	case GE_VTYPE_POS_8BIT >> 7:
+		LoadS8x3(XMM0, dec.posoff);
+		CVTDQ2PS(XMM0, R(XMM0));
+		DIVPS(XMM0, M((void *)by127_));
+		MOVUPS(MDisp(dstReg, dstoff), XMM0);
+		break;
+
+	case GE_VTYPE_POS_16BIT >> 7:
+		LoadS16x3(XMM0, dec.posoff);
+		CVTDQ2PS(XMM0, R(XMM0));
+		if (!dec.throughmode)
+			MULPS(XMM0, M((void *)pos16Scale_));
+		MOVUPS(MDisp(dstReg, dstoff), XMM0);
+		break;
+
+	case GE_VTYPE_POS_FLOAT >> 7:
+		MOVQ_xmm(XMM0, MDisp(srcReg, dec.posoff));
+		MOVSS(XMM1, MDisp(srcReg, dec.posoff + 8));
+		MOVQ_xmm(MDisp(dstReg, dstoff), XMM0);
+		MOVSS(MDisp(dstReg, dstoff + 8), XMM1);
+		break;
+	}
+}
+
+static VertexDecoderJitCache *jitCache = 0;
+
+void VertexDecoderJit_Init()
+{
+	if (!jitCache)
+		jitCache = new VertexDecoderJitCache();
+}
+
+void VertexDecoderJit_Shutdown()
+{
+	delete jitCache;
+	jitCache = 0;
+}
+
+JittedVertexDecoder VertexDecoderJit_Get(const VertexDecoder &dec)
+{
+	if (!jitCache)
+		return 0;
+	return jitCache->Get(dec);
+}
+
+#else
+
+void VertexDecoderJit_Init()
+{
+}
+
+void VertexDecoderJit_Shutdown()
+{
+}
+
+JittedVertexDecoder VertexDecoderJit_Get(const VertexDecoder &dec)
+{
+	return 0;
+}
+
+#endif
@@ -0,0 +1,41 @@
+// Copyright (c) 2012- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#pragma once
+
+#include "../Globals.h"
+
+class VertexDecoder;
+struct DecodedVertex;
+
+// State the jitted decoders can't bake in, filled in for each draw.
+struct VertexDecoderJitParams
+{
+	float uvScale[4];      // Texture width, height, width, height. Through mode UVs are divided by these.
+	float normalScale[4];  // The morph weight, negated when normals are reversed.
+};
+
+// Decodes count consecutive vertices from src into dst.
+typedef void (*JittedVertexDecoder)(const u8 *src, DecodedVertex *dst, int count, const VertexDecoderJitParams *params);
+
+void VertexDecoderJit_Init();
+void VertexDecoderJit_Shutdown();
+
+// Returns a decoder specialised for the vertex type dec was set up with, compiling it
+// the first time the type is seen. Returns 0 for types the jit doesn't handle (morphing)
+// and on hosts without an x86 emitter, VertexDecoder::DecodeVerts decodes those itself.
+JittedVertexDecoder VertexDecoderJit_Get(const VertexDecoder &dec);
@@ -19,6 +19,8 @@
 
 #include "../Globals.h"
 
+class PointerWrap;
+
 class GPUInterface
 {
 public:
@@ -41,10 +43,19 @@ public:
 	virtual void SetDisplayFramebuffer(u32 framebuf, u32 stride, int format) = 0;
 	virtual void BeginFrame() = 0;  // Can be a good place to draw the "memory" framebuffer for accelerated plugins
 	virtual void CopyDisplayToOutput() = 0;
+	// Frameskip. Drops draws until cleared, state changes and transfers still happen.
+	virtual void SetSkipDrawing(bool skip) = 0;
+
+	// Called when something other than the CPU (DMA, block transfers, HLE memcpy) wrote to PSP memory,
+	// so cached copies of that range like textures get checked again.
+	virtual void InvalidateCache(u32 addr, int size) = 0;
 
 	// Tells the GPU to update the gpuStats structure.
 	virtual void UpdateStats() = 0;
 
 	// Internal hack to avoid interrupts from "PPGe" drawing (utility UI, etc)
 	virtual void EnableInterrupts(bool enable) = 0;
+
+	// Pending display lists. gstate itself is saved by GPU_DoState.
+	virtual void DoState(PointerWrap &p) = 0;
 };
@@ -22,6 +22,7 @@
 #include "Null/NullGpu.h"
 #include "../Core/CoreParameter.h"
 #include "../Core/System.h"
+#include "ChunkFile.h"
 
 GPUgstate gstate;
 GPUStateCache gstate_c;
@@ -114,3 +115,20 @@ void ReapplyGfxState()
 
 	// TODO: there's more...
 }
+
+void GPU_DoState(PointerWrap &p)
+{
+	if (!p.Section("GPUState", 1, 1))
+		return;
+
+	p.Do(gstate);
+	p.Do(gstate_c);
+	gpu->DoState(p);
+	p.DoMarker("GPUState");
+
+	if (p.mode == p.MODE_READ)
+	{
+		gstate_c.textureChanged = true;
+		ReapplyGfxState();
+	}
+}
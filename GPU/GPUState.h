@@ -294,6 +294,8 @@ struct GPUStatistics
 		numVertsTransformed = 0;
 		numTextureSwitches = 0;
 		numShaderSwitches = 0;
+		numVertexCacheHits = 0;
+		numVertexCacheMisses = 0;
 	}
 
 	// Per frame statistics
@@ -301,6 +303,8 @@ struct GPUStatistics
 	int numVertsTransformed;
 	int numTextureSwitches;
 	int numShaderSwitches;
+	int numVertexCacheHits;
+	int numVertexCacheMisses;
 
 	// Total statistics, updated by the GPU core in UpdateStats
 	int numFrames;
@@ -308,11 +312,15 @@ struct GPUStatistics
 	int numVertexShaders;
 	int numFragmentShaders;
 	int numShaders;
+	int numVertexCacheEntries;
 };
 
+class PointerWrap;
+
 void InitGfxState();
 void ShutdownGfxState();
 void ReapplyGfxState();
+void GPU_DoState(PointerWrap &p);
 
 // PSP uses a curious 24-bit float - it's basically the top 24 bits of a regular IEEE754 32-bit float.
 // This is used for light positions, transform matrices, you name it.
@@ -21,6 +21,7 @@
 #include "../ge_constants.h"
 #include "../../Core/MemMap.h"
 #include "../../Core/HLE/sceKernelInterrupt.h"
+#include "ChunkFile.h"
 
 struct DisplayState 
 {
@@ -835,4 +836,16 @@ void NullGPU::UpdateStats()
 	gpuStats.numFragmentShaders = 0;
 	gpuStats.numShaders = 0;
 	gpuStats.numTextures = 0;
+	gpuStats.numVertexCacheEntries = 0;
+}
+
+void NullGPU::DoState(PointerWrap &p)
+{
+	p.Do(dlQueue);
+	p.Do(dcontext);
+	p.DoArray(stack, 2);
+	p.Do(stackptr);
+	p.Do(dlIdGenerator);
+	p.Do(interruptsEnabled_);
+	p.DoMarker("NullGPU");
 }
@@ -39,7 +39,10 @@ public:
 	virtual void BeginFrame() {}
 	virtual void SetDisplayFramebuffer(u32 framebuf, u32 stride, int format) {}
 	virtual void CopyDisplayToOutput() {}
+	virtual void SetSkipDrawing(bool skip) {}
+	virtual void InvalidateCache(u32 addr, int size) {}
 	virtual void UpdateStats();
+	virtual void DoState(PointerWrap &p);
 
 private:
 	bool ProcessDLQueue();
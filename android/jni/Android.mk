@@ -71,9 +71,11 @@ LOCAL_SRC_FILES := \
   $(SRC)/GPU/GLES/Framebuffer.cpp \
   $(SRC)/GPU/GLES/DisplayListInterpreter.cpp \
   $(SRC)/GPU/GLES/TextureCache.cpp \
+  $(SRC)/GPU/GLES/TextureDecoder.cpp \
   $(SRC)/GPU/GLES/TransformPipeline.cpp \
   $(SRC)/GPU/GLES/StateMapping.cpp \
   $(SRC)/GPU/GLES/VertexDecoder.cpp \
+  $(SRC)/GPU/GLES/VertexDecoderJit.cpp \
   $(SRC)/GPU/GLES/ShaderManager.cpp \
   $(SRC)/GPU/GLES/VertexShaderGenerator.cpp \
   $(SRC)/GPU/GLES/FragmentShaderGenerator.cpp \
@@ -91,6 +93,8 @@ LOCAL_SRC_FILES := \
   $(SRC)/Core/PSPLoaders.cpp \
   $(SRC)/Core/MemMap.cpp \
   $(SRC)/Core/MemMapFunctions.cpp \
+  $(SRC)/Core/Replay.cpp \
+  $(SRC)/Core/SaveState.cpp \
   $(SRC)/Core/System.cpp \
   $(SRC)/Core/PSPMixer.cpp \
   $(SRC)/Core/Debugger/Breakpoints.cpp \
@@ -139,12 +143,14 @@ LOCAL_SRC_FILES := \
   $(SRC)/Core/MIPS/MIPSDis.cpp \
   $(SRC)/Core/MIPS/MIPSDisVFPU.cpp \
   $(SRC)/Core/MIPS/MIPSInt.cpp.arm \
+  $(SRC)/Core/MIPS/MIPSIntBlockCache.cpp.arm \
   $(SRC)/Core/MIPS/MIPSIntVFPU.cpp.arm \
   $(SRC)/Core/MIPS/MIPSTables.cpp.arm \
   $(SRC)/Core/MIPS/MIPSVFPUUtils.cpp \
   $(SRC)/Core/MIPS/MIPSCodeUtils.cpp \
   $(SRC)/Core/MIPS/MIPSDebugInterface.cpp \
   $(SRC)/Core/MIPS/JitCommon/JitCommon.cpp \
+  $(SRC)/Core/MIPS/JitCommon/JitDiskCache.cpp \
   $(SRC)/Core/MIPS/ARM/JitCache.cpp \
   $(SRC)/Core/MIPS/ARM/CompALU.cpp \
   $(SRC)/Core/MIPS/ARM/CompBranch.cpp \
@@ -3,15 +3,29 @@
 // To build on non-windows systems, just run CMake in the SDL directory, it will build both a normal ppsspp and the headless version.
 
 #include <stdio.h>
+#include <stdlib.h>
 
 #include "../Core/Config.h"
 #include "../Core/Core.h"
 #include "../Core/CoreTiming.h"
 #include "../Core/System.h"
 #include "../Core/MIPS/MIPS.h"
+#include "../Core/MIPS/JitCommon/JitCommon.h"
+#include "../Core/MemMap.h"
+#include "../Core/HLE/HLE.h"
+#include "../Core/HLE/sceKernelMemory.h"
+#include "../Core/HLE/sceKernelThread.h"
+#include "../Core/HLE/sceDisplay.h"
 #include "../Core/Host.h"
+#include "../Core/Replay.h"
+#include "../Core/SaveState.h"
+#include "../GPU/GPUState.h"
+#include "../GPU/GLES/TextureDecoder.h"
+#include "Atomic.h"
 #include "Log.h"
 #include "LogManager.h"
+#include "StdThread.h"
+#include "base/timeutil.h"
 
 // TODO: Get rid of this junk
 class HeadlessHost : public Host
@@ -80,17 +94,451 @@ void printUsage(const char *progname, const char *reason)
 	fprintf(stderr, "  -m, --mount umd.cso   mount iso on umd:\n");
 	fprintf(stderr, "  -l, --log             full log output, not just emulated printfs\n");
 	fprintf(stderr, "  -f                    use the fast interpreter\n");
+	fprintf(stderr, "  -b                    use the block interpreter (overrides -f)\n");
 	fprintf(stderr, "  -j                    use jit (overrides -f)\n");
 	fprintf(stderr, "  -c, --compare         compare with output in file.expected\n");
+	fprintf(stderr, "  --bench-jitcache      time jit block invalidation/recompilation and exit\n");
+	fprintf(stderr, "  --bench-coretiming    time scheduling and unscheduling lots of events and exit\n");
+	fprintf(stderr, "  --bench-rewind        run for a while with a rewind snapshot every frame, report times and sizes\n");
+	fprintf(stderr, "  --bench-texdecode     check the texture decoding kernels against each other, time them and exit\n");
+	fprintf(stderr, "  --jit-diskcache       remember compiled blocks between runs, precompile them at boot\n");
+	fprintf(stderr, "  --tiered=N            interpret blocks until they've run N times, then jit them\n");
+	fprintf(stderr, "  --hle-stats           print call counts and host time per syscall on exit\n");
+	fprintf(stderr, "  --sched-trace         print the last few thousand thread reschedules on exit\n");
+	fprintf(stderr, "  --state-load=FILE     load a save state of the same executable right after boot\n");
+	fprintf(stderr, "  --state-save=FILE     save a state after --state-frame frames, then keep running\n");
+	fprintf(stderr, "  --state-frame=N       frame to save the state at (default 60)\n");
+	fprintf(stderr, "  --replay-record=FILE  record input and host time to a replay\n");
+	fprintf(stderr, "  --replay-play=FILE    play back a replay, made from the same executable and options\n");
+	fprintf(stderr, "  --frame-hashes=FILE   write a hash of the displayed framebuffer every frame\n");
+	fprintf(stderr, "  --fast-forward        skip all host frame work, report emulated frames per second on exit\n");
+	fprintf(stderr, "  --frameskip=N         only draw every Nth frame\n");
 	fprintf(stderr, "\nSee headless.txt for details.\n");
 }
 
+// Fills some user memory with a chain of tiny blocks, compiles them all, and then keeps
+// invalidating slices of it and compiling them again, roughly like a game that streams code.
+void RunJitCacheBenchmark()
+{
+	const int numBlocks = 4096;
+	const int blockSize = 16;
+	const int rounds = 200;
+	const int blocksPerInvalidate = 16;
+
+	u32 size = numBlocks * blockSize;
+	u32 base = userMemory.Alloc(size, false, "JitBench");
+	if (base == (u32)-1)
+	{
+		printf("Unable to allocate memory for the jit benchmark.\n");
+		return;
+	}
+
+	for (int i = 0; i < numBlocks; i++)
+	{
+		u32 addr = base + i * blockSize;
+		u32 next = base + ((i + 1) % numBlocks) * blockSize;
+		Memory::Write_U32(0x24420001, addr);                            // addiu v0, v0, 1
+		Memory::Write_U32((2 << 26) | ((next >> 2) & 0x03FFFFFF), addr + 4); // j next
+		Memory::Write_U32(0, addr + 8);                                 // nop
+		Memory::Write_U32(0, addr + 12);
+	}
+
+	u32 oldPC = currentMIPS->pc;
+	currentMIPS->InvalidateICache(base, size);
+
+	double start = time_now_d();
+	for (int i = 0; i < numBlocks; i++)
+	{
+		currentMIPS->pc = base + i * blockSize;
+		MIPSComp::jit->Compile(currentMIPS->pc);
+	}
+	double compileTime = time_now_d() - start;
+
+	start = time_now_d();
+	int compiled = 0;
+	for (int r = 0; r < rounds; r++)
+	{
+		int first = (r * 97) % (numBlocks - blocksPerInvalidate);
+		u32 addr = base + first * blockSize;
+		currentMIPS->InvalidateICache(addr, blocksPerInvalidate * blockSize);
+		for (int i = 0; i < blocksPerInvalidate; i++)
+		{
+			currentMIPS->pc = addr + i * blockSize;
+			MIPSComp::jit->Compile(currentMIPS->pc);
+			compiled++;
+		}
+	}
+	double churnTime = time_now_d() - start;
+
+	printf("Compiled %d blocks in %0.3f ms\n", numBlocks, compileTime * 1000.0);
+	printf("Invalidated and recompiled %d blocks in %0.3f ms (%0.0f blocks/sec)\n", compiled, churnTime * 1000.0, churnTime > 0.0 ? compiled / churnTime : 0.0);
+
+	currentMIPS->InvalidateICache(base, size);
+	currentMIPS->pc = oldPC;
+	userMemory.Free(base);
+}
+
+static void BenchEventCallback(u64 userdata, int cyclesLate)
+{
+}
+
+static int benchEventType;
+static const int benchPostsPerThread = 100000;
+static volatile u32 benchThreadsDone;
+
+static void BenchPostThread()
+{
+	for (int i = 0; i < benchPostsPerThread; i++)
+		CoreTiming::ScheduleEvent_Threadsafe(1000 + i % 5000, benchEventType, i);
+	Common::AtomicIncrement(benchThreadsDone);
+}
+
+// Keeps a queue of a thousand or so events around, like a game with lots of threads
+// sleeping and timers running, and reschedules them the way waits and timeouts do.
+void RunCoreTimingBenchmark()
+{
+	const int numEvents = 1024;
+	const int rounds = 1000;
+
+	int eventType = CoreTiming::RegisterEvent("BenchEvent", &BenchEventCallback);
+	for (int i = 0; i < numEvents; i++)
+		CoreTiming::ScheduleEvent(usToCycles(100 + (i * 7919) % 100000), eventType, i);
+
+	double start = time_now_d();
+	int ops = 0;
+	for (int r = 0; r < rounds; r++)
+	{
+		for (int i = r % 8; i < numEvents; i += 8)
+		{
+			u64 left = CoreTiming::UnscheduleEvent(eventType, i);
+			CoreTiming::ScheduleEvent((int)left + 1000 + ((i * 31 + r) % 5000), eventType, i);
+			ops++;
+		}
+	}
+	double rescheduleTime = time_now_d() - start;
+
+	start = time_now_d();
+	int found = 0;
+	for (int r = 0; r < rounds * 100; r++)
+		found += CoreTiming::IsScheduled(eventType) ? 1 : 0;
+	double isScheduledTime = time_now_d() - start;
+
+	start = time_now_d();
+	CoreTiming::RemoveEvent(eventType);
+	double removeTime = time_now_d() - start;
+
+	printf("Rescheduled %d events in %0.3f ms (%0.0f/sec)\n", ops, rescheduleTime * 1000.0, rescheduleTime > 0.0 ? ops / rescheduleTime : 0.0);
+	printf("IsScheduled x%d in %0.3f ms\n", found, isScheduledTime * 1000.0);
+	printf("Removed %d events in %0.3f ms\n", numEvents, removeTime * 1000.0);
+
+	// A few threads posting, like audio and input would, while this one drains.
+	const int numThreads = 3;
+	benchEventType = eventType;
+	start = time_now_d();
+	std::thread *threads[numThreads];
+	for (int i = 0; i < numThreads; i++)
+		threads[i] = new std::thread(&BenchPostThread);
+	while (Common::AtomicLoadAcquire(benchThreadsDone) < (u32)numThreads)
+		CoreTiming::MoveEvents();
+	for (int i = 0; i < numThreads; i++)
+	{
+		threads[i]->join();
+		delete threads[i];
+	}
+	double postTime = time_now_d() - start;
+	CoreTiming::MoveEvents();
+	CoreTiming::RemoveEvent(eventType);
+
+	const CoreTiming::ThreadsafeEventStats &stats = CoreTiming::GetThreadsafeEventStats();
+	printf("Posted %d events from %d threads in %0.3f ms\n", numThreads * benchPostsPerThread, numThreads, postTime * 1000.0);
+	printf("Threadsafe events: %u posted, %u CAS retries, %u overflowed, %u drains (%u locked)\n", stats.posted, stats.casRetries, stats.overflowed, stats.drains, stats.lockedDrains);
+}
+
+// Runs the executable taking a rewind snapshot every frame, then rewinds through them.
+void RunRewindBenchmark()
+{
+	const int frames = 300;
+	const int keepStates = 120;
+	const int rewindSteps = 10;
+	SaveState::RewindBuffer rewind(keepStates, 512 * 1024 * 1024);
+
+	std::vector<u8> full;
+	double start = time_now_d();
+	SaveState::SaveToRam(full);
+	double fullTime = time_now_d() - start;
+
+	double snapshotTime = 0.0;
+	size_t deltaBytes = 0;
+	int snapshots = 0;
+	coreState = CORE_RUNNING;
+	for (int i = 0; i < frames && coreState == CORE_RUNNING; i++)
+	{
+		mipsr4k.RunLoopUntil(CoreTiming::GetTicks() + usToCycles(1000000/60));
+		if (coreState == CORE_NEXTFRAME)
+			coreState = CORE_RUNNING;
+
+		start = time_now_d();
+		rewind.Save();
+		snapshotTime += time_now_d() - start;
+		// The first one has nothing to diff against.
+		if (snapshots++ > 0)
+			deltaBytes += rewind.LastDeltaSize();
+	}
+
+	int stepped = 0;
+	start = time_now_d();
+	for (int i = 0; i < rewindSteps && rewind.Size() > 2; i++)
+	{
+		rewind.Rewind(2);
+		stepped++;
+	}
+	double rewindTime = time_now_d() - start;
+
+	printf("Full state: %d bytes, %0.3f ms\n", (int)full.size(), fullTime * 1000.0);
+	if (snapshots > 1)
+	{
+		printf("Snapshots: %d, %0.3f ms each, %d bytes per frame\n", snapshots, snapshotTime * 1000.0 / snapshots, (int)(deltaBytes / (snapshots - 1)));
+		printf("Rewind buffer: %d states in %d bytes\n", rewind.Size(), (int)rewind.MemoryUsage());
+	}
+	if (stepped > 0)
+		printf("Rewound a frame %d times, %0.3f ms each\n", stepped, rewindTime * 1000.0 / stepped);
+}
+
+static u32 texBenchSeed = 1;
+
+static u32 TexBenchRand()
+{
+	texBenchSeed = texBenchSeed * 1103515245 + 12345;
+	return texBenchSeed >> 8;
+}
+
+static void TexBenchFill(void *p, size_t bytes)
+{
+	u8 *b = (u8 *)p;
+	for (size_t i = 0; i < bytes; i++)
+		b[i] = (u8)TexBenchRand();
+}
+
+static bool TexBenchSame(const char *set, const char *kernel, int pixels, const void *expected, const void *actual, size_t bytes)
+{
+	if (memcmp(expected, actual, bytes) == 0)
+		return true;
+	printf("%s %s differs from Generic at %d pixels\n", set, kernel, pixels);
+	return false;
+}
+
+enum
+{
+	TEXBENCH_UNSWIZZLE,
+	TEXBENCH_DEINDEX4TO16,
+	TEXBENCH_DEINDEX4TO32,
+	TEXBENCH_DEINDEX8TO16,
+	TEXBENCH_DEINDEX8TO32,
+	TEXBENCH_CONVERT4444,
+	TEXBENCH_CONVERT5551,
+	TEXBENCH_CONVERT565,
+	TEXBENCH_NUM_KERNELS,
+};
+
+static const char *texBenchNames[TEXBENCH_NUM_KERNELS] = {
+	"UnswizzleBlocks", "DeIndex4To16", "DeIndex4To32", "DeIndex8To16", "DeIndex8To32", "Convert4444", "Convert5551", "Convert565",
+};
+
+static bool TexBenchHas(const TextureDecoderKernels &k, int kernel)
+{
+	switch (kernel)
+	{
+	case TEXBENCH_UNSWIZZLE: return k.unswizzleBlocks != 0;
+	case TEXBENCH_DEINDEX4TO16: return k.deIndex4To16 != 0;
+	case TEXBENCH_DEINDEX4TO32: return k.deIndex4To32 != 0;
+	case TEXBENCH_DEINDEX8TO16: return k.deIndex8To16 != 0;
+	case TEXBENCH_DEINDEX8TO32: return k.deIndex8To32 != 0;
+	case TEXBENCH_CONVERT4444: return k.convert4444 != 0;
+	case TEXBENCH_CONVERT5551: return k.convert5551 != 0;
+	case TEXBENCH_CONVERT565: return k.convert565 != 0;
+	}
+	return false;
+}
+
+// Runs one kernel over pixels pixels of src into dst, returns the bytes it wrote.
+// The 32-bit lookups run in place when dst and src are the same buffer.
+static size_t TexBenchRun(const TextureDecoderKernels &k, int kernel, void *dst, const u8 *src, int pixels, const u16 *pal16, const u32 *pal32)
+{
+	switch (kernel)
+	{
+	case TEXBENCH_UNSWIZZLE:
+		// pixels is the byte size here, whole rows of 512 byte wide blocks.
+		k.unswizzleBlocks((u32 *)dst, src, 512, pixels / (512 * 8));
+		return pixels;
+	case TEXBENCH_DEINDEX4TO16: k.deIndex4To16((u16 *)dst, src, pixels, pal16); return pixels * 2;
+	case TEXBENCH_DEINDEX4TO32: k.deIndex4To32((u32 *)dst, src, pixels, pal32); return pixels * 4;
+	case TEXBENCH_DEINDEX8TO16: k.deIndex8To16((u16 *)dst, src, pixels, pal16); return pixels * 2;
+	case TEXBENCH_DEINDEX8TO32: k.deIndex8To32((u32 *)dst, src, pixels, pal32); return pixels * 4;
+	case TEXBENCH_CONVERT4444: k.convert4444((u16 *)dst, pixels); return pixels * 2;
+	case TEXBENCH_CONVERT5551: k.convert5551((u16 *)dst, pixels); return pixels * 2;
+	case TEXBENCH_CONVERT565: k.convert565((u16 *)dst, pixels); return pixels * 2;
+	}
+	return 0;
+}
+
+// Checks every texture decoding kernel the CPU can run against the generic ones on random input,
+// then times them all on a 512x512 texture. Returns false if any output differs.
+bool RunTexDecodeBenchmark()
+{
+	const TextureDecoderKernels *sets;
+	int numSets = TextureDecoder_GetKernels(&sets);
+	const TextureDecoderKernels &ref = sets[0];
+
+	const int maxPixels = 4096 + 64;
+	const int trials = 1024;
+	std::vector<u8> src(maxPixels * 4 + 16);
+	std::vector<u32> expected(maxPixels + 16), actual(maxPixels + 16);
+	u16 pal16[256];
+	u32 pal32[256];
+	int failures = 0;
+
+	for (int t = 0; t < trials; t++)
+	{
+		// Every count up to 256 first, so every odd count and tail length after the vector loops
+		// shows up, then random ones. The source is misaligned on purpose.
+		int pixels = t < 256 ? t : (int)(TexBenchRand() % maxPixels);
+		const u8 *s = &src[TexBenchRand() % 16];
+		TexBenchFill(&src[0], src.size());
+		TexBenchFill(pal16, sizeof(pal16));
+		TexBenchFill(pal32, sizeof(pal32));
+		// Compare past the end too, to catch kernels writing more than they should.
+		size_t compareBytes = expected.size() * sizeof(u32);
+
+		for (int i = 0; i < numSets; i++)
+		{
+			const TextureDecoderKernels &k = sets[i];
+			for (int kernel = TEXBENCH_DEINDEX4TO16; kernel < TEXBENCH_NUM_KERNELS; kernel++)
+			{
+				if (!TexBenchHas(k, kernel))
+					continue;
+				bool convert = kernel >= TEXBENCH_CONVERT4444;
+				memset(&expected[0], 0xCD, compareBytes);
+				memset(&actual[0], 0xCD, compareBytes);
+				if (convert)
+				{
+					memcpy(&expected[0], s, pixels * 2);
+					memcpy(&actual[0], s, pixels * 2);
+				}
+				TexBenchRun(ref, kernel, &expected[0], convert ? 0 : s, pixels, pal16, pal32);
+				TexBenchRun(k, kernel, &actual[0], convert ? 0 : s, pixels, pal16, pal32);
+				if (!TexBenchSame(k.name, texBenchNames[kernel], pixels, &expected[0], &actual[0], compareBytes))
+					failures++;
+
+				if (kernel == TEXBENCH_DEINDEX4TO32 || kernel == TEXBENCH_DEINDEX8TO32)
+				{
+					// The texture cache expands these in place, straight over the source.
+					memset(&actual[0], 0xCD, compareBytes);
+					memcpy(&actual[0], s, kernel == TEXBENCH_DEINDEX4TO32 ? (pixels + 1) / 2 : pixels);
+					TexBenchRun(k, kernel, &actual[0], (const u8 *)&actual[0], pixels, pal16, pal32);
+					if (!TexBenchSame(k.name, (std::string(texBenchNames[kernel]) + " in place").c_str(), pixels, &expected[0], &actual[0], compareBytes))
+						failures++;
+				}
+			}
+		}
+
+		if (t < 256)
+			continue;
+		// Unswizzling works on whole blocks, 16 bytes wide and 8 rows high.
+		u32 rowWidth = 16 * (1 + TexBenchRand() % 32);
+		u32 blockRows = 1 + TexBenchRand() % 4;
+		size_t bytes = rowWidth * 8 * blockRows;
+		for (int i = 1; i < numSets; i++)
+		{
+			const TextureDecoderKernels &k = sets[i];
+			if (!k.unswizzleBlocks)
+				continue;
+			memset(&expected[0], 0xCD, compareBytes);
+			memset(&actual[0], 0xCD, compareBytes);
+			ref.unswizzleBlocks(&expected[0], s, rowWidth, blockRows);
+			k.unswizzleBlocks(&actual[0], s, rowWidth, blockRows);
+			if (!TexBenchSame(k.name, texBenchNames[TEXBENCH_UNSWIZZLE], (int)bytes, &expected[0], &actual[0], compareBytes))
+				failures++;
+		}
+	}
+
+	printf("Checked %d kernel sets with %d random inputs each: %d mismatches\n", numSets, trials, failures);
+
+	const int benchPixels = 512 * 512;
+	const int rounds = 50;
+	std::vector<u32> benchSrc(benchPixels), benchDst(benchPixels);
+	TexBenchFill(&benchSrc[0], benchSrc.size() * sizeof(u32));
+	for (int kernel = 0; kernel < TEXBENCH_NUM_KERNELS; kernel++)
+	{
+		for (int i = 0; i < numSets; i++)
+		{
+			const TextureDecoderKernels &k = sets[i];
+			if (!TexBenchHas(k, kernel))
+				continue;
+			// Unswizzling takes a byte count, the rest take pixels.
+			int count = kernel == TEXBENCH_UNSWIZZLE ? benchPixels * 4 : benchPixels;
+			size_t written = 0;
+			double start = time_now_d();
+			for (int r = 0; r < rounds; r++)
+				written += TexBenchRun(k, kernel, &benchDst[0], (const u8 *)&benchSrc[0], count, pal16, pal32);
+			double elapsed = time_now_d() - start;
+			printf("%-16s %-6s %8.1f MB/s\n", texBenchNames[kernel], k.name, elapsed > 0.0 ? written / elapsed / (1024.0 * 1024.0) : 0.0);
+		}
+	}
+
+	return failures == 0;
+}
+
+static FILE *frameHashFile = 0;
+static bool reportSpeed = false;
+static double runStartTime = 0.0;
+static int runStartFrame = 0;
+
+// Games end with exit(), so this runs from atexit.
+static void FinishRun()
+{
+	if (reportSpeed)
+	{
+		double runTime = time_now_d() - runStartTime;
+		int runFrames = gpuStats.numFrames - runStartFrame;
+		fprintf(stderr, "Emulated %d frames in %0.2f s (%0.1f frames/sec)\n", runFrames, runTime, runTime > 0.0 ? runFrames / runTime : 0.0);
+	}
+
+	bool playing = Replay_IsPlaying();
+	Replay_End();
+	if (Replay_HasDesynced())
+		fprintf(stderr, "Replay desynced\n");
+	else if (playing)
+		fprintf(stderr, "Replay finished\n");
+	if (frameHashFile)
+	{
+		fclose(frameHashFile);
+		frameHashFile = 0;
+	}
+}
+
 int main(int argc, const char* argv[])
 {
 	bool fullLog = false;
 	bool useJit = false;
 	bool fastInterpreter = false;
+	bool blockInterpreter = false;
 	bool autoCompare = false;
+	bool benchJitCache = false;
+	bool benchCoreTiming = false;
+	bool benchRewind = false;
+	bool benchTexDecode = false;
+	bool jitDiskCache = false;
+	int tieredThreshold = 0;
+	bool hleStats = false;
+	bool schedTrace = false;
+	const char *stateLoad = 0;
+	const char *stateSave = 0;
+	int stateFrame = 60;
+	const char *replayRecord = 0;
+	const char *replayPlay = 0;
+	const char *frameHashes = 0;
+	bool fastForward = false;
+	int frameSkip = 0;
 	
 	const char *bootFilename = 0;
 	const char *mountIso = 0;
@@ -112,8 +560,45 @@ int main(int argc, const char* argv[])
 			useJit = true;
 		else if (!strcmp(argv[i], "-f"))
 			fastInterpreter = true;
+		else if (!strcmp(argv[i], "-b"))
+			blockInterpreter = true;
 		else if (!strcmp(argv[i], "-c") || !strcmp(argv[i], "--compare"))
 			autoCompare = true;
+		else if (!strcmp(argv[i], "--bench-jitcache"))
+			benchJitCache = true;
+		else if (!strcmp(argv[i], "--bench-coretiming"))
+			benchCoreTiming = true;
+		else if (!strcmp(argv[i], "--bench-rewind"))
+			benchRewind = true;
+		else if (!strcmp(argv[i], "--bench-texdecode"))
+			benchTexDecode = true;
+		else if (!strcmp(argv[i], "--jit-diskcache"))
+			jitDiskCache = true;
+		else if (!strncmp(argv[i], "--tiered=", strlen("--tiered=")))
+		{
+			tieredThreshold = atoi(argv[i] + strlen("--tiered="));
+			useJit = true;
+		}
+		else if (!strcmp(argv[i], "--hle-stats"))
+			hleStats = true;
+		else if (!strcmp(argv[i], "--sched-trace"))
+			schedTrace = true;
+		else if (!strncmp(argv[i], "--state-load=", strlen("--state-load=")))
+			stateLoad = argv[i] + strlen("--state-load=");
+		else if (!strncmp(argv[i], "--state-save=", strlen("--state-save=")))
+			stateSave = argv[i] + strlen("--state-save=");
+		else if (!strncmp(argv[i], "--state-frame=", strlen("--state-frame=")))
+			stateFrame = atoi(argv[i] + strlen("--state-frame="));
+		else if (!strncmp(argv[i], "--replay-record=", strlen("--replay-record=")))
+			replayRecord = argv[i] + strlen("--replay-record=");
+		else if (!strncmp(argv[i], "--replay-play=", strlen("--replay-play=")))
+			replayPlay = argv[i] + strlen("--replay-play=");
+		else if (!strncmp(argv[i], "--frame-hashes=", strlen("--frame-hashes=")))
+			frameHashes = argv[i] + strlen("--frame-hashes=");
+		else if (!strcmp(argv[i], "--fast-forward"))
+			fastForward = true;
+		else if (!strncmp(argv[i], "--frameskip=", strlen("--frameskip=")))
+			frameSkip = atoi(argv[i] + strlen("--frameskip="));
 		else if (bootFilename == 0)
 			bootFilename = argv[i];
 		else
@@ -134,6 +619,12 @@ int main(int argc, const char* argv[])
 		printUsage(argv[0], "Missing argument after -m");
 		return 1;
 	}
+	// Doesn't need an executable or the emulator running.
+	if (benchTexDecode)
+	{
+		TextureDecoder_Init();
+		return RunTexDecodeBenchmark() ? 0 : 1;
+	}
 	if (!bootFilename)
 	{
 		printUsage(argv[0], argc <= 1 ? NULL : "No executable specified");
@@ -159,7 +650,13 @@ int main(int argc, const char* argv[])
 	coreParameter.fileToStart = bootFilename;
 	coreParameter.mountIso = mountIso ? mountIso : "";
 	coreParameter.startPaused = false;
-	coreParameter.cpuCore = useJit ? CPU_JIT : (fastInterpreter ? CPU_FASTINTERPRETER : CPU_INTERPRETER);
+	coreParameter.cpuCore = CPU_INTERPRETER;
+	if (useJit || benchJitCache)
+		coreParameter.cpuCore = CPU_JIT;
+	else if (blockInterpreter)
+		coreParameter.cpuCore = CPU_BLOCKINTERPRETER;
+	else if (fastInterpreter)
+		coreParameter.cpuCore = CPU_FASTINTERPRETER;
 	coreParameter.gpuCore = GPU_NULL;
 	coreParameter.enableSound = false;
 	coreParameter.headLess = true;
@@ -168,6 +665,12 @@ int main(int argc, const char* argv[])
 	g_Config.bEnableSound = false;
 	g_Config.bFirstRun = false;
 	g_Config.bIgnoreBadMemAccess = true;
+	g_Config.bFastMemory = true;
+	g_Config.bJitDiskCache = jitDiskCache;
+	g_Config.iTieredJitThreshold = tieredThreshold;
+	g_Config.bFastForward = fastForward;
+	g_Config.iFrameSkip = frameSkip;
+	EnableSyscallStats(hleStats);
 
 	std::string error_string;
 
@@ -177,14 +680,74 @@ int main(int argc, const char* argv[])
 		return 1;
 	}
 
+	if (benchJitCache)
+	{
+		RunJitCacheBenchmark();
+		PSP_Shutdown();
+		return 0;
+	}
+
+	if (benchCoreTiming)
+	{
+		RunCoreTimingBenchmark();
+		PSP_Shutdown();
+		return 0;
+	}
+
+	if (benchRewind)
+	{
+		RunRewindBenchmark();
+		PSP_Shutdown();
+		return 0;
+	}
+
+	if (stateLoad && !SaveState::Load(stateLoad))
+	{
+		fprintf(stderr, "Failed to load state %s\n", stateLoad);
+		printf("TESTERROR\n");
+		PSP_Shutdown();
+		return 1;
+	}
+
+	// After loading a state, so a replay can start from one.
+	if ((replayRecord && !Replay_BeginRecord(replayRecord)) || (replayPlay && !Replay_BeginPlayback(replayPlay)))
+	{
+		printf("TESTERROR\n");
+		PSP_Shutdown();
+		return 1;
+	}
+	if (frameHashes)
+		frameHashFile = fopen(frameHashes, "w");
+	atexit(&FinishRun);
+
+	// Frames are counted from here, after boot and any state load.
+	reportSpeed = fastForward;
+	// The texture and vertex caches age entries by this counter, so leave it running.
+	runStartFrame = gpuStats.numFrames;
+	runStartTime = time_now_d();
+
 	coreState = CORE_RUNNING;
 
+	int frames = 0;
 	while (coreState == CORE_RUNNING)
 	{
 		// Run for a frame at a time, just because.
 		u64 nowTicks = CoreTiming::GetTicks();
 		u64 frameTicks = usToCycles(1000000/60);
 		mipsr4k.RunLoopUntil(nowTicks + frameTicks);
+		++frames;
+
+		if (frameHashFile)
+			fprintf(frameHashFile, "%d %08x\n", frames, __DisplayGetFrameHash());
+
+		if (stateSave && frames == stateFrame)
+		{
+			double start = time_now_d();
+			if (SaveState::Save(stateSave))
+				fprintf(stderr, "Saved state %s at frame %d in %0.2f ms\n", stateSave, frames, (time_now_d() - start) * 1000.0);
+			else
+				fprintf(stderr, "Failed to save state %s\n", stateSave);
+		}
 
 		// If we were rendering, this might be a nice time to do something about it.
 		if (coreState == CORE_NEXTFRAME)
@@ -193,6 +756,18 @@ int main(int argc, const char* argv[])
 
 	// NOTE: we won't get here until I've gotten rid of the exit(0) in sceExitProcess or whatever it's called
 
+	if (tieredThreshold > 0 && MIPSComp::jit)
+	{
+		const MIPSComp::JitTierStats &stats = MIPSComp::jit->GetTierStats();
+		fprintf(stderr, "Interpreter: %u block runs, %0.2f ms\n", stats.interpretedRuns, stats.interpretTime * 1000.0);
+		fprintf(stderr, "Compiler: %u blocks (%u promoted), %0.2f ms\n", stats.compiledBlocks, stats.promotedBlocks, stats.compileTime * 1000.0);
+		fprintf(stderr, "Jit: %0.2f ms\n", stats.jitTime * 1000.0);
+	}
+	if (hleStats)
+		fprintf(stderr, "%s", GetSyscallStatsSummary().c_str());
+	if (schedTrace)
+		fprintf(stderr, "%s", __KernelGetRescheduleTrace().c_str());
+
 	PSP_Shutdown();
 
 	if (autoCompare)